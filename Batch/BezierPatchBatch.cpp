@@ -0,0 +1,350 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "BezierPatchBatch.h"
+#include "BezierSimd.h"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MN_SIMD_X86
+#endif
+
+// Lane loops of each level are compiled for its own instruction set, regardless of compiler flags of this file
+#if defined(__GNUC__) || defined(__clang__)
+#define MN_SIMD_TARGET_ATTR(isa) __attribute__((target(isa)))
+#else
+#define MN_SIMD_TARGET_ATTR(isa)
+#endif
+
+#define MN_SIMD_NS Scalar
+#define MN_SIMD_TARGET
+#include "BezierPatchBatchKernel.inl"
+#undef MN_SIMD_NS
+#undef MN_SIMD_TARGET
+
+#ifdef MN_SIMD_X86
+#define MN_SIMD_NS AVX2
+#define MN_SIMD_TARGET MN_SIMD_TARGET_ATTR("avx2,fma")
+#include "BezierPatchBatchKernel.inl"
+#undef MN_SIMD_NS
+#undef MN_SIMD_TARGET
+
+#define MN_SIMD_NS AVX512
+#define MN_SIMD_TARGET MN_SIMD_TARGET_ATTR("avx512f")
+#include "BezierPatchBatchKernel.inl"
+#undef MN_SIMD_NS
+#undef MN_SIMD_TARGET
+#endif
+
+namespace MN {
+	// Lane loops for instruction set chosen by [ BezierSimd::getLevel ], where SSE2 is baseline of scalar build on x86-64
+	class LaneKernels {
+	public:
+		void (*addScaled)(Real, const Real*, const Real*, const Real*, Real*, Real*, Real*, int);
+		void (*addWeighted)(const Real*, const Real*, const Real*, const Real*, Real*, Real*, Real*, int);
+		void (*multiply)(const Real*, const Real*, Real*, int);
+	};
+	static LaneKernels getLaneKernels() noexcept {
+		switch (BezierSimd::getLevel()) {
+#ifdef MN_SIMD_X86
+		case BezierSimd::Level::AVX512:
+			return { BezierPatchBatchImpl::AVX512::addScaled, BezierPatchBatchImpl::AVX512::addWeighted, BezierPatchBatchImpl::AVX512::multiply };
+		case BezierSimd::Level::AVX2:
+			return { BezierPatchBatchImpl::AVX2::addScaled, BezierPatchBatchImpl::AVX2::addWeighted, BezierPatchBatchImpl::AVX2::multiply };
+#endif
+		default:
+			return { BezierPatchBatchImpl::Scalar::addScaled, BezierPatchBatchImpl::Scalar::addWeighted, BezierPatchBatchImpl::Scalar::multiply };
+		}
+	}
+
+	void BezierPatchBatch::allocate(int dimension, int uDegree, int vDegree, int wDegree, int size) {
+		this->dimension = dimension;
+		this->uDegree = uDegree;
+		this->vDegree = vDegree;
+		this->wDegree = wDegree;
+		this->size = size;
+		stride = ((size + laneAlign - 1) / laneAlign) * laneAlign;
+
+		int cptsNum = (uDegree + 1) * (vDegree + 1) * (wDegree + 1);
+		data.assign((size_t)cptsNum * 3 * stride, 0.0);
+	}
+	void BezierPatchBatch::setPatch(int lane, const BezierSurface3d& surface) {
+		if (surface.getDegree(0) != uDegree || surface.getDegree(1) != vDegree)
+			throw(std::runtime_error("Every patch in Bezier patch batch must have same degree"));
+
+		const auto& cpts = surface.getCptsC();
+		int k = 0;
+		for (int i = 0; i <= uDegree; i++) {
+			for (int j = 0; j <= vDegree; j++) {
+				for (int c = 0; c < 3; c++)
+					data[(size_t)(k * 3 + c) * stride + lane] = cpts[i][j][c];
+				k++;
+			}
+		}
+	}
+	void BezierPatchBatch::setPatch(int lane, const BezierVolume3d& volume) {
+		if (volume.getDegree(0) != uDegree || volume.getDegree(1) != vDegree || volume.getDegree(2) != wDegree)
+			throw(std::runtime_error("Every patch in Bezier patch batch must have same degree"));
+
+		const auto& cpts = volume.getCptsC();
+		int n = 0;
+		for (int i = 0; i <= uDegree; i++) {
+			for (int j = 0; j <= vDegree; j++) {
+				for (int k = 0; k <= wDegree; k++) {
+					for (int c = 0; c < 3; c++)
+						data[(size_t)(n * 3 + c) * stride + lane] = cpts[i][j][k][c];
+					n++;
+				}
+			}
+		}
+	}
+
+	BezierPatchBatch BezierPatchBatch::create(const std::vector<BsplineSurface3d::Patch>& patches) {
+		std::vector<BezierSurface3d::Ptr> surfaces;
+		surfaces.reserve(patches.size());
+		for (const auto& patch : patches)
+			surfaces.push_back(patch.patch);
+		return create(surfaces);
+	}
+	BezierPatchBatch BezierPatchBatch::create(const std::vector<BsplineVolume3d::Patch>& patches) {
+		std::vector<BezierVolume3d::Ptr> volumes;
+		volumes.reserve(patches.size());
+		for (const auto& patch : patches)
+			volumes.push_back(patch.patch);
+		return create(volumes);
+	}
+	BezierPatchBatch BezierPatchBatch::create(const std::vector<BezierSurface3d::Ptr>& surfaces) {
+		if (surfaces.empty())
+			throw(std::runtime_error("Cannot create Bezier patch batch from empty patches"));
+
+		BezierPatchBatch batch;
+		batch.allocate(2, surfaces[0]->getDegree(0), surfaces[0]->getDegree(1), 0, (int)surfaces.size());
+		for (int i = 0; i < batch.size; i++)
+			batch.setPatch(i, *surfaces[i]);
+		return batch;
+	}
+	BezierPatchBatch BezierPatchBatch::create(const std::vector<BezierVolume3d::Ptr>& volumes) {
+		if (volumes.empty())
+			throw(std::runtime_error("Cannot create Bezier patch batch from empty patches"));
+
+		BezierPatchBatch batch;
+		batch.allocate(3, volumes[0]->getDegree(0), volumes[0]->getDegree(1), volumes[0]->getDegree(2), (int)volumes.size());
+		for (int i = 0; i < batch.size; i++)
+			batch.setPatch(i, *volumes[i]);
+		return batch;
+	}
+
+	void BezierPatchBatch::padLanes(const std::vector<Real>& params, std::vector<Real>& lanes) const {
+		if ((int)params.size() < size)
+			throw(std::runtime_error("Bezier patch batch needs one parameter per patch"));
+		lanes.assign(stride, 0.0);
+		std::copy(params.begin(), params.begin() + size, lanes.begin());
+	}
+	void BezierPatchBatch::calLaneBasis(const std::vector<Real>& t, int degree, int order, std::vector<Real>& basis) const {
+		// Same recurrences as Bezier::calBasisDerivVector, but every step runs over all lanes
+		std::vector<Real> lanes;
+		padLanes(t, lanes);
+
+		basis.assign((size_t)(degree + 1) * stride, 0.0);
+		if (order > degree)
+			return;
+
+		const Real* tl = lanes.data();
+		Real* b = basis.data();
+		for (int l = 0; l < stride; l++)
+			b[l] = 1.0;
+
+		// Bernstein basis of (degree - order) by triangular recurrence : B(i, d) = (1 - t) * B(i, d - 1) + t * B(i - 1, d - 1)
+		int base = degree - order;
+		for (int d = 1; d <= base; d++) {
+			for (int i = d; i >= 0; i--) {
+				Real* bi = b + (size_t)i * stride;
+				if (i == 0) {
+					for (int l = 0; l < stride; l++)
+						bi[l] = (1.0 - tl[l]) * bi[l];
+					continue;
+				}
+				// Row (i - 1) exists only from here, as pointer before [b] is not valid even if unused
+				const Real* bp = b + (size_t)(i - 1) * stride;
+				if (i == d) {
+					for (int l = 0; l < stride; l++)
+						bi[l] = tl[l] * bp[l];
+				}
+				else {
+					for (int l = 0; l < stride; l++)
+						bi[l] = (1.0 - tl[l]) * bi[l] + tl[l] * bp[l];
+				}
+			}
+		}
+		// Differentiate : D(i, d) = d * (B(i - 1, d - 1) - B(i, d - 1))
+		for (int d = base + 1; d <= degree; d++) {
+			for (int i = d; i >= 0; i--) {
+				Real* bi = b + (size_t)i * stride;
+				if (i == 0) {
+					for (int l = 0; l < stride; l++)
+						bi[l] = -d * bi[l];
+					continue;
+				}
+				const Real* bp = b + (size_t)(i - 1) * stride;
+				if (i == d) {
+					for (int l = 0; l < stride; l++)
+						bi[l] = d * bp[l];
+				}
+				else {
+					for (int l = 0; l < stride; l++)
+						bi[l] = d * (bp[l] - bi[l]);
+				}
+			}
+		}
+	}
+
+	void BezierPatchBatch::contract(const BasisVector& uBasis, const BasisVector& vBasis, const BasisVector& wBasis, Points& out) const {
+		int uNum = uDegree + 1, vNum = vDegree + 1, wNum = wDegree + 1;
+
+		// Tensor product weights are same for all lanes, so they are computed only once
+		BasisVector weights((size_t)uNum * vNum * wNum);
+		int k = 0;
+		for (int i = 0; i < uNum; i++)
+			for (int j = 0; j < vNum; j++)
+				for (int m = 0; m < wNum; m++)
+					weights[k++] = uBasis[i] * vBasis[j] * (dimension == 3 ? wBasis[m] : 1.0);
+
+		out.resize(stride);
+		std::fill(out.x.begin(), out.x.end(), 0.0);
+		std::fill(out.y.begin(), out.y.end(), 0.0);
+		std::fill(out.z.begin(), out.z.end(), 0.0);
+
+		LaneKernels kernels = getLaneKernels();
+		int cptsNum = (int)weights.size();
+		for (int lBeg = 0; lBeg < stride; lBeg += laneBlock) {
+			int lNum = std::min(laneBlock, stride - lBeg);
+			Real* ox = out.x.data() + lBeg;
+			Real* oy = out.y.data() + lBeg;
+			Real* oz = out.z.data() + lBeg;
+			for (k = 0; k < cptsNum; k++) {
+				Real wk = weights[k];
+				if (wk == 0.0)
+					continue;
+				const Real* px = data.data() + (size_t)(k * 3) * stride + lBeg;
+				kernels.addScaled(wk, px, px + stride, px + 2 * (size_t)stride, ox, oy, oz, lNum);
+			}
+		}
+	}
+	void BezierPatchBatch::contractLanes(const std::vector<Real>& uBasis, const std::vector<Real>& vBasis, const std::vector<Real>& wBasis, Points& out) const {
+		int uNum = uDegree + 1, vNum = vDegree + 1, wNum = wDegree + 1;
+
+		out.resize(stride);
+		std::fill(out.x.begin(), out.x.end(), 0.0);
+		std::fill(out.y.begin(), out.y.end(), 0.0);
+		std::fill(out.z.begin(), out.z.end(), 0.0);
+
+		LaneKernels kernels = getLaneKernels();
+		Real uv[laneBlock];
+		Real weight[laneBlock];
+		for (int lBeg = 0; lBeg < stride; lBeg += laneBlock) {
+			int lNum = std::min(laneBlock, stride - lBeg);
+			Real* ox = out.x.data() + lBeg;
+			Real* oy = out.y.data() + lBeg;
+			Real* oz = out.z.data() + lBeg;
+
+			int k = 0;
+			for (int i = 0; i < uNum; i++) {
+				const Real* bu = uBasis.data() + (size_t)i * stride + lBeg;
+				for (int j = 0; j < vNum; j++) {
+					const Real* bv = vBasis.data() + (size_t)j * stride + lBeg;
+					kernels.multiply(bu, bv, uv, lNum);
+
+					for (int m = 0; m < wNum; m++) {
+						const Real* wk = uv;
+						if (dimension == 3) {
+							const Real* bw = wBasis.data() + (size_t)m * stride + lBeg;
+							kernels.multiply(uv, bw, weight, lNum);
+							wk = weight;
+						}
+						const Real* px = data.data() + (size_t)(k * 3) * stride + lBeg;
+						kernels.addWeighted(wk, px, px + stride, px + 2 * (size_t)stride, ox, oy, oz, lNum);
+						k++;
+					}
+				}
+			}
+		}
+	}
+
+	void BezierPatchBatch::evaluate(Real u, Real v, Points& out) const {
+		differentiate(u, v, 0, 0, out);
+	}
+	void BezierPatchBatch::evaluate(Real u, Real v, Real w, Points& out) const {
+		differentiate(u, v, w, 0, 0, 0, out);
+	}
+	void BezierPatchBatch::differentiate(Real u, Real v, int uOrder, int vOrder, Points& out) const {
+		if (dimension != 2)
+			throw(std::runtime_error("Bezier patch batch of volumes needs three parameters"));
+		BasisVector uBasis, vBasis, wBasis;
+		Bezier::calBasisDerivVector(u, uDegree, uOrder, uBasis);
+		Bezier::calBasisDerivVector(v, vDegree, vOrder, vBasis);
+		contract(uBasis, vBasis, wBasis, out);
+	}
+	void BezierPatchBatch::differentiate(Real u, Real v, Real w, int uOrder, int vOrder, int wOrder, Points& out) const {
+		if (dimension != 3)
+			throw(std::runtime_error("Bezier patch batch of surfaces needs two parameters"));
+		BasisVector uBasis, vBasis, wBasis;
+		Bezier::calBasisDerivVector(u, uDegree, uOrder, uBasis);
+		Bezier::calBasisDerivVector(v, vDegree, vOrder, vBasis);
+		Bezier::calBasisDerivVector(w, wDegree, wOrder, wBasis);
+		contract(uBasis, vBasis, wBasis, out);
+	}
+
+	void BezierPatchBatch::evaluate(const std::vector<Real>& u, const std::vector<Real>& v, Points& out) const {
+		differentiate(u, v, 0, 0, out);
+	}
+	void BezierPatchBatch::evaluate(const std::vector<Real>& u, const std::vector<Real>& v, const std::vector<Real>& w, Points& out) const {
+		differentiate(u, v, w, 0, 0, 0, out);
+	}
+	void BezierPatchBatch::differentiate(const std::vector<Real>& u, const std::vector<Real>& v, int uOrder, int vOrder, Points& out) const {
+		if (dimension != 2)
+			throw(std::runtime_error("Bezier patch batch of volumes needs three parameters"));
+		std::vector<Real> uBasis, vBasis, wBasis;
+		calLaneBasis(u, uDegree, uOrder, uBasis);
+		calLaneBasis(v, vDegree, vOrder, vBasis);
+		contractLanes(uBasis, vBasis, wBasis, out);
+	}
+	void BezierPatchBatch::differentiate(const std::vector<Real>& u, const std::vector<Real>& v, const std::vector<Real>& w, int uOrder, int vOrder, int wOrder, Points& out) const {
+		if (dimension != 3)
+			throw(std::runtime_error("Bezier patch batch of surfaces needs two parameters"));
+		std::vector<Real> uBasis, vBasis, wBasis;
+		calLaneBasis(u, uDegree, uOrder, uBasis);
+		calLaneBasis(v, vDegree, vOrder, vBasis);
+		calLaneBasis(w, wDegree, wOrder, wBasis);
+		contractLanes(uBasis, vBasis, wBasis, out);
+	}
+
+	void BezierPatchBatch::centers(Points& out) const {
+		if (dimension == 2)
+			evaluate(0.5, 0.5, out);
+		else
+			evaluate(0.5, 0.5, 0.5, out);
+	}
+	void BezierPatchBatch::normals(Real u, Real v, Points& out) const {
+		Points su, sv;
+		differentiate(u, v, 1, 0, su);
+		differentiate(u, v, 0, 1, sv);
+
+		out.resize(stride);
+		for (int l = 0; l < stride; l++) {
+			Real
+				x = su.y[l] * sv.z[l] - su.z[l] * sv.y[l],
+				y = su.z[l] * sv.x[l] - su.x[l] * sv.z[l],
+				z = su.x[l] * sv.y[l] - su.y[l] * sv.x[l],
+				len = sqrt(x * x + y * y + z * z),
+				inv = (len > 0.0) ? 1.0 / len : 0.0;
+			out.x[l] = x * inv;
+			out.y[l] = y * inv;
+			out.z[l] = z * inv;
+		}
+	}
+}
@@ -0,0 +1,127 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_BEZIER_PATCH_BATCH_H__
+#define __MN_BEZIER_PATCH_BATCH_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "../Surface/BsplineSurface3d.h"
+#include "../Volume/BsplineVolume3d.h"
+#include <vector>
+
+namespace MN {
+	/*
+	 * Batch of same-degree Bezier surfaces or volumes in structure-of-arrays layout.
+	 * Each patch occupies one lane, and same coordinate of same control point of every patch is stored contiguously.
+	 * Therefore every inner loop runs over lanes on consecutive memory, which is vectorized across patches.
+	 * Lane loops are compiled for AVX2 and AVX-512 as well, and chosen at runtime by [ BezierSimd::getLevel ].
+	 * Parameters are given in local Bezier domain [0, 1] of each patch.
+	 */
+	class BezierPatchBatch {
+	public:
+		// Number of lanes is padded to multiple of this value : 8 doubles fill one AVX-512 register
+		const static int laneAlign = 8;
+		// Lanes are processed in blocks of this size, so that output and basis of a block stay in cache
+		const static int laneBlock = 256;
+
+		// Points in structure-of-arrays layout : i-th point is (x[i], y[i], z[i])
+		class Points {
+		public:
+			std::vector<Real> x;
+			std::vector<Real> y;
+			std::vector<Real> z;
+
+			inline void resize(int size) {
+				x.resize(size);
+				y.resize(size);
+				z.resize(size);
+			}
+			inline int size() const noexcept {
+				return (int)x.size();
+			}
+			inline Vec3 at(int i) const noexcept {
+				return { x[i], y[i], z[i] };
+			}
+		};
+	private:
+		BezierPatchBatch() = default;
+
+		int dimension = 0;	// 2 for surface, 3 for volume
+		int uDegree = 0;
+		int vDegree = 0;
+		int wDegree = 0;	// Always 0 for surface
+		int size = 0;		// Number of patches
+		int stride = 0;		// Number of lanes, [size] padded to multiple of [laneAlign]
+
+		// Coordinate [c] of [k]-th control point of [l]-th patch is at [ (k * 3 + c) * stride + l ]
+		// Control points are ordered as cpts[i][j] or cpts[i][j][k] of original patch
+		std::vector<Real> data;
+
+		void allocate(int dimension, int uDegree, int vDegree, int wDegree, int size);
+		void setPatch(int lane, const BezierSurface3d& surface);
+		void setPatch(int lane, const BezierVolume3d& volume);
+
+		void padLanes(const std::vector<Real>& params, std::vector<Real>& lanes) const;
+		void calLaneBasis(const std::vector<Real>& t, int degree, int order, std::vector<Real>& basis) const;
+
+		// Contract control points with tensor product of given basis, same basis for all lanes
+		void contract(const BasisVector& uBasis, const BasisVector& vBasis, const BasisVector& wBasis, Points& out) const;
+		// Contract control points with tensor product of given basis, which are given per lane : basis[i * stride + lane]
+		void contractLanes(const std::vector<Real>& uBasis, const std::vector<Real>& vBasis, const std::vector<Real>& wBasis, Points& out) const;
+	public:
+		static BezierPatchBatch create(const std::vector<BsplineSurface3d::Patch>& patches);
+		static BezierPatchBatch create(const std::vector<BsplineVolume3d::Patch>& patches);
+		static BezierPatchBatch create(const std::vector<BezierSurface3d::Ptr>& surfaces);
+		static BezierPatchBatch create(const std::vector<BezierVolume3d::Ptr>& volumes);
+
+		inline int getDimension() const noexcept {
+			return dimension;
+		}
+		inline int getSize() const noexcept {
+			return size;
+		}
+		inline int getStride() const noexcept {
+			return stride;
+		}
+		// Direction : 0 for U, 1 for V, 2 for W
+		inline int getDegree(int dir) const noexcept {
+			if (dir == 0)
+				return uDegree;
+			else if (dir == 1)
+				return vDegree;
+			else
+				return wDegree;
+		}
+		inline const std::vector<Real>& getData() const noexcept {
+			return data;
+		}
+
+		// Same parameter for every patch : basis is computed once and shared across lanes
+		// Output has [stride] points, and only first [size] of them are meaningful
+		void evaluate(Real u, Real v, Points& out) const;
+		void evaluate(Real u, Real v, Real w, Points& out) const;
+		void differentiate(Real u, Real v, int uOrder, int vOrder, Points& out) const;
+		void differentiate(Real u, Real v, Real w, int uOrder, int vOrder, int wOrder, Points& out) const;
+
+		// One parameter per patch : [i]-th parameter is evaluated on [i]-th patch
+		void evaluate(const std::vector<Real>& u, const std::vector<Real>& v, Points& out) const;
+		void evaluate(const std::vector<Real>& u, const std::vector<Real>& v, const std::vector<Real>& w, Points& out) const;
+		void differentiate(const std::vector<Real>& u, const std::vector<Real>& v, int uOrder, int vOrder, Points& out) const;
+		void differentiate(const std::vector<Real>& u, const std::vector<Real>& v, const std::vector<Real>& w, int uOrder, int vOrder, int wOrder, Points& out) const;
+
+		// Per-patch quantities
+		void centers(Points& out) const;					// Point at parameter center of every patch
+		void normals(Real u, Real v, Points& out) const;	// Unit normal of every surface patch, e.g) corner normals with (0, 0)
+	};
+}
+
+#endif
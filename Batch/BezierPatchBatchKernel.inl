@@ -0,0 +1,39 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+// Lane loops of BezierPatchBatch, included once per instruction set by BezierPatchBatch.cpp.
+// Loops are plain so that compiler vectorizes them with register width of [ MN_SIMD_TARGET ],
+// which is target attribute of namespace [ MN_SIMD_NS ]. Arrays must not overlap, so they are marked [ __restrict ].
+
+namespace MN {
+	namespace BezierPatchBatchImpl {
+		namespace MN_SIMD_NS {
+			// o += w * p, with weight shared by all lanes
+			MN_SIMD_TARGET static void addScaled(Real w, const Real* __restrict px, const Real* __restrict py, const Real* __restrict pz, Real* __restrict ox, Real* __restrict oy, Real* __restrict oz, int num) {
+				for (int l = 0; l < num; l++) {
+					ox[l] += w * px[l];
+					oy[l] += w * py[l];
+					oz[l] += w * pz[l];
+				}
+			}
+			// o += w * p, with weight given per lane
+			MN_SIMD_TARGET static void addWeighted(const Real* __restrict w, const Real* __restrict px, const Real* __restrict py, const Real* __restrict pz, Real* __restrict ox, Real* __restrict oy, Real* __restrict oz, int num) {
+				for (int l = 0; l < num; l++) {
+					ox[l] += w[l] * px[l];
+					oy[l] += w[l] * py[l];
+					oz[l] += w[l] * pz[l];
+				}
+			}
+			// out = a * b
+			MN_SIMD_TARGET static void multiply(const Real* __restrict a, const Real* __restrict b, Real* __restrict out, int num) {
+				for (int l = 0; l < num; l++)
+					out[l] = a[l] * b[l];
+			}
+		}
+	}
+}
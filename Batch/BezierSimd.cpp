@@ -0,0 +1,219 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "BezierSimd.h"
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MN_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// Kernels of each level are compiled for its own instruction set, regardless of compiler flags of this file
+#if defined(__GNUC__) || defined(__clang__)
+#define MN_SIMD_TARGET_ATTR(isa) __attribute__((target(isa)))
+#else
+#define MN_SIMD_TARGET_ATTR(isa)
+#endif
+
+// ============================================================= Scalar
+namespace MN {
+	namespace BezierSimdImpl {
+		namespace Scalar {
+			using Pack = Real;
+			const int width = 1;
+			static inline Pack load(const Real* p) { return *p; }
+			static inline void store(Real* p, Pack a) { *p = a; }
+			static inline Pack set1(Real a) { return a; }
+			static inline Pack add(Pack a, Pack b) { return a + b; }
+			static inline Pack sub(Pack a, Pack b) { return a - b; }
+			static inline Pack mul(Pack a, Pack b) { return a * b; }
+			static inline Pack fmadd(Pack a, Pack b, Pack c) { return a * b + c; }
+		}
+	}
+}
+#define MN_SIMD_NS Scalar
+#define MN_SIMD_TARGET
+#include "BezierSimdKernel.inl"
+#undef MN_SIMD_NS
+#undef MN_SIMD_TARGET
+
+#ifdef MN_SIMD_X86
+// ============================================================= SSE2
+#define MN_SIMD_TARGET MN_SIMD_TARGET_ATTR("sse2")
+namespace MN {
+	namespace BezierSimdImpl {
+		namespace SSE2 {
+			using Pack = __m128d;
+			const int width = 2;
+			MN_SIMD_TARGET static inline Pack load(const Real* p) { return _mm_loadu_pd(p); }
+			MN_SIMD_TARGET static inline void store(Real* p, Pack a) { _mm_storeu_pd(p, a); }
+			MN_SIMD_TARGET static inline Pack set1(Real a) { return _mm_set1_pd(a); }
+			MN_SIMD_TARGET static inline Pack add(Pack a, Pack b) { return _mm_add_pd(a, b); }
+			MN_SIMD_TARGET static inline Pack sub(Pack a, Pack b) { return _mm_sub_pd(a, b); }
+			MN_SIMD_TARGET static inline Pack mul(Pack a, Pack b) { return _mm_mul_pd(a, b); }
+			MN_SIMD_TARGET static inline Pack fmadd(Pack a, Pack b, Pack c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+		}
+	}
+}
+#define MN_SIMD_NS SSE2
+#include "BezierSimdKernel.inl"
+#undef MN_SIMD_NS
+#undef MN_SIMD_TARGET
+
+// ============================================================= AVX2
+#define MN_SIMD_TARGET MN_SIMD_TARGET_ATTR("avx2,fma")
+namespace MN {
+	namespace BezierSimdImpl {
+		namespace AVX2 {
+			using Pack = __m256d;
+			const int width = 4;
+			MN_SIMD_TARGET static inline Pack load(const Real* p) { return _mm256_loadu_pd(p); }
+			MN_SIMD_TARGET static inline void store(Real* p, Pack a) { _mm256_storeu_pd(p, a); }
+			MN_SIMD_TARGET static inline Pack set1(Real a) { return _mm256_set1_pd(a); }
+			MN_SIMD_TARGET static inline Pack add(Pack a, Pack b) { return _mm256_add_pd(a, b); }
+			MN_SIMD_TARGET static inline Pack sub(Pack a, Pack b) { return _mm256_sub_pd(a, b); }
+			MN_SIMD_TARGET static inline Pack mul(Pack a, Pack b) { return _mm256_mul_pd(a, b); }
+			MN_SIMD_TARGET static inline Pack fmadd(Pack a, Pack b, Pack c) { return _mm256_fmadd_pd(a, b, c); }
+		}
+	}
+}
+#define MN_SIMD_NS AVX2
+#include "BezierSimdKernel.inl"
+#undef MN_SIMD_NS
+#undef MN_SIMD_TARGET
+
+// ============================================================= AVX-512
+#define MN_SIMD_TARGET MN_SIMD_TARGET_ATTR("avx512f")
+namespace MN {
+	namespace BezierSimdImpl {
+		namespace AVX512 {
+			using Pack = __m512d;
+			const int width = 8;
+			MN_SIMD_TARGET static inline Pack load(const Real* p) { return _mm512_loadu_pd(p); }
+			MN_SIMD_TARGET static inline void store(Real* p, Pack a) { _mm512_storeu_pd(p, a); }
+			MN_SIMD_TARGET static inline Pack set1(Real a) { return _mm512_set1_pd(a); }
+			MN_SIMD_TARGET static inline Pack add(Pack a, Pack b) { return _mm512_add_pd(a, b); }
+			MN_SIMD_TARGET static inline Pack sub(Pack a, Pack b) { return _mm512_sub_pd(a, b); }
+			MN_SIMD_TARGET static inline Pack mul(Pack a, Pack b) { return _mm512_mul_pd(a, b); }
+			MN_SIMD_TARGET static inline Pack fmadd(Pack a, Pack b, Pack c) { return _mm512_fmadd_pd(a, b, c); }
+		}
+	}
+}
+#define MN_SIMD_NS AVX512
+#include "BezierSimdKernel.inl"
+#undef MN_SIMD_NS
+#undef MN_SIMD_TARGET
+#endif
+
+namespace MN {
+	static std::atomic<int> simdLevel(-1);	// -1 until first use, then detected level
+
+	BezierSimd::Level BezierSimd::detect() noexcept {
+#if defined(MN_SIMD_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+		__cpuid(info, 1);
+		bool
+			sse2 = (info[3] & (1 << 26)) != 0,
+			fma = (info[2] & (1 << 12)) != 0,
+			osxsave = (info[2] & (1 << 27)) != 0,
+			avx2 = false,
+			avx512 = false;
+		if (maxLeaf >= 7) {
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+			avx512 = (info[1] & (1 << 16)) != 0;
+		}
+		// OS must save YMM / ZMM registers on context switch
+		unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+		bool
+			ymm = (xcr0 & 0x6) == 0x6,
+			zmm = (xcr0 & 0xe6) == 0xe6;
+		if (avx512 && zmm)
+			return Level::AVX512;
+		if (avx2 && fma && ymm)
+			return Level::AVX2;
+		if (sse2)
+			return Level::SSE2;
+		return Level::Scalar;
+#elif defined(MN_SIMD_X86)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f"))
+			return Level::AVX512;
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			return Level::AVX2;
+		if (__builtin_cpu_supports("sse2"))
+			return Level::SSE2;
+		return Level::Scalar;
+#else
+		return Level::Scalar;
+#endif
+	}
+	BezierSimd::Level BezierSimd::getLevel() noexcept {
+		int level = simdLevel.load(std::memory_order_relaxed);
+		if (level < 0) {
+			level = (int)detect();
+			simdLevel.store(level, std::memory_order_relaxed);
+		}
+		return (Level)level;
+	}
+	void BezierSimd::setLevel(Level level) {
+		if ((int)level > (int)detect())
+			throw(std::runtime_error("Given SIMD level is not supported by current CPU"));
+		simdLevel.store((int)level, std::memory_order_relaxed);
+	}
+
+	static void checkDegree(int degree) {
+		if (degree < 0 || degree > BezierSimd::maxDegree)
+			throw(std::runtime_error("Invalid degree for Bezier SIMD evaluation"));
+	}
+	void BezierSimd::evaluateCurve(int degree, const Real* cpts, int count, const Real* t, Real* points) {
+		checkDegree(degree);
+		switch (getLevel()) {
+#ifdef MN_SIMD_X86
+		case Level::AVX512:
+			BezierSimdImpl::AVX512::evaluateCurve(degree, cpts, count, t, points);
+			break;
+		case Level::AVX2:
+			BezierSimdImpl::AVX2::evaluateCurve(degree, cpts, count, t, points);
+			break;
+		case Level::SSE2:
+			BezierSimdImpl::SSE2::evaluateCurve(degree, cpts, count, t, points);
+			break;
+#endif
+		default:
+			BezierSimdImpl::Scalar::evaluateCurve(degree, cpts, count, t, points);
+			break;
+		}
+	}
+	void BezierSimd::evaluateSurface(int uDegree, int vDegree, const Real* cpts, int count, const Real* u, const Real* v, Real* points) {
+		checkDegree(uDegree);
+		checkDegree(vDegree);
+		switch (getLevel()) {
+#ifdef MN_SIMD_X86
+		case Level::AVX512:
+			BezierSimdImpl::AVX512::evaluateSurface(uDegree, vDegree, cpts, count, u, v, points);
+			break;
+		case Level::AVX2:
+			BezierSimdImpl::AVX2::evaluateSurface(uDegree, vDegree, cpts, count, u, v, points);
+			break;
+		case Level::SSE2:
+			BezierSimdImpl::SSE2::evaluateSurface(uDegree, vDegree, cpts, count, u, v, points);
+			break;
+#endif
+		default:
+			BezierSimdImpl::Scalar::evaluateSurface(uDegree, vDegree, cpts, count, u, v, points);
+			break;
+		}
+	}
+}
@@ -0,0 +1,48 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_BEZIER_SIMD_H__
+#define __MN_BEZIER_SIMD_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+
+namespace MN {
+	/*
+	 * SIMD kernels that evaluate a single Bezier entity at many parameters at once.
+	 * Each SIMD lane holds one parameter : Bernstein basis is computed for all lanes together,
+	 * and then control points are broadcast and accumulated into every lane.
+	 * Instruction set is chosen at runtime among SSE2, AVX2 and AVX-512 by CPU detection.
+	 *
+	 * Control points and output points are flat arrays of (x, y, z) triples.
+	 * Surface control points are ordered as cpts[i][j] -> [ i * (vDegree + 1) + j ].
+	 */
+	class BezierSimd {
+	public:
+		enum class Level {
+			Scalar = 0,
+			SSE2 = 1,
+			AVX2 = 2,
+			AVX512 = 3
+		};
+		// Maximum degree that kernels support, which equals to limit of [ Bin16 ]
+		const static int maxDegree = 16;
+
+		static Level detect() noexcept;			// Best level that current CPU supports
+		static Level getLevel() noexcept;		// Level that is used by kernels
+		static void setLevel(Level level);		// Force kernels to use given level, e.g) for comparison. Throws if CPU does not support it
+
+		static void evaluateCurve(int degree, const Real* cpts, int count, const Real* t, Real* points);
+		static void evaluateSurface(int uDegree, int vDegree, const Real* cpts, int count, const Real* u, const Real* v, Real* points);
+	};
+}
+
+#endif
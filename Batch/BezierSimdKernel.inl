@@ -0,0 +1,93 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+// Kernel bodies of BezierSimd, included once per instruction set by BezierSimd.cpp.
+// Before inclusion, namespace [ MN_SIMD_NS ] must define [ Pack ], [ width ] and pack operations
+// [ load, store, set1, add, sub, mul, fmadd ], and [ MN_SIMD_TARGET ] must be target attribute of them.
+
+namespace MN {
+	namespace BezierSimdImpl {
+		namespace MN_SIMD_NS {
+			// Bernstein basis of [degree] for every lane of [t] by triangular recurrence
+			MN_SIMD_TARGET static inline void basis(Pack t, int degree, Pack* b) {
+				Pack one = set1(1.0);
+				Pack t1 = sub(one, t);
+				b[0] = one;
+				for (int d = 1; d <= degree; d++) {
+					b[d] = mul(t, b[d - 1]);
+					for (int i = d - 1; i > 0; i--)
+						b[i] = fmadd(t1, b[i], mul(t, b[i - 1]));
+					b[0] = mul(t1, b[0]);
+				}
+			}
+			// Load [num] parameters, padding rest of lanes with zero
+			MN_SIMD_TARGET static inline Pack loadParams(const Real* params, int num) {
+				if (num == width)
+					return load(params);
+				Real pad[width];
+				for (int i = 0; i < width; i++)
+					pad[i] = (i < num) ? params[i] : 0.0;
+				return load(pad);
+			}
+			MN_SIMD_TARGET static inline void storePoints(Pack x, Pack y, Pack z, int num, Real* points) {
+				Real buf[3][width];
+				store(buf[0], x);
+				store(buf[1], y);
+				store(buf[2], z);
+				for (int i = 0; i < num; i++) {
+					points[i * 3] = buf[0][i];
+					points[i * 3 + 1] = buf[1][i];
+					points[i * 3 + 2] = buf[2][i];
+				}
+			}
+
+			MN_SIMD_TARGET void evaluateCurve(int degree, const Real* cpts, int count, const Real* t, Real* points) {
+				Pack b[BezierSimd::maxDegree + 1];
+				for (int beg = 0; beg < count; beg += width) {
+					int num = (count - beg < width) ? count - beg : width;
+					basis(loadParams(t + beg, num), degree, b);
+
+					Pack x = set1(0.0), y = set1(0.0), z = set1(0.0);
+					for (int i = 0; i <= degree; i++) {
+						const Real* p = cpts + i * 3;
+						x = fmadd(b[i], set1(p[0]), x);
+						y = fmadd(b[i], set1(p[1]), y);
+						z = fmadd(b[i], set1(p[2]), z);
+					}
+					storePoints(x, y, z, num, points + beg * 3);
+				}
+			}
+			MN_SIMD_TARGET void evaluateSurface(int uDegree, int vDegree, const Real* cpts, int count, const Real* u, const Real* v, Real* points) {
+				Pack bu[BezierSimd::maxDegree + 1];
+				Pack bv[BezierSimd::maxDegree + 1];
+				for (int beg = 0; beg < count; beg += width) {
+					int num = (count - beg < width) ? count - beg : width;
+					basis(loadParams(u + beg, num), uDegree, bu);
+					basis(loadParams(v + beg, num), vDegree, bv);
+
+					// Contract each row in V direction first, and then the rows in U direction
+					Pack x = set1(0.0), y = set1(0.0), z = set1(0.0);
+					for (int i = 0; i <= uDegree; i++) {
+						const Real* row = cpts + i * (vDegree + 1) * 3;
+						Pack rx = set1(0.0), ry = set1(0.0), rz = set1(0.0);
+						for (int j = 0; j <= vDegree; j++) {
+							const Real* p = row + j * 3;
+							rx = fmadd(bv[j], set1(p[0]), rx);
+							ry = fmadd(bv[j], set1(p[1]), ry);
+							rz = fmadd(bv[j], set1(p[2]), rz);
+						}
+						x = fmadd(bu[i], rx, x);
+						y = fmadd(bu[i], ry, y);
+						z = fmadd(bu[i], rz, z);
+					}
+					storePoints(x, y, z, num, points + beg * 3);
+				}
+			}
+		}
+	}
+}
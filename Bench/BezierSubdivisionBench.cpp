@@ -0,0 +1,126 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+// Time of de Casteljau subdivision of Bezier curve, surface and volume over degrees 1 ~ 10
+// Surface and volume are split once in each direction, and time is average of one split
+// Pieces are reused between runs without deriv matrices, so that timing excludes allocation of outputs,
+// and heap allocations per split are counted to check that none happen once pieces have their size
+
+#include "../Curve/BezierCurve3d.h"
+#include "../Surface/BezierSurface3d.h"
+#include "../Volume/BezierVolume3d.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace MN;
+
+const static int maxBenchDegree = 10;
+const static double minBenchTime = 0.05;		// Seconds spent on each case at least
+
+// Allocations of whole process, counted by replaced global operator new
+#ifdef MINUTE_FREEFORM_INSTRUMENT_HEAP
+// Library replaces operator new already
+static uint64_t allocCount() {
+	return Instrument::snapshot().get(Instrument::Counter::HeapAllocations);
+}
+#else
+static std::atomic<uint64_t> allocCounter(0);
+
+void* operator new(std::size_t size) {
+	allocCounter.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size > 0 ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+void operator delete(void* ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+static uint64_t allocCount() {
+	return allocCounter.load();
+}
+#endif
+
+static Vec3 samplePoint(int i) {
+	return Vec3{ sin(i * 1.3), cos(i * 0.7), sin(i * 0.3 + 1.0) };
+}
+class Measure {
+public:
+	double ns = 0;			// Per call of [func]
+	double allocs = 0;
+};
+template<typename Func>
+static Measure measure(Func&& func, int splits) {
+	using Clock = std::chrono::steady_clock;
+	func();		// Pieces get their size here
+	long long runs = 0;
+	double elapsed = 0;
+	uint64_t allocs0 = allocCount();
+	auto beg = Clock::now();
+	while (elapsed < minBenchTime) {
+		for (int i = 0; i < 64; i++)
+			func();
+		runs += 64;
+		elapsed = std::chrono::duration<double>(Clock::now() - beg).count();
+	}
+	Measure result;
+	result.ns = elapsed * 1e9 / (runs * splits);
+	result.allocs = (double)(allocCount() - allocs0) / (runs * splits);
+	return result;
+}
+
+int main() {
+	printf("%8s %14s %14s %14s %14s\n", "degree", "curve (ns)", "surface (ns)", "volume (ns)", "allocs/split");
+	for (int degree = 1; degree <= maxBenchDegree; degree++) {
+		int size = degree + 1;
+
+		BezierCurve3d::ControlPoints curveCpts(size);
+		BezierSurface3d::ControlPoints surfaceCpts(size, std::vector<Vec3>(size));
+		BezierVolume3d::ControlPoints volumeCpts(size, BezierSurface3d::ControlPoints(size, std::vector<Vec3>(size)));
+		for (int i = 0; i < size; i++) {
+			curveCpts[i] = samplePoint(i);
+			for (int j = 0; j < size; j++) {
+				surfaceCpts[i][j] = samplePoint(i * size + j);
+				for (int k = 0; k < size; k++)
+					volumeCpts[i][j][k] = samplePoint((i * size + j) * size + k);
+			}
+		}
+
+		BezierCurve3d curve = BezierCurve3d::create(degree, curveCpts, false);
+		BezierCurve3d curveLower = curve, curveUpper = curve;
+		Measure curveTime = measure([&]() {
+			curve.subdivide(0.4, curveLower, curveUpper);
+		}, 1);
+
+		BezierSurface3d surface = BezierSurface3d::create(degree, degree, surfaceCpts, false);
+		BezierSurface3d surfaceLower = surface, surfaceUpper = surface;
+		Measure surfaceTime = measure([&]() {
+			surface.uSubdivide(0.4, surfaceLower, surfaceUpper, false);
+			surface.vSubdivide(0.4, surfaceLower, surfaceUpper, false);
+		}, 2);
+
+		BezierVolume3d volume = BezierVolume3d::create(degree, degree, degree, volumeCpts, false);
+		BezierVolume3d volumeLower = volume, volumeUpper = volume;
+		Measure volumeTime = measure([&]() {
+			volume.uSubdivide(0.4, volumeLower, volumeUpper, false);
+			volume.vSubdivide(0.4, volumeLower, volumeUpper, false);
+			volume.wSubdivide(0.4, volumeLower, volumeUpper, false);
+		}, 3);
+
+		double allocs = std::max({ curveTime.allocs, surfaceTime.allocs, volumeTime.allocs });
+		printf("%8d %14.1f %14.1f %14.1f %14.2f\n", degree, curveTime.ns, surfaceTime.ns, volumeTime.ns, allocs);
+	}
+	return 0;
+}
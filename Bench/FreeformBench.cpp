@@ -0,0 +1,396 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+// Time of evaluate, differentiate, curvature, subdivide and updatePatches of every freeform entity, over degrees and sizes of nets
+// Curvature is measured from degree 2, which has second derivatives
+// Models are generated from fixed seed, so that every run measures the same geometry
+// usage : FreeformBench [--filter text] [--min-time seconds] [--json path] [--trace path]
+// With instrumentation compiled in, totals of counters and timers are printed, and [--trace] writes Chrome trace of timed scopes
+
+#include "../Curve/BezierCurve2d.h"
+#include "../Curve/BezierCurve3d.h"
+#include "../Curve/BsplineCurve2d.h"
+#include "../Curve/BsplineCurve3d.h"
+#include "../Surface/BezierSurface2d.h"
+#include "../Surface/BezierSurface3d.h"
+#include "../Surface/BsplineSurface2d.h"
+#include "../Surface/BsplineSurface3d.h"
+#include "../Volume/BezierVolume3d.h"
+#include "../Volume/BsplineVolume3d.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using namespace MN;
+
+const static double defaultMinTime = 0.05;		// Seconds spent on each case at least
+const static int paramNum = 1024;				// Parameters cycled by each case, so that it does not settle on one value
+const static uint64_t benchSeed = 0x5eed;
+
+// Allocations of whole process, counted by replaced global operator new
+#ifdef MINUTE_FREEFORM_INSTRUMENT_HEAP
+// Library replaces operator new already
+static uint64_t allocCount() {
+	return Instrument::snapshot().get(Instrument::Counter::HeapAllocations);
+}
+static uint64_t allocBytes() {
+	return Instrument::snapshot().get(Instrument::Counter::HeapBytes);
+}
+#else
+static std::atomic<uint64_t> allocCounter(0);
+static std::atomic<uint64_t> allocByteCounter(0);
+
+void* operator new(std::size_t size) {
+	allocCounter.fetch_add(1, std::memory_order_relaxed);
+	allocByteCounter.fetch_add(size, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size > 0 ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+void operator delete(void* ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+static uint64_t allocCount() {
+	return allocCounter.load();
+}
+static uint64_t allocBytes() {
+	return allocByteCounter.load();
+}
+#endif
+
+// Generator of models, which does not depend on distributions of standard library
+class Random {
+private:
+	uint64_t state;
+public:
+	Random(uint64_t seed) : state(seed) {
+	}
+	// splitmix64
+	inline uint64_t next() noexcept {
+		uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+	// Uniform in [0, 1)
+	inline Real uniform() noexcept {
+		return (Real)(next() >> 11) * (1.0 / 9007199254740992.0);
+	}
+	template<int N>
+	inline void point(VecN<N>& p) noexcept {
+		for (int d = 0; d < N; d++)
+			p[d] = uniform() * 2.0 - 1.0;
+	}
+	template<typename Point>
+	inline void net(std::vector<Point>& cpts, int num) {
+		cpts.resize(num);
+		for (auto& p : cpts)
+			point(p);
+	}
+	template<typename Point>
+	inline void net(std::vector<std::vector<Point>>& cpts, int uNum, int vNum) {
+		cpts.resize(uNum);
+		for (auto& row : cpts)
+			net(row, vNum);
+	}
+	template<typename Point>
+	inline void net(std::vector<std::vector<std::vector<Point>>>& cpts, int uNum, int vNum, int wNum) {
+		cpts.resize(uNum);
+		for (auto& plane : cpts)
+			net(plane, vNum, wNum);
+	}
+	// Clamped knot vector over [0, 1] with sorted random interior knots
+	inline KnotVector knots(int degree, int cptsNum) {
+		KnotVector knot(degree + 1, 0.0);
+		std::vector<Real> inner(cptsNum - degree - 1);
+		for (auto& k : inner)
+			k = 0.05 + 0.9 * uniform();
+		std::sort(inner.begin(), inner.end());
+		knot.insert(knot.end(), inner.begin(), inner.end());
+		knot.insert(knot.end(), degree + 1, 1.0);
+		return knot;
+	}
+	inline std::vector<Real> params() {
+		std::vector<Real> values(paramNum);
+		for (auto& t : values)
+			t = uniform();
+		return values;
+	}
+};
+
+template<typename Point>
+static size_t pointNum(const std::vector<Point>& cpts) {
+	return cpts.size();
+}
+template<typename Point>
+static size_t pointNum(const std::vector<std::vector<Point>>& cpts) {
+	size_t num = 0;
+	for (const auto& row : cpts)
+		num += pointNum(row);
+	return num;
+}
+
+// Results are summed into [sink] and printed, so that calls are not optimized out
+static Real sink = 0;
+template<int N>
+static inline void consume(const VecN<N>& p) {
+	sink += p[0];
+}
+static inline void consume(Real value) {
+	sink += value;
+}
+
+class BenchResult {
+public:
+	std::string entity;
+	std::string op;
+	int degree = 0;
+	int size = 0;			// Number of control points in each direction
+	double nsPerOp = 0;
+	double allocsPerOp = 0;
+	double allocBytesPerOp = 0;
+	double bytesPerOp = 0;	// Estimate of bytes of control points read and written by each call
+	long long runs = 0;
+};
+
+class Bench {
+public:
+	std::string filter;
+	double minTime = defaultMinTime;
+	std::vector<BenchResult> results;
+
+	// Call [ func(i) ] with increasing [i] until [minTime] passes, after one call for warm up
+	template<typename Func>
+	void run(const char* entity, const char* op, int degree, int size, size_t bytes, Func&& func) {
+		std::string name = std::string(entity) + "/" + op;
+		if (!filter.empty() && name.find(filter) == std::string::npos)
+			return;
+		using Clock = std::chrono::steady_clock;
+		func(0);
+
+		uint64_t count0 = allocCount(), bytes0 = allocBytes();
+		long long runs = 0;
+		double elapsed = 0;
+		auto beg = Clock::now();
+		while (elapsed < minTime) {
+			for (int i = 0; i < 16; i++, runs++)
+				func((int)(runs % paramNum));
+			elapsed = std::chrono::duration<double>(Clock::now() - beg).count();
+		}
+		BenchResult result;
+		result.entity = entity;
+		result.op = op;
+		result.degree = degree;
+		result.size = size;
+		result.nsPerOp = elapsed * 1e9 / runs;
+		result.allocsPerOp = (double)(allocCount() - count0) / runs;
+		result.allocBytesPerOp = (double)(allocBytes() - bytes0) / runs;
+		result.bytesPerOp = (double)bytes;
+		result.runs = runs;
+		printf("%-18s %-14s %6d %6d %14.1f %10.2f %14.1f %14.0f\n", entity, op, degree, size,
+			result.nsPerOp, result.allocsPerOp, result.allocBytesPerOp, result.bytesPerOp);
+		results.push_back(result);
+	}
+	void writeJson(const char* path) const {
+		FILE* file = std::fopen(path, "w");
+		if (file == nullptr)
+			throw(std::runtime_error("Cannot open file to write benchmark result"));
+		std::fprintf(file, "{\n  \"schema\": 1,\n  \"minTime\": %g,\n  \"cases\": [\n", minTime);
+		for (size_t i = 0; i < results.size(); i++) {
+			const auto& r = results[i];
+			std::fprintf(file, "    { \"entity\": \"%s\", \"op\": \"%s\", \"degree\": %d, \"size\": %d, \"nsPerOp\": %.3f, "
+				"\"allocsPerOp\": %.3f, \"allocBytesPerOp\": %.1f, \"bytesPerOp\": %.0f, \"runs\": %lld }%s\n",
+				r.entity.c_str(), r.op.c_str(), r.degree, r.size, r.nsPerOp, r.allocsPerOp, r.allocBytesPerOp, r.bytesPerOp, r.runs,
+				i + 1 < results.size() ? "," : "");
+		}
+		std::fprintf(file, "  ]\n}\n");
+		std::fclose(file);
+	}
+};
+
+template<typename Curve, typename Point>
+static void benchBezierCurve(Bench& bench, const char* entity, Random& random) {
+	auto params = random.params();
+	for (int degree : { 1, 2, 3, 5, 8 }) {
+		int size = degree + 1;
+		typename Curve::ControlPoints cpts;
+		random.net(cpts, size);
+		Curve curve = Curve::create(degree, cpts);
+		Curve lower = Curve::create(), upper = Curve::create();
+		size_t bytes = size * sizeof(Point);
+
+		bench.run(entity, "evaluate", degree, size, bytes, [&](int i) { consume(curve.evaluate(params[i])); });
+		bench.run(entity, "differentiate", degree, size, bytes, [&](int i) { consume(curve.differentiate(params[i], 1)); });
+		if (degree >= 2)
+			bench.run(entity, "curvature", degree, size, 2 * bytes, [&](int i) { consume(curve.curvature(params[i])); });
+		bench.run(entity, "subdivide", degree, size, 3 * bytes, [&](int i) { curve.subdivide(params[i], lower, upper); });
+	}
+}
+template<typename Surface, typename Point>
+static void benchBezierSurface(Bench& bench, const char* entity, Random& random) {
+	auto uParams = random.params(), vParams = random.params();
+	for (int degree : { 1, 2, 3, 5 }) {
+		int size = degree + 1;
+		typename Surface::ControlPoints cpts;
+		random.net(cpts, size, size);
+		Surface surface = Surface::create(degree, degree, cpts);
+		size_t bytes = size * size * sizeof(Point);
+
+		bench.run(entity, "evaluate", degree, size, bytes, [&](int i) { consume(surface.evaluate(uParams[i], vParams[i])); });
+		bench.run(entity, "differentiate", degree, size, bytes, [&](int i) { consume(surface.differentiate(uParams[i], vParams[i], 1, 0)); });
+		if constexpr (std::is_same<Point, Vec3>::value)
+			if (degree >= 2)
+				bench.run(entity, "curvature", degree, size, 5 * bytes, [&](int i) { consume(surface.curvature(uParams[i], vParams[i]).K); });
+		bench.run(entity, "subdivide", degree, size, 2 * bytes, [&](int i) {
+			Real u = uParams[i] * 0.5, v = vParams[i] * 0.5;
+			consume(surface.subdivide(Domain::create(u, u + 0.5), Domain::create(v, v + 0.5))->getCptsC()[0][0]);
+		});
+	}
+}
+static void benchBezierVolume(Bench& bench, const char* entity, Random& random) {
+	auto uParams = random.params(), vParams = random.params(), wParams = random.params();
+	for (int degree : { 1, 2, 3 }) {
+		int size = degree + 1;
+		BezierVolume3d::ControlPoints cpts;
+		random.net(cpts, size, size, size);
+		BezierVolume3d volume = BezierVolume3d::create(degree, degree, degree, cpts);
+		BezierVolume3d lower = BezierVolume3d::create(), upper = BezierVolume3d::create();
+		size_t bytes = size * size * size * sizeof(Vec3);
+
+		bench.run(entity, "evaluate", degree, size, bytes, [&](int i) { consume(volume.evaluate(uParams[i], vParams[i], wParams[i])); });
+		bench.run(entity, "differentiate", degree, size, bytes, [&](int i) { consume(volume.differentiate(uParams[i], vParams[i], wParams[i], 1, 0, 0)); });
+		bench.run(entity, "subdivide", degree, size, 3 * bytes, [&](int i) { volume.uSubdivide(uParams[i], lower, upper, false); });
+	}
+}
+
+template<typename Curve, typename Point>
+static void benchBsplineCurve(Bench& bench, const char* entity, Random& random) {
+	auto params = random.params();
+	for (int degree : { 1, 2, 3, 5 })
+		for (int size : { 16, 256 }) {
+			typename Curve::ControlPoints cpts;
+			random.net(cpts, size);
+			KnotVector knots = random.knots(degree, size);
+			Curve curve = Curve::create(degree, knots, cpts);
+			size_t patchBytes = (degree + 1) * sizeof(Point);
+			size_t buildBytes = (size + (size - degree) * (degree + 1)) * sizeof(Point);
+
+			bench.run(entity, "evaluate", degree, size, patchBytes, [&](int i) { consume(curve.evaluate(params[i])); });
+			bench.run(entity, "differentiate", degree, size, patchBytes, [&](int i) { consume(curve.differentiate(params[i], 1)); });
+			if (degree >= 2)
+				bench.run(entity, "curvature", degree, size, 2 * patchBytes, [&](int i) { consume(curve.curvature(params[i])); });
+			// Knot insertion changes knots and control points, so every call starts from the original ones through [ create ]
+			bench.run(entity, "updatePatches", degree, size, buildBytes, [&](int) {
+				consume(Curve::create(degree, knots, cpts).evaluate(0.5));
+			});
+		}
+}
+template<typename Surface, typename Point>
+static void benchBsplineSurface(Bench& bench, const char* entity, Random& random) {
+	auto uParams = random.params(), vParams = random.params();
+	for (int degree : { 1, 2, 3 })
+		for (int size : { 8, 32 }) {
+			typename Surface::ControlPoints cpts;
+			random.net(cpts, size, size);
+			KnotVector uKnots = random.knots(degree, size), vKnots = random.knots(degree, size);
+			Surface surface = Surface::create(degree, degree, uKnots, vKnots, cpts);
+			size_t patchBytes = (degree + 1) * (degree + 1) * sizeof(Point);
+			size_t buildBytes = size * size * sizeof(Point) + surface.patches.size() * patchBytes;
+
+			bench.run(entity, "evaluate", degree, size, patchBytes, [&](int i) { consume(surface.evaluate(uParams[i], vParams[i])); });
+			bench.run(entity, "differentiate", degree, size, patchBytes, [&](int i) { consume(surface.differentiate(uParams[i], vParams[i], 1, 0)); });
+			if constexpr (std::is_same<Point, Vec3>::value)
+				if (degree >= 2)
+					bench.run(entity, "curvature", degree, size, 5 * patchBytes, [&](int i) { consume(surface.curvature(uParams[i], vParams[i]).K); });
+			bench.run(entity, "updatePatches", degree, size, buildBytes, [&](int) {
+				consume(Surface::create(degree, degree, uKnots, vKnots, cpts).evaluate(0.5, 0.5));
+			});
+		}
+}
+static void benchBsplineVolume(Bench& bench, const char* entity, Random& random) {
+	auto uParams = random.params(), vParams = random.params(), wParams = random.params();
+	for (int degree : { 1, 2, 3 })
+		for (int size : { 6, 12 }) {
+			BsplineVolume3d::ControlPoints cpts;
+			random.net(cpts, size, size, size);
+			KnotVector uKnots = random.knots(degree, size), vKnots = random.knots(degree, size), wKnots = random.knots(degree, size);
+			BsplineVolume3d volume = BsplineVolume3d::create(degree, degree, degree, uKnots, vKnots, wKnots, cpts);
+			size_t patchBytes = (degree + 1) * (degree + 1) * (degree + 1) * sizeof(Vec3);
+			size_t buildBytes = pointNum(cpts) * sizeof(Vec3) + volume.patches.size() * patchBytes;
+
+			bench.run(entity, "evaluate", degree, size, patchBytes, [&](int i) { consume(volume.evaluate(uParams[i], vParams[i], wParams[i])); });
+			bench.run(entity, "differentiate", degree, size, patchBytes, [&](int i) { consume(volume.differentiate(uParams[i], vParams[i], wParams[i], 1, 0, 0)); });
+			bench.run(entity, "updatePatches", degree, size, buildBytes, [&](int) {
+				consume(BsplineVolume3d::create(degree, degree, degree, uKnots, vKnots, wKnots, cpts).evaluate(0.5, 0.5, 0.5));
+			});
+		}
+}
+
+int main(int argc, char** argv) {
+	Bench bench;
+	const char* jsonPath = nullptr;
+	const char* tracePath = nullptr;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+			bench.filter = argv[++i];
+		else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+			bench.minTime = std::atof(argv[++i]);
+		else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+			jsonPath = argv[++i];
+		else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			tracePath = argv[++i];
+		else {
+			printf("usage : %s [--filter text] [--min-time seconds] [--json path] [--trace path]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	Instrument::setTracing(tracePath != nullptr);
+	Instrument::reset();
+	printf("%-18s %-14s %6s %6s %14s %10s %14s %14s\n", "entity", "op", "degree", "size", "ns/op", "allocs/op", "alloc B/op", "touched B/op");
+	// Each entity takes its own generator, so that adding cases to one does not change models of others
+	Random curve2(benchSeed + 1), curve3(benchSeed + 2), bcurve2(benchSeed + 3), bcurve3(benchSeed + 4);
+	Random surface2(benchSeed + 5), surface3(benchSeed + 6), bsurface2(benchSeed + 7), bsurface3(benchSeed + 8);
+	Random volume3(benchSeed + 9), bvolume3(benchSeed + 10);
+	benchBezierCurve<BezierCurve2d, Vec2>(bench, "BezierCurve2d", curve2);
+	benchBezierCurve<BezierCurve3d, Vec3>(bench, "BezierCurve3d", curve3);
+	benchBsplineCurve<BsplineCurve2d, Vec2>(bench, "BsplineCurve2d", bcurve2);
+	benchBsplineCurve<BsplineCurve3d, Vec3>(bench, "BsplineCurve3d", bcurve3);
+	benchBezierSurface<BezierSurface2d, Vec2>(bench, "BezierSurface2d", surface2);
+	benchBezierSurface<BezierSurface3d, Vec3>(bench, "BezierSurface3d", surface3);
+	benchBsplineSurface<BsplineSurface2d, Vec2>(bench, "BsplineSurface2d", bsurface2);
+	benchBsplineSurface<BsplineSurface3d, Vec3>(bench, "BsplineSurface3d", bsurface3);
+	benchBezierVolume(bench, "BezierVolume3d", volume3);
+	benchBsplineVolume(bench, "BsplineVolume3d", bvolume3);
+	printf("checksum %.6g\n", sink);
+
+	if (Instrument::enabled) {
+		auto snap = Instrument::snapshot();
+		for (int i = 0; i < Instrument::counterNum; i++)
+			printf("%-18s %llu\n", Instrument::getName((Instrument::Counter)i), (unsigned long long)snap.counters[i]);
+		for (int i = 0; i < Instrument::timerNum; i++)
+			printf("%-18s %llu calls %.6f s\n", Instrument::getName((Instrument::Timer)i),
+				(unsigned long long)snap.timerCalls[i], snap.getSeconds((Instrument::Timer)i));
+	}
+
+	if (jsonPath)
+		bench.writeJson(jsonPath);
+	if (tracePath)
+		Instrument::writeChromeTrace(tracePath);
+	return 0;
+}
@@ -12,29 +12,18 @@ namespace MN {
 	// BezierCurve2d
 	const static BezierCurve2d empty = BezierCurve2d::create(0, {});
 	void BezierCurve2d::subdivideCpts(const ControlPoints& cpts, Real t, ControlPoints& lower, ControlPoints& upper) {
-		// De Casteljou's algorithm
 		int size = (int)cpts.size();
 		lower.resize(size);
 		upper.resize(size);
-
-		double t1 = 1 - t;
-
-		ControlPoints copy = cpts;
-		lower[0] = copy.front();
-		upper[size - 1] = copy.back();
-
-		int cnt = 1;
-		for (int i = size - 1; i > 0; i--) {
-			ControlPoints tmp;
-			tmp.resize(i);
-			for (int j = 0; j < i; j++)
-				tmp[j] = copy[j] * t1 + copy[j + 1] * t;
-			copy = tmp;
-
-			lower[cnt] = copy.front();
-			upper[size - cnt - 1] = copy.back();
-			cnt++;
-		}
+		Bezier::subdivide(cpts, size, t, Bezier::StridedView<Vec2>{ lower.data(), 1 }, Bezier::StridedView<Vec2>{ upper.data(), 1 });
+	}
+	void BezierCurve2d::prepareSubdivision(BezierCurve2d& piece) const {
+		piece.setDegree(degree);
+		piece.setDomain(Domain::create(0, 1));
+		piece.cpts.resize(cpts.size());
+		piece.derivMatT.clear();
+		piece.derivMatTT.clear();
+		piece.derivMatTTT.clear();
 	}
 	BezierCurve2d BezierCurve2d::create() {
 		return empty;
@@ -101,20 +90,18 @@ namespace MN {
 			throw(std::runtime_error("Bezier curve differentiation is only allowed up to 3rd derivatives"));
 	}
 	void BezierCurve2d::subdivide(Real t, BezierCurve2d& lower, BezierCurve2d& upper) const {
-		ControlPoints lowerCpts, upperCpts;
-		subdivideCpts(cpts, t, lowerCpts, upperCpts);
-
-		lower = BezierCurve2d::create(degree, lowerCpts, false);
-		upper = BezierCurve2d::create(degree, upperCpts, false);
+		// Writes into control points of [lower] and [upper] in place, either of which may be this curve
+		int size = (int)cpts.size();
+		prepareSubdivision(lower);
+		prepareSubdivision(upper);
+		Bezier::subdivide(cpts, size, t, Bezier::StridedView<Vec2>{ lower.cpts.data(), 1 }, Bezier::StridedView<Vec2>{ upper.cpts.data(), 1 });
 	}
 	BezierCurve2d::Ptr BezierCurve2d::subdivide(const Domain& subdomain) const {
-		BezierCurve2d tmpLower, tmpUpper;
-		subdivide(subdomain.beg(), tmpLower, tmpUpper);
-
-		Real t = (subdomain.width()) / (1.0 - subdomain.beg());
-		tmpUpper.subdivide(t, tmpLower, tmpUpper);
-		tmpLower.updateDerivMat();
-
-		return std::make_shared<BezierCurve2d>(tmpLower);
+		// Blossoming gives control points over subdomain at once, into the only allocated curve
+		BezierCurve2d piece;
+		prepareSubdivision(piece);
+		Bezier::extract(cpts, (int)cpts.size(), subdomain.beg(), subdomain.end(), Bezier::StridedView<Vec2>{ piece.cpts.data(), 1 });
+		piece.updateDerivMat();
+		return std::make_shared<BezierCurve2d>(std::move(piece));
 	}
 }
\ No newline at end of file
@@ -27,6 +27,8 @@ namespace MN {
 		ControlPoints derivMatTTT;
 
 		static void subdivideCpts(const ControlPoints& cpts, Real t, ControlPoints& lower, ControlPoints& upper);
+		// Gives [piece] degree, domain and size of control points of this curve to be overwritten by subdivision
+		void prepareSubdivision(BezierCurve2d& piece) const;
 	public:
 		using Ptr = std::shared_ptr<BezierCurve2d>;
 
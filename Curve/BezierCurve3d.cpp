@@ -7,34 +7,25 @@
  */
 
 #include "BezierCurve3d.h"
+#include "../Batch/BezierSimd.h"
 
 namespace MN {
 	// BezierCurve3d
 	const static BezierCurve3d empty = BezierCurve3d::create(0, {});
 	void BezierCurve3d::subdivideCpts(const ControlPoints& cpts, Real t, ControlPoints& lower, ControlPoints& upper) {
-		// De Casteljou's algorithm
 		int size = (int)cpts.size();
 		lower.resize(size);
 		upper.resize(size);
-
-		double t1 = 1 - t;
-
-		ControlPoints copy = cpts;
-		lower[0] = copy.front();
-		upper[size - 1] = copy.back();
-
-		int cnt = 1;
-		for (int i = size - 1; i > 0; i--) {
-			ControlPoints tmp;
-			tmp.resize(i);
-			for (int j = 0; j < i; j++)
-				tmp[j] = copy[j] * t1 + copy[j + 1] * t;
-			copy = tmp;
-
-			lower[cnt] = copy.front();
-			upper[size - cnt - 1] = copy.back();
-			cnt++;
-		}
+		Bezier::subdivide(cpts, size, t, Bezier::StridedView<Vec3>{ lower.data(), 1 }, Bezier::StridedView<Vec3>{ upper.data(), 1 });
+	}
+	void BezierCurve3d::prepareSubdivision(BezierCurve3d& piece) const {
+		piece.setDegree(degree);
+		piece.setDomain(Domain::create(0, 1));
+		piece.cpts.resize(cpts.size());
+		piece.derivMatT.clear();
+		piece.derivMatTT.clear();
+		piece.derivMatTTT.clear();
+		piece.boundValid = false;
 	}
 	BezierCurve3d BezierCurve3d::create() {
 		return empty;
@@ -42,10 +33,12 @@ namespace MN {
 	BezierCurve3d BezierCurve3d::create(int degree, const ControlPoints& cpts, bool buildMat) {
 		BezierCurve3d curve;
 		curve.setDegree(degree);
-		curve.setCpts(cpts);
+		curve.cpts = cpts;
 		curve.setDomain(Domain::create(0, 1));
 		if (buildMat)
 			curve.updateDerivMat();
+		else
+			curve.updateBound();
 		return curve;
 	}
 	BezierCurve3d::Ptr BezierCurve3d::createPtr(int degree, const ControlPoints& cpts, bool buildMat) {
@@ -72,12 +65,62 @@ namespace MN {
 			for (int i = 0; i < num - 3; i++)
 				derivMatTTT[i] = (derivMatTT[i + 1] - derivMatTT[i]) * (degree - 2);
 		}
+		updateBound();
+	}
+	void BezierCurve3d::updateBound() {
+		if (cpts.empty()) {
+			boundValid = false;
+			return;
+		}
+		int num = (int)cpts.size();
+		patchBound = PatchBound3d();
+		for (const auto& cpt : cpts)
+			patchBound.bound.expand(cpt);
+		// Hodograph control points
+		for (int i = 0; i < num - 1; i++)
+			patchBound.expandDeriv(0, (cpts[i + 1] - cpts[i]) * degree);
+		if (num == 1)
+			patchBound.expandDeriv(0, Vec3{ 0, 0, 0 });
+		patchBound.finish();
+		boundValid = true;
+	}
+	const AABB3d& BezierCurve3d::getBound() const {
+		if (!boundValid)
+			throw(std::runtime_error("Bezier curve has no control points to bound"));
+		return patchBound.bound;
+	}
+	const AABB3d& BezierCurve3d::getDerivBound() const {
+		if (!boundValid)
+			throw(std::runtime_error("Bezier curve has no control points to bound"));
+		return patchBound.derivBound[0];
+	}
+	Real BezierCurve3d::getLipschitz() const {
+		if (!boundValid)
+			throw(std::runtime_error("Bezier curve has no control points to bound"));
+		return patchBound.lipschitz[0];
+	}
+	OBB3d BezierCurve3d::getOrientedBound() const {
+		return OBB3d::create(cpts);
 	}
 	Vec3 BezierCurve3d::evaluate(Real t) const {
 		BasisVector basis;
 		Bezier::calBasisVector(t, degree, basis);
 		return tensorProduct(basis, cpts);
 	}
+	void BezierCurve3d::evaluate(const std::vector<Real>& t, std::vector<Vec3>& points) const {
+		int count = (int)t.size();
+		std::vector<Real> flatCpts, flatPoints;
+		flatCpts.resize(cpts.size() * 3);
+		for (int i = 0; i < (int)cpts.size(); i++)
+			for (int c = 0; c < 3; c++)
+				flatCpts[i * 3 + c] = cpts[i][c];
+		flatPoints.resize((size_t)count * 3);
+		BezierSimd::evaluateCurve(degree, flatCpts.data(), count, t.data(), flatPoints.data());
+
+		points.resize(count);
+		for (int i = 0; i < count; i++)
+			points[i] = { flatPoints[i * 3], flatPoints[i * 3 + 1], flatPoints[i * 3 + 2] };
+	}
 	Vec3 BezierCurve3d::differentiate(Real t, int order) const {
 		BasisVector basis;
 		if (order == 0)
@@ -100,21 +143,35 @@ namespace MN {
 		else
 			throw(std::runtime_error("Bezier curve differentiation is only allowed up to 3rd derivatives"));
 	}
-	void BezierCurve3d::subdivide(Real t, BezierCurve3d& lower, BezierCurve3d& upper) const {
-		ControlPoints lowerCpts, upperCpts;
-		subdivideCpts(cpts, t, lowerCpts, upperCpts);
+	BezierCurve3d::Jet BezierCurve3d::jet(Real t) const {
+		// Basis of all orders share one recurrence, and are contracted with control points directly
+		Real basis[Bezier::maxDegree + 1], basisT[Bezier::maxDegree + 1], basisTT[Bezier::maxDegree + 1];
+		Bezier::calBasisJet(t, degree, basis, basisT, basisTT);
 
-		lower = BezierCurve3d::create(degree, lowerCpts, false);
-		upper = BezierCurve3d::create(degree, upperCpts, false);
+		Jet j;
+		j.C = j.Ct = j.Ctt = Vec3::zero();
+		for (int i = 0; i <= degree; i++) {
+			j.C += cpts[i] * basis[i];
+			j.Ct += cpts[i] * basisT[i];
+			j.Ctt += cpts[i] * basisTT[i];
+		}
+		return j;
+	}
+	void BezierCurve3d::subdivide(Real t, BezierCurve3d& lower, BezierCurve3d& upper) const {
+		// Writes into control points of [lower] and [upper] in place, either of which may be this curve
+		int size = (int)cpts.size();
+		prepareSubdivision(lower);
+		prepareSubdivision(upper);
+		Bezier::subdivide(cpts, size, t, Bezier::StridedView<Vec3>{ lower.cpts.data(), 1 }, Bezier::StridedView<Vec3>{ upper.cpts.data(), 1 });
+		lower.updateBound();
+		upper.updateBound();
 	}
 	BezierCurve3d::Ptr BezierCurve3d::subdivide(const Domain& subdomain) const {
-		BezierCurve3d tmpLower, tmpUpper;
-		subdivide(subdomain.beg(), tmpLower, tmpUpper);
-
-		Real t = (subdomain.width()) / (1.0 - subdomain.beg());
-		tmpUpper.subdivide(t, tmpLower, tmpUpper);
-		tmpLower.updateDerivMat();
-
-		return std::make_shared<BezierCurve3d>(tmpLower);
+		// Blossoming gives control points over subdomain at once, into the only allocated curve
+		BezierCurve3d piece;
+		prepareSubdivision(piece);
+		Bezier::extract(cpts, (int)cpts.size(), subdomain.beg(), subdomain.end(), Bezier::StridedView<Vec3>{ piece.cpts.data(), 1 });
+		piece.updateDerivMat();
+		return std::make_shared<BezierCurve3d>(std::move(piece));
 	}
 }
\ No newline at end of file
@@ -14,11 +14,13 @@
 #endif
 
 #include "../Freeform.h"
+#include "../Query/OBB.h"
 
 namespace MN {
 	class BezierCurve3d : public Freeform3dc {
 	private:
 		BezierCurve3d() = default;
+		friend class FreeformStore;
 
 		// Control points for calculating derivatives up to 3rd order
 		// @WARNING : Degree multiplication is already done in those matrices e.g) When 3rd degree Bezier is differentiated once, 6 must be multiplied. 
@@ -26,7 +28,16 @@ namespace MN {
 		ControlPoints derivMatTT;
 		ControlPoints derivMatTTT;
 
+		// Bounds of control points, rebuilt whenever control points are set, subdivided or deriv matrices are updated
+		PatchBound3d patchBound;
+		bool boundValid = false;
+		inline void cptsChanged() override {
+			updateBound();
+		}
+
 		static void subdivideCpts(const ControlPoints& cpts, Real t, ControlPoints& lower, ControlPoints& upper);
+		// Gives [piece] degree, domain and size of control points of this curve to be overwritten by subdivision
+		void prepareSubdivision(BezierCurve3d& piece) const;
 	public:
 		using Ptr = std::shared_ptr<BezierCurve3d>;
 
@@ -35,10 +46,23 @@ namespace MN {
 		static BezierCurve3d create(int degree, const ControlPoints& cpts, bool buildMat = true);
 		static Ptr createPtr(int degree, const ControlPoints& cpts, bool buildMat = true);
 
-		void updateDerivMat();	// Update deriv matrices with current control points
+		void updateDerivMat();	// Update deriv matrices and bounds with current control points
+		// Rebuild bounds alone, e.g) after editing control points in place through [ getCpts ]
+		void updateBound();
+
+		// Bound of control points, which contains the curve
+		const AABB3d& getBound() const;
+		// Bound of first derivative, and largest speed
+		const AABB3d& getDerivBound() const;
+		Real getLipschitz() const;
+		// Bound along principal axes of control points, computed on each request as it is rarely needed
+		OBB3d getOrientedBound() const;
 
 		virtual Vec3 evaluate(Real t) const;
 		virtual Vec3 differentiate(Real t, int order) const;
+		virtual Jet jet(Real t) const;
+		// Evaluate at multiple parameters at once with SIMD : points[i] = C(t[i])
+		void evaluate(const std::vector<Real>& t, std::vector<Vec3>& points) const;
 		void subdivide(Real t, BezierCurve3d& lower, BezierCurve3d& upper) const;
 		Ptr subdivide(const Domain& subdomain) const;
 
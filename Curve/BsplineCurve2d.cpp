@@ -130,6 +130,7 @@ namespace MN {
 	Vec2 BsplineCurve2d::evaluate(Real t) const {
 		for (const auto& patch : patchVector) {
 			if (patch.subdomain.has(t)) {
+				MN_INSTRUMENT_ADD(PatchScans, &patch - patchVector.data() + 1);
 				Real nt = (t - patch.subdomain.beg()) / patch.subdomain.width();
 				return patch.curve->evaluate(nt);
 			}
@@ -139,6 +140,7 @@ namespace MN {
 	Vec2 BsplineCurve2d::differentiate(Real t, int order) const {
 		for (const auto& patch : patchVector) {
 			if (patch.subdomain.has(t)) {
+				MN_INSTRUMENT_ADD(PatchScans, &patch - patchVector.data() + 1);
 				Real width;
 				width = patch.subdomain.width();
 				double nt = (t - patch.subdomain.beg()) / width;
@@ -156,6 +158,7 @@ namespace MN {
 		throw(std::runtime_error("Invalid parameter for Bspline curve 2d differentiation"));
 	}
 	void BsplineCurve2d::updatePatches() {
+		MN_INSTRUMENT_TIMER(UpdatePatches);
 		// Insert knots full
 		insertKnotFull();
 
@@ -130,6 +130,7 @@ namespace MN {
 	Vec3 BsplineCurve3d::evaluate(Real t) const {
 		for (const auto& patch : patchVector) {
 			if (patch.subdomain.has(t)) {
+				MN_INSTRUMENT_ADD(PatchScans, &patch - patchVector.data() + 1);
 				Real nt = (t - patch.subdomain.beg()) / patch.subdomain.width();
 				return patch.curve->evaluate(nt);
 			}
@@ -139,6 +140,7 @@ namespace MN {
 	Vec3 BsplineCurve3d::differentiate(Real t, int order) const {
 		for (const auto& patch : patchVector) {
 			if (patch.subdomain.has(t)) {
+				MN_INSTRUMENT_ADD(PatchScans, &patch - patchVector.data() + 1);
 				Real width;
 				width = patch.subdomain.width();
 				double nt = (t - patch.subdomain.beg()) / width;
@@ -155,7 +157,22 @@ namespace MN {
 		}
 		throw(std::runtime_error("Invalid parameter for Bspline curve 2d differentiation"));
 	}
+	BsplineCurve3d::Jet BsplineCurve3d::jet(Real t) const {
+		for (const auto& patch : patchVector) {
+			if (patch.subdomain.has(t)) {
+				MN_INSTRUMENT_ADD(PatchScans, &patch - patchVector.data() + 1);
+				Real width = patch.subdomain.width();
+				Real nt = (t - patch.subdomain.beg()) / width;
+				Jet j = patch.curve->jet(nt);
+				j.Ct /= width;
+				j.Ctt /= (width * width);
+				return j;
+			}
+		}
+		throw(std::runtime_error("Invalid parameter for Bspline curve 3d jet"));
+	}
 	void BsplineCurve3d::updatePatches() {
+		MN_INSTRUMENT_TIMER(UpdatePatches);
 		// Insert knots full
 		insertKnotFull();
 
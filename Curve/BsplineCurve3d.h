@@ -48,6 +48,7 @@ namespace MN {
 
 		virtual Vec3 evaluate(Real t) const;
 		virtual Vec3 differentiate(Real t, int order) const;
+		virtual Jet jet(Real t) const;
 
 		void updatePatches();
 	};
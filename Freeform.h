@@ -14,8 +14,12 @@
 #endif
 
 #include "MinuteUtils/utils.h"
+#include "Instrument.h"
 #include <vector>
 #include <memory>
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
 
 namespace MN {
 	using BasisVector = std::vector<Real>;
@@ -238,6 +242,8 @@ namespace MN {
 				vec += tensor[r] * basis[r];
 			return vec;
 		}
+		// Called after control points are replaced, so that derived entities rebuild what they cache from them without allocation
+		inline virtual void cptsChanged() {}
 	public:
 		inline ControlPoints& getCpts() noexcept {
 			return cpts;
@@ -245,8 +251,9 @@ namespace MN {
 		inline const ControlPoints& getCptsC() const noexcept {
 			return cpts;
 		}
-		inline void setCpts(const ControlPoints& cpts) noexcept {
+		inline void setCpts(const ControlPoints& cpts) {
 			this->cpts = cpts;
+			cptsChanged();
 		}
 
 		inline void setDomain(const Domain& domain) noexcept {
@@ -290,6 +297,20 @@ namespace MN {
 		inline virtual Vec3 differentiate(Real t, int order) const {
 			return Vec3();
 		}
+
+		// Point and derivatives up to 2nd order at one parameter
+		struct Jet {
+			Vec3 C;			// Point
+			Vec3 Ct, Ctt;	// 1st, 2nd derivatives
+		};
+		inline virtual Jet jet(Real t) const {
+			Jet j;
+			j.C = evaluate(t);
+			j.Ct = differentiate(t, 1);
+			j.Ctt = differentiate(t, 2);
+			return j;
+		}
+
 		inline virtual Vec3 normal(Real t) const {
 			Vec3 firstD = differentiate(t, 1);
 			Vec3 secondD = differentiate(t, 2);
@@ -328,6 +349,8 @@ namespace MN {
 					vec += tensor[r][c] * left[r] * right[c];
 			return vec;
 		}
+		// Called after control points are replaced, so that derived entities rebuild what they cache from them without allocation
+		inline virtual void cptsChanged() {}
 	public:
 		inline ControlPoints& getCpts() noexcept {
 			return cpts;
@@ -335,8 +358,9 @@ namespace MN {
 		inline const ControlPoints& getCptsC() const noexcept {
 			return cpts;
 		}
-		inline void setCpts(const ControlPoints& cpts) noexcept {
+		inline void setCpts(const ControlPoints& cpts) {
 			this->cpts = cpts;
+			cptsChanged();
 		}
 
 		// Direction : 0 for U, 1 for V
@@ -385,6 +409,23 @@ namespace MN {
 		inline virtual Vec3 differentiate(double u, double v, int u_order, int v_order) const {
 			return Vec3::zero();
 		}
+
+		// Point and derivatives up to 2nd order at one parameter
+		struct Jet {
+			Vec3 S;					// Point
+			Vec3 Su, Sv;			// 1st derivatives
+			Vec3 Suu, Suv, Svv;		// 2nd derivatives
+		};
+		inline virtual Jet jet(double u, double v) const {
+			Jet j;
+			j.S = evaluate(u, v);
+			j.Su = differentiate(u, v, 1, 0);
+			j.Sv = differentiate(u, v, 0, 1);
+			j.Suu = differentiate(u, v, 2, 0);
+			j.Suv = differentiate(u, v, 1, 1);
+			j.Svv = differentiate(u, v, 0, 2);
+			return j;
+		}
 		inline virtual Vec3 normal(double u, double v) const {
 			auto Su = differentiate(u, v, 1, 0);
 			auto Sv = differentiate(u, v, 0, 1);
@@ -399,35 +440,62 @@ namespace MN {
 			Vec3 w1, w2;	// Principal directions
 			Real k1, k2;	// Principal curvatures
 		};
+		// Curvature of every pair (uParams[i], vParams[j]) in structure of arrays, where sample is stored at [ i * vNum + j ]
+		class CurvatureGrid {
+		public:
+			int uNum = 0;
+			int vNum = 0;
+			std::vector<Real> K, H, k1, k2;
+			std::vector<Vec3> w1, w2;
+
+			inline void resize(int uNum, int vNum) {
+				this->uNum = uNum;
+				this->vNum = vNum;
+				size_t num = (size_t)uNum * vNum;
+				K.resize(num);
+				H.resize(num);
+				k1.resize(num);
+				k2.resize(num);
+				w1.resize(num);
+				w2.resize(num);
+			}
+			inline CurvatureInfo at(int i, int j) const noexcept {
+				size_t id = (size_t)i * vNum + j;
+				return { K[id], H[id], w1[id], w2[id], k1[id], k2[id] };
+			}
+		};
 		inline virtual CurvatureInfo curvature(double u, double v) {
+			return calCurvature(jet(u, v));
+		}
+		// Curvature from derivatives at one parameter
+		inline static CurvatureInfo calCurvature(const Jet& j) {
 			CurvatureInfo cinfo;
-			Vec3 point, Fu, Fv, Fuu, Fuv, Fvv, normal;
-			point = evaluate(u, v);
-			Fu = differentiate(u, v, 1, 0);
-			Fv = differentiate(u, v, 0, 1);
-			Fuu = differentiate(u, v, 2, 0);
-			Fuv = differentiate(u, v, 1, 1);
-			Fvv = differentiate(u, v, 0, 2);
-			normal = Fu.cross(Fv);
-			normal.normalize();
-
+			const Vec3& Fu = j.Su;
+			const Vec3& Fv = j.Sv;
 			Real
 				E = Fu.dot(Fu),
 				F = Fu.dot(Fv),
 				G = Fv.dot(Fv),
 				denom = sqrt(E * G - F * F),
-				e = Vec3::Tcross(Fu, Fv, Fuu) / denom,
-				f = Vec3::Tcross(Fu, Fv, Fuv) / denom,
-				g = Vec3::Tcross(Fu, Fv, Fvv) / denom;
+				e = Vec3::Tcross(Fu, Fv, j.Suu) / denom,
+				f = Vec3::Tcross(Fu, Fv, j.Suv) / denom,
+				g = Vec3::Tcross(Fu, Fv, j.Svv) / denom;
 			denom = E * G - F * F;
-			
+
 			cinfo.K = (e * g - f * f) / denom;
 			cinfo.H = 0.5 * (e * G - 2.0 * f * F + g * E) / denom;
 			Real
-				tmp = sqrt(cinfo.H * cinfo.H - cinfo.K);
+				tmp = sqrt(std::max(cinfo.H * cinfo.H - cinfo.K, (Real)0));	// Clamped for umbilics
 			cinfo.k1 = cinfo.H + tmp;
 			cinfo.k2 = cinfo.H - tmp;
+			calPrincipalDirections(Fu, Fv, E, F, G, e, f, g, cinfo.k1, cinfo.k2, cinfo.w1, cinfo.w2);
+			return cinfo;
+		}
+	protected:
+		// @e, f, g : Second fundamental form, already divided by sqrt(EG - F^2)
+		inline static void calPrincipalDirections(const Vec3& Fu, const Vec3& Fv, Real E, Real F, Real G, Real e, Real f, Real g, Real k1, Real k2, Vec3& w1, Vec3& w2) {
 			Real
+				denom = E * G - F * F,
 				a11 = (f * F - e * G) / denom,
 				a12 = (g * F - f * G) / denom,
 				a21 = (e * F - f * E) / denom,
@@ -437,30 +505,81 @@ namespace MN {
 			if (fabs(a12) < eps && fabs(a21) < eps) {
 				// Set principal direction properly
 				Real
-					a11_k1 = (a11 + cinfo.k1) * (a11 + cinfo.k1),
-					a11_k2 = (a11 + cinfo.k2) * (a11 + cinfo.k2);	// Compare a11 + k1, k2. Find k s.t. a11 = -k
+					a11_k1 = (a11 + k1) * (a11 + k1),
+					a11_k2 = (a11 + k2) * (a11 + k2);	// Compare a11 + k1, k2. Find k s.t. a11 = -k
 				if (a11_k1 < a11_k2) {
 					// Xu direction has k1 curvature
-					cinfo.w1 = Fu;
-					cinfo.w2 = Fv;
+					w1 = Fu;
+					w2 = Fv;
 				}
 				else {
 					// Xu direction has k2 curvature
-					cinfo.w1 = Fv;
-					cinfo.w2 = Fu;
+					w1 = Fv;
+					w2 = Fu;
 				}
 			}
 			else if (fabs(a12) < eps) {
-				cinfo.w1 = Fv + Fu * ((-cinfo.k1 - a22) / a21);
-				cinfo.w2 = Fv + Fu * ((-cinfo.k2 - a22) / a21);
+				w1 = Fv + Fu * ((-k1 - a22) / a21);
+				w2 = Fv + Fu * ((-k2 - a22) / a21);
 			}
 			else {
-				cinfo.w1 = Fu + Fv * ((-cinfo.k1 - a11) / a12);
-				cinfo.w2 = Fu + Fv * ((-cinfo.k2 - a11) / a12);
+				w1 = Fu + Fv * ((-k1 - a11) / a12);
+				w2 = Fu + Fv * ((-k2 - a11) / a12);
+			}
+			w1.normalize();
+			w2.normalize();
+		}
+		// Curvature of [count] jets into [grid] from [offset]
+		// Fundamental forms are gathered into blocks of arrays first, so that the arithmetic on them is vectorized
+		inline static void calCurvatureRow(const Jet* jets, int count, CurvatureGrid& grid, size_t offset) {
+			const int block = 64;
+			Real E[block], F[block], G[block], e[block], f[block], g[block];
+			for (int beg = 0; beg < count; beg += block) {
+				int num = std::min(block, count - beg);
+				const Jet* jet = jets + beg;
+				for (int s = 0; s < num; s++) {
+					const Vec3& Fu = jet[s].Su;
+					const Vec3& Fv = jet[s].Sv;
+					E[s] = Fu.dot(Fu);
+					F[s] = Fu.dot(Fv);
+					G[s] = Fv.dot(Fv);
+					e[s] = Vec3::Tcross(Fu, Fv, jet[s].Suu);
+					f[s] = Vec3::Tcross(Fu, Fv, jet[s].Suv);
+					g[s] = Vec3::Tcross(Fu, Fv, jet[s].Svv);
+				}
+				Real* K = grid.K.data() + offset + beg;
+				Real* H = grid.H.data() + offset + beg;
+				Real* k1 = grid.k1.data() + offset + beg;
+				Real* k2 = grid.k2.data() + offset + beg;
+				for (int s = 0; s < num; s++) {
+					Real denom = E[s] * G[s] - F[s] * F[s];
+					Real inv = 1.0 / sqrt(denom);
+					e[s] *= inv;
+					f[s] *= inv;
+					g[s] *= inv;
+					K[s] = (e[s] * g[s] - f[s] * f[s]) / denom;
+					H[s] = 0.5 * (e[s] * G[s] - 2.0 * f[s] * F[s] + g[s] * E[s]) / denom;
+					Real tmp = sqrt(std::max(H[s] * H[s] - K[s], (Real)0));
+					k1[s] = H[s] + tmp;
+					k2[s] = H[s] - tmp;
+				}
+				for (int s = 0; s < num; s++) {
+					size_t id = offset + beg + s;
+					calPrincipalDirections(jet[s].Su, jet[s].Sv, E[s], F[s], G[s], e[s], f[s], g[s], k1[s], k2[s], grid.w1[id], grid.w2[id]);
+				}
+			}
+		}
+	public:
+		// Batched curvature, which is implemented by surfaces that share basis over grid rows and columns
+		inline virtual void curvatureGrid(const std::vector<Real>& uParams, const std::vector<Real>& vParams, CurvatureGrid& grid) const {
+			int uNum = (int)uParams.size(), vNum = (int)vParams.size();
+			grid.resize(uNum, vNum);
+			std::vector<Jet> jets(vNum);
+			for (int i = 0; i < uNum; i++) {
+				for (int j = 0; j < vNum; j++)
+					jets[j] = jet(uParams[i], vParams[j]);
+				calCurvatureRow(jets.data(), vNum, grid, (size_t)i * vNum);
 			}
-			cinfo.w1.normalize();
-			cinfo.w2.normalize();
-			return cinfo;
 		}
 	};
 
@@ -493,6 +612,8 @@ namespace MN {
 						vec += tensor[u][v][w] * basisU[u] * basisV[v] * basisW[w];
 			return vec;
 		}
+		// Called after control points are replaced, so that derived entities rebuild what they cache from them without allocation
+		inline virtual void cptsChanged() {}
 	public:
 		inline ControlPoints& getCpts() noexcept {
 			return cpts;
@@ -500,8 +621,9 @@ namespace MN {
 		inline const ControlPoints& getCptsC() const noexcept {
 			return cpts;
 		}
-		inline void setCpts(const ControlPoints& cpts) noexcept {
+		inline void setCpts(const ControlPoints& cpts) {
 			this->cpts = cpts;
+			cptsChanged();
 		}
 
 		// Direction : 0 for U, 1 for V, 2 for W
@@ -560,12 +682,30 @@ namespace MN {
 		inline virtual Vec3 differentiate(Real u, Real v, Real w, int uOrder, int vOrder, int wOrder) const {
 			return Vec3();
 		}
+
+		// Point and 1st derivatives at one parameter, which are columns of Jacobian matrix
+		struct Jet {
+			Vec3 V;					// Point
+			Vec3 Vu, Vv, Vw;		// 1st derivatives
+		};
+		inline virtual Jet jet(Real u, Real v, Real w) const {
+			Jet j;
+			j.V = evaluate(u, v, w);
+			j.Vu = differentiate(u, v, w, 1, 0, 0);
+			j.Vv = differentiate(u, v, w, 0, 1, 0);
+			j.Vw = differentiate(u, v, w, 0, 0, 1);
+			return j;
+		}
 	};
 
 	// Bezier
 	class Bezier {
 	public:
+		// Maximum degree, which equals to limit of [ Bin16 ]
+		const static int maxDegree = 16;
+
 		inline static void calBasisVector(Real t, int degree, BasisVector& basis) {
+			MN_INSTRUMENT_COUNT(BasisBuilds);
 			Real t_1 = 1.0 - t;
 			std::vector<Real> Ts;
 			std::vector<Real> T_1s;
@@ -582,6 +722,130 @@ namespace MN {
 			for (int i = 0; i < degree + 1; i++)
 				basis[i] = Bin16.at(degree, i) * T_1s[degree - i] * Ts[i];
 		}
+		// [order]-th derivative of Bernstein basis of [degree], so that it can be contracted with original control points
+		// Uses B'(i, n) = n * (B(i - 1, n - 1) - B(i, n - 1)) repeatedly, starting from basis of (degree - order)
+		inline static void calBasisDerivVector(Real t, int degree, int order, BasisVector& basis) {
+			if (order > degree) {
+				basis.assign(degree + 1, 0.0);
+				return;
+			}
+			calBasisVector(t, degree - order, basis);
+			basis.resize(degree + 1);
+			for (int d = degree - order + 1; d <= degree; d++) {
+				basis[d] = 0.0;
+				for (int i = d; i >= 0; i--) {
+					Real prev = (i > 0) ? basis[i - 1] : 0.0;
+					basis[i] = d * (prev - basis[i]);
+				}
+			}
+		}
+		// Bernstein basis of [degree] and its 1st, 2nd derivatives at [t], without heap allocation
+		// Each array must hold (degree + 1) values, and derivatives are zero when [degree] is not high enough
+		// Callers keep arrays of (maxDegree + 1) values on stack, so higher degree throws before anything is written
+		inline static void calBasisJet(Real t, int degree, Real* basis, Real* basisT, Real* basisTT) {
+			MN_INSTRUMENT_COUNT(BasisBuilds);
+			if (degree > maxDegree)
+				throw(std::runtime_error("Degree of bezier is too high for basis jet"));
+			Real t_1 = 1.0 - t;
+			Real lower1[maxDegree + 1], lower2[maxDegree + 1];	// Basis of (degree - 1), (degree - 2)
+
+			// Triangular recurrence, keeping rows of lower degrees on the way
+			basis[0] = 1.0;
+			for (int d = 0; d < degree; d++) {
+				if (d == degree - 2)
+					std::copy(basis, basis + d + 1, lower2);
+				if (d == degree - 1)
+					std::copy(basis, basis + d + 1, lower1);
+				basis[d + 1] = t * basis[d];
+				for (int i = d; i > 0; i--)
+					basis[i] = t_1 * basis[i] + t * basis[i - 1];
+				basis[0] *= t_1;
+			}
+
+			int n = degree;
+			for (int i = 0; i <= n; i++) {
+				if (n >= 1) {
+					Real
+						a = (i > 0) ? lower1[i - 1] : 0.0,
+						b = (i < n) ? lower1[i] : 0.0;
+					basisT[i] = n * (a - b);
+				}
+				else
+					basisT[i] = 0.0;
+				if (n >= 2) {
+					Real
+						a = (i > 1) ? lower2[i - 2] : 0.0,
+						b = (i > 0 && i < n) ? lower2[i - 1] : 0.0,
+						c = (i < n - 1) ? lower2[i] : 0.0;
+					basisTT[i] = n * (n - 1) * (a - 2.0 * b + c);
+				}
+				else
+					basisTT[i] = 0.0;
+			}
+		}
+
+		// View of [ data[i * stride] ], e.g) row of control net, or column of control net stored in one buffer
+		template<typename T>
+		class StridedView {
+		public:
+			T* data;
+			ptrdiff_t stride;
+
+			inline T& operator[](int i) const noexcept {
+				return data[i * stride];
+			}
+		};
+		// De Casteljau's algorithm, splitting [size] control points at [t] without heap allocation
+		// Views only need [ operator[] ], and [upper] serves as working storage, so either [lower] or [upper] may alias [cpts]
+		template<typename Src, typename Lower, typename Upper>
+		inline static void subdivide(const Src& cpts, int size, Real t, const Lower& lower, const Upper& upper) {
+			Real t1 = 1.0 - t;
+			for (int i = 0; i < size; i++)
+				upper[i] = cpts[i];
+			// After level r, upper[0 .. size - r) holds r-th intermediate points, whose first one is lower[r] and last one is upper[size - r - 1]
+			for (int r = 1; r < size; r++) {
+				lower[r - 1] = upper[0];
+				for (int i = 0; i < size - r; i++)
+					upper[i] = upper[i] * t1 + upper[i + 1] * t;
+			}
+			if (size > 0)
+				lower[size - 1] = upper[0];
+		}
+		// Control points of [size] control points restricted to [a, b] of [0, 1], which are blossom values P(a, ..., a, b, ..., b)
+		// Only convex combinations at [a] and [b] are taken, without rescaling parameter, so it stays accurate near ends of domain
+		// Points are copied to stack first, so [sub] may alias [cpts]
+		template<typename Src, typename Dst>
+		inline static void extract(const Src& cpts, int size, Real a, Real b, const Dst& sub) {
+			using Point = typename std::decay<decltype(cpts[0])>::type;
+			if (size > maxDegree + 1)
+				throw(std::runtime_error("Degree of bezier is too high for extraction"));
+			Point work[maxDegree + 1], tmp[maxDegree + 1];
+			for (int i = 0; i < size; i++)
+				work[i] = cpts[i];
+
+			Real a1 = 1.0 - a, b1 = 1.0 - b;
+			for (int i = 0; i < size; i++) {
+				// [work] has been blossomed at [b] for i times, so (size - i - 1) more times at [a] gives P(a^(size - i - 1), b^i)
+				int num = size - i;
+				std::copy(work, work + num, tmp);
+				for (int r = 1; r < num; r++)
+					for (int j = 0; j < num - r; j++)
+						tmp[j] = tmp[j] * a1 + tmp[j + 1] * a;
+				sub[i] = tmp[0];
+				for (int j = 0; j < num - 1; j++)
+					work[j] = work[j] * b1 + work[j + 1] * b;
+			}
+		}
+		// Splits [size] control points at [data] into 2^levels pieces at midpoints in place, where [data] holds (2^levels * size) points
+		// Piece s, over [s, s + 1] / 2^levels, takes [ data[s * size .. (s + 1) * size) ]
+		template<typename Point>
+		inline static void subdivideUniform(Point* data, int size, int levels) {
+			// Pieces are split from the last one, so that each piece lands on already consumed or its own place
+			for (int l = 0; l < levels; l++)
+				for (int s = (1 << l) - 1; s >= 0; s--)
+					subdivide(StridedView<Point>{ data + s * size, 1 }, size, 0.5,
+						StridedView<Point>{ data + 2 * s * size, 1 }, StridedView<Point>{ data + (2 * s + 1) * size, 1 });
+		}
 	};
 
 	// Bspline
@@ -605,6 +869,60 @@ namespace MN {
 				knotVector.push_back(val);
 			return knotVector;
 		}
+		// Index [span] of knot interval that has [t], such that knot[span] <= t < knot[span + 1], where end of domain belongs to the last interval
+		inline static int findSpan(Real t, int degree, const KnotVector& knot) {
+			int last = (int)knot.size() - degree - 2;
+			if (t >= knot[last + 1])
+				return last;
+			if (t <= knot[degree])
+				return degree;
+			return (int)(std::upper_bound(knot.begin() + degree, knot.begin() + last + 1, t) - knot.begin()) - 1;
+		}
+		// Nonzero basis functions at [t], which belong to control points [span - degree, span]
+		inline static void calBasis(Real t, int span, int degree, const KnotVector& knot, Real* basis) {
+			MN_INSTRUMENT_COUNT(BasisBuilds);
+			if (degree > Bezier::maxDegree)
+				throw(std::runtime_error("Degree of bspline is too high for basis"));
+			Real left[Bezier::maxDegree + 1], right[Bezier::maxDegree + 1];
+			basis[0] = 1.0;
+			for (int j = 1; j <= degree; j++) {
+				left[j] = t - knot[span + 1 - j];
+				right[j] = knot[span + j] - t;
+				Real saved = 0.0;
+				for (int r = 0; r < j; r++) {
+					Real tmp = basis[r] / (right[r + 1] + left[j - r]);
+					basis[r] = saved + right[r + 1] * tmp;
+					saved = left[j - r] * tmp;
+				}
+				basis[j] = saved;
+			}
+		}
+		// Bezier control points of knot interval [span] of Bspline, which are blossom values P(a, ..., a, b, ..., b) for a = knot[span], b = knot[span + 1]
+		// [cpts] gives control points [span - degree, span], as [ cpts[0 .. degree] ], and [bezier] may alias [cpts]
+		template<typename Src, typename Dst>
+		inline static void extractSpan(const Src& cpts, int span, int degree, const KnotVector& knot, const Dst& bezier) {
+			using Point = typename std::decay<decltype(cpts[0])>::type;
+			if (degree > Bezier::maxDegree)
+				throw(std::runtime_error("Degree of bspline is too high for extraction"));
+			Point src[Bezier::maxDegree + 1], work[Bezier::maxDegree + 1];
+			for (int i = 0; i <= degree; i++)
+				src[i] = cpts[i];
+
+			Real a = knot[span], b = knot[span + 1];
+			for (int i = 0; i <= degree; i++) {
+				// De Boor's algorithm, taking [a] at first (degree - i) levels and [b] at the rest
+				std::copy(src, src + degree + 1, work);
+				for (int r = 1; r <= degree; r++) {
+					Real t = r <= degree - i ? a : b;
+					for (int j = degree; j >= r; j--) {
+						Real lo = knot[span - degree + j], hi = knot[span + j + 1 - r];
+						Real alpha = (t - lo) / (hi - lo);
+						work[j] = work[j - 1] * (1.0 - alpha) + work[j] * alpha;
+					}
+				}
+				bezier[i] = work[degree];
+			}
+		}
 	};
 }
 
@@ -0,0 +1,725 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "FreeformStore.h"
+#include "../Parallel.h"
+#include <cstring>
+#include <fstream>
+#include <functional>
+
+namespace MN {
+	const static char storeMagic[8] = { 'M', 'N', 'F', 'F', 'S', 'T', 'O', 'R' };
+	const static uint32_t endianTag = 0x01020304;
+	const static uint64_t sectionAlign = 64;		// Alignment of sections in file, which is page aligned when mapped
+
+	static_assert(sizeof(Vec3) == 3 * sizeof(Real), "Points of store are read in place as Vec3");
+	static_assert(sizeof(Real) == sizeof(double), "Store keeps real numbers as double");
+
+	class StoreHeader {
+	public:
+		char magic[8];
+		uint32_t version;
+		uint32_t entity;
+		uint32_t endian;
+		uint32_t realSize;
+		uint32_t sectionNum;
+		uint32_t reserved[9];
+	};
+	class StoreSection {
+	public:
+		uint32_t id;
+		uint32_t reserved;
+		uint64_t offset;
+		uint64_t size;
+	};
+	static_assert(sizeof(StoreHeader) == 64, "Header of store must be 64 bytes");
+
+	// Entries of info section
+	enum StoreInfo {
+		InfoDimension,
+		InfoDegree,
+		InfoCptsNum = InfoDegree + 3,
+		InfoKnotNum = InfoCptsNum + 3,
+		InfoPatchNum = InfoKnotNum + 3,
+		InfoDerivMatNum,
+		InfoSize = 16
+	};
+
+	// Control nets are flattened in row major order, with shape of 1 for direction beyond their dimension
+	static void appendNet(const std::vector<Vec3>& net, std::vector<Real>& out, int32_t* shape) {
+		shape[0] = (int32_t)net.size();
+		shape[1] = shape[2] = 1;
+		for (const auto& p : net)
+			out.insert(out.end(), p.v, p.v + 3);
+	}
+	static void appendNet(const std::vector<std::vector<Vec3>>& net, std::vector<Real>& out, int32_t* shape) {
+		shape[0] = (int32_t)net.size();
+		shape[1] = net.empty() ? 0 : (int32_t)net[0].size();
+		shape[2] = 1;
+		for (const auto& row : net)
+			for (const auto& p : row)
+				out.insert(out.end(), p.v, p.v + 3);
+	}
+	static void appendNet(const std::vector<std::vector<std::vector<Vec3>>>& net, std::vector<Real>& out, int32_t* shape) {
+		shape[0] = (int32_t)net.size();
+		shape[1] = net.empty() ? 0 : (int32_t)net[0].size();
+		shape[2] = (net.empty() || net[0].empty()) ? 0 : (int32_t)net[0][0].size();
+		for (const auto& plane : net)
+			for (const auto& row : plane)
+				for (const auto& p : row)
+					out.insert(out.end(), p.v, p.v + 3);
+	}
+	static void readNet(const Vec3* data, const int32_t* shape, std::vector<Vec3>& net) {
+		net.assign(data, data + shape[0]);
+	}
+	static void readNet(const Vec3* data, const int32_t* shape, std::vector<std::vector<Vec3>>& net) {
+		net.resize(shape[0]);
+		for (int i = 0; i < shape[0]; i++, data += shape[1])
+			net[i].assign(data, data + shape[1]);
+	}
+	static void readNet(const Vec3* data, const int32_t* shape, std::vector<std::vector<std::vector<Vec3>>>& net) {
+		net.resize(shape[0]);
+		for (int i = 0; i < shape[0]; i++) {
+			net[i].resize(shape[1]);
+			for (int j = 0; j < shape[1]; j++, data += shape[2])
+				net[i][j].assign(data, data + shape[2]);
+		}
+	}
+	static size_t shapeSize(const int32_t* shape) {
+		return (size_t)shape[0] * shape[1] * shape[2];
+	}
+
+	// Write header and section table, returning offset of each section, which is aligned to [sectionAlign]
+	static std::vector<uint64_t> writeLayout(std::ofstream& file, FreeformStore::Entity entity, const std::vector<FreeformStore::Section>& ids, const std::vector<uint64_t>& sizes) {
+		StoreHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, storeMagic, sizeof(storeMagic));
+		header.version = FreeformStore::version;
+		header.entity = (uint32_t)entity;
+		header.endian = endianTag;
+		header.realSize = (uint32_t)sizeof(Real);
+		header.sectionNum = (uint32_t)ids.size();
+
+		std::vector<StoreSection> table(ids.size());
+		std::vector<uint64_t> offsets(ids.size());
+		uint64_t offset = sizeof(StoreHeader) + sizeof(StoreSection) * table.size();
+		for (size_t i = 0; i < ids.size(); i++) {
+			offset = (offset + sectionAlign - 1) / sectionAlign * sectionAlign;
+			table[i].id = (uint32_t)ids[i];
+			table[i].reserved = 0;
+			table[i].offset = offsets[i] = offset;
+			table[i].size = sizes[i];
+			offset += sizes[i];
+		}
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)table.data(), sizeof(StoreSection) * table.size());
+		return offsets;
+	}
+
+	/*
+	 * Sections are flattened one at a time while writing, so that memory in use stays at the largest section.
+	 * Size of each section must be known before, to write section table first.
+	 */
+	class StoreWriter {
+	public:
+		class Entry {
+		public:
+			FreeformStore::Section id;
+			uint64_t size;
+			std::function<void(std::vector<unsigned char>&)> fill;
+		};
+		std::vector<Entry> entries;
+
+		template<typename T>
+		void add(FreeformStore::Section id, size_t count, std::function<void(std::vector<T>&)> fill) {
+			entries.push_back({ id, (uint64_t)(count * sizeof(T)), [fill, count](std::vector<unsigned char>& bytes) {
+				std::vector<T> data;
+				data.reserve(count);
+				fill(data);
+				if (data.size() != count)
+					throw(std::runtime_error("Size of store section does not match its content"));
+				bytes.resize(count * sizeof(T));
+				if (count > 0)
+					std::memcpy(bytes.data(), data.data(), bytes.size());
+			} });
+		}
+		void write(const std::string& path, FreeformStore::Entity entity) const {
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			if (!file)
+				throw(std::runtime_error("Cannot open file to store : " + path));
+			std::vector<FreeformStore::Section> ids;
+			std::vector<uint64_t> sizes;
+			for (const auto& entry : entries) {
+				ids.push_back(entry.id);
+				sizes.push_back(entry.size);
+			}
+			std::vector<uint64_t> offsets = writeLayout(file, entity, ids, sizes);
+
+			std::vector<unsigned char> bytes;
+			uint64_t position = sizeof(StoreHeader) + sizeof(StoreSection) * entries.size();
+			const char zeros[sectionAlign] = {};
+			for (size_t i = 0; i < entries.size(); i++) {
+				file.write(zeros, (std::streamsize)(offsets[i] - position));
+				entries[i].fill(bytes);
+				file.write((const char*)bytes.data(), (std::streamsize)bytes.size());
+				position = offsets[i] + sizes[i];
+			}
+			if (!file)
+				throw(std::runtime_error("Cannot write file to store : " + path));
+		}
+	};
+
+	// Sections shared by every entity, from patches of [ Bezier ] type and their subdomains given by [domainOf]
+	template<typename Bezier, typename Patch, typename PatchOf, typename DomainOf, typename DerivMatsOf>
+	static void addPatchSections(StoreWriter& writer, const std::vector<Patch>& patches, int dimension, int sections,
+		PatchOf patchOf, DomainOf domainOf, DerivMatsOf derivMatsOf, std::vector<int32_t>& info) {
+		int patchNum = (sections & FreeformStore::Patches) ? (int)patches.size() : 0;
+		info[InfoPatchNum] = patchNum;
+		if (patchNum == 0)
+			return;
+
+		int32_t shape[3];
+		std::vector<Real> scratch;
+		appendNet(patchOf(patches[0]).getCptsC(), scratch, shape);
+		size_t patchSize = shapeSize(shape);
+
+		writer.add<Real>(FreeformStore::Section::PatchDomains, (size_t)patchNum * dimension * 2, [&patches, patchNum, domainOf](std::vector<Real>& data) {
+			for (int p = 0; p < patchNum; p++)
+				domainOf(patches[p], data);
+		});
+		writer.add<Real>(FreeformStore::Section::PatchCpts, (size_t)patchNum * patchSize * 3, [&patches, patchNum, patchOf](std::vector<Real>& data) {
+			int32_t patchShape[3];
+			for (int p = 0; p < patchNum; p++)
+				appendNet(patchOf(patches[p]).getCptsC(), data, patchShape);
+		});
+		if (!(sections & FreeformStore::DerivMats))
+			return;
+
+		// Every patch has the same degrees, so shapes of deriv matrices are taken from the first one
+		auto mats = derivMatsOf(patchOf(patches[0]));
+		std::vector<int32_t> shapes(mats.size() * 3);
+		size_t derivSize = 0;
+		for (size_t m = 0; m < mats.size(); m++) {
+			scratch.clear();
+			appendNet(*mats[m], scratch, &shapes[m * 3]);
+			derivSize += shapeSize(&shapes[m * 3]);
+		}
+		info[InfoDerivMatNum] = (int32_t)mats.size();
+		writer.add<int32_t>(FreeformStore::Section::DerivShapes, shapes.size(), [shapes](std::vector<int32_t>& data) {
+			data = shapes;
+		});
+		writer.add<Real>(FreeformStore::Section::DerivMats, (size_t)patchNum * derivSize * 3, [&patches, patchNum, patchOf, derivMatsOf](std::vector<Real>& data) {
+			int32_t matShape[3];
+			for (int p = 0; p < patchNum; p++)
+				for (auto* mat : derivMatsOf(patchOf(patches[p])))
+					appendNet(*mat, data, matShape);
+		});
+	}
+
+	template<typename Patch>
+	auto FreeformStore::derivMatsOf(Patch& patch) {
+		using Type = std::remove_const_t<Patch>;
+		if constexpr (std::is_same<Type, BezierCurve3d>::value) {
+			return std::vector<decltype(&patch.derivMatT)>{ &patch.derivMatT, &patch.derivMatTT, &patch.derivMatTTT };
+		}
+		else if constexpr (std::is_same<Type, BezierSurface3d>::value) {
+			return std::vector<decltype(&patch.derivMatU)>{ &patch.derivMatU, &patch.derivMatV, &patch.derivMatUU, &patch.derivMatUV, &patch.derivMatVV,
+				&patch.derivMatUUU, &patch.derivMatUUV, &patch.derivMatUVV, &patch.derivMatVVV };
+		}
+		else {
+			static_assert(std::is_same<Type, BezierVolume3d>::value, "Deriv matrices of unknown entity");
+			return std::vector<decltype(&patch.derivMatU)>{ &patch.derivMatU, &patch.derivMatV, &patch.derivMatW,
+				&patch.derivMatUU, &patch.derivMatUV, &patch.derivMatUW, &patch.derivMatVV, &patch.derivMatVW, &patch.derivMatWW,
+				&patch.derivMatUUU, &patch.derivMatUUV, &patch.derivMatUUW, &patch.derivMatUVV, &patch.derivMatUVW,
+				&patch.derivMatUWW, &patch.derivMatVVV, &patch.derivMatVVW, &patch.derivMatVWW, &patch.derivMatWWW };
+		}
+	}
+
+	// Info, knots and control points, with [ knots[d] ] of each direction below [dimension]
+	static void addBaseSections(StoreWriter& writer, std::vector<int32_t>& info, int dimension, const int* degree, const KnotVector* const* knots, const int32_t* cptsShape,
+		std::function<void(std::vector<Real>&)> fillCpts) {
+		info[InfoDimension] = dimension;
+		size_t knotNum = 0;
+		for (int d = 0; d < 3; d++) {
+			info[InfoDegree + d] = d < dimension ? degree[d] : 0;
+			info[InfoCptsNum + d] = cptsShape[d];
+			info[InfoKnotNum + d] = d < dimension ? (int32_t)knots[d]->size() : 0;
+			knotNum += info[InfoKnotNum + d];
+		}
+		writer.add<Real>(FreeformStore::Section::Knots, knotNum, [dimension, knots](std::vector<Real>& data) {
+			for (int d = 0; d < dimension; d++)
+				data.insert(data.end(), knots[d]->begin(), knots[d]->end());
+		});
+		writer.add<Real>(FreeformStore::Section::Cpts, shapeSize(cptsShape) * 3, fillCpts);
+	}
+	// Info section is added last in writer, but placed first in file, since patch sections fill parts of it
+	static void finishInfo(StoreWriter& writer, const std::vector<int32_t>& info) {
+		writer.add<int32_t>(FreeformStore::Section::Info, info.size(), [info](std::vector<int32_t>& data) {
+			data = info;
+		});
+		std::rotate(writer.entries.begin(), writer.entries.end() - 1, writer.entries.end());
+	}
+
+	void FreeformStore::save(const std::string& path, const BsplineCurve3d& curve, int sections) {
+		StoreWriter writer;
+		std::vector<int32_t> info(InfoSize, 0);
+		int degree[1] = { curve.getDegree() };
+		const KnotVector* knots[1] = { &curve.getKnotVectorC() };
+		const auto& cpts = curve.getCptsC();
+		int32_t shape[3] = { (int32_t)cpts.size(), 1, 1 };
+		addBaseSections(writer, info, 1, degree, knots, shape, [&cpts](std::vector<Real>& data) {
+			int32_t netShape[3];
+			appendNet(cpts, data, netShape);
+		});
+		addPatchSections<BezierCurve3d>(writer, curve.getPatchVectorC(), 1, sections,
+			[](const BsplineCurve3d::Patch& patch) -> const BezierCurve3d& { return *patch.curve; },
+			[](const BsplineCurve3d::Patch& patch, std::vector<Real>& data) {
+				data.push_back(patch.subdomain.beg());
+				data.push_back(patch.subdomain.end());
+			},
+			[](const BezierCurve3d& patch) { return derivMatsOf(patch); }, info);
+		finishInfo(writer, info);
+		writer.write(path, Entity::BsplineCurve3d);
+	}
+	void FreeformStore::save(const std::string& path, const BsplineSurface3d& surface, int sections) {
+		StoreWriter writer;
+		std::vector<int32_t> info(InfoSize, 0);
+		int degree[2] = { surface.getDegree(0), surface.getDegree(1) };
+		const KnotVector* knots[2] = { &surface.uKnot, &surface.vKnot };
+		const auto& cpts = surface.getCptsC();
+		int32_t shape[3] = { (int32_t)cpts.size(), cpts.empty() ? 0 : (int32_t)cpts[0].size(), 1 };
+		addBaseSections(writer, info, 2, degree, knots, shape, [&cpts](std::vector<Real>& data) {
+			int32_t netShape[3];
+			appendNet(cpts, data, netShape);
+		});
+		addPatchSections<BezierSurface3d>(writer, surface.patches, 2, sections,
+			[](const BsplineSurface3d::Patch& patch) -> const BezierSurface3d& { return *patch.patch; },
+			[](const BsplineSurface3d::Patch& patch, std::vector<Real>& data) {
+				for (const Domain* domain : { &patch.uSubdomain, &patch.vSubdomain }) {
+					data.push_back(domain->beg());
+					data.push_back(domain->end());
+				}
+			},
+			[](const BezierSurface3d& patch) { return derivMatsOf(patch); }, info);
+		finishInfo(writer, info);
+		writer.write(path, Entity::BsplineSurface3d);
+	}
+	void FreeformStore::save(const std::string& path, const BsplineVolume3d& volume, int sections) {
+		StoreWriter writer;
+		std::vector<int32_t> info(InfoSize, 0);
+		int degree[3] = { volume.getDegree(0), volume.getDegree(1), volume.getDegree(2) };
+		const KnotVector* knots[3] = { &volume.uKnot, &volume.vKnot, &volume.wKnot };
+		const auto& cpts = volume.getCptsC();
+		int32_t shape[3];
+		shape[0] = (int32_t)cpts.size();
+		shape[1] = cpts.empty() ? 0 : (int32_t)cpts[0].size();
+		shape[2] = (cpts.empty() || cpts[0].empty()) ? 0 : (int32_t)cpts[0][0].size();
+		addBaseSections(writer, info, 3, degree, knots, shape, [&cpts](std::vector<Real>& data) {
+			int32_t netShape[3];
+			appendNet(cpts, data, netShape);
+		});
+		addPatchSections<BezierVolume3d>(writer, volume.patches, 3, sections,
+			[](const BsplineVolume3d::Patch& patch) -> const BezierVolume3d& { return *patch.patch; },
+			[](const BsplineVolume3d::Patch& patch, std::vector<Real>& data) {
+				for (const Domain* domain : { &patch.uSubdomain, &patch.vSubdomain, &patch.wSubdomain }) {
+					data.push_back(domain->beg());
+					data.push_back(domain->end());
+				}
+			},
+			[](const BezierVolume3d& patch) { return derivMatsOf(patch); }, info);
+		finishInfo(writer, info);
+		writer.write(path, Entity::BsplineVolume3d);
+	}
+
+	// View
+	FreeformStore::View FreeformStore::View::create(const MappedFile::Ptr& file) {
+		const unsigned char* data = file->getData();
+		size_t size = file->getSize();
+		if (size < sizeof(StoreHeader))
+			throw(std::runtime_error("File is too small for freeform store"));
+		StoreHeader header;
+		std::memcpy(&header, data, sizeof(header));
+		if (std::memcmp(header.magic, storeMagic, sizeof(storeMagic)) != 0)
+			throw(std::runtime_error("File is not freeform store"));
+		if (header.version != FreeformStore::version)
+			throw(std::runtime_error("Unsupported version of freeform store"));
+		if (header.endian != endianTag || header.realSize != sizeof(Real))
+			throw(std::runtime_error("Freeform store was written on incompatible platform"));
+		if (header.entity < (uint32_t)Entity::BsplineCurve3d || header.entity > (uint32_t)Entity::BsplineVolume3d)
+			throw(std::runtime_error("Unknown entity in freeform store"));
+		if (sizeof(StoreHeader) + (size_t)header.sectionNum * sizeof(StoreSection) > size)
+			throw(std::runtime_error("Section table of freeform store is truncated"));
+
+		View view;
+		view.file = file;
+		view.entity = (Entity)header.entity;
+		for (uint32_t i = 0; i < header.sectionNum; i++) {
+			StoreSection entry;
+			std::memcpy(&entry, data + sizeof(StoreHeader) + i * sizeof(StoreSection), sizeof(entry));
+			if (entry.id == 0 || entry.id >= (uint32_t)Section::End)
+				continue;		// Sections of later versions are skipped
+			if (entry.offset % sectionAlign != 0 || entry.offset > size || entry.size > size - entry.offset)
+				throw(std::runtime_error("Section of freeform store is out of file"));
+			view.sections[entry.id] = data + entry.offset;
+			view.sectionSizes[entry.id] = (size_t)entry.size;
+		}
+		for (Section id : { Section::Info, Section::Knots, Section::Cpts })
+			if (view.sections[(int)id] == nullptr)
+				throw(std::runtime_error("Freeform store misses required section"));
+		if (view.sectionSizes[(int)Section::Info] < InfoSize * sizeof(int32_t))
+			throw(std::runtime_error("Info section of freeform store is truncated"));
+		view.info = (const int32_t*)view.section(Section::Info);
+
+		// Check info before any accessor indexes with it, as file may be corrupt
+		int dimension = view.getDimension();
+		if (dimension != (int)view.entity)
+			throw(std::runtime_error("Dimension of freeform store does not match its entity"));
+		for (int d = 0; d < 3; d++) {
+			int degree = view.getDegree(d), cptsNum = view.getCptsNum(d), knotNum = view.getKnotNum(d);
+			bool valid = d < dimension ?
+				(degree >= 0 && degree <= Bezier::maxDegree && cptsNum > degree && knotNum == cptsNum + degree + 1) :
+				(degree == 0 && cptsNum == 1 && knotNum == 0);
+			if (!valid)
+				throw(std::runtime_error("Invalid degree or size in freeform store"));
+		}
+		if (view.info[InfoPatchNum] < 0 || view.info[InfoDerivMatNum] < 0)
+			throw(std::runtime_error("Invalid number of patches in freeform store"));
+
+		// Check sizes of sections against info, so that accessors need not
+		// Every count is below 2^31, so that product of two fits, and the third is checked against file size before multiplied
+		size_t knotNum = 0;
+		view.knotOffsets.resize(3);
+		for (int d = 0; d < 3; d++) {
+			view.knotOffsets[d] = knotNum;
+			knotNum += (size_t)view.info[InfoKnotNum + d];
+		}
+		size_t cptsPlane = (size_t)view.getCptsNum(0) * view.getCptsNum(1);
+		if (cptsPlane > size / sizeof(Vec3) ||
+			view.sectionSizes[(int)Section::Knots] < knotNum * sizeof(Real) ||
+			view.sectionSizes[(int)Section::Cpts] / sizeof(Vec3) / view.getCptsNum(2) < cptsPlane)
+			throw(std::runtime_error("Section of freeform store is smaller than its info"));
+		size_t patchSize = 1;
+		int32_t patchShape[3] = { 1, 1, 1 };
+		for (int d = 0; d < dimension; d++) {
+			patchShape[d] = view.getDegree(d) + 1;
+			patchSize *= (size_t)patchShape[d];
+		}
+		if (view.hasPatches()) {
+			size_t patchNum = view.getPatchNum();
+			if (view.sectionSizes[(int)Section::PatchDomains] < patchNum * dimension * 2 * sizeof(Real) ||
+				view.sectionSizes[(int)Section::PatchCpts] < patchNum * patchSize * sizeof(Vec3))
+				throw(std::runtime_error("Patch section of freeform store is smaller than its info"));
+		}
+		if (view.hasDerivMats()) {
+			// Shapes must be what [ updateDerivMat ] builds for the degrees, which are taken from patch of zero points
+			std::vector<int32_t> expected;
+			std::vector<Vec3> zeros(patchSize);
+			auto collect = [&](auto& patch, auto mats) {
+				readNet(zeros.data(), patchShape, patch.getCpts());
+				patch.updateDerivMat();
+				std::vector<Real> scratch;
+				int32_t shape[3];
+				for (auto* mat : mats) {
+					appendNet(*mat, scratch, shape);
+					expected.insert(expected.end(), shape, shape + 3);
+				}
+			};
+			if (view.entity == Entity::BsplineCurve3d) {
+				BezierCurve3d patch = BezierCurve3d::create();
+				patch.setDegree(view.getDegree(0));
+				collect(patch, derivMatsOf(patch));
+			}
+			else if (view.entity == Entity::BsplineSurface3d) {
+				BezierSurface3d patch;
+				for (int d = 0; d < 2; d++) {
+					patch.setDomain(d, Domain::create(0, 1));
+					patch.setDegree(d, view.getDegree(d));
+				}
+				collect(patch, derivMatsOf(patch));
+			}
+			else {
+				BezierVolume3d patch = BezierVolume3d::create();
+				for (int d = 0; d < 3; d++) {
+					patch.setDomain(d, Domain::create(0, 1));
+					patch.setDegree(d, view.getDegree(d));
+				}
+				collect(patch, derivMatsOf(patch));
+			}
+
+			int matNum = view.getDerivMatNum();
+			if (matNum * 3 != (int)expected.size() || view.sectionSizes[(int)Section::DerivShapes] < expected.size() * sizeof(int32_t) ||
+				!std::equal(expected.begin(), expected.end(), (const int32_t*)view.section(Section::DerivShapes)))
+				throw(std::runtime_error("Deriv shapes of freeform store do not match its degrees"));
+			size_t offset = 0;
+			for (int m = 0; m < matNum; m++) {
+				view.derivOffsets.push_back(offset);
+				offset += shapeSize(view.getDerivMatShape(m));
+			}
+			view.derivOffsets.push_back(offset);
+			if (view.sectionSizes[(int)Section::DerivMats] / sizeof(Vec3) / std::max(offset, (size_t)1) < (size_t)view.getPatchNum())
+				throw(std::runtime_error("Deriv section of freeform store is smaller than its info"));
+		}
+		return view;
+	}
+	const unsigned char* FreeformStore::View::section(Section id) const {
+		return sections[(int)id];
+	}
+	int FreeformStore::View::getDimension() const noexcept {
+		return info[InfoDimension];
+	}
+	int FreeformStore::View::getDegree(int dir) const noexcept {
+		return info[InfoDegree + dir];
+	}
+	int FreeformStore::View::getCptsNum(int dir) const noexcept {
+		return info[InfoCptsNum + dir];
+	}
+	int FreeformStore::View::getKnotNum(int dir) const noexcept {
+		return info[InfoKnotNum + dir];
+	}
+	const Real* FreeformStore::View::getKnots(int dir) const noexcept {
+		return (const Real*)section(Section::Knots) + knotOffsets[dir];
+	}
+	const Vec3* FreeformStore::View::getCpts() const noexcept {
+		return (const Vec3*)section(Section::Cpts);
+	}
+	bool FreeformStore::View::hasPatches() const noexcept {
+		return info[InfoPatchNum] > 0 && section(Section::PatchDomains) && section(Section::PatchCpts);
+	}
+	int FreeformStore::View::getPatchNum() const noexcept {
+		return hasPatches() ? info[InfoPatchNum] : 0;
+	}
+	const Real* FreeformStore::View::getPatchDomain(int patch) const noexcept {
+		return (const Real*)section(Section::PatchDomains) + (size_t)patch * getDimension() * 2;
+	}
+	const Vec3* FreeformStore::View::getPatchCpts(int patch) const noexcept {
+		size_t patchSize = 1;
+		for (int d = 0; d < getDimension(); d++)
+			patchSize *= (size_t)getDegree(d) + 1;
+		return (const Vec3*)section(Section::PatchCpts) + (size_t)patch * patchSize;
+	}
+	bool FreeformStore::View::hasDerivMats() const noexcept {
+		return hasPatches() && info[InfoDerivMatNum] > 0 && section(Section::DerivShapes) && section(Section::DerivMats);
+	}
+	int FreeformStore::View::getDerivMatNum() const noexcept {
+		return hasDerivMats() ? info[InfoDerivMatNum] : 0;
+	}
+	const int32_t* FreeformStore::View::getDerivMatShape(int mat) const noexcept {
+		return (const int32_t*)section(Section::DerivShapes) + (size_t)mat * 3;
+	}
+	const Vec3* FreeformStore::View::getDerivMat(int patch, int mat) const noexcept {
+		return (const Vec3*)section(Section::DerivMats) + (size_t)patch * derivOffsets.back() + derivOffsets[mat];
+	}
+
+	uint64_t FreeformStore::View::getSectionOffset(Section id) const noexcept {
+		return section(id) ? (uint64_t)(section(id) - file->getData()) : 0;
+	}
+
+	// VolumeWriter
+	FreeformStore::VolumeWriter::Ptr FreeformStore::VolumeWriter::createPtr(const std::string& path, const int* degree, const BsplineVolume3d::KnotVector* knots, int patchNum) {
+		Ptr writer(new VolumeWriter());
+		writer->path = path;
+		writer->file.open(path, std::ios::binary | std::ios::trunc);
+		if (!writer->file)
+			throw(std::runtime_error("Cannot open file to store : " + path));
+
+		std::vector<int32_t> info(InfoSize, 0);
+		std::vector<Real> knotData;
+		info[InfoDimension] = 3;
+		info[InfoPatchNum] = patchNum;
+		size_t cptsNum = 1;
+		writer->patchSize = 1;
+		for (int d = 0; d < 3; d++) {
+			info[InfoDegree + d] = degree[d];
+			info[InfoCptsNum + d] = (int32_t)knots[d].size() - degree[d] - 1;
+			info[InfoKnotNum + d] = (int32_t)knots[d].size();
+			if (info[InfoCptsNum + d] <= degree[d])
+				throw(std::runtime_error("Invalid knot vector for volume store"));
+			cptsNum *= (size_t)info[InfoCptsNum + d];
+			writer->patchSize *= (size_t)degree[d] + 1;
+			knotData.insert(knotData.end(), knots[d].begin(), knots[d].end());
+		}
+
+		std::vector<Section> ids = { Section::Info, Section::Knots, Section::Cpts };
+		std::vector<uint64_t> sizes = { info.size() * sizeof(int32_t), knotData.size() * sizeof(Real), cptsNum * sizeof(Vec3) };
+		if (patchNum > 0) {
+			ids.insert(ids.end(), { Section::PatchDomains, Section::PatchCpts });
+			sizes.insert(sizes.end(), { (uint64_t)patchNum * 6 * sizeof(Real), (uint64_t)patchNum * writer->patchSize * sizeof(Vec3) });
+		}
+		std::vector<uint64_t> offsets = writeLayout(writer->file, Entity::BsplineVolume3d, ids, sizes);
+		for (size_t i = 0; i < ids.size(); i++) {
+			writer->offsets[(int)ids[i]] = offsets[i];
+			writer->sizes[(int)ids[i]] = sizes[i];
+		}
+		writer->write(Section::Info, info.data(), sizes[0]);
+		writer->write(Section::Knots, knotData.data(), sizes[1]);
+		return writer;
+	}
+	void FreeformStore::VolumeWriter::write(Section id, const void* data, size_t bytes) {
+		uint64_t& cursor = cursors[(int)id];
+		if (cursor + bytes > sizes[(int)id])
+			throw(std::runtime_error("Too much data for section of volume store"));
+		// Gaps between sections are left to file system, which fills them with zeros
+		file.seekp((std::streamoff)(offsets[(int)id] + cursor));
+		file.write((const char*)data, (std::streamsize)bytes);
+		if (!file)
+			throw(std::runtime_error("Cannot write file to store : " + path));
+		cursor += bytes;
+	}
+	void FreeformStore::VolumeWriter::writeCpts(const Vec3* cpts, size_t num) {
+		write(Section::Cpts, cpts, num * sizeof(Vec3));
+	}
+	void FreeformStore::VolumeWriter::writePatches(const std::vector<BsplineVolume3d::Patch>& patches) {
+		if (patches.empty())
+			return;
+		std::vector<Real> domains;
+		std::vector<Real> points;
+		int32_t shape[3];
+		domains.reserve(patches.size() * 6);
+		points.reserve(patches.size() * patchSize * 3);
+		for (const auto& patch : patches) {
+			for (const Domain* domain : { &patch.uSubdomain, &patch.vSubdomain, &patch.wSubdomain }) {
+				domains.push_back(domain->beg());
+				domains.push_back(domain->end());
+			}
+			appendNet(patch.patch->getCptsC(), points, shape);
+			if (shapeSize(shape) != patchSize)
+				throw(std::runtime_error("Patch of different degree for volume store"));
+		}
+		write(Section::PatchDomains, domains.data(), domains.size() * sizeof(Real));
+		write(Section::PatchCpts, points.data(), points.size() * sizeof(Real));
+	}
+	void FreeformStore::VolumeWriter::close() {
+		for (int id = 0; id < (int)Section::End; id++)
+			if (cursors[id] != sizes[id])
+				throw(std::runtime_error("Volume store is closed before every section is written"));
+		file.close();
+		if (!file)
+			throw(std::runtime_error("Cannot write file to store : " + path));
+	}
+
+	FreeformStore::View FreeformStore::open(const std::string& path) {
+		return View::create(MappedFile::createPtr(path));
+	}
+
+	// Fill Bezier patch from view, and compute deriv matrices only when they are not stored
+	template<typename Bezier>
+	static void loadPatch(const FreeformStore::View& view, int p, Bezier& patch, std::vector<typename Bezier::ControlPoints*> mats) {
+		int32_t shape[3] = { 1, 1, 1 };
+		for (int d = 0; d < view.getDimension(); d++)
+			shape[d] = view.getDegree(d) + 1;
+		readNet(view.getPatchCpts(p), shape, patch.getCpts());
+		if (view.hasDerivMats()) {
+			for (int m = 0; m < (int)mats.size(); m++)
+				readNet(view.getDerivMat(p, m), view.getDerivMatShape(m), *mats[m]);
+			patch.updateBound();
+		}
+		else
+			patch.updateDerivMat();
+	}
+	static void checkEntity(const FreeformStore::View& view, FreeformStore::Entity entity) {
+		if (view.getEntity() != entity)
+			throw(std::runtime_error("Freeform store has different entity"));
+	}
+
+	BsplineCurve3d::Ptr FreeformStore::loadCurve(const View& view) {
+		MN_INSTRUMENT_TIMER(StoreLoad);
+		checkEntity(view, Entity::BsplineCurve3d);
+		auto curve = std::make_shared<BsplineCurve3d>();
+		curve->setDegree(view.getDegree(0));
+		curve->setKnotVector(KnotVector(view.getKnots(0), view.getKnots(0) + view.getKnotNum(0)));
+		curve->setDomain(Domain::create(curve->getKnotVectorC().front(), curve->getKnotVectorC().back()));
+		int32_t shape[3] = { view.getCptsNum(0), 1, 1 };
+		readNet(view.getCpts(), shape, curve->getCpts());
+		if (!view.hasPatches()) {
+			curve->updatePatches();
+			return curve;
+		}
+
+		auto& patches = curve->getPatchVector();
+		patches.resize(view.getPatchNum());
+		Parallel::forEach(0, (int)patches.size(), [&](int p) {
+			const Real* domain = view.getPatchDomain(p);
+			BezierCurve3d patch = BezierCurve3d::create();
+			patch.setDegree(view.getDegree(0));
+			loadPatch(view, p, patch, derivMatsOf(patch));
+			patches[p].subdomain = Domain::create(domain[0], domain[1]);
+			patches[p].curve = std::make_shared<BezierCurve3d>(std::move(patch));
+		});
+		return curve;
+	}
+	BsplineSurface3d::Ptr FreeformStore::loadSurface(const View& view) {
+		MN_INSTRUMENT_TIMER(StoreLoad);
+		checkEntity(view, Entity::BsplineSurface3d);
+		auto surface = std::make_shared<BsplineSurface3d>();
+		surface->uKnot.assign(view.getKnots(0), view.getKnots(0) + view.getKnotNum(0));
+		surface->vKnot.assign(view.getKnots(1), view.getKnots(1) + view.getKnotNum(1));
+		for (int d = 0; d < 2; d++) {
+			const auto& knot = d == 0 ? surface->uKnot : surface->vKnot;
+			surface->setDegree(d, view.getDegree(d));
+			surface->setDomain(d, knot.front(), knot.back());
+		}
+		int32_t shape[3] = { view.getCptsNum(0), view.getCptsNum(1), 1 };
+		readNet(view.getCpts(), shape, surface->getCpts());
+		if (!view.hasPatches()) {
+			surface->updatePatches();
+			return surface;
+		}
+
+		surface->patches.resize(view.getPatchNum());
+		Parallel::forEach(0, (int)surface->patches.size(), [&](int p) {
+			const Real* domain = view.getPatchDomain(p);
+			BezierSurface3d patch;
+			patch.setDomain(0, Domain::create(0, 1));
+			patch.setDomain(1, Domain::create(0, 1));
+			patch.setDegree(0, view.getDegree(0));
+			patch.setDegree(1, view.getDegree(1));
+			loadPatch(view, p, patch, derivMatsOf(patch));
+			auto& target = surface->patches[p];
+			target.uSubdomain = Domain::create(domain[0], domain[1]);
+			target.vSubdomain = Domain::create(domain[2], domain[3]);
+			target.patch = std::make_shared<BezierSurface3d>(std::move(patch));
+		});
+		return surface;
+	}
+	BsplineVolume3d::Ptr FreeformStore::loadVolume(const View& view) {
+		MN_INSTRUMENT_TIMER(StoreLoad);
+		checkEntity(view, Entity::BsplineVolume3d);
+		BsplineVolume3d volume;
+		volume.uKnot.assign(view.getKnots(0), view.getKnots(0) + view.getKnotNum(0));
+		volume.vKnot.assign(view.getKnots(1), view.getKnots(1) + view.getKnotNum(1));
+		volume.wKnot.assign(view.getKnots(2), view.getKnots(2) + view.getKnotNum(2));
+		for (int d = 0; d < 3; d++) {
+			const auto& knot = d == 0 ? volume.uKnot : (d == 1 ? volume.vKnot : volume.wKnot);
+			volume.setDegree(d, view.getDegree(d));
+			volume.setDomain(d, knot.front(), knot.back());
+		}
+		int32_t shape[3] = { view.getCptsNum(0), view.getCptsNum(1), view.getCptsNum(2) };
+		readNet(view.getCpts(), shape, volume.getCpts());
+		if (!view.hasPatches()) {
+			volume.updatePatches();
+			return std::make_shared<BsplineVolume3d>(std::move(volume));
+		}
+
+		volume.patches.resize(view.getPatchNum());
+		Parallel::forEach(0, (int)volume.patches.size(), [&](int p) {
+			const Real* domain = view.getPatchDomain(p);
+			BezierVolume3d patch = BezierVolume3d::create();
+			for (int d = 0; d < 3; d++) {
+				patch.setDomain(d, Domain::create(0, 1));
+				patch.setDegree(d, view.getDegree(d));
+			}
+			loadPatch(view, p, patch, derivMatsOf(patch));
+			auto& target = volume.patches[p];
+			target.uSubdomain = Domain::create(domain[0], domain[1]);
+			target.vSubdomain = Domain::create(domain[2], domain[3]);
+			target.wSubdomain = Domain::create(domain[4], domain[5]);
+			target.patch = std::make_shared<BezierVolume3d>(std::move(patch));
+		});
+		return std::make_shared<BsplineVolume3d>(std::move(volume));
+	}
+}
@@ -0,0 +1,156 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_FREEFORM_STORE_H__
+#define __MN_FREEFORM_STORE_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "../Curve/BsplineCurve3d.h"
+#include "../Surface/BsplineSurface3d.h"
+#include "../Volume/BsplineVolume3d.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace MN {
+	/*
+	 * Versioned binary format of Bspline curve, surface and volume, made to be memory mapped.
+	 * File is header and section table followed by sections aligned to 64 bytes, each of which is one contiguous array :
+	 * info, knots, control points and, optionally, Bezier patches with their subdomains and deriv matrices.
+	 * Points are stored as 3 doubles in row major order of control net, i.e. [ (i * vNum + j) * wNum + k ].
+	 * Numbers are in native byte order of writer, which is marked in header, and file of other byte order is rejected, not swapped.
+	 * View reads sections in place from mapped file without copy, and load builds entity from stored patches and deriv matrices,
+	 * skipping knot insertion and differentiation.
+	 */
+	class FreeformStore {
+	public:
+		const static uint32_t version = 1;
+		enum class Entity : uint32_t {
+			BsplineCurve3d = 1,
+			BsplineSurface3d = 2,
+			BsplineVolume3d = 3
+		};
+		// Optional sections, combined as bits
+		const static int Patches = 1;
+		const static int DerivMats = 2;
+
+		enum class Section : uint32_t {
+			Info = 1,
+			Knots,
+			Cpts,
+			PatchDomains,
+			PatchCpts,
+			DerivShapes,
+			DerivMats,
+			End
+		};
+
+		// Zero-copy view of stored entity, which keeps mapped file alive
+		class View {
+		private:
+			MappedFile::Ptr file = nullptr;
+			Entity entity = Entity::BsplineCurve3d;
+			const unsigned char* sections[(int)Section::End] = {};
+			size_t sectionSizes[(int)Section::End] = {};
+			const int32_t* info = nullptr;
+			std::vector<size_t> knotOffsets;
+			std::vector<size_t> derivOffsets;		// Offset of each deriv matrix in points, within deriv matrices of a patch
+
+			const unsigned char* section(Section id) const;
+		public:
+			static View create(const MappedFile::Ptr& file);
+
+			inline Entity getEntity() const noexcept {
+				return entity;
+			}
+			// 1 for curve, 2 for surface, 3 for volume
+			int getDimension() const noexcept;
+			int getDegree(int dir) const noexcept;
+			// Number of control points in [dir], which is 1 for direction beyond dimension
+			int getCptsNum(int dir) const noexcept;
+			int getKnotNum(int dir) const noexcept;
+			const Real* getKnots(int dir) const noexcept;
+			const Vec3* getCpts() const noexcept;
+
+			bool hasPatches() const noexcept;
+			int getPatchNum() const noexcept;
+			// [ beg, end ] of subdomain of patch in each direction, in sequence
+			const Real* getPatchDomain(int patch) const noexcept;
+			const Vec3* getPatchCpts(int patch) const noexcept;
+
+			bool hasDerivMats() const noexcept;
+			// Deriv matrices of each patch are in the order of their declaration in Bezier entity, e.g) U, V, UU, UV, VV, ... for surface
+			int getDerivMatNum() const noexcept;
+			// Number of points of deriv matrix in each direction, where empty matrix has zero size
+			const int32_t* getDerivMatShape(int mat) const noexcept;
+			const Vec3* getDerivMat(int patch, int mat) const noexcept;
+
+			// Offset of section in file, which is 0 for absent section, to read it without mapping
+			uint64_t getSectionOffset(Section id) const noexcept;
+		};
+		/*
+		 * Writer of volume store piece by piece, for volume that does not fit in memory.
+		 * Every section has its size fixed at creation, so control points and patches are written to their places as they come.
+		 * Control points are appended in rows of u, and patches in the order of [ updatePatches ], without deriv matrices.
+		 */
+		class VolumeWriter {
+		public:
+			using Ptr = std::shared_ptr<VolumeWriter>;
+		private:
+			VolumeWriter() = default;
+
+			std::ofstream file;
+			std::string path;
+			uint64_t offsets[(int)Section::End] = {};
+			uint64_t sizes[(int)Section::End] = {};
+			uint64_t cursors[(int)Section::End] = {};		// Bytes written to each section
+			size_t patchSize = 0;
+
+			void write(Section id, const void* data, size_t bytes);
+		public:
+			VolumeWriter(const VolumeWriter&) = delete;
+			VolumeWriter& operator=(const VolumeWriter&) = delete;
+
+			// @patchNum : Number of patches to be written, which is product of numbers of nonzero knot intervals
+			static Ptr createPtr(const std::string& path, const int* degree, const BsplineVolume3d::KnotVector* knots, int patchNum);
+
+			// [num] points of control lattice, in order of [ (i * vNum + j) * wNum + k ]
+			void writeCpts(const Vec3* cpts, size_t num);
+			void writePatches(const std::vector<BsplineVolume3d::Patch>& patches);
+			// Throws if any section is not completely written
+			void close();
+		};
+	private:
+		// Pointers to deriv matrices of Bezier [patch] in the order of their declaration, which point to const for const patch
+		template<typename Patch>
+		static auto derivMatsOf(Patch& patch);
+	public:
+		// @sections : Optional sections to store, e.g) [ Patches | DerivMats ]
+		// Deriv matrices are about 10 times as large as patches, and computing them is usually faster than reading them back,
+		// so they are worth storing only for readers that use views directly
+		static void save(const std::string& path, const BsplineCurve3d& curve, int sections = Patches);
+		static void save(const std::string& path, const BsplineSurface3d& surface, int sections = Patches);
+		static void save(const std::string& path, const BsplineVolume3d& volume, int sections = Patches);
+
+		static View open(const std::string& path);
+
+		// Entity copied out of view. Without stored patches they are rebuilt, and without stored deriv matrices they are computed
+		static BsplineCurve3d::Ptr loadCurve(const View& view);
+		static BsplineSurface3d::Ptr loadSurface(const View& view);
+		static BsplineVolume3d::Ptr loadVolume(const View& view);
+	};
+}
+
+#endif
@@ -0,0 +1,449 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "IgesImporter.h"
+#include "../Parallel.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+namespace MN {
+	const static int igesSectionColumn = 72;		// Column of section letter, preceded by data
+	const static int igesFieldWidth = 8;			// Width of each field of directory entry
+	const static int igesParamColumns = 64;			// Columns of parameter data, followed by pointer back to directory entry
+	const static int maxTokenLength = 128;
+	const static int maxTransformChain = 16;		// Limit of transformation matrices applied in sequence
+	const static Real weightTolerance = 1e-12;		// Relative difference of weights that are regarded as equal
+	const static Real rangeTolerance = 1e-9;		// Distance of parameter range from ends of knot vector, relative to its width, regarded as none
+
+	// Lines of each section, where line of sequence number [n] is at [n - 1]
+	class IgesFile {
+	public:
+		std::vector<const char*> global;
+		std::vector<const char*> directory;
+		std::vector<const char*> parameter;
+		char paramDelim = ',';
+		char recordDelim = ';';
+	};
+
+	static void indexLines(const char* data, size_t size, IgesFile& iges) {
+		const char* end = data + size;
+		const char* line = data;
+		while (line < end) {
+			const char* next = (const char*)std::memchr(line, '\n', end - line);
+			size_t length = (next ? next : end) - line;
+			if (length > 0 && line[length - 1] == '\r')
+				length--;
+			if (length > 0) {
+				if (length <= (size_t)igesSectionColumn)
+					throw(std::runtime_error("IGES line is shorter than fixed columns"));
+				switch (line[igesSectionColumn]) {
+				case 'S':
+				case 'T':
+					break;
+				case 'G':
+					iges.global.push_back(line);
+					break;
+				case 'D':
+					iges.directory.push_back(line);
+					break;
+				case 'P':
+					iges.parameter.push_back(line);
+					break;
+				case 'C':
+					throw(std::runtime_error("Compressed IGES is not supported"));
+				default:
+					throw(std::runtime_error("Invalid section of IGES line"));
+				}
+			}
+			line = next ? next + 1 : end;
+		}
+		if (iges.directory.size() % 2 != 0)
+			throw(std::runtime_error("IGES directory entry is truncated"));
+	}
+	// Parameter and record delimiters are the first two fields of global section, given as Hollerith constants or left empty for defaults
+	static void readDelimiters(IgesFile& iges) {
+		std::string global;
+		for (const char* line : iges.global)
+			global.append(line, igesSectionColumn);
+		size_t pos = 0;
+		while (pos < global.size() && global[pos] == ' ')
+			pos++;
+		if (pos + 2 < global.size() && global.compare(pos, 2, "1H") == 0) {
+			iges.paramDelim = global[pos + 2];
+			pos += 3;
+		}
+		if (pos < global.size() && global[pos] == iges.paramDelim)
+			pos++;
+		if (pos + 2 < global.size() && global.compare(pos, 2, "1H") == 0)
+			iges.recordDelim = global[pos + 2];
+	}
+
+	static int parseInt(const char* beg, const char* end) {
+		while (beg < end && *beg == ' ')
+			beg++;
+		while (end > beg && end[-1] == ' ')
+			end--;
+		if (beg < end && *beg == '+')
+			beg++;
+		int value = 0;
+		if (beg == end)
+			return value;
+		auto result = std::from_chars(beg, end, value);
+		if (result.ec != std::errc() || result.ptr != end)
+			throw(std::runtime_error("Invalid integer in IGES"));
+		return value;
+	}
+	// Real of IGES may take 'D' for exponent of double precision, which is rewritten in place
+	static Real parseReal(char* beg, char* end) {
+		if (beg < end && *beg == '+')
+			beg++;
+		Real value = 0;
+		if (beg == end)
+			return value;
+		for (char* c = beg; c < end; c++)
+			if (*c == 'D' || *c == 'd')
+				*c = 'E';
+		auto result = std::from_chars(beg, end, value);
+		if (result.ec != std::errc() || result.ptr != end)
+			throw(std::runtime_error("Invalid real number in IGES"));
+		return value;
+	}
+	static int directoryField(const char* line, int field) {
+		return parseInt(line + field * igesFieldWidth, line + (field + 1) * igesFieldWidth);
+	}
+
+	// Directory entry of sequence number [2 * index + 1]
+	class IgesEntry {
+	public:
+		int type = 0;
+		int paramLine = 0;			// Index of first parameter line
+		int paramLineNum = 0;
+		int transform = 0;			// Sequence number of directory entry of transformation matrix, or 0
+
+		static IgesEntry create(const IgesFile& iges, int index) {
+			const char* first = iges.directory[2 * index];
+			const char* second = iges.directory[2 * index + 1];
+			IgesEntry entry;
+			entry.type = directoryField(first, 0);
+			entry.paramLine = directoryField(first, 1) - 1;
+			entry.transform = directoryField(first, 6);
+			entry.paramLineNum = directoryField(second, 3);
+			if (entry.paramLine < 0 || entry.paramLineNum < 1 || entry.paramLine + entry.paramLineNum > (int)iges.parameter.size())
+				throw(std::runtime_error("Invalid parameter pointer of IGES entity"));
+			return entry;
+		}
+	};
+
+	// Tokens of parameter data of an entity, read across its lines into stack buffer
+	class IgesParams {
+	private:
+		const IgesFile& iges;
+		int line;
+		int lineEnd;
+		int column = 0;
+		bool ended = false;
+		char token[maxTokenLength];
+		int length = 0;
+
+		bool next() {
+			length = 0;
+			if (ended)
+				return false;
+			bool read = false;
+			while (line < lineEnd) {
+				char c = iges.parameter[line][column];
+				if (++column == igesParamColumns) {
+					column = 0;
+					line++;
+				}
+				if (c == iges.paramDelim || c == iges.recordDelim) {
+					ended = c == iges.recordDelim;
+					read = true;
+					break;
+				}
+				if (c == ' ')
+					continue;
+				if (length == maxTokenLength)
+					throw(std::runtime_error("Too long parameter in IGES"));
+				token[length++] = c;
+			}
+			if (!read)
+				ended = true;
+			return read || length > 0;
+		}
+	public:
+		IgesParams(const IgesFile& iges, const IgesEntry& entry) : iges(iges), line(entry.paramLine), lineEnd(entry.paramLine + entry.paramLineNum) {
+		}
+
+		int nextInt() {
+			if (!next())
+				throw(std::runtime_error("Parameter data of IGES entity is truncated"));
+			return parseInt(token, token + length);
+		}
+		Real nextReal() {
+			if (!next())
+				throw(std::runtime_error("Parameter data of IGES entity is truncated"));
+			return parseReal(token, token + length);
+		}
+	};
+
+	// Affine transform [ (R | T) ] of entity type 124, composed with transforms it refers to
+	class IgesTransform {
+	public:
+		Real m[3][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 } };
+
+		static IgesTransform create(const IgesFile& iges, int sequence, int depth = 0) {
+			int index = (sequence - 1) / 2;
+			if (sequence < 1 || sequence % 2 != 1 || 2 * index + 1 >= (int)iges.directory.size() || depth >= maxTransformChain)
+				throw(std::runtime_error("Invalid transformation matrix pointer of IGES entity"));
+			IgesEntry entry = IgesEntry::create(iges, index);
+			if (entry.type != 124)
+				throw(std::runtime_error("IGES transformation matrix pointer refers to other entity"));
+			IgesParams params(iges, entry);
+			if (params.nextInt() != 124)
+				throw(std::runtime_error("IGES parameter data does not match its directory entry"));
+			IgesTransform transform;
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 4; j++)
+					transform.m[i][j] = params.nextReal();
+			if (entry.transform <= 0)
+				return transform;
+
+			// Parent transform is applied after this one
+			IgesTransform parent = create(iges, entry.transform, depth + 1), composed;
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 4; j++) {
+					composed.m[i][j] = j == 3 ? parent.m[i][3] : 0.0;
+					for (int k = 0; k < 3; k++)
+						composed.m[i][j] += parent.m[i][k] * transform.m[k][j];
+				}
+			return composed;
+		}
+		inline Vec3 apply(const Vec3& p) const noexcept {
+			Vec3 q;
+			for (int i = 0; i < 3; i++)
+				q.v[i] = m[i][0] * p.v[0] + m[i][1] * p.v[1] + m[i][2] * p.v[2] + m[i][3];
+			return q;
+		}
+	};
+
+	static void readKnots(IgesParams& params, int num, KnotVector& knots) {
+		knots.resize(num);
+		for (auto& knot : knots)
+			knot = params.nextReal();
+	}
+	// Whether weights are equal, so that rational Bspline is in fact polynomial
+	static bool readWeights(IgesParams& params, int num) {
+		Real first = params.nextReal();
+		bool equal = first > 0;
+		for (int i = 1; i < num; i++) {
+			Real weight = params.nextReal();
+			if (std::fabs(weight - first) > weightTolerance * std::fabs(first))
+				equal = false;
+		}
+		return equal;
+	}
+	// Whether each end of knot vector is repeated (degree + 1) times, as [ updatePatches ] expects
+	static bool isClamped(const KnotVector& knots, int degree) {
+		int num = (int)knots.size();
+		for (int i = 1; i <= degree; i++)
+			if (knots[i] != knots[0] || knots[num - 1 - i] != knots[num - 1])
+				return false;
+		return knots[0] < knots[num - 1];
+	}
+	// Parameter range that follows control points, snapped to ends of knot vector when it is close to them
+	static void readRange(IgesParams& params, const KnotVector& knots, Real& beg, Real& end) {
+		beg = params.nextReal();
+		end = params.nextReal();
+		Real tolerance = rangeTolerance * (knots.back() - knots.front());
+		if (std::fabs(beg - knots.front()) <= tolerance)
+			beg = knots.front();
+		if (std::fabs(end - knots.back()) <= tolerance)
+			end = knots.back();
+		if (!(knots.front() <= beg && beg < end && end <= knots.back()))
+			throw(std::runtime_error("Invalid parameter range of IGES bspline entity"));
+	}
+	// Inserts [t] once into [knots], and into each line of control points along them by Boehm's algorithm
+	static void insertKnot(KnotVector& knots, std::vector<std::vector<Vec3>>& lines, int degree, Real t) {
+		int k = Bspline::findSpan(t, degree, knots);
+		for (auto& line : lines) {
+			std::vector<Vec3> next(line.size() + 1);
+			for (int i = 0; i <= k - degree; i++)
+				next[i] = line[i];
+			for (int i = k - degree + 1; i <= k; i++) {
+				Real alpha = (t - knots[i]) / (knots[i + degree] - knots[i]);
+				next[i] = line[i - 1] * (1.0 - alpha) + line[i] * alpha;
+			}
+			for (int i = k + 1; i < (int)next.size(); i++)
+				next[i] = line[i - 1];
+			line.swap(next);
+		}
+		knots.insert(knots.begin() + k + 1, t);
+	}
+	// Restricts lines of control points to [beg, end] of [knots], which are clamped there afterwards
+	// Each end is inserted up to multiplicity of [degree], where the curve passes through a single control point
+	static void trimLines(KnotVector& knots, std::vector<std::vector<Vec3>>& lines, int degree, Real beg, Real end) {
+		auto multiplicity = [&](Real t) {
+			return (int)(std::upper_bound(knots.begin(), knots.end(), t) - std::lower_bound(knots.begin(), knots.end(), t));
+		};
+		while (multiplicity(beg) < degree)
+			insertKnot(knots, lines, degree, beg);
+		while (multiplicity(end) < degree)
+			insertKnot(knots, lines, degree, end);
+		int last = (int)(std::upper_bound(knots.begin(), knots.end(), beg) - knots.begin()) - 1;
+		int first = (int)(std::lower_bound(knots.begin(), knots.end(), end) - knots.begin());
+		KnotVector trimmed(degree + 1, beg);
+		trimmed.insert(trimmed.end(), knots.begin() + last + 1, knots.begin() + first);
+		trimmed.insert(trimmed.end(), degree + 1, end);
+		for (auto& line : lines)
+			line = std::vector<Vec3>(line.begin() + last - degree, line.begin() + first);
+		knots.swap(trimmed);
+	}
+	static void checkDegree(int degree, int cptsNum) {
+		if (degree < 1 || degree > Bezier::maxDegree || cptsNum <= degree)
+			throw(std::runtime_error("Invalid degree of IGES bspline entity"));
+	}
+
+	// Result of parsing a single entity, where both pointers are null for skipped one
+	class IgesResult {
+	public:
+		BsplineCurve3d::Ptr curve = nullptr;
+		BsplineSurface3d::Ptr surface = nullptr;
+	};
+
+	static IgesResult readCurve(const IgesFile& iges, const IgesEntry& entry) {
+		IgesParams params(iges, entry);
+		if (params.nextInt() != 126)
+			throw(std::runtime_error("IGES parameter data does not match its directory entry"));
+		int k = params.nextInt(), degree = params.nextInt();
+		checkDegree(degree, k + 1);
+		params.nextInt();
+		params.nextInt();
+		params.nextInt();
+		params.nextInt();
+
+		KnotVector knots;
+		readKnots(params, k + degree + 2, knots);
+		bool polynomial = readWeights(params, k + 1);
+		BsplineCurve3d::ControlPoints cpts(k + 1);
+		for (auto& cpt : cpts)
+			for (int c = 0; c < 3; c++)
+				cpt.v[c] = params.nextReal();
+		if (!polynomial || !isClamped(knots, degree))
+			return IgesResult();
+		Real beg, end;
+		readRange(params, knots, beg, end);
+		if (beg > knots.front() || end < knots.back()) {
+			std::vector<std::vector<Vec3>> lines = { std::move(cpts) };
+			trimLines(knots, lines, degree, beg, end);
+			cpts = std::move(lines[0]);
+		}
+
+		if (entry.transform > 0) {
+			IgesTransform transform = IgesTransform::create(iges, entry.transform);
+			for (auto& cpt : cpts)
+				cpt = transform.apply(cpt);
+		}
+		IgesResult result;
+		result.curve = BsplineCurve3d::createPtr(degree, knots, cpts);
+		return result;
+	}
+	static IgesResult readSurface(const IgesFile& iges, const IgesEntry& entry) {
+		IgesParams params(iges, entry);
+		if (params.nextInt() != 128)
+			throw(std::runtime_error("IGES parameter data does not match its directory entry"));
+		int k1 = params.nextInt(), k2 = params.nextInt();
+		int uDegree = params.nextInt(), vDegree = params.nextInt();
+		checkDegree(uDegree, k1 + 1);
+		checkDegree(vDegree, k2 + 1);
+		params.nextInt();
+		params.nextInt();
+		params.nextInt();
+		params.nextInt();
+		params.nextInt();
+
+		KnotVector uKnots, vKnots;
+		readKnots(params, k1 + uDegree + 2, uKnots);
+		readKnots(params, k2 + vDegree + 2, vKnots);
+		bool polynomial = readWeights(params, (k1 + 1) * (k2 + 1));
+		// First index, which is of u, runs fastest in IGES
+		BsplineSurface3d::ControlPoints cpts(k1 + 1, std::vector<Vec3>(k2 + 1));
+		for (int j = 0; j <= k2; j++)
+			for (int i = 0; i <= k1; i++)
+				for (int c = 0; c < 3; c++)
+					cpts[i][j].v[c] = params.nextReal();
+		if (!polynomial || !isClamped(uKnots, uDegree) || !isClamped(vKnots, vDegree))
+			return IgesResult();
+		Real uBeg, uEnd, vBeg, vEnd;
+		readRange(params, uKnots, uBeg, uEnd);
+		readRange(params, vKnots, vBeg, vEnd);
+		if (uBeg > uKnots.front() || uEnd < uKnots.back()) {
+			// Lines along U are columns of control net
+			std::vector<std::vector<Vec3>> lines(cpts[0].size(), std::vector<Vec3>(cpts.size()));
+			for (size_t i = 0; i < cpts.size(); i++)
+				for (size_t j = 0; j < lines.size(); j++)
+					lines[j][i] = cpts[i][j];
+			trimLines(uKnots, lines, uDegree, uBeg, uEnd);
+			cpts.assign(lines[0].size(), std::vector<Vec3>(lines.size()));
+			for (size_t i = 0; i < cpts.size(); i++)
+				for (size_t j = 0; j < lines.size(); j++)
+					cpts[i][j] = lines[j][i];
+		}
+		if (vBeg > vKnots.front() || vEnd < vKnots.back())
+			trimLines(vKnots, cpts, vDegree, vBeg, vEnd);
+
+		if (entry.transform > 0) {
+			IgesTransform transform = IgesTransform::create(iges, entry.transform);
+			for (auto& row : cpts)
+				for (auto& cpt : row)
+					cpt = transform.apply(cpt);
+		}
+		IgesResult result;
+		result.surface = BsplineSurface3d::createPtr(uDegree, vDegree, uKnots, vKnots, cpts);
+		return result;
+	}
+
+	IgesImporter::Model IgesImporter::load(const std::string& path) {
+		return load(MappedFile::createPtr(path));
+	}
+	IgesImporter::Model IgesImporter::load(const MappedFile::Ptr& file) {
+		IgesFile iges;
+		indexLines((const char*)file->getData(), file->getSize(), iges);
+		readDelimiters(iges);
+
+		std::vector<int> targets;
+		for (int e = 0; e < (int)iges.directory.size() / 2; e++) {
+			int type = directoryField(iges.directory[2 * e], 0);
+			if (type == 126 || type == 128)
+				targets.push_back(e);
+		}
+		std::vector<IgesResult> results(targets.size());
+		Parallel::forEach(0, (int)targets.size(), [&](int i) {
+			IgesEntry entry = IgesEntry::create(iges, targets[i]);
+			results[i] = entry.type == 126 ? readCurve(iges, entry) : readSurface(iges, entry);
+		});
+
+		Model model;
+		for (size_t i = 0; i < targets.size(); i++) {
+			int id = 2 * targets[i] + 1;
+			if (results[i].curve) {
+				model.curves.push_back(std::move(results[i].curve));
+				model.curveIds.push_back(id);
+			}
+			else if (results[i].surface) {
+				model.surfaces.push_back(std::move(results[i].surface));
+				model.surfaceIds.push_back(id);
+			}
+			else
+				model.skippedIds.push_back(id);
+		}
+		return model;
+	}
+}
@@ -0,0 +1,48 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_IGES_IMPORTER_H__
+#define __MN_IGES_IMPORTER_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "../Curve/BsplineCurve3d.h"
+#include "../Surface/BsplineSurface3d.h"
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+
+namespace MN {
+	/*
+	 * Importer of polynomial Bspline curves (type 126) and surfaces (type 128) from IGES file.
+	 * File is memory mapped and its fixed column records are indexed in one pass, then parameter data of entities is tokenized in place
+	 * on stack buffers, and entities are parsed and created in parallel.
+	 * Transformation matrices (type 124) referenced by entities are applied to their control points.
+	 * Entities whose parameter range is a sub-range of their knot vector are trimmed to it by knot insertion.
+	 */
+	class IgesImporter {
+	public:
+		class Model {
+		public:
+			std::vector<BsplineCurve3d::Ptr> curves;
+			std::vector<int> curveIds;			// Sequence number of directory entry of each curve
+			std::vector<BsplineSurface3d::Ptr> surfaces;
+			std::vector<int> surfaceIds;
+			// Entities of type 126 / 128 that are not imported, as they are rational or their knot vectors are not clamped
+			std::vector<int> skippedIds;
+		};
+	public:
+		static Model load(const std::string& path);
+		static Model load(const MappedFile::Ptr& file);
+	};
+}
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "MappedFile.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace MN {
+	MappedFile::Ptr MappedFile::createPtr(const std::string& path) {
+		// Constructor is private, so pointer is made from new object
+		Ptr mapped(new MappedFile());
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			throw(std::runtime_error("Cannot open file to map : " + path));
+		mapped->file = file;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size))
+			throw(std::runtime_error("Cannot get size of file to map : " + path));
+		mapped->size = (size_t)size.QuadPart;
+		if (mapped->size == 0)
+			return mapped;
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+			throw(std::runtime_error("Cannot map file : " + path));
+		mapped->mapping = mapping;
+		mapped->data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (mapped->data == nullptr)
+			throw(std::runtime_error("Cannot map file : " + path));
+#else
+		int file = open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			throw(std::runtime_error("Cannot open file to map : " + path));
+		mapped->file = file;
+		struct stat info;
+		if (fstat(file, &info) != 0)
+			throw(std::runtime_error("Cannot get size of file to map : " + path));
+		mapped->size = (size_t)info.st_size;
+		if (mapped->size == 0)
+			return mapped;
+		void* data = mmap(nullptr, mapped->size, PROT_READ, MAP_SHARED, file, 0);
+		if (data == MAP_FAILED)
+			throw(std::runtime_error("Cannot map file : " + path));
+		mapped->data = (const unsigned char*)data;
+#endif
+		return mapped;
+	}
+	MappedFile::~MappedFile() {
+#ifdef _WIN32
+		if (data)
+			UnmapViewOfFile(data);
+		if (mapping)
+			CloseHandle((HANDLE)mapping);
+		if (file)
+			CloseHandle((HANDLE)file);
+#else
+		if (data)
+			munmap((void*)data, size);
+		if (file >= 0)
+			close(file);
+#endif
+	}
+}
@@ -0,0 +1,55 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_MAPPED_FILE_H__
+#define __MN_MAPPED_FILE_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace MN {
+	/*
+	 * Read-only memory mapping of whole file, unmapped when the last pointer to it is released.
+	 * Pages are loaded by OS on first access, so opening is cheap regardless of file size.
+	 */
+	class MappedFile {
+	public:
+		using Ptr = std::shared_ptr<MappedFile>;
+	private:
+		MappedFile() = default;
+
+		const unsigned char* data = nullptr;
+		size_t size = 0;
+#ifdef _WIN32
+		void* file = nullptr;
+		void* mapping = nullptr;
+#else
+		int file = -1;
+#endif
+	public:
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		static Ptr createPtr(const std::string& path);
+
+		inline const unsigned char* getData() const noexcept {
+			return data;
+		}
+		inline size_t getSize() const noexcept {
+			return size;
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,318 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "MeshWriter.h"
+#include "../Parallel.h"
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+
+namespace MN {
+	const static int meshPatchBatch = 64;			// Patches sampled in parallel before they are written in sequence
+	const static int plyCountWidth = 10;			// Digits of counts in PLY header, filled with leading zeros when closed
+	const static size_t stlHeaderSize = 80;
+	const static size_t stlTriangleSize = 50;
+	const static size_t maxTextLine = 128;			// Upper bound of length of a line of OBJ
+
+	// PLY header, where counts of vertices and faces follow [plyHead] and [plyMid]
+	const static char plyHead[] = "ply\nformat binary_little_endian 1.0\nelement vertex ";
+	const static char plyMid[] = "\nproperty float x\nproperty float y\nproperty float z\nelement face ";
+	const static char plyTail[] = "\nproperty list uchar int vertex_indices\nend_header\n";
+
+	// Output
+	void MeshWriter::Output::open(const std::string& path) {
+		file.open(path, std::ios::binary | std::ios::trunc);
+		if (!file)
+			throw(std::runtime_error("Cannot open file to write mesh : " + path));
+		buffer.resize(bufferSize);
+		used = 0;
+	}
+	void MeshWriter::Output::flush() {
+		file.write(buffer.data(), (std::streamsize)used);
+		if (!file)
+			throw(std::runtime_error("Cannot write mesh"));
+		used = 0;
+	}
+
+	static inline char* writeFloat(char* out, float value) {
+		return std::to_chars(out, out + 32, value).ptr;
+	}
+	static inline char* writeIndex(char* out, uint64_t value) {
+		return std::to_chars(out, out + 24, value).ptr;
+	}
+	static inline char* writeBytes(char* out, const void* data, size_t bytes) {
+		std::memcpy(out, data, bytes);
+		return out + bytes;
+	}
+	// Binary STL and PLY are little endian, so bytes of each value are reversed on big endian host
+	template<typename T>
+	static inline char* writeLittle(char* out, const T* values, size_t num) {
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		for (size_t i = 0; i < num; i++) {
+			const char* bytes = (const char*)(values + i);
+			for (size_t b = 0; b < sizeof(T); b++)
+				*out++ = bytes[sizeof(T) - 1 - b];
+		}
+		return out;
+#else
+		return writeBytes(out, values, sizeof(T) * num);
+#endif
+	}
+
+	MeshWriter::Ptr MeshWriter::createPtr(const std::string& path, Format format) {
+		Ptr writer(new MeshWriter());
+		writer->format = format;
+		writer->path = path;
+		writer->output.open(path);
+		if (format == Format::Ply) {
+			writer->facePath = path + ".faces.tmp";
+			writer->faceOutput.open(writer->facePath);
+		}
+		writer->writeHeader();
+		return writer;
+	}
+	MeshWriter::~MeshWriter() {
+		if (closed)
+			return;
+		try {
+			close();
+		}
+		catch (...) {
+		}
+	}
+
+	// Counts are written as zeros here, and overwritten in place when closed
+	void MeshWriter::writeHeader() {
+		if (format == Format::Stl) {
+			char header[stlHeaderSize + 4] = {};
+			std::snprintf(header, stlHeaderSize, "MinuteFreeform");
+			char* out = output.reserve(sizeof(header));
+			output.used = writeBytes(out, header, sizeof(header)) - output.buffer.data();
+		}
+		else if (format == Format::Ply) {
+			char header[256];
+			int length = std::snprintf(header, sizeof(header), "%s%0*d%s%0*d%s", plyHead, plyCountWidth, 0, plyMid, plyCountWidth, 0, plyTail);
+			char* out = output.reserve(length);
+			output.used = writeBytes(out, header, length) - output.buffer.data();
+		}
+	}
+	void MeshWriter::writeVertices(const Vec3* vertices, int num) {
+		if (format == Format::Obj) {
+			for (int i = 0; i < num; i++) {
+				char* out = output.reserve(maxTextLine);
+				*out++ = 'v';
+				for (int c = 0; c < 3; c++) {
+					*out++ = ' ';
+					out = writeFloat(out, (float)vertices[i].v[c]);
+				}
+				*out++ = '\n';
+				output.used = out - output.buffer.data();
+			}
+		}
+		else if (format == Format::Ply) {
+			for (int i = 0; i < num; i++) {
+				float point[3] = { (float)vertices[i].v[0], (float)vertices[i].v[1], (float)vertices[i].v[2] };
+				char* out = output.reserve(sizeof(point));
+				output.used = writeLittle(out, point, 3) - output.buffer.data();
+			}
+		}
+		vertexNum += num;
+	}
+	void MeshWriter::writeFaces(const Vec3* vertices, const int* indices, int num, uint64_t base) {
+		for (int t = 0; t < num; t++) {
+			const int* tri = indices + 3 * t;
+			if (format == Format::Obj) {
+				char* out = output.reserve(maxTextLine);
+				*out++ = 'f';
+				for (int c = 0; c < 3; c++) {
+					*out++ = ' ';
+					out = writeIndex(out, base + tri[c] + 1);
+				}
+				*out++ = '\n';
+				output.used = out - output.buffer.data();
+			}
+			else if (format == Format::Stl) {
+				float points[3][3];
+				for (int c = 0; c < 3; c++)
+					for (int d = 0; d < 3; d++)
+						points[c][d] = (float)vertices[tri[c]].v[d];
+				float e0[3], e1[3], normal[3];
+				for (int d = 0; d < 3; d++) {
+					e0[d] = points[1][d] - points[0][d];
+					e1[d] = points[2][d] - points[0][d];
+				}
+				normal[0] = e0[1] * e1[2] - e0[2] * e1[1];
+				normal[1] = e0[2] * e1[0] - e0[0] * e1[2];
+				normal[2] = e0[0] * e1[1] - e0[1] * e1[0];
+				float len = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+				for (int d = 0; d < 3; d++)
+					normal[d] = len > 0 ? normal[d] / len : 0.0f;
+				uint16_t attribute = 0;
+				char* out = output.reserve(stlTriangleSize);
+				out = writeLittle(out, normal, 3);
+				out = writeLittle(out, &points[0][0], 9);
+				out = writeLittle(out, &attribute, 1);
+				output.used = out - output.buffer.data();
+			}
+			else {
+				unsigned char count = 3;
+				int32_t face[3] = { (int32_t)(base + tri[0]), (int32_t)(base + tri[1]), (int32_t)(base + tri[2]) };
+				char* out = faceOutput.reserve(sizeof(count) + sizeof(face));
+				out = writeBytes(out, &count, sizeof(count));
+				out = writeLittle(out, face, 3);
+				faceOutput.used = out - faceOutput.buffer.data();
+			}
+		}
+		triangleNum += num;
+	}
+
+	void MeshWriter::writeTriangles(const Vec3* vertices, int vertexNum, const int* indices, int num) {
+		if (closed)
+			throw(std::runtime_error("Mesh writer is already closed"));
+		for (int i = 0; i < 3 * num; i++)
+			if (indices[i] < 0 || indices[i] >= vertexNum)
+				throw(std::runtime_error("Invalid vertex index of mesh"));
+		uint64_t base = this->vertexNum;
+		if (format == Format::Ply && base + vertexNum > (uint64_t)INT32_MAX)
+			throw(std::runtime_error("Too many vertices for PLY"));
+		writeVertices(vertices, vertexNum);
+		writeFaces(vertices, indices, num, base);
+	}
+	void MeshWriter::writeGrid(const Vec3* points, int uNum, int vNum, bool flip) {
+		if (uNum < 2 || vNum < 2)
+			return;
+		std::vector<int> indices;
+		indices.reserve((size_t)(uNum - 1) * (vNum - 1) * 6);
+		for (int i = 0; i < uNum - 1; i++)
+			for (int j = 0; j < vNum - 1; j++) {
+				int a = i * vNum + j, b = a + vNum, c = b + 1, d = a + 1;
+				int cell[6] = { a, b, c, a, c, d };
+				if (flip) {
+					std::swap(cell[1], cell[2]);
+					std::swap(cell[4], cell[5]);
+				}
+				indices.insert(indices.end(), cell, cell + 6);
+			}
+		writeTriangles(points, uNum * vNum, indices.data(), (int)indices.size() / 3);
+	}
+
+	// Sample [num] grids of [ (resolution + 1)^2 ] points in parallel batches, and write them in order
+	static void writeGrids(MeshWriter& writer, int num, int resolution, const std::function<bool(int, std::vector<Vec3>&)>& sample) {
+		if (resolution < 1)
+			throw(std::runtime_error("Invalid resolution of mesh"));
+		std::vector<std::vector<Vec3>> grids(std::min(num, meshPatchBatch));
+		std::vector<char> flips(grids.size());
+		for (int beg = 0; beg < num; beg += meshPatchBatch) {
+			int end = std::min(beg + meshPatchBatch, num);
+			Parallel::forEach(beg, end, [&](int i) {
+				auto& grid = grids[i - beg];
+				grid.resize((size_t)(resolution + 1) * (resolution + 1));
+				flips[i - beg] = sample(i, grid);
+			});
+			for (int i = beg; i < end; i++)
+				writer.writeGrid(grids[i - beg].data(), resolution + 1, resolution + 1, flips[i - beg] != 0);
+		}
+	}
+	static inline Real gridParam(const Domain& domain, int i, int resolution) {
+		return i == resolution ? domain.end() : domain.beg() + domain.width() * i / resolution;
+	}
+	// Face of volume at [side] of direction [dir], sampled over the other two directions in cyclic order, which faces +dir
+	static bool sampleFace(const BezierVolume3d& volume, int dir, int side, int resolution, std::vector<Vec3>& grid) {
+		int first = (dir + 1) % 3, second = (dir + 2) % 3;
+		Real param[3];
+		const Domain& fixed = volume.getDomainC(dir);
+		param[dir] = side ? fixed.end() : fixed.beg();
+		for (int i = 0; i <= resolution; i++) {
+			param[first] = gridParam(volume.getDomainC(first), i, resolution);
+			for (int j = 0; j <= resolution; j++) {
+				param[second] = gridParam(volume.getDomainC(second), j, resolution);
+				grid[(size_t)i * (resolution + 1) + j] = volume.evaluate(param[0], param[1], param[2]);
+			}
+		}
+		return side == 0;
+	}
+
+	void MeshWriter::writeSurface(const BsplineSurface3d& surface, int resolution) {
+		writeGrids(*this, (int)surface.patches.size(), resolution, [&](int p, std::vector<Vec3>& grid) {
+			const auto& patch = *surface.patches[p].patch;
+			for (int i = 0; i <= resolution; i++) {
+				Real u = gridParam(patch.getDomainC(0), i, resolution);
+				for (int j = 0; j <= resolution; j++)
+					grid[(size_t)i * (resolution + 1) + j] = patch.evaluate(u, gridParam(patch.getDomainC(1), j, resolution));
+			}
+			return false;
+		});
+	}
+	void MeshWriter::writeBoundary(const BezierVolume3d& volume, int resolution) {
+		writeGrids(*this, 6, resolution, [&](int f, std::vector<Vec3>& grid) {
+			return sampleFace(volume, f / 2, f % 2, resolution, grid);
+		});
+	}
+	void MeshWriter::writeBoundary(const BsplineVolume3d& volume, int resolution) {
+		// Faces of patches whose subdomains touch ends of domain, as (patch, dir, side)
+		std::vector<int> faces;
+		for (int p = 0; p < (int)volume.patches.size(); p++) {
+			const auto& patch = volume.patches[p];
+			const Domain* subdomains[3] = { &patch.uSubdomain, &patch.vSubdomain, &patch.wSubdomain };
+			for (int d = 0; d < 3; d++) {
+				if (subdomains[d]->beg() == volume.getDomainC(d).beg())
+					faces.insert(faces.end(), { p, d, 0 });
+				if (subdomains[d]->end() == volume.getDomainC(d).end())
+					faces.insert(faces.end(), { p, d, 1 });
+			}
+		}
+		writeGrids(*this, (int)faces.size() / 3, resolution, [&](int f, std::vector<Vec3>& grid) {
+			return sampleFace(*volume.patches[faces[3 * f]].patch, faces[3 * f + 1], faces[3 * f + 2], resolution, grid);
+		});
+	}
+
+	void MeshWriter::close() {
+		if (closed)
+			return;
+		closed = true;
+		output.flush();
+		if (format == Format::Ply) {
+			// Append spilled faces in blocks of buffer
+			faceOutput.flush();
+			faceOutput.file.close();
+			std::ifstream faces(facePath, std::ios::binary);
+			while (faces) {
+				faces.read(output.buffer.data(), (std::streamsize)output.buffer.size());
+				output.used = (size_t)faces.gcount();
+				output.flush();
+			}
+			faces.close();
+			std::remove(facePath.c_str());
+			if (vertexNum > (uint64_t)INT32_MAX || triangleNum > (uint64_t)INT32_MAX)
+				throw(std::runtime_error("Too many elements for PLY"));
+
+			char count[plyCountWidth + 1];
+			std::streamoff offsets[2] = { (std::streamoff)(sizeof(plyHead) - 1), (std::streamoff)(sizeof(plyHead) - 1 + plyCountWidth + sizeof(plyMid) - 1) };
+			uint64_t counts[2] = { vertexNum, triangleNum };
+			for (int i = 0; i < 2; i++) {
+				std::snprintf(count, sizeof(count), "%0*llu", plyCountWidth, (unsigned long long)counts[i]);
+				output.file.seekp(offsets[i]);
+				output.file.write(count, plyCountWidth);
+			}
+		}
+		else if (format == Format::Stl) {
+			if (triangleNum > (uint64_t)UINT32_MAX)
+				throw(std::runtime_error("Too many triangles for STL"));
+			uint32_t count = (uint32_t)triangleNum;
+			char bytes[sizeof(count)];
+			writeLittle(bytes, &count, 1);
+			output.file.seekp((std::streamoff)stlHeaderSize);
+			output.file.write(bytes, sizeof(bytes));
+		}
+		output.file.close();
+		if (!output.file)
+			throw(std::runtime_error("Cannot write mesh : " + path));
+	}
+}
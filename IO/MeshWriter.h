@@ -0,0 +1,104 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_MESH_WRITER_H__
+#define __MN_MESH_WRITER_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "../Surface/BsplineSurface3d.h"
+#include "../Volume/BezierVolume3d.h"
+#include "../Volume/BsplineVolume3d.h"
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace MN {
+	/*
+	 * Streaming writer of triangle mesh in OBJ, binary STL or binary little endian PLY, which takes mesh piece by piece,
+	 * e.g) one patch after another, and keeps only a fixed size buffer, whatever the size of mesh.
+	 * Text is formatted by [ std::to_chars ], and counts in headers of STL and PLY are filled in when closed.
+	 * Faces of PLY must follow every vertex, so they are spilled to temporary file next to output and appended when closed.
+	 * Coordinates are written in single precision.
+	 */
+	class MeshWriter {
+	public:
+		using Ptr = std::shared_ptr<MeshWriter>;
+		enum class Format {
+			Obj,
+			Stl,
+			Ply
+		};
+		const static size_t bufferSize = 1 << 22;
+	private:
+		// Output file with its own buffer, written in large blocks
+		class Output {
+		public:
+			std::ofstream file;
+			std::vector<char> buffer;
+			size_t used = 0;
+
+			void open(const std::string& path);
+			void flush();
+			inline char* reserve(size_t bytes) {
+				if (used + bytes > buffer.size())
+					flush();
+				return buffer.data() + used;
+			}
+		};
+
+		MeshWriter() = default;
+
+		Format format = Format::Obj;
+		std::string path;
+		std::string facePath;
+		Output output;
+		Output faceOutput;			// Faces of PLY
+		uint64_t vertexNum = 0;
+		uint64_t triangleNum = 0;
+		bool closed = false;
+
+		void writeHeader();
+		void writeVertices(const Vec3* vertices, int num);
+		void writeFaces(const Vec3* vertices, const int* indices, int num, uint64_t base);
+	public:
+		MeshWriter(const MeshWriter&) = delete;
+		MeshWriter& operator=(const MeshWriter&) = delete;
+		~MeshWriter();
+
+		static Ptr createPtr(const std::string& path, Format format);
+
+		// Triangles of [num] triples of [indices] into [vertices], which are numbered from 0 in each call
+		void writeTriangles(const Vec3* vertices, int vertexNum, const int* indices, int num);
+		// Two triangles for each cell of grid of [ uNum x vNum ] points at [ i * vNum + j ], facing (d / di) x (d / dj), or opposite when [flip]
+		void writeGrid(const Vec3* points, int uNum, int vNum, bool flip = false);
+
+		// Every patch of surface on grid of [resolution] cells in each direction
+		void writeSurface(const BsplineSurface3d& surface, int resolution);
+		// Six faces of volume, facing outward when determinant of Jacobian is positive
+		void writeBoundary(const BezierVolume3d& volume, int resolution);
+		// Faces of patches on boundary of domain of volume
+		void writeBoundary(const BsplineVolume3d& volume, int resolution);
+
+		inline uint64_t getVertexNum() const noexcept {
+			return vertexNum;
+		}
+		inline uint64_t getTriangleNum() const noexcept {
+			return triangleNum;
+		}
+		// Fill counts of header and close file, which must be called to get complete file
+		void close();
+	};
+}
+
+#endif
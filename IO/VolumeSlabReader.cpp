@@ -0,0 +1,211 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "VolumeSlabReader.h"
+#include "FreeformStore.h"
+#include "../Parallel.h"
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace MN {
+	VolumeSlabReader VolumeSlabReader::create(const int* degree, const BsplineVolume3d::KnotVector* knots, const Source& source, int slabSpans) {
+		if (slabSpans < 1)
+			throw(std::runtime_error("Invalid number of spans of slab"));
+		VolumeSlabReader reader;
+		reader.source = source;
+		for (int d = 0; d < 3; d++) {
+			reader.degree[d] = degree[d];
+			reader.knots[d] = knots[d];
+			reader.cptsNum[d] = (int)knots[d].size() - degree[d] - 1;
+			if (degree[d] < 0 || degree[d] > Bezier::maxDegree || reader.cptsNum[d] <= degree[d])
+				throw(std::runtime_error("Invalid knot vector for volume slab reader"));
+			for (int s = degree[d]; s < reader.cptsNum[d]; s++)
+				if (knots[d][s] < knots[d][s + 1])
+					reader.spans[d].push_back(s);
+		}
+
+		// Consecutive slabs share [degree] rows, which are read again rather than kept
+		int rowEnd = 0;
+		const auto& uSpans = reader.spans[0];
+		for (int beg = 0; beg < (int)uSpans.size(); beg += slabSpans) {
+			Slab slab;
+			slab.spanBeg = beg;
+			slab.spanEnd = std::min(beg + slabSpans, (int)uSpans.size());
+			slab.rowBeg = std::min(uSpans[beg] - degree[0], rowEnd);
+			slab.rowEnd = slab.spanEnd == (int)uSpans.size() ? reader.cptsNum[0] : uSpans[slab.spanEnd - 1] + 1;
+			rowEnd = slab.rowEnd;
+			reader.slabs.push_back(slab);
+		}
+		return reader;
+	}
+	VolumeSlabReader VolumeSlabReader::create(const std::string& storePath, int slabSpans) {
+		int degree[3];
+		BsplineVolume3d::KnotVector knots[3];
+		uint64_t offset;
+		size_t rowSize;
+		{
+			// Mapping is dropped once header is read, so control lattice is never mapped
+			auto view = FreeformStore::open(storePath);
+			if (view.getEntity() != FreeformStore::Entity::BsplineVolume3d)
+				throw(std::runtime_error("Freeform store has different entity"));
+			for (int d = 0; d < 3; d++) {
+				degree[d] = view.getDegree(d);
+				knots[d].assign(view.getKnots(d), view.getKnots(d) + view.getKnotNum(d));
+			}
+			offset = view.getSectionOffset(FreeformStore::Section::Cpts);
+			rowSize = (size_t)view.getCptsNum(1) * view.getCptsNum(2);
+		}
+
+		auto file = std::make_shared<std::ifstream>(storePath, std::ios::binary);
+		if (!(*file))
+			throw(std::runtime_error("Cannot open file to read : " + storePath));
+		Source source = [file, offset, rowSize](int uBeg, int uEnd, Vec3* out) {
+			file->seekg((std::streamoff)(offset + (uint64_t)uBeg * rowSize * sizeof(Vec3)));
+			file->read((char*)out, (std::streamsize)((size_t)(uEnd - uBeg) * rowSize * sizeof(Vec3)));
+			if (!(*file))
+				throw(std::runtime_error("Cannot read control points of volume store"));
+		};
+		return create(degree, knots, source, slabSpans);
+	}
+
+	void VolumeSlabReader::extract(const Slab& slab, std::vector<BsplineVolume3d::Patch>& patches, bool buildMat) const {
+		int p = degree[0], q = degree[1], r = degree[2];
+		int vNum = cptsNum[1], wNum = cptsNum[2];
+		int columns = vNum * wNum;
+		int uSpanNum = slab.spanEnd - slab.spanBeg;
+		int vSpanNum = (int)spans[1].size(), wSpanNum = (int)spans[2].size();
+
+		// 1. Bezier rows of each u span, at [ ((s * (p + 1) + a) * vNum + j) * wNum + k ]
+		std::vector<Vec3> uBezier((size_t)uSpanNum * (p + 1) * columns);
+		Parallel::forEach(0, uSpanNum * columns, [&](int id) {
+			int s = id / columns, column = id % columns;
+			int span = spans[0][slab.spanBeg + s];
+			Bezier::StridedView<const Vec3> src{ slab.cpts.data() + (size_t)(span - p - slab.rowBeg) * columns + column, columns };
+			Bezier::StridedView<Vec3> dst{ uBezier.data() + (size_t)s * (p + 1) * columns + column, columns };
+			Bspline::extractSpan(src, span, p, knots[0], dst);
+		}, 256);
+
+		// 2. For each (u, v) span, Bezier in v, then every w span of it in w
+		patches.resize((size_t)uSpanNum * vSpanNum * wSpanNum);
+		Parallel::forEach(0, uSpanNum * vSpanNum, [&](int id) {
+			int s = id / vSpanNum, t = id % vSpanNum;
+			int vSpan = spans[1][t];
+			std::vector<Vec3> uvBezier((size_t)(p + 1) * (q + 1) * wNum);
+			for (int a = 0; a <= p; a++)
+				for (int k = 0; k < wNum; k++) {
+					Bezier::StridedView<const Vec3> src{ uBezier.data() + ((size_t)(s * (p + 1) + a) * vNum + vSpan - q) * wNum + k, wNum };
+					Bezier::StridedView<Vec3> dst{ uvBezier.data() + (size_t)a * (q + 1) * wNum + k, wNum };
+					Bspline::extractSpan(src, vSpan, q, knots[1], dst);
+				}
+
+			int uSpan = spans[0][slab.spanBeg + s];
+			BsplineVolume3d::ControlPoints net(p + 1, std::vector<std::vector<Vec3>>(q + 1, std::vector<Vec3>(r + 1)));
+			for (int z = 0; z < wSpanNum; z++) {
+				int wSpan = spans[2][z];
+				for (int a = 0; a <= p; a++)
+					for (int b = 0; b <= q; b++) {
+						Bezier::StridedView<const Vec3> src{ uvBezier.data() + (size_t)(a * (q + 1) + b) * wNum + wSpan - r, 1 };
+						Bezier::StridedView<Vec3> dst{ net[a][b].data(), 1 };
+						Bspline::extractSpan(src, wSpan, r, knots[2], dst);
+					}
+				auto& patch = patches[(size_t)id * wSpanNum + z];
+				patch.uSubdomain = Domain::create(knots[0][uSpan], knots[0][uSpan + 1]);
+				patch.vSubdomain = Domain::create(knots[1][vSpan], knots[1][vSpan + 1]);
+				patch.wSubdomain = Domain::create(knots[2][wSpan], knots[2][wSpan + 1]);
+				patch.patch = BezierVolume3d::createPtr(p, q, r, net, buildMat);
+			}
+		});
+	}
+
+	void VolumeSlabReader::stream(const std::function<void(const Slab&, std::vector<BsplineVolume3d::Patch>&)>& func, bool buildMat) const {
+		std::mutex mutex;
+		std::condition_variable cond;
+		std::deque<Slab> queue;
+		bool stop = false;
+		std::exception_ptr error = nullptr;
+		size_t rowSize = (size_t)cptsNum[1] * cptsNum[2];
+
+		// I/O thread reads slabs ahead, and stops early when extraction fails
+		std::thread io([&]() {
+			try {
+				for (const auto& layout : slabs) {
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						cond.wait(lock, [&]() { return stop || (int)queue.size() < maxQueuedSlabs; });
+						if (stop)
+							return;
+					}
+					Slab slab = layout;
+					slab.cpts.resize((size_t)(slab.rowEnd - slab.rowBeg) * rowSize);
+					source(slab.rowBeg, slab.rowEnd, slab.cpts.data());
+					std::lock_guard<std::mutex> lock(mutex);
+					queue.push_back(std::move(slab));
+					cond.notify_all();
+				}
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(mutex);
+				error = std::current_exception();
+				stop = true;
+				cond.notify_all();
+			}
+		});
+
+		try {
+			std::vector<BsplineVolume3d::Patch> patches;
+			for (size_t i = 0; i < slabs.size(); i++) {
+				Slab slab;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					cond.wait(lock, [&]() { return stop || !queue.empty(); });
+					if (queue.empty())
+						break;
+					slab = std::move(queue.front());
+					queue.pop_front();
+					cond.notify_all();
+				}
+				extract(slab, patches, buildMat);
+				func(slab, patches);
+			}
+		}
+		catch (...) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stop = true;
+				cond.notify_all();
+			}
+			io.join();
+			throw;
+		}
+		io.join();
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	void VolumeSlabReader::read(const Consumer& consumer, bool buildMat) const {
+		MN_INSTRUMENT_TIMER(SlabRead);
+		stream([&](const Slab&, std::vector<BsplineVolume3d::Patch>& patches) {
+			consumer(patches);
+		}, buildMat);
+	}
+	void VolumeSlabReader::spill(const std::string& path) const {
+		auto writer = FreeformStore::VolumeWriter::createPtr(path, degree, knots, getPatchNum());
+		size_t rowSize = (size_t)cptsNum[1] * cptsNum[2];
+		int written = 0;
+		stream([&](const Slab& slab, std::vector<BsplineVolume3d::Patch>& patches) {
+			// Rows shared with previous slab are written once
+			writer->writeCpts(slab.cpts.data() + (size_t)(written - slab.rowBeg) * rowSize, (size_t)(slab.rowEnd - written) * rowSize);
+			written = slab.rowEnd;
+			writer->writePatches(patches);
+		}, false);
+		writer->close();
+	}
+}
@@ -0,0 +1,76 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_VOLUME_SLAB_READER_H__
+#define __MN_VOLUME_SLAB_READER_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "../Volume/BsplineVolume3d.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace MN {
+	/*
+	 * Streaming reader of Bspline volume whose control lattice does not fit in memory.
+	 * Lattice is read in slabs of rows along u, each of which covers [slabSpans] nonzero knot intervals of u,
+	 * and Bezier patches over the slab are extracted span by span with Bspline blossoms, instead of knot insertion over whole lattice.
+	 * Slabs are read on a separate thread, at most [maxQueuedSlabs] ahead of extraction, so memory stays at a few slabs.
+	 */
+	class VolumeSlabReader {
+	public:
+		// Fills rows [uBeg, uEnd) of control lattice into [out], at [ ((i - uBeg) * vNum + j) * wNum + k ]
+		using Source = std::function<void(int uBeg, int uEnd, Vec3* out)>;
+		// Receives patches of each slab in the order of [ updatePatches ], which may be moved out
+		using Consumer = std::function<void(std::vector<BsplineVolume3d::Patch>& patches)>;
+
+		const static int maxQueuedSlabs = 2;
+	private:
+		class Slab {
+		public:
+			int spanBeg = 0, spanEnd = 0;		// Range in nonzero intervals of u
+			int rowBeg = 0, rowEnd = 0;			// Range of rows of control lattice
+			std::vector<Vec3> cpts;
+		};
+
+		VolumeSlabReader() = default;
+
+		int degree[3] = { 0, 0, 0 };
+		int cptsNum[3] = { 0, 0, 0 };
+		BsplineVolume3d::KnotVector knots[3];
+		std::vector<int> spans[3];			// Nonzero knot intervals in domain of each direction
+		std::vector<Slab> slabs;			// Layout of slabs, without control points
+		Source source;
+
+		void stream(const std::function<void(const Slab&, std::vector<BsplineVolume3d::Patch>&)>& func, bool buildMat) const;
+		void extract(const Slab& slab, std::vector<BsplineVolume3d::Patch>& patches, bool buildMat) const;
+	public:
+		// @slabSpans : Number of nonzero knot intervals of u in each slab
+		static VolumeSlabReader create(const int* degree, const BsplineVolume3d::KnotVector* knots, const Source& source, int slabSpans = 4);
+		// Reads volume store saved by [ FreeformStore ], with file stream instead of mapping
+		static VolumeSlabReader create(const std::string& storePath, int slabSpans = 4);
+
+		inline int getSlabNum() const noexcept {
+			return (int)slabs.size();
+		}
+		inline int getPatchNum() const noexcept {
+			return (int)(spans[0].size() * spans[1].size() * spans[2].size());
+		}
+
+		// @buildMat : Whether to build deriv matrices of patches
+		void read(const Consumer& consumer, bool buildMat = false) const;
+		// Write knots, control lattice and patches to volume store at [path], which [ FreeformStore::loadVolume ] loads without knot insertion
+		void spill(const std::string& path) const;
+	};
+}
+
+#endif
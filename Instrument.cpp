@@ -0,0 +1,259 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "Instrument.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+
+namespace MN {
+	// Calling thread's own allocations are not counted, e.g) while it is registered or records event
+	thread_local static bool muted = false;
+	thread_local static bool detached = false;
+	static std::atomic<bool> tracing(false);
+
+	class InstrumentMute {
+	private:
+		bool prev;
+	public:
+		InstrumentMute() noexcept : prev(muted) {
+			muted = true;
+		}
+		~InstrumentMute() {
+			muted = prev;
+		}
+	};
+
+	class Instrument::Registry {
+	public:
+		std::mutex mutex;
+		std::vector<Local*> threads;
+		Snapshot retired;			// Counts of finished threads
+		Snapshot baseline;			// Totals at last reset
+		std::vector<Event> retiredEvents;
+		int nextId = 0;
+
+		// Totals of every thread, with [ mutex ] locked
+		Snapshot total() const noexcept {
+			Snapshot sum = retired;
+			for (const Local* data : threads) {
+				for (int i = 0; i < counterNum; i++)
+					sum.counters[i] += data->counters[i].load(std::memory_order_relaxed);
+				for (int i = 0; i < timerNum; i++) {
+					sum.timerCalls[i] += data->timerCalls[i].load(std::memory_order_relaxed);
+					sum.timerNanos[i] += data->timerNanos[i].load(std::memory_order_relaxed);
+				}
+			}
+			return sum;
+		}
+	};
+
+	Instrument::Snapshot Instrument::Snapshot::operator-(const Snapshot& prev) const noexcept {
+		Snapshot diff;
+		for (int i = 0; i < counterNum; i++)
+			diff.counters[i] = counters[i] - prev.counters[i];
+		for (int i = 0; i < timerNum; i++) {
+			diff.timerCalls[i] = timerCalls[i] - prev.timerCalls[i];
+			diff.timerNanos[i] = timerNanos[i] - prev.timerNanos[i];
+		}
+		return diff;
+	}
+
+	Instrument::Registry& Instrument::registry() noexcept {
+		// Never destroyed, as threads may count after static objects are destroyed
+		static Registry* instance = []() {
+			InstrumentMute mute;
+			return new Registry;
+		}();
+		return *instance;
+	}
+	Instrument::Local* Instrument::attach() noexcept {
+		// Detaches at thread exit, keeping counts in registry
+		class Holder {
+		public:
+			Local* data = nullptr;
+			~Holder() {
+				if (data)
+					detach(data);
+			}
+		};
+
+		InstrumentMute mute;
+		Local* data = new Local;
+		Registry& reg = registry();
+		{
+			std::lock_guard<std::mutex> lock(reg.mutex);
+			data->id = reg.nextId++;
+			reg.threads.push_back(data);
+		}
+		thread_local Holder holder;
+		holder.data = data;
+		current() = data;
+		return data;
+	}
+	void Instrument::detach(Local* data) noexcept {
+		InstrumentMute mute;
+		Registry& reg = registry();
+		{
+			std::lock_guard<std::mutex> lock(reg.mutex);
+			for (int i = 0; i < counterNum; i++)
+				reg.retired.counters[i] += data->counters[i].load(std::memory_order_relaxed);
+			for (int i = 0; i < timerNum; i++) {
+				reg.retired.timerCalls[i] += data->timerCalls[i].load(std::memory_order_relaxed);
+				reg.retired.timerNanos[i] += data->timerNanos[i].load(std::memory_order_relaxed);
+			}
+			std::lock_guard<std::mutex> eventLock(data->eventMutex);
+			reg.retiredEvents.insert(reg.retiredEvents.end(), data->events.begin(), data->events.end());
+			reg.threads.erase(std::find(reg.threads.begin(), reg.threads.end(), data));
+		}
+		current() = nullptr;
+		detached = true;
+		delete data;
+	}
+	void Instrument::addSlow(Counter counter, uint64_t num) noexcept {
+		if (muted)
+			return;
+		if (detached) {
+			Registry& reg = registry();
+			std::lock_guard<std::mutex> lock(reg.mutex);
+			reg.retired.counters[(int)counter] += num;
+			return;
+		}
+		increase(attach()->counters[(int)counter], num);
+	}
+	void Instrument::finish(Timer timer, int64_t beg, int64_t end) noexcept {
+		Local* data = current();
+		if (!data) {
+			if (muted || detached)
+				return;
+			data = attach();
+		}
+		increase(data->timerCalls[(int)timer], 1);
+		increase(data->timerNanos[(int)timer], (uint64_t)(end - beg));
+		if (tracing.load(std::memory_order_relaxed)) {
+			InstrumentMute mute;
+			std::lock_guard<std::mutex> lock(data->eventMutex);
+			data->events.push_back({ timer, beg, end, data->id });
+		}
+	}
+
+	Instrument::Snapshot Instrument::snapshot() {
+		InstrumentMute mute;
+		Registry& reg = registry();
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		return reg.total() - reg.baseline;
+	}
+	Instrument::Snapshot Instrument::threadSnapshot() {
+		Snapshot snap;
+		const Local* data = current();
+		if (!data)
+			return snap;
+		for (int i = 0; i < counterNum; i++)
+			snap.counters[i] = data->counters[i].load(std::memory_order_relaxed);
+		for (int i = 0; i < timerNum; i++) {
+			snap.timerCalls[i] = data->timerCalls[i].load(std::memory_order_relaxed);
+			snap.timerNanos[i] = data->timerNanos[i].load(std::memory_order_relaxed);
+		}
+		return snap;
+	}
+	void Instrument::reset() {
+		InstrumentMute mute;
+		Registry& reg = registry();
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		reg.baseline = reg.total();
+		reg.retiredEvents.clear();
+		for (Local* data : reg.threads) {
+			std::lock_guard<std::mutex> eventLock(data->eventMutex);
+			data->events.clear();
+		}
+	}
+
+	void Instrument::setTracing(bool on) noexcept {
+		tracing.store(on);
+	}
+	bool Instrument::isTracing() noexcept {
+		return tracing.load();
+	}
+	void Instrument::writeChromeTrace(const std::string& path) {
+		InstrumentMute mute;
+		std::vector<Event> events;
+		{
+			Registry& reg = registry();
+			std::lock_guard<std::mutex> lock(reg.mutex);
+			events.swap(reg.retiredEvents);
+			for (Local* data : reg.threads) {
+				std::lock_guard<std::mutex> eventLock(data->eventMutex);
+				events.insert(events.end(), data->events.begin(), data->events.end());
+				data->events.clear();
+			}
+		}
+		// Enclosing scopes come first at the same time stamp, so that nesting is drawn correctly
+		std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+			return a.beg != b.beg ? a.beg < b.beg : a.end > b.end;
+		});
+
+		std::ofstream file(path, std::ios::binary);
+		if (!file)
+			throw(std::runtime_error("Failed to open file for Chrome trace"));
+		int64_t origin = events.empty() ? 0 : events.front().beg;
+		char line[256];
+		file << "{\"traceEvents\": [\n";
+		for (size_t i = 0; i < events.size(); i++) {
+			const Event& event = events[i];
+			int len = std::snprintf(line, sizeof(line),
+				"{\"name\": \"%s\", \"cat\": \"MinuteFreeform\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}%s\n",
+				getName(event.timer), event.thread, (event.beg - origin) * 1e-3, (event.end - event.beg) * 1e-3, i + 1 < events.size() ? "," : "");
+			file.write(line, len);
+		}
+		file << "], \"displayTimeUnit\": \"ns\"}\n";
+		if (!file)
+			throw(std::runtime_error("Failed to write Chrome trace"));
+	}
+
+	const char* Instrument::getName(Counter counter) noexcept {
+		switch (counter) {
+		case Counter::PatchScans:		return "PatchScans";
+		case Counter::BasisBuilds:		return "BasisBuilds";
+		case Counter::HeapAllocations:	return "HeapAllocations";
+		case Counter::HeapBytes:		return "HeapBytes";
+		default:						return "Unknown";
+		}
+	}
+	const char* Instrument::getName(Timer timer) noexcept {
+		switch (timer) {
+		case Timer::UpdatePatches:		return "UpdatePatches";
+		case Timer::CurvatureGrid:		return "CurvatureGrid";
+		case Timer::BVHBuild:			return "BVHBuild";
+		case Timer::Project:			return "Project";
+		case Timer::RayIntersect:		return "RayIntersect";
+		case Timer::StoreLoad:			return "StoreLoad";
+		case Timer::SlabRead:			return "SlabRead";
+		default:						return "Unknown";
+		}
+	}
+}
+
+#ifdef MINUTE_FREEFORM_INSTRUMENT_HEAP
+// Array and nothrow forms call these, so every allocation of process is counted
+void* operator new(std::size_t size) {
+	MN::Instrument::add(MN::Instrument::Counter::HeapAllocations);
+	MN::Instrument::add(MN::Instrument::Counter::HeapBytes, size);
+	if (void* ptr = std::malloc(size > 0 ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+void operator delete(void* ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+#endif
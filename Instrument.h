@@ -0,0 +1,171 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_INSTRUMENT_H__
+#define __MN_INSTRUMENT_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace MN {
+	/*
+	 * Per-thread counters and scoped timers on hot paths of freeform entities and queries.
+	 * Hot paths use [ MN_INSTRUMENT_COUNT ], [ MN_INSTRUMENT_ADD ] and [ MN_INSTRUMENT_TIMER ], which expand to nothing
+	 * unless [ MINUTE_FREEFORM_INSTRUMENT ] is defined, so disabled build has no cost at all.
+	 * Each thread only writes its own counters, and snapshot sums counters of every thread, including finished ones.
+	 * When tracing is on, each timed scope is also recorded as event, which can be exported in Chrome trace format.
+	 * Heap allocations are counted by replaced global operator new, only when [ MINUTE_FREEFORM_INSTRUMENT_HEAP ] is defined.
+	 */
+	class Instrument {
+	public:
+		enum class Counter : int {
+			PatchScans,			// Patches tested to find patch of parameter in Bspline entities
+			BasisBuilds,		// Bernstein or Bspline basis computed
+			HeapAllocations,
+			HeapBytes,
+			Num
+		};
+		enum class Timer : int {
+			UpdatePatches,		// Bezier patches of Bspline entities
+			CurvatureGrid,
+			BVHBuild,
+			Project,			// Closest point of one point
+			RayIntersect,		// One ray or one packet of rays
+			StoreLoad,
+			SlabRead,
+			Num
+		};
+		const static int counterNum = (int)Counter::Num;
+		const static int timerNum = (int)Timer::Num;
+#ifdef MINUTE_FREEFORM_INSTRUMENT
+		const static bool enabled = true;
+#else
+		const static bool enabled = false;
+#endif
+
+		// Counts at one moment, where timers have number of calls and inclusive time
+		class Snapshot {
+		public:
+			uint64_t counters[counterNum] = {};
+			uint64_t timerCalls[timerNum] = {};
+			uint64_t timerNanos[timerNum] = {};
+
+			inline uint64_t get(Counter counter) const noexcept {
+				return counters[(int)counter];
+			}
+			inline uint64_t getCalls(Timer timer) const noexcept {
+				return timerCalls[(int)timer];
+			}
+			inline double getSeconds(Timer timer) const noexcept {
+				return timerNanos[(int)timer] * 1e-9;
+			}
+			// Counts between [prev] and this snapshot, e.g) around one query
+			Snapshot operator-(const Snapshot& prev) const noexcept;
+		};
+	private:
+		class Event {
+		public:
+			Timer timer;
+			int64_t beg;
+			int64_t end;
+			int thread;
+		};
+		// Counts of one thread, which are read by other threads only in [ snapshot ]
+		class Local {
+		public:
+			std::atomic<uint64_t> counters[counterNum] = {};
+			std::atomic<uint64_t> timerCalls[timerNum] = {};
+			std::atomic<uint64_t> timerNanos[timerNum] = {};
+			std::mutex eventMutex;
+			std::vector<Event> events;
+			int id = 0;
+		};
+
+		inline static Local*& current() noexcept {
+			thread_local Local* data = nullptr;
+			return data;
+		}
+		// Owner is the only writer, so relaxed load and store are enough, without locked instruction
+		inline static void increase(std::atomic<uint64_t>& value, uint64_t num) noexcept {
+			value.store(value.load(std::memory_order_relaxed) + num, std::memory_order_relaxed);
+		}
+		// Counts of every thread, defined in source
+		class Registry;
+		static Registry& registry() noexcept;
+		static Local* attach() noexcept;
+		static void detach(Local* data) noexcept;
+		// Registers calling thread at its first count, or counts of thread that already finished
+		static void addSlow(Counter counter, uint64_t num) noexcept;
+		static void finish(Timer timer, int64_t beg, int64_t end) noexcept;
+	public:
+		inline static int64_t now() noexcept {
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+		inline static void add(Counter counter, uint64_t num = 1) noexcept {
+			if (Local* data = current())
+				increase(data->counters[(int)counter], num);
+			else
+				addSlow(counter, num);
+		}
+
+		// Adds time between construction and destruction to [timer]
+		class ScopedTimer {
+		private:
+			Timer timer;
+			int64_t beg;
+		public:
+			inline ScopedTimer(Timer timer) noexcept : timer(timer), beg(now()) {}
+			ScopedTimer(const ScopedTimer&) = delete;
+			ScopedTimer& operator=(const ScopedTimer&) = delete;
+			inline ~ScopedTimer() {
+				finish(timer, beg, now());
+			}
+		};
+
+		// Sum of every thread since last [ reset ]
+		static Snapshot snapshot();
+		// Counts of calling thread since it started, to be differenced around work done by this thread
+		static Snapshot threadSnapshot();
+		// Starts counts of [ snapshot ] from zero, and drops recorded events
+		static void reset();
+
+		// Record each timed scope from now on, or stop recording
+		static void setTracing(bool tracing) noexcept;
+		static bool isTracing() noexcept;
+		// Write recorded events in Chrome trace JSON, which opens in [ chrome://tracing ] or Perfetto, and drop them
+		static void writeChromeTrace(const std::string& path);
+
+		static const char* getName(Counter counter) noexcept;
+		static const char* getName(Timer timer) noexcept;
+	};
+}
+
+#if defined(MINUTE_FREEFORM_INSTRUMENT_HEAP) && !defined(MINUTE_FREEFORM_INSTRUMENT)
+#error "MINUTE_FREEFORM_INSTRUMENT_HEAP requires MINUTE_FREEFORM_INSTRUMENT"
+#endif
+#define MN_INSTRUMENT_CONCAT_(a, b) a##b
+#define MN_INSTRUMENT_CONCAT(a, b) MN_INSTRUMENT_CONCAT_(a, b)
+#ifdef MINUTE_FREEFORM_INSTRUMENT
+#define MN_INSTRUMENT_COUNT(counter) ::MN::Instrument::add(::MN::Instrument::Counter::counter)
+#define MN_INSTRUMENT_ADD(counter, num) ::MN::Instrument::add(::MN::Instrument::Counter::counter, (uint64_t)(num))
+#define MN_INSTRUMENT_TIMER(timer) ::MN::Instrument::ScopedTimer MN_INSTRUMENT_CONCAT(mnScopedTimer, __LINE__)(::MN::Instrument::Timer::timer)
+#else
+#define MN_INSTRUMENT_COUNT(counter) ((void)0)
+#define MN_INSTRUMENT_ADD(counter, num) ((void)0)
+#define MN_INSTRUMENT_TIMER(timer) ((void)0)
+#endif
+
+#endif
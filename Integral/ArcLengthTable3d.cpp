@@ -0,0 +1,225 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "ArcLengthTable3d.h"
+#include "GaussLegendre.h"
+#include "../Parallel.h"
+#include <algorithm>
+
+namespace MN {
+	const static Real eps = 1e-30;			// Guard against division by zero
+	const static int tableOrder = 16;		// Number of quadrature points for each segment of table
+	const static int correctOrder = 8;		// Number of quadrature points for Newton correction inside inaccurate segment
+	const static int maxDepth = 12;			// Maximum number of halvings of initial segment
+	const static int maxIteration = 32;		// Maximum number of Newton iterations
+	const static int queryChunk = 256;		// Number of consecutive queries handled by one thread, sharing segment hint
+	const static Real checkPoints[] = { 0.2, 0.4, 0.6, 0.8 };	// Where Hermite model is compared to quadrature
+
+	// Quintic Hermite model of arc length over normalized parameter [0, 1] of segment, and its derivative
+	static inline Real calHermite(Real length, Real d0, Real dd0, Real d1, Real dd1, Real t, Real& dt) noexcept {
+		Real t2 = t * t, t3 = t2 * t, t4 = t3 * t, t5 = t4 * t;
+		dt =
+			d0 * (1.0 - 18.0 * t2 + 32.0 * t3 - 15.0 * t4) +
+			dd0 * (t - 4.5 * t2 + 6.0 * t3 - 2.5 * t4) +
+			length * (30.0 * t2 - 60.0 * t3 + 30.0 * t4) +
+			d1 * (-12.0 * t2 + 28.0 * t3 - 15.0 * t4) +
+			dd1 * (1.5 * t2 - 4.0 * t3 + 2.5 * t4);
+		return
+			d0 * (t - 6.0 * t3 + 8.0 * t4 - 3.0 * t5) +
+			dd0 * (0.5 * t2 - 1.5 * t3 + 1.5 * t4 - 0.5 * t5) +
+			length * (10.0 * t3 - 15.0 * t4 + 6.0 * t5) +
+			d1 * (-4.0 * t3 + 7.0 * t4 - 3.0 * t5) +
+			dd1 * (0.5 * t3 - t4 + 0.5 * t5);
+	}
+
+	ArcLengthTable3d ArcLengthTable3d::create(const BsplineCurve3d::Ptr& curve, Real tolerance, int segmentNum) {
+		if (segmentNum < 1)
+			throw(std::runtime_error("Arc length table needs at least one segment in each patch"));
+		ArcLengthTable3d table;
+		table.curve = curve;
+		table.tolerance = tolerance;
+		table.segmentNum = segmentNum;
+		table.update();
+		return table;
+	}
+	ArcLengthTable3d::Ptr ArcLengthTable3d::createPtr(const BsplineCurve3d::Ptr& curve, Real tolerance, int segmentNum) {
+		return std::make_shared<ArcLengthTable3d>(create(curve, tolerance, segmentNum));
+	}
+	Real ArcLengthTable3d::integrate(int patch, Real a, Real b, int order) const {
+		const auto& rule = GaussLegendre::get(order);
+		const auto& bezier = *curve->getPatchVectorC()[patch].curve;
+		Real sum = 0;
+		for (int i = 0; i < order; i++)
+			sum += rule.weights[i] * bezier.jet(a + (b - a) * rule.nodes[i]).Ct.len();
+		return sum * (b - a);
+	}
+	ArcLengthTable3d::Segment ArcLengthTable3d::calSegment(int patch, Real a, Real b) const {
+		const auto& bezier = *curve->getPatchVectorC()[patch].curve;
+		Segment segment;
+		segment.patch = patch;
+		segment.a = a;
+		segment.b = b;
+		segment.accurate = true;
+		Real* derivs[2][2] = { { &segment.d0, &segment.dd0 }, { &segment.d1, &segment.dd1 } };
+		for (int end = 0; end < 2; end++) {
+			Freeform3dc::Jet j = bezier.jet(end == 0 ? a : b);
+			Real speed = j.Ct.len();
+			*derivs[end][0] = speed * (b - a);
+			*derivs[end][1] = ((speed > eps) ? j.Ct.dot(j.Ctt) / speed : j.Ctt.len()) * (b - a) * (b - a);
+		}
+		return segment;
+	}
+	void ArcLengthTable3d::update() {
+		const auto& patches = curve->getPatchVectorC();
+		int patchNum = (int)patches.size();
+		if (patchNum == 0)
+			throw(std::runtime_error("Cannot build arc length table of Bspline curve without patches"));
+
+		// Length of each patch, to settle absolute tolerance
+		std::vector<Real> patchLengths(patchNum);
+		Parallel::forEach(0, patchNum, [&](int p) {
+			patchLengths[p] = 0.0;
+			for (int j = 0; j < segmentNum; j++)
+				patchLengths[p] += integrate(p, (Real)j / segmentNum, (Real)(j + 1) / segmentNum, tableOrder);
+		});
+		Real total = 0;
+		for (Real length : patchLengths)
+			total += length;
+		Real tol = tolerance * total;
+
+		// Halve segments until Hermite model agrees with quadrature
+		std::vector<std::vector<Segment>> patchSegments(patchNum);
+		std::vector<std::vector<Real>> patchSegLengths(patchNum);
+		Parallel::forEach(0, patchNum, [&](int p) {
+			class Entry {
+			public:
+				Real a, b;
+				int depth;
+			};
+			std::vector<Entry> entries;
+			for (int j = segmentNum - 1; j >= 0; j--)
+				entries.push_back({ (Real)j / segmentNum, (Real)(j + 1) / segmentNum, 0 });
+			while (!entries.empty()) {
+				Entry e = entries.back();
+				entries.pop_back();
+				Segment segment = calSegment(p, e.a, e.b);
+				Real length = integrate(p, e.a, e.b, tableOrder), dt;
+				for (Real t : checkPoints) {
+					Real exact = integrate(p, e.a, e.a + t * (e.b - e.a), tableOrder);
+					if (fabs(calHermite(length, segment.d0, segment.dd0, segment.d1, segment.dd1, t, dt) - exact) > tol) {
+						segment.accurate = false;
+						break;
+					}
+				}
+				if (!segment.accurate && e.depth < maxDepth) {
+					Real mid = (e.a + e.b) * 0.5;
+					entries.push_back({ mid, e.b, e.depth + 1 });
+					entries.push_back({ e.a, mid, e.depth + 1 });
+					continue;
+				}
+				patchSegments[p].push_back(segment);
+				patchSegLengths[p].push_back(length);
+			}
+		});
+
+		segments.clear();
+		lengths.assign(1, 0.0);
+		for (int p = 0; p < patchNum; p++) {
+			segments.insert(segments.end(), patchSegments[p].begin(), patchSegments[p].end());
+			for (Real length : patchSegLengths[p])
+				lengths.push_back(lengths.back() + length);
+		}
+	}
+	int ArcLengthTable3d::findSegment(Real length, int hint) const {
+		int num = (int)segments.size();
+		for (int i = hint; i >= 0 && i < num && i <= hint + 1; i++)
+			if (lengths[i] <= length && length <= lengths[i + 1])
+				return i;
+		int segment = (int)(std::upper_bound(lengths.begin(), lengths.end(), length) - lengths.begin()) - 1;
+		return std::min(std::max(segment, 0), num - 1);
+	}
+	Real ArcLengthTable3d::solve(Real length, int index) const {
+		const Segment& segment = segments[index];
+		Real target = std::min(std::max(length, lengths[index]), lengths[index + 1]) - lengths[index];
+		Real segLength = lengths[index + 1] - lengths[index];
+		if (segLength <= eps)
+			return segment.a;
+
+		// Invert Hermite model by Newton iteration, which is safeguarded by bisection
+		Real t = target / segLength, lo = 0.0, hi = 1.0;
+		for (int it = 0; it < maxIteration; it++) {
+			Real dt;
+			Real f = calHermite(segLength, segment.d0, segment.dd0, segment.d1, segment.dd1, t, dt) - target;
+			if (f == 0.0)
+				break;
+			if (f > 0.0)
+				hi = t;
+			else
+				lo = t;
+			Real next = (dt > eps) ? t - f / dt : -1.0;
+			if (next <= lo || next >= hi)
+				next = (lo + hi) * 0.5;
+			if (fabs(next - t) <= 1e-15)
+				break;
+			t = next;
+		}
+		Real param = segment.a + t * (segment.b - segment.a);
+		if (segment.accurate)
+			return param;
+
+		// Newton correction on length integrated from segment start
+		Real tol = tolerance * getLength();
+		const auto& bezier = *curve->getPatchVectorC()[segment.patch].curve;
+		for (int it = 0; it < maxIteration; it++) {
+			Real f = integrate(segment.patch, segment.a, param, correctOrder) - target;
+			if (fabs(f) <= tol)
+				break;
+			Real speed = bezier.jet(param).Ct.len();
+			if (speed <= eps)
+				break;
+			param = std::min(std::max(param - f / speed, segment.a), segment.b);
+		}
+		return param;
+	}
+	Real ArcLengthTable3d::paramAtLength(Real length) const {
+		int segment = findSegment(length, -1);
+		const auto& patch = curve->getPatchVectorC()[segments[segment].patch];
+		return patch.subdomain.beg() + solve(length, segment) * patch.subdomain.width();
+	}
+	Vec3 ArcLengthTable3d::pointAtLength(Real length) const {
+		int segment = findSegment(length, -1);
+		return curve->getPatchVectorC()[segments[segment].patch].curve->evaluate(solve(length, segment));
+	}
+	void ArcLengthTable3d::paramsAtLengths(const std::vector<Real>& lengths, std::vector<Real>& params) const {
+		int num = (int)lengths.size();
+		const auto& patches = curve->getPatchVectorC();
+		params.resize(num);
+		Parallel::forEach(0, (num + queryChunk - 1) / queryChunk, [&](int chunk) {
+			int segment = -1;
+			int end = std::min((chunk + 1) * queryChunk, num);
+			for (int i = chunk * queryChunk; i < end; i++) {
+				segment = findSegment(lengths[i], segment);
+				const auto& patch = patches[segments[segment].patch];
+				params[i] = patch.subdomain.beg() + solve(lengths[i], segment) * patch.subdomain.width();
+			}
+		});
+	}
+	void ArcLengthTable3d::pointsAtLengths(const std::vector<Real>& lengths, std::vector<Vec3>& points) const {
+		int num = (int)lengths.size();
+		const auto& patches = curve->getPatchVectorC();
+		points.resize(num);
+		Parallel::forEach(0, (num + queryChunk - 1) / queryChunk, [&](int chunk) {
+			int segment = -1;
+			int end = std::min((chunk + 1) * queryChunk, num);
+			for (int i = chunk * queryChunk; i < end; i++) {
+				segment = findSegment(lengths[i], segment);
+				points[i] = patches[segments[segment].patch].curve->evaluate(solve(lengths[i], segment));
+			}
+		});
+	}
+}
@@ -0,0 +1,81 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_ARC_LENGTH_TABLE_3D_H__
+#define __MN_ARC_LENGTH_TABLE_3D_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "../Curve/BsplineCurve3d.h"
+#include <memory>
+#include <vector>
+
+namespace MN {
+	/*
+	 * Table of cumulative arc length of Bspline curve, for evaluation at given arc length.
+	 * Each patch is divided into segments, whose lengths are integrated by Gauss-Legendre quadrature when table is built.
+	 * Arc length in a segment is modeled by quintic Hermite polynomial of its parameter, and segments are halved until
+	 * the model agrees with quadrature within tolerance, so that query only needs binary search, Newton iteration on the model,
+	 * and one evaluation. Segments that cannot meet tolerance, e.g. around zero speed, are corrected by Newton iteration on quadrature.
+	 * Arc length out of [0, length] is clamped.
+	 */
+	class ArcLengthTable3d {
+	public:
+		using Ptr = std::shared_ptr<ArcLengthTable3d>;
+	private:
+		class Segment {
+		public:
+			int patch;
+			Real a, b;				// Local parameter range in patch
+			Real d0, dd0;			// First and second derivatives of arc length by normalized parameter of segment, at start
+			Real d1, dd1;			// Same at end
+			bool accurate;			// Whether Hermite model meets tolerance
+		};
+		ArcLengthTable3d() = default;
+
+		BsplineCurve3d::Ptr curve = nullptr;
+		int segmentNum = 4;				// Number of initial segments in each patch
+		Real tolerance = 1e-10;			// Error of arc length allowed, relative to length of curve
+		std::vector<Segment> segments;
+		std::vector<Real> lengths;		// Arc length from curve start at each segment boundary
+
+		// Length of patch between local parameters [a, b]
+		Real integrate(int patch, Real a, Real b, int order) const;
+		Segment calSegment(int patch, Real a, Real b) const;
+		int findSegment(Real length, int hint) const;
+		// Local parameter in patch of segment
+		Real solve(Real length, int segment) const;
+	public:
+		static ArcLengthTable3d create(const BsplineCurve3d::Ptr& curve, Real tolerance = 1e-10, int segmentNum = 4);
+		static Ptr createPtr(const BsplineCurve3d::Ptr& curve, Real tolerance = 1e-10, int segmentNum = 4);
+
+		// Call after control points of curve patches are edited
+		void update();
+
+		inline Real getLength() const noexcept {
+			return lengths.empty() ? 0.0 : lengths.back();
+		}
+		inline Real getTolerance() const noexcept {
+			return tolerance;
+		}
+		inline int getSegmentNum() const noexcept {
+			return (int)segments.size();
+		}
+
+		Real paramAtLength(Real length) const;
+		Vec3 pointAtLength(Real length) const;
+		// Batched queries run in parallel, and ascending lengths reuse segment of previous query instead of binary search
+		void paramsAtLengths(const std::vector<Real>& lengths, std::vector<Real>& params) const;
+		void pointsAtLengths(const std::vector<Real>& lengths, std::vector<Vec3>& points) const;
+	};
+}
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "GaussLegendre.h"
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace MN {
+	// Roots of Legendre polynomial by Newton iteration from asymptotic guess, mapped from [-1, 1] to [0, 1]
+	static GaussLegendre::Rule calRule(int order) {
+		GaussLegendre::Rule rule;
+		rule.nodes.resize(order);
+		rule.weights.resize(order);
+		for (int i = 0; i < (order + 1) / 2; i++) {
+			Real x = cos(PI * (i + 0.75) / (order + 0.5)), dp = 0;
+			for (int it = 0; it < 100; it++) {
+				// Recurrence for P_n(x), and its derivative from P_n and P_n-1
+				Real p0 = 1.0, p1 = 0.0;
+				for (int k = 1; k <= order; k++) {
+					Real p2 = p1;
+					p1 = p0;
+					p0 = ((2.0 * k - 1.0) * x * p1 - (k - 1.0) * p2) / k;
+				}
+				dp = order * (x * p0 - p1) / (x * x - 1.0);
+				Real dx = p0 / dp;
+				x -= dx;
+				if (fabs(dx) <= 1e-16)
+					break;
+			}
+			Real w = 2.0 / ((1.0 - x * x) * dp * dp);
+			rule.nodes[i] = (1.0 - x) * 0.5;
+			rule.nodes[order - 1 - i] = (1.0 + x) * 0.5;
+			rule.weights[i] = rule.weights[order - 1 - i] = w * 0.5;
+		}
+		return rule;
+	}
+	const GaussLegendre::Rule& GaussLegendre::get(int order) {
+		if (order < 1 || order > maxOrder)
+			throw(std::runtime_error("Invalid order of Gauss-Legendre quadrature"));
+		static const std::vector<Rule> rules = []() {
+			std::vector<Rule> rules(maxOrder + 1);
+			for (int order = 1; order <= maxOrder; order++)
+				rules[order] = calRule(order);
+			return rules;
+		}();
+		return rules[order];
+	}
+	const GaussLegendre::BasisTable& GaussLegendre::getBasis(int degree, int order) {
+		if (degree < 0 || degree > Bezier::maxDegree)
+			throw(std::runtime_error("Invalid degree for Bernstein basis table"));
+		const Rule& rule = get(order);
+		static std::mutex mutex;
+		static std::map<std::pair<int, int>, std::unique_ptr<BasisTable>> tables;
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& table = tables[{ degree, order }];
+		if (!table) {
+			table.reset(new BasisTable());
+			table->degree = degree;
+			table->order = order;
+			table->basis.resize((size_t)order * (degree + 1));
+			table->basisT.resize((size_t)order * (degree + 1));
+			Real basisTT[Bezier::maxDegree + 1];
+			for (int i = 0; i < order; i++)
+				Bezier::calBasisJet(rule.nodes[i], degree, &table->basis[(size_t)i * (degree + 1)], &table->basisT[(size_t)i * (degree + 1)], basisTT);
+		}
+		return *table;
+	}
+}
@@ -0,0 +1,56 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_GAUSS_LEGENDRE_H__
+#define __MN_GAUSS_LEGENDRE_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include <vector>
+
+namespace MN {
+	// Gauss-Legendre quadrature rules on [0, 1], computed once and shared by every thread
+	class GaussLegendre {
+	public:
+		// Rule of n points is exact for polynomials of degree up to 2n - 1
+		class Rule {
+		public:
+			std::vector<Real> nodes;
+			std::vector<Real> weights;
+		};
+		// Bernstein basis of [ degree ] and its derivative at nodes of rule of [ order ], as [order][degree + 1] arrays
+		class BasisTable {
+		public:
+			int degree;
+			int order;
+			std::vector<Real> basis;
+			std::vector<Real> basisT;
+
+			inline const Real* basisAt(int node) const noexcept {
+				return &basis[(size_t)node * (degree + 1)];
+			}
+			inline const Real* basisTAt(int node) const noexcept {
+				return &basisT[(size_t)node * (degree + 1)];
+			}
+		};
+		const static int maxOrder = 64;
+
+		static const Rule& get(int order);
+		// Tables are built on first request and kept
+		static const BasisTable& getBasis(int degree, int order);
+		// Number of points that integrates polynomial of [ degree ] exactly
+		inline static int orderOf(int degree) noexcept {
+			return degree / 2 + 1;
+		}
+	};
+}
+
+#endif
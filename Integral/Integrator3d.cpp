@@ -0,0 +1,214 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "Integrator3d.h"
+#include "GaussLegendre.h"
+#include "../Parallel.h"
+
+namespace MN {
+	const static int sqrtMargin = 6;	// Extra quadrature points for square root in speed of curve and surface
+
+	// Moments of measure accumulated over quadrature points
+	class Moments {
+	public:
+		Real m = 0;
+		Vec3 first{ 0, 0, 0 };
+		Real second[3][3] = {};
+
+		inline void add(const Vec3& x, Real weight) noexcept {
+			m += weight;
+			first += x * weight;
+			for (int i = 0; i < 3; i++)
+				for (int k = 0; k < 3; k++)
+					second[i][k] += x[i] * x[k] * weight;
+		}
+		inline void add(const Moments& other) noexcept {
+			m += other.m;
+			first += other.first;
+			for (int i = 0; i < 3; i++)
+				for (int k = 0; k < 3; k++)
+					second[i][k] += other.second[i][k];
+		}
+		Integrator3d::Properties toProperties(Real density) const {
+			Integrator3d::Properties props;
+			props.measure = m;
+			props.mass = m * density;
+			if (m <= 0.0)
+				return props;
+			props.centroid = first / m;
+			const Vec3& c = props.centroid;
+			Real central[3][3], trace = 0;
+			for (int i = 0; i < 3; i++) {
+				for (int k = 0; k < 3; k++)
+					central[i][k] = second[i][k] - m * c[i] * c[k];
+				trace += central[i][i];
+			}
+			for (int i = 0; i < 3; i++)
+				for (int k = 0; k < 3; k++)
+					props.inertia[i][k] = density * (((i == k) ? trace : 0.0) - central[i][k]);
+			return props;
+		}
+	};
+
+	// Integrate every patch in parallel, then sum in order of patches so that result does not depend on threads
+	template<typename Func>
+	static Moments integratePatches(int patchNum, const Func& func) {
+		std::vector<Moments> moments(patchNum);
+		Parallel::forEach(0, patchNum, [&](int p) { func(p, moments[p]); });
+		Moments sum;
+		for (const auto& m : moments)
+			sum.add(m);
+		return sum;
+	}
+	static void checkOrder(int order) {
+		if (order < 0 || order > GaussLegendre::maxOrder)
+			throw(std::runtime_error("Invalid order of quadrature"));
+	}
+
+	static Moments integrateCurve(const BsplineCurve3d& curve, int order) {
+		checkOrder(order);
+		const auto& patches = curve.getPatchVectorC();
+		return integratePatches((int)patches.size(), [&](int p, Moments& moments) {
+			const auto& bezier = *patches[p].curve;
+			const auto& cpts = bezier.getCptsC();
+			int degree = bezier.getDegree();
+			int n = (order > 0) ? order : GaussLegendre::orderOf(3 * degree) + sqrtMargin;
+			const auto& rule = GaussLegendre::get(n);
+			const auto& table = GaussLegendre::getBasis(degree, n);
+			for (int q = 0; q < n; q++) {
+				const Real* B = table.basisAt(q);
+				const Real* Bt = table.basisTAt(q);
+				Vec3 C{ 0, 0, 0 }, Ct{ 0, 0, 0 };
+				for (int i = 0; i <= degree; i++) {
+					C += cpts[i] * B[i];
+					Ct += cpts[i] * Bt[i];
+				}
+				moments.add(C, rule.weights[q] * Ct.len());
+			}
+		});
+	}
+	static Moments integrateSurface(const BsplineSurface3d& surface, int order) {
+		checkOrder(order);
+		const auto& patches = surface.patches;
+		return integratePatches((int)patches.size(), [&](int p, Moments& moments) {
+			const auto& bezier = *patches[p].patch;
+			const auto& cpts = bezier.getCptsC();
+			int uDegree = bezier.getDegree(0), vDegree = bezier.getDegree(1);
+			int
+				nu = (order > 0) ? order : GaussLegendre::orderOf(4 * uDegree) + sqrtMargin,
+				nv = (order > 0) ? order : GaussLegendre::orderOf(4 * vDegree) + sqrtMargin;
+			const auto& ruleU = GaussLegendre::get(nu);
+			const auto& ruleV = GaussLegendre::get(nv);
+			const auto& tableU = GaussLegendre::getBasis(uDegree, nu);
+			const auto& tableV = GaussLegendre::getBasis(vDegree, nv);
+
+			// Sum factorization : contract v first, then u
+			Vec3 T[Bezier::maxDegree + 1], Tv[Bezier::maxDegree + 1];
+			for (int qv = 0; qv < nv; qv++) {
+				const Real* Bv = tableV.basisAt(qv);
+				const Real* Bvt = tableV.basisTAt(qv);
+				for (int i = 0; i <= uDegree; i++) {
+					T[i] = Tv[i] = Vec3{ 0, 0, 0 };
+					for (int k = 0; k <= vDegree; k++) {
+						T[i] += cpts[i][k] * Bv[k];
+						Tv[i] += cpts[i][k] * Bvt[k];
+					}
+				}
+				for (int qu = 0; qu < nu; qu++) {
+					const Real* Bu = tableU.basisAt(qu);
+					const Real* But = tableU.basisTAt(qu);
+					Vec3 S{ 0, 0, 0 }, Su{ 0, 0, 0 }, Sv{ 0, 0, 0 };
+					for (int i = 0; i <= uDegree; i++) {
+						S += T[i] * Bu[i];
+						Su += T[i] * But[i];
+						Sv += Tv[i] * Bu[i];
+					}
+					moments.add(S, ruleU.weights[qu] * ruleV.weights[qv] * Su.cross(Sv).len());
+				}
+			}
+		});
+	}
+	static Moments integrateVolume(const BsplineVolume3d& volume, int order) {
+		checkOrder(order);
+		const auto& patches = volume.patches;
+		return integratePatches((int)patches.size(), [&](int p, Moments& moments) {
+			const auto& bezier = *patches[p].patch;
+			const auto& cpts = bezier.getCptsC();
+			int degree[3], n[3];
+			const GaussLegendre::Rule* rules[3];
+			const GaussLegendre::BasisTable* tables[3];
+			for (int d = 0; d < 3; d++) {
+				degree[d] = bezier.getDegree(d);
+				n[d] = (order > 0) ? order : GaussLegendre::orderOf(5 * degree[d]);
+				rules[d] = &GaussLegendre::get(n[d]);
+				tables[d] = &GaussLegendre::getBasis(degree[d], n[d]);
+			}
+			const int size = Bezier::maxDegree + 1;
+
+			// Sum factorization : contract w first, then v, then u
+			Vec3 T1[size][size], T1w[size][size], T2[size], T2v[size], T2w[size];
+			for (int qw = 0; qw < n[2]; qw++) {
+				const Real* Bw = tables[2]->basisAt(qw);
+				const Real* Bwt = tables[2]->basisTAt(qw);
+				for (int i = 0; i <= degree[0]; i++) {
+					for (int j = 0; j <= degree[1]; j++) {
+						T1[i][j] = T1w[i][j] = Vec3{ 0, 0, 0 };
+						for (int k = 0; k <= degree[2]; k++) {
+							T1[i][j] += cpts[i][j][k] * Bw[k];
+							T1w[i][j] += cpts[i][j][k] * Bwt[k];
+						}
+					}
+				}
+				for (int qv = 0; qv < n[1]; qv++) {
+					const Real* Bv = tables[1]->basisAt(qv);
+					const Real* Bvt = tables[1]->basisTAt(qv);
+					for (int i = 0; i <= degree[0]; i++) {
+						T2[i] = T2v[i] = T2w[i] = Vec3{ 0, 0, 0 };
+						for (int j = 0; j <= degree[1]; j++) {
+							T2[i] += T1[i][j] * Bv[j];
+							T2v[i] += T1[i][j] * Bvt[j];
+							T2w[i] += T1w[i][j] * Bv[j];
+						}
+					}
+					for (int qu = 0; qu < n[0]; qu++) {
+						const Real* Bu = tables[0]->basisAt(qu);
+						const Real* But = tables[0]->basisTAt(qu);
+						Vec3 V{ 0, 0, 0 }, Vu{ 0, 0, 0 }, Vv{ 0, 0, 0 }, Vw{ 0, 0, 0 };
+						for (int i = 0; i <= degree[0]; i++) {
+							V += T2[i] * Bu[i];
+							Vu += T2[i] * But[i];
+							Vv += T2v[i] * Bu[i];
+							Vw += T2w[i] * Bu[i];
+						}
+						Real weight = rules[0]->weights[qu] * rules[1]->weights[qv] * rules[2]->weights[qw];
+						moments.add(V, weight * fabs(Vec3::Tcross(Vu, Vv, Vw)));
+					}
+				}
+			}
+		});
+	}
+
+	Real Integrator3d::length(const BsplineCurve3d& curve, int order) {
+		return integrateCurve(curve, order).m;
+	}
+	Real Integrator3d::area(const BsplineSurface3d& surface, int order) {
+		return integrateSurface(surface, order).m;
+	}
+	Real Integrator3d::volume(const BsplineVolume3d& volume, int order) {
+		return integrateVolume(volume, order).m;
+	}
+	Integrator3d::Properties Integrator3d::properties(const BsplineCurve3d& curve, Real density, int order) {
+		return integrateCurve(curve, order).toProperties(density);
+	}
+	Integrator3d::Properties Integrator3d::properties(const BsplineSurface3d& surface, Real density, int order) {
+		return integrateSurface(surface, order).toProperties(density);
+	}
+	Integrator3d::Properties Integrator3d::properties(const BsplineVolume3d& volume, Real density, int order) {
+		return integrateVolume(volume, order).toProperties(density);
+	}
+}
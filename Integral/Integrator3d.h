@@ -0,0 +1,49 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_INTEGRATOR_3D_H__
+#define __MN_INTEGRATOR_3D_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "../Curve/BsplineCurve3d.h"
+#include "../Surface/BsplineSurface3d.h"
+#include "../Volume/BsplineVolume3d.h"
+
+namespace MN {
+	/*
+	 * Length, area, volume and mass properties of Bspline entities by Gauss-Legendre quadrature over Bezier patches.
+	 * Bernstein basis at quadrature nodes comes from cached tables, and patches are integrated in parallel then summed in order.
+	 * Curve and surface are regarded as wire and shell of uniform density, and volume as solid of uniform density.
+	 * @order : Number of quadrature points in each parameter direction, 0 to choose by degree.
+	 *			Automatic order is exact for every integrand of volume, and for curve and surface integrands whose speed is polynomial.
+	 */
+	class Integrator3d {
+	public:
+		class Properties {
+		public:
+			Real measure = 0;			// Length, area, or volume
+			Real mass = 0;
+			Vec3 centroid;
+			Real inertia[3][3] = {};	// Inertia tensor about centroid
+		};
+	public:
+		static Real length(const BsplineCurve3d& curve, int order = 0);
+		static Real area(const BsplineSurface3d& surface, int order = 0);
+		static Real volume(const BsplineVolume3d& volume, int order = 0);
+
+		static Properties properties(const BsplineCurve3d& curve, Real density = 1.0, int order = 0);
+		static Properties properties(const BsplineSurface3d& surface, Real density = 1.0, int order = 0);
+		static Properties properties(const BsplineVolume3d& volume, Real density = 1.0, int order = 0);
+	};
+}
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_PARALLEL_H__
+#define __MN_PARALLEL_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MN {
+	/*
+	 * Minimal thread helpers shared by batched algorithms.
+	 * Calls made from inside a parallel region run serially, so nested use does not oversubscribe threads.
+	 */
+	class Parallel {
+	private:
+		inline static bool& inParallel() noexcept {
+			thread_local bool flag = false;
+			return flag;
+		}
+		inline static int& maxThreads() noexcept {
+			static int count = 0;	// 0 for hardware concurrency
+			return count;
+		}
+	public:
+		// Number of threads used by parallel loops
+		inline static int threadCount() noexcept {
+			int count = maxThreads();
+			if (count <= 0)
+				count = (int)std::thread::hardware_concurrency();
+			return std::max(count, 1);
+		}
+		// Limit number of threads, 0 for hardware concurrency
+		inline static void setThreadCount(int count) noexcept {
+			maxThreads() = count;
+		}
+
+		// Call [ func(i) ] for every i in [beg, end), distributing chunks of at least [grain] indices over threads
+		// First exception thrown by [ func ] is rethrown after every thread finishes
+		template<typename Func>
+		inline static void forEach(int beg, int end, const Func& func, int grain = 1) {
+			int num = end - beg;
+			if (num <= 0)
+				return;
+			grain = std::max(grain, 1);
+			int threadNum = std::min(threadCount(), (num + grain - 1) / grain);
+			if (threadNum <= 1 || inParallel()) {
+				for (int i = beg; i < end; i++)
+					func(i);
+				return;
+			}
+
+			// Chunks are handed out dynamically, so that uneven work per index is balanced
+			int chunk = std::max(grain, num / (threadNum * 8));
+			std::atomic<int> next(beg);
+			std::exception_ptr error = nullptr;
+			std::mutex errorMutex;
+			auto worker = [&]() {
+				inParallel() = true;
+				try {
+					while (true) {
+						int cBeg = next.fetch_add(chunk);
+						if (cBeg >= end)
+							break;
+						int cEnd = std::min(cBeg + chunk, end);
+						for (int i = cBeg; i < cEnd; i++)
+							func(i);
+					}
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(errorMutex);
+					if (!error)
+						error = std::current_exception();
+					next.store(end);
+				}
+				inParallel() = false;
+			};
+
+			std::vector<std::thread> threads;
+			threads.reserve(threadNum - 1);
+			for (int i = 0; i < threadNum - 1; i++)
+				threads.emplace_back(worker);
+			worker();
+			for (auto& thread : threads)
+				thread.join();
+			if (error)
+				std::rethrow_exception(error);
+		}
+
+		// Call [ funcA ] and [ funcB ] concurrently, e.g) for two halves of recursive algorithm
+		// Both sides are inside parallel region, so that parallel calls made by them run serially
+		template<typename FuncA, typename FuncB>
+		inline static void invoke(const FuncA& funcA, const FuncB& funcB) {
+			if (threadCount() <= 1 || inParallel()) {
+				funcA();
+				funcB();
+				return;
+			}
+			std::exception_ptr error = nullptr;
+			std::thread thread([&]() {
+				inParallel() = true;
+				try {
+					funcA();
+				}
+				catch (...) {
+					error = std::current_exception();
+				}
+				inParallel() = false;
+			});
+			inParallel() = true;
+			try {
+				funcB();
+			}
+			catch (...) {
+				inParallel() = false;
+				thread.join();
+				throw;
+			}
+			inParallel() = false;
+			thread.join();
+			if (error)
+				std::rethrow_exception(error);
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,165 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_AABB_H__
+#define __MN_AABB_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include <algorithm>
+#include <limits>
+
+namespace MN {
+	/*
+	 * Axis aligned bounding box.
+	 * @dimension	: Number of axes, 2 or 3
+	 * @T			: Type of point
+	 */
+	template<int dimension, typename T>
+	class AABB {
+	public:
+		const static int dim = dimension;
+
+		T minCorner;
+		T maxCorner;
+
+		// Empty box, which contains nothing and becomes any point when expanded
+		inline static AABB create() noexcept {
+			AABB box;
+			for (int i = 0; i < dimension; i++) {
+				box.minCorner[i] = std::numeric_limits<Real>::max();
+				box.maxCorner[i] = -std::numeric_limits<Real>::max();
+			}
+			return box;
+		}
+		inline static AABB create(const T& minCorner, const T& maxCorner) noexcept {
+			AABB box;
+			box.minCorner = minCorner;
+			box.maxCorner = maxCorner;
+			return box;
+		}
+		// Smallest box that contains given points. It also contains their convex hull
+		inline static AABB create(const std::vector<T>& points) noexcept {
+			AABB box = create();
+			for (const auto& point : points)
+				box.expand(point);
+			return box;
+		}
+
+		inline bool isEmpty() const noexcept {
+			return minCorner[0] > maxCorner[0];
+		}
+		// Branch free, as points of control nets come in no particular order
+		inline void expand(const T& point) noexcept {
+			for (int i = 0; i < dimension; i++) {
+				minCorner[i] = std::min(minCorner[i], point[i]);
+				maxCorner[i] = std::max(maxCorner[i], point[i]);
+			}
+		}
+		inline void expand(const AABB& box) noexcept {
+			for (int i = 0; i < dimension; i++) {
+				if (box.minCorner[i] < minCorner[i])
+					minCorner[i] = box.minCorner[i];
+				if (box.maxCorner[i] > maxCorner[i])
+					maxCorner[i] = box.maxCorner[i];
+			}
+		}
+		inline void inflate(Real margin) noexcept {
+			for (int i = 0; i < dimension; i++) {
+				minCorner[i] -= margin;
+				maxCorner[i] += margin;
+			}
+		}
+
+		inline T center() const noexcept {
+			T point;
+			for (int i = 0; i < dimension; i++)
+				point[i] = (minCorner[i] + maxCorner[i]) * 0.5;
+			return point;
+		}
+		inline T extent() const noexcept {
+			T size;
+			for (int i = 0; i < dimension; i++)
+				size[i] = maxCorner[i] - minCorner[i];
+			return size;
+		}
+		inline int longestAxis() const noexcept {
+			int axis = 0;
+			for (int i = 1; i < dimension; i++)
+				if (maxCorner[i] - minCorner[i] > maxCorner[axis] - minCorner[axis])
+					axis = i;
+			return axis;
+		}
+
+		inline bool has(const T& point) const noexcept {
+			for (int i = 0; i < dimension; i++)
+				if (point[i] < minCorner[i] || point[i] > maxCorner[i])
+					return false;
+			return true;
+		}
+		inline bool overlap(const AABB& box) const noexcept {
+			for (int i = 0; i < dimension; i++)
+				if (box.maxCorner[i] < minCorner[i] || box.minCorner[i] > maxCorner[i])
+					return false;
+			return true;
+		}
+
+		// Squared distance from [point] to nearest point in this box, 0 if inside
+		inline Real distanceSq(const T& point) const noexcept {
+			Real dist = 0;
+			for (int i = 0; i < dimension; i++) {
+				Real d = 0;
+				if (point[i] < minCorner[i])
+					d = minCorner[i] - point[i];
+				else if (point[i] > maxCorner[i])
+					d = point[i] - maxCorner[i];
+				dist += d * d;
+			}
+			return dist;
+		}
+		// Squared distance from [point] to farthest point in this box
+		inline Real maxDistanceSq(const T& point) const noexcept {
+			Real dist = 0;
+			for (int i = 0; i < dimension; i++) {
+				Real d = std::max(fabs(point[i] - minCorner[i]), fabs(point[i] - maxCorner[i]));
+				dist += d * d;
+			}
+			return dist;
+		}
+
+		// Slab test for ray [ origin + t * dir ] with t in [tMin, tMax]
+		// @invDir : Component-wise inverse of ray direction
+		// @tEnter : Parameter where ray enters this box, valid only when returned true
+		inline bool intersectRay(const T& origin, const T& invDir, Real tMin, Real tMax, Real& tEnter) const noexcept {
+			for (int i = 0; i < dimension; i++) {
+				Real
+					t0 = (minCorner[i] - origin[i]) * invDir[i],
+					t1 = (maxCorner[i] - origin[i]) * invDir[i];
+				if (t0 > t1)
+					std::swap(t0, t1);
+				// NaN from 0 * inf is ignored by these comparisons
+				if (t0 > tMin)
+					tMin = t0;
+				if (t1 < tMax)
+					tMax = t1;
+				if (tMin > tMax)
+					return false;
+			}
+			tEnter = tMin;
+			return true;
+		}
+	};
+
+	using AABB2d = AABB<2, Vec2>;
+	using AABB3d = AABB<3, Vec3>;
+}
+
+#endif
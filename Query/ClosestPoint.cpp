@@ -0,0 +1,390 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "ClosestPoint.h"
+#include "Morton.h"
+#include "../Parallel.h"
+#include <limits>
+
+namespace MN {
+	const static Real eps = 1e-30;			// Guard against division by zero
+	const static Real gradientTol = 1e-6;	// Cosine between residual and tangent that is regarded as orthogonal
+	const static int maxHalving = 8;		// Maximum number of step halving in line search
+	const static int queryChunk = 64;		// Number of consecutive queries handled by one thread, sharing warm start
+
+	static inline Real clamp01(Real t) noexcept {
+		return std::min(std::max(t, 0.0), 1.0);
+	}
+	// Squared distances of seed samples of one patch, kept per thread so that traversal does not allocate
+	static inline std::vector<Real>& sampleScratch(size_t size) {
+		thread_local std::vector<Real> samples;
+		if (samples.size() < size)
+			samples.resize(size);
+		return samples;
+	}
+	// Whether descent along gradient component [g] is blocked by boundary of [0, 1]
+	static inline bool isBlocked(Real g, Real t) noexcept {
+		return (t <= 0.0 && g >= 0.0) || (t >= 1.0 && g <= 0.0);
+	}
+	// Whether gradient component [g] along tangent of squared length [tt] vanishes, considering boundary of [0, 1]
+	static inline bool isStationary(Real g, Real tt, Real t, Real residual) noexcept {
+		if (isBlocked(g, t))
+			return true;
+		return fabs(g) <= gradientTol * sqrt(tt) * residual;
+	}
+
+	// CurveProjector3d
+	CurveProjector3d CurveProjector3d::create(const BsplineCurve3d::Ptr& curve, int leafSize) {
+		CurveProjector3d projector;
+		projector.curve = curve;
+		projector.bvh = PatchBVH3d::create(*curve, leafSize);
+		return projector;
+	}
+	CurveProjector3d::Ptr CurveProjector3d::createPtr(const BsplineCurve3d::Ptr& curve, int leafSize) {
+		return std::make_shared<CurveProjector3d>(create(curve, leafSize));
+	}
+	void CurveProjector3d::refit() {
+		bvh.refit(*curve);
+	}
+	Real CurveProjector3d::solvePatch(const BezierCurve3d& patch, const Vec3& point, Real& t, bool& converged) const {
+		converged = false;
+		Freeform3dc::Jet j = patch.jet(t);
+		Vec3 r = j.C - point;
+		Real f = r.dot(r);
+		for (int it = 0; it < maxIteration; it++) {
+			if (f <= eps) {
+				converged = true;
+				break;
+			}
+			// Newton step for minimizing |C(t) - point|^2, falling back to Gauss-Newton when curvature term makes it non-convex
+			Real
+				g = j.Ct.dot(r),
+				tt = j.Ct.dot(j.Ct),
+				h = tt + j.Ctt.dot(r);
+			if (h <= eps)
+				h = tt;
+			Real nt = (h > eps) ? clamp01(t - g / h) : t;
+
+			// Halve step until squared distance does not increase
+			Freeform3dc::Jet nj;
+			Real nf = f;
+			bool accepted = false;
+			for (int k = 0; k < maxHalving && !accepted; k++) {
+				nj = patch.jet(nt);
+				Vec3 nr = nj.C - point;
+				nf = nr.dot(nr);
+				if (nf <= f)
+					accepted = true;
+				else
+					nt = (t + nt) * 0.5;
+			}
+			if (!accepted) {
+				converged = isStationary(g, tt, t, sqrt(f));
+				break;
+			}
+			Real step = fabs(nt - t);
+			t = nt;
+			j = nj;
+			r = j.C - point;
+			f = nf;
+			if (step < tolerance) {
+				converged = true;
+				break;
+			}
+		}
+		return f;
+	}
+	CurveProjector3d::Result CurveProjector3d::project(const Vec3& point, const Result* hint) const {
+		MN_INSTRUMENT_TIMER(Project);
+		const auto& patches = curve->getPatchVectorC();
+		Result best;
+		Real bestSq = std::numeric_limits<Real>::max();
+		Real bestT = 0;
+		auto solve = [&](int index, Real t) {
+			bool converged;
+			Real distSq = solvePatch(*patches[index].curve, point, t, converged);
+			if (distSq < bestSq) {
+				bestSq = distSq;
+				bestT = t;
+				best.patch = index;
+				best.converged = converged;
+			}
+		};
+
+		// Distance can have several local minima in one patch, so start from every sample that is smaller than its neighbors
+		auto seed = [&](int index) {
+			const auto& patch = *patches[index].curve;
+			std::vector<Real>& samples = sampleScratch(seedResolution + 1);
+			for (int i = 0; i <= seedResolution; i++) {
+				Vec3 d = patch.evaluate((Real)i / seedResolution) - point;
+				samples[i] = d.dot(d);
+			}
+			for (int i = 0; i <= seedResolution; i++) {
+				if ((i > 0 && samples[i - 1] < samples[i]) || (i < seedResolution && samples[i + 1] < samples[i]))
+					continue;
+				solve(index, (Real)i / seedResolution);
+			}
+		};
+
+		// Warm start from previous result, which bounds search of every other patch, and hinted patch is not visited again
+		int hinted = -1;
+		if (hint != nullptr && hint->patch >= 0) {
+			hinted = hint->patch;
+			const auto& subdomain = patches[hinted].subdomain;
+			solve(hinted, clamp01((hint->t - subdomain.beg()) / subdomain.width()));
+			seed(hinted);
+		}
+		bvh.traverseNearest(
+			[&](const AABB3d& bound) { return bound.distanceSq(point); },
+			[&](int index) {
+				if (index == hinted || bvh.getBounds()[index].distanceSq(point) >= bestSq)
+					return bestSq;
+				seed(index);
+				return bestSq;
+			});
+		if (best.patch < 0)
+			throw(std::runtime_error("Cannot project point onto Bspline curve without patches"));
+
+		const auto& patch = patches[best.patch];
+		best.t = patch.subdomain.beg() + bestT * patch.subdomain.width();
+		best.point = patch.curve->evaluate(bestT);
+		best.distance = sqrt(bestSq);
+		return best;
+	}
+	CurveProjector3d::Result CurveProjector3d::project(const Vec3& point) const {
+		return project(point, nullptr);
+	}
+	void CurveProjector3d::project(const std::vector<Vec3>& points, std::vector<Result>& results) const {
+		int num = (int)points.size();
+		std::vector<int> order;
+		Morton::sort(points, order);
+		results.resize(num);
+		Parallel::forEach(0, (num + queryChunk - 1) / queryChunk, [&](int chunk) {
+			const Result* prev = nullptr;
+			int end = std::min((chunk + 1) * queryChunk, num);
+			for (int i = chunk * queryChunk; i < end; i++) {
+				int query = order[i];
+				results[query] = project(points[query], prev);
+				prev = &results[query];
+			}
+		});
+	}
+
+	// SurfaceProjector3d
+	SurfaceProjector3d SurfaceProjector3d::create(const BsplineSurface3d::Ptr& surface, int leafSize) {
+		SurfaceProjector3d projector;
+		projector.surface = surface;
+		projector.bvh = PatchBVH3d::create(*surface, leafSize);
+		return projector;
+	}
+	SurfaceProjector3d::Ptr SurfaceProjector3d::createPtr(const BsplineSurface3d::Ptr& surface, int leafSize) {
+		return std::make_shared<SurfaceProjector3d>(create(surface, leafSize));
+	}
+	void SurfaceProjector3d::refit() {
+		bvh.refit(*surface);
+	}
+	Real SurfaceProjector3d::solvePatch(const BezierSurface3d& patch, const Vec3& point, Real& u, Real& v, bool& converged) const {
+		converged = false;
+		Freeform3ds::Jet j = patch.jet(u, v);
+		Vec3 r = j.S - point;
+		Real f = r.dot(r);
+		for (int it = 0; it < maxIteration; it++) {
+			if (f <= eps) {
+				converged = true;
+				break;
+			}
+			Real
+				gu = j.Su.dot(r),
+				gv = j.Sv.dot(r),
+				a = j.Su.dot(j.Su),
+				b = j.Su.dot(j.Sv),
+				c = j.Sv.dot(j.Sv),
+				huu = a + j.Suu.dot(r),
+				huv = b + j.Suv.dot(r),
+				hvv = c + j.Svv.dot(r);
+
+			// Coordinate sitting on patch boundary with gradient pointing outward stays fixed
+			bool
+				uFixed = isBlocked(gu, u),
+				vFixed = isBlocked(gv, v);
+			if (uFixed && vFixed) {
+				converged = true;
+				break;
+			}
+			Real
+				uStep = -gu / ((huu > eps) ? huu : std::max(a, eps)),	// Step along one direction with the other fixed
+				vStep = -gv / ((hvv > eps) ? hvv : std::max(c, eps));
+			Real du = 0.0, dv = 0.0;
+			if (uFixed)
+				dv = vStep;
+			else if (vFixed)
+				du = uStep;
+			else {
+				// Newton step for minimizing |S(u, v) - point|^2, falling back to Gauss-Newton when Hessian is not positive definite
+				if (huu <= 0.0 || huu * hvv - huv * huv <= eps) {
+					huu = a;
+					huv = b;
+					hvv = c;
+				}
+				Real det = huu * hvv - huv * huv;
+				if (det > eps) {
+					du = (huv * gv - hvv * gu) / det;
+					dv = (huv * gu - huu * gv) / det;
+				}
+				else {
+					// Degenerate tangents, e.g) collapsed edge : move along each tangent separately
+					du = (a > eps) ? -gu / a : 0.0;
+					dv = (c > eps) ? -gv / c : 0.0;
+				}
+				// Coupling term can still push coordinate on boundary outward, then move along the other one only
+				if ((u <= 0.0 && du < 0.0) || (u >= 1.0 && du > 0.0)) {
+					du = 0.0;
+					dv = vStep;
+				}
+				else if ((v <= 0.0 && dv < 0.0) || (v >= 1.0 && dv > 0.0)) {
+					du = uStep;
+					dv = 0.0;
+				}
+			}
+
+			// Truncate step at patch boundary, which keeps its direction
+			Real scale = 1.0;
+			if (u + du < 0.0)
+				scale = std::min(scale, -u / du);
+			else if (u + du > 1.0)
+				scale = std::min(scale, (1.0 - u) / du);
+			if (v + dv < 0.0)
+				scale = std::min(scale, -v / dv);
+			else if (v + dv > 1.0)
+				scale = std::min(scale, (1.0 - v) / dv);
+			Real
+				nu = clamp01(u + du * scale),
+				nv = clamp01(v + dv * scale);
+
+			// Halve step until squared distance does not increase
+			Freeform3ds::Jet nj;
+			Real nf = f;
+			bool accepted = false;
+			for (int k = 0; k < maxHalving && !accepted; k++) {
+				nj = patch.jet(nu, nv);
+				Vec3 nr = nj.S - point;
+				nf = nr.dot(nr);
+				if (nf <= f)
+					accepted = true;
+				else {
+					nu = (u + nu) * 0.5;
+					nv = (v + nv) * 0.5;
+				}
+			}
+			if (!accepted) {
+				Real residual = sqrt(f);
+				converged = isStationary(gu, a, u, residual) && isStationary(gv, c, v, residual);
+				break;
+			}
+			Real step = fabs(nu - u) + fabs(nv - v);
+			u = nu;
+			v = nv;
+			j = nj;
+			r = j.S - point;
+			f = nf;
+			if (step < tolerance) {
+				converged = true;
+				break;
+			}
+		}
+		return f;
+	}
+	SurfaceProjector3d::Result SurfaceProjector3d::project(const Vec3& point, const Result* hint) const {
+		MN_INSTRUMENT_TIMER(Project);
+		const auto& patches = surface->patches;
+		Result best;
+		Real bestSq = std::numeric_limits<Real>::max();
+		Real bestU = 0, bestV = 0;
+		auto solve = [&](int index, Real u, Real v) {
+			bool converged;
+			Real distSq = solvePatch(*patches[index].patch, point, u, v, converged);
+			if (distSq < bestSq) {
+				bestSq = distSq;
+				bestU = u;
+				bestV = v;
+				best.patch = index;
+				best.converged = converged;
+			}
+		};
+
+		// Distance can have several local minima in one patch, so start from every sample that is smaller than its neighbors
+		auto seed = [&](int index) {
+			const auto& patch = *patches[index].patch;
+			int sampleNum = seedResolution + 1;
+			std::vector<Real>& samples = sampleScratch((size_t)sampleNum * sampleNum);
+			for (int i = 0; i < sampleNum; i++) {
+				for (int k = 0; k < sampleNum; k++) {
+					Vec3 d = patch.evaluate((Real)i / seedResolution, (Real)k / seedResolution) - point;
+					samples[i * sampleNum + k] = d.dot(d);
+				}
+			}
+			for (int i = 0; i < sampleNum; i++) {
+				for (int k = 0; k < sampleNum; k++) {
+					Real sample = samples[i * sampleNum + k];
+					bool isMin = true;
+					for (int di = std::max(i - 1, 0); di <= std::min(i + 1, seedResolution) && isMin; di++)
+						for (int dk = std::max(k - 1, 0); dk <= std::min(k + 1, seedResolution) && isMin; dk++)
+							isMin = (samples[di * sampleNum + dk] >= sample);
+					if (isMin)
+						solve(index, (Real)i / seedResolution, (Real)k / seedResolution);
+				}
+			}
+		};
+
+		// Warm start from previous result, which bounds search of every other patch, and hinted patch is not visited again
+		int hinted = -1;
+		if (hint != nullptr && hint->patch >= 0) {
+			hinted = hint->patch;
+			const auto& patch = patches[hinted];
+			solve(hinted,
+				clamp01((hint->u - patch.uSubdomain.beg()) / patch.uSubdomain.width()),
+				clamp01((hint->v - patch.vSubdomain.beg()) / patch.vSubdomain.width()));
+			seed(hinted);
+		}
+		bvh.traverseNearest(
+			[&](const AABB3d& bound) { return bound.distanceSq(point); },
+			[&](int index) {
+				if (index == hinted || bvh.getBounds()[index].distanceSq(point) >= bestSq)
+					return bestSq;
+				seed(index);
+				return bestSq;
+			});
+		if (best.patch < 0)
+			throw(std::runtime_error("Cannot project point onto Bspline surface without patches"));
+
+		const auto& patch = patches[best.patch];
+		best.u = patch.uSubdomain.beg() + bestU * patch.uSubdomain.width();
+		best.v = patch.vSubdomain.beg() + bestV * patch.vSubdomain.width();
+		best.point = patch.patch->evaluate(bestU, bestV);
+		best.distance = sqrt(bestSq);
+		return best;
+	}
+	SurfaceProjector3d::Result SurfaceProjector3d::project(const Vec3& point) const {
+		return project(point, nullptr);
+	}
+	void SurfaceProjector3d::project(const std::vector<Vec3>& points, std::vector<Result>& results) const {
+		int num = (int)points.size();
+		std::vector<int> order;
+		Morton::sort(points, order);
+		results.resize(num);
+		Parallel::forEach(0, (num + queryChunk - 1) / queryChunk, [&](int chunk) {
+			const Result* prev = nullptr;
+			int end = std::min((chunk + 1) * queryChunk, num);
+			for (int i = chunk * queryChunk; i < end; i++) {
+				int query = order[i];
+				results[query] = project(points[query], prev);
+				prev = &results[query];
+			}
+		});
+	}
+}
@@ -0,0 +1,147 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_CLOSEST_POINT_H__
+#define __MN_CLOSEST_POINT_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "../Curve/BsplineCurve3d.h"
+#include "../Surface/BsplineSurface3d.h"
+#include "PatchBVH.h"
+#include <memory>
+
+namespace MN {
+	/*
+	 * Closest point projection onto Bspline curve / surface in 3D space.
+	 * Patches are visited nearest-first through patch BVH and pruned when their control net bound is farther than current best.
+	 * On each candidate patch, Newton iteration runs on its local Bezier form with jet derivatives.
+	 * Batched queries are sorted along Morton curve and run in parallel, and each query is warm-started from previous result.
+	 */
+	class CurveProjector3d {
+	public:
+		class Result {
+		public:
+			Real t = 0;					// Parameter of closest point
+			Vec3 point;					// Closest point
+			Real distance = 0;
+			int patch = -1;				// Index of patch that holds closest point
+			bool converged = false;		// Whether Newton iteration converged
+		};
+		using Ptr = std::shared_ptr<CurveProjector3d>;
+	private:
+		CurveProjector3d() = default;
+
+		BsplineCurve3d::Ptr curve = nullptr;
+		PatchBVH3d bvh;
+		Real tolerance = 1e-12;		// Newton iteration stops when parameter step is smaller than this
+		int maxIteration = 32;
+		int seedResolution = 8;		// Number of intervals per direction sampled on each patch to seed Newton iteration
+
+		// Newton iteration on local parameter [t] of one patch, returns squared distance
+		Real solvePatch(const BezierCurve3d& patch, const Vec3& point, Real& t, bool& converged) const;
+		Result project(const Vec3& point, const Result* hint) const;
+	public:
+		static CurveProjector3d create(const BsplineCurve3d::Ptr& curve, int leafSize = 4);
+		static Ptr createPtr(const BsplineCurve3d::Ptr& curve, int leafSize = 4);
+
+		// Call after control points of curve patches are edited
+		void refit();
+
+		inline void setTolerance(Real tolerance) noexcept {
+			this->tolerance = tolerance;
+		}
+		inline Real getTolerance() const noexcept {
+			return tolerance;
+		}
+		inline void setMaxIteration(int maxIteration) noexcept {
+			this->maxIteration = maxIteration;
+		}
+		inline int getMaxIteration() const noexcept {
+			return maxIteration;
+		}
+		inline void setSeedResolution(int seedResolution) {
+			if (seedResolution < 1)
+				throw(std::runtime_error("Seed resolution must be positive"));
+			this->seedResolution = seedResolution;
+		}
+		inline int getSeedResolution() const noexcept {
+			return seedResolution;
+		}
+		inline const PatchBVH3d& getBVH() const noexcept {
+			return bvh;
+		}
+
+		Result project(const Vec3& point) const;
+		void project(const std::vector<Vec3>& points, std::vector<Result>& results) const;
+	};
+
+	class SurfaceProjector3d {
+	public:
+		class Result {
+		public:
+			Real u = 0;					// Parameter of closest point
+			Real v = 0;
+			Vec3 point;					// Closest point
+			Real distance = 0;
+			int patch = -1;				// Index of patch that holds closest point
+			bool converged = false;		// Whether Newton iteration converged
+		};
+		using Ptr = std::shared_ptr<SurfaceProjector3d>;
+	private:
+		SurfaceProjector3d() = default;
+
+		BsplineSurface3d::Ptr surface = nullptr;
+		PatchBVH3d bvh;
+		Real tolerance = 1e-12;		// Newton iteration stops when parameter step is smaller than this
+		int maxIteration = 32;
+		int seedResolution = 4;		// Number of intervals per direction sampled on each patch to seed Newton iteration
+
+		// Newton iteration on local parameter (u, v) of one patch, returns squared distance
+		Real solvePatch(const BezierSurface3d& patch, const Vec3& point, Real& u, Real& v, bool& converged) const;
+		Result project(const Vec3& point, const Result* hint) const;
+	public:
+		static SurfaceProjector3d create(const BsplineSurface3d::Ptr& surface, int leafSize = 4);
+		static Ptr createPtr(const BsplineSurface3d::Ptr& surface, int leafSize = 4);
+
+		// Call after control points of surface patches are edited
+		void refit();
+
+		inline void setTolerance(Real tolerance) noexcept {
+			this->tolerance = tolerance;
+		}
+		inline Real getTolerance() const noexcept {
+			return tolerance;
+		}
+		inline void setMaxIteration(int maxIteration) noexcept {
+			this->maxIteration = maxIteration;
+		}
+		inline int getMaxIteration() const noexcept {
+			return maxIteration;
+		}
+		inline void setSeedResolution(int seedResolution) {
+			if (seedResolution < 1)
+				throw(std::runtime_error("Seed resolution must be positive"));
+			this->seedResolution = seedResolution;
+		}
+		inline int getSeedResolution() const noexcept {
+			return seedResolution;
+		}
+		inline const PatchBVH3d& getBVH() const noexcept {
+			return bvh;
+		}
+
+		Result project(const Vec3& point) const;
+		void project(const std::vector<Vec3>& points, std::vector<Result>& results) const;
+	};
+}
+
+#endif
@@ -0,0 +1,682 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "CurveIntersector.h"
+#include "PatchBVH.h"
+#include "../Parallel.h"
+#include <limits>
+
+namespace MN {
+	const static Real eps = 1e-30;			// Guard against division by zero
+	const static Real stallRatio = 0.64;	// Pair is split when one clipping step keeps more than this ratio of its parameter area
+	const static int maxDepth = 64;			// Maximum number of splits of one pair
+	const static int maxNewton = 16;		// Maximum number of Newton iterations for refinement and projection
+	const static int overlapSamples = 4;	// Number of intervals sampled on subcurve to check coincidence
+	const static int pairChunk = 16;		// Number of curve pairs handled by one thread, sharing scratch buffer
+	const static Real mergeRatio = 16.0;	// Points closer than this ratio of tolerance, in parameter scaled by domain width, are merged
+
+	static inline Real clamp01(Real t) noexcept {
+		return std::min(std::max(t, 0.0), 1.0);
+	}
+
+	// Operations on Bezier control points stored as [num] points of [D] coordinates, without heap allocation
+	template<int D>
+	class BezierKernel {
+	public:
+		static void evaluate(const Real* p, int num, Real t, Real* out) {
+			Real tmp[(Bezier::maxDegree + 1) * D];
+			for (int i = 0; i < num * D; i++)
+				tmp[i] = p[i];
+			for (int r = 1; r < num; r++)
+				for (int i = 0; i < num - r; i++)
+					for (int d = 0; d < D; d++)
+						tmp[i * D + d] = (1.0 - t) * tmp[i * D + d] + t * tmp[(i + 1) * D + d];
+			for (int d = 0; d < D; d++)
+				out[d] = tmp[d];
+		}
+		static void differentiate(const Real* p, int num, Real t, Real* out) {
+			int degree = num - 1;
+			if (degree == 0) {
+				std::fill(out, out + D, 0.0);
+				return;
+			}
+			Real hodograph[Bezier::maxDegree * D];
+			for (int i = 0; i < degree; i++)
+				for (int d = 0; d < D; d++)
+					hodograph[i * D + d] = degree * (p[(i + 1) * D + d] - p[i * D + d]);
+			evaluate(hodograph, degree, t, out);
+		}
+		static void bound(const Real* p, int num, Real* lo, Real* hi) {
+			for (int d = 0; d < D; d++) {
+				lo[d] = std::numeric_limits<Real>::max();
+				hi[d] = std::numeric_limits<Real>::lowest();
+			}
+			for (int i = 0; i < num; i++) {
+				for (int d = 0; d < D; d++) {
+					lo[d] = std::min(lo[d], p[i * D + d]);
+					hi[d] = std::max(hi[d], p[i * D + d]);
+				}
+			}
+		}
+		// Maximum distance from control points to chord, which bounds distance from curve to chord
+		static Real flatness(const Real* p, int num) {
+			const Real* last = p + (num - 1) * D;
+			Real chord[D], chordSq = 0;
+			for (int d = 0; d < D; d++) {
+				chord[d] = last[d] - p[d];
+				chordSq += chord[d] * chord[d];
+			}
+			Real flat = 0;
+			for (int i = 1; i < num; i++) {
+				Real diff[D], proj = 0, distSq = 0;
+				for (int d = 0; d < D; d++) {
+					diff[d] = p[i * D + d] - p[d];
+					proj += diff[d] * chord[d];
+				}
+				proj = (chordSq > eps) ? proj / chordSq : 0.0;
+				for (int d = 0; d < D; d++) {
+					Real r = diff[d] - proj * chord[d];
+					distSq += r * r;
+				}
+				flat = std::max(flat, distSq);
+			}
+			return sqrt(flat);
+		}
+		// Restrict to [a, b] by de Casteljau's algorithm in place
+		static void extract(Real* p, int num, Real a, Real b) {
+			int n = num - 1;
+			for (int r = 1; r <= n; r++)
+				for (int i = n; i >= r; i--)
+					for (int d = 0; d < D; d++)
+						p[i * D + d] = (1.0 - b) * p[(i - 1) * D + d] + b * p[i * D + d];
+			Real s = (b > 0.0) ? a / b : 0.0;
+			if (s > 0.0) {
+				for (int r = 1; r <= n; r++)
+					for (int i = 0; i <= n - r; i++)
+						for (int d = 0; d < D; d++)
+							p[i * D + d] = (1.0 - s) * p[i * D + d] + s * p[(i + 1) * D + d];
+			}
+		}
+		// Parameter of point on curve nearest to [point] by Newton iteration from [t], returns squared distance
+		static Real project(const Real* p, int num, const Real* point, Real& t) {
+			Real c[D], dc[D], distSq = 0;
+			evaluate(p, num, t, c);
+			for (int d = 0; d < D; d++)
+				distSq += (c[d] - point[d]) * (c[d] - point[d]);
+			for (int it = 0; it < maxNewton; it++) {
+				differentiate(p, num, t, dc);
+				Real g = 0, h = 0;
+				for (int d = 0; d < D; d++) {
+					g += dc[d] * (c[d] - point[d]);
+					h += dc[d] * dc[d];
+				}
+				if (h <= eps)
+					break;
+				Real nt = clamp01(t - g / h), nc[D], nDistSq = 0;
+				evaluate(p, num, nt, nc);
+				for (int d = 0; d < D; d++)
+					nDistSq += (nc[d] - point[d]) * (nc[d] - point[d]);
+				if (nDistSq >= distSq)
+					break;
+				t = nt;
+				distSq = nDistSq;
+				std::copy(nc, nc + D, c);
+			}
+			return distSq;
+		}
+	};
+
+	// Range of parameter of [A] whose convex hull lies in fat line of [B], false if it does not at all
+	static bool clipFatLine(const Real* A, int numA, const Real* B, int numB, Real tolerance, Real& s0, Real& s1) {
+		s0 = 0.0;
+		s1 = 1.0;
+		const Real* last = B + (numB - 1) * 2;
+		Real lx = last[0] - B[0], ly = last[1] - B[1];
+		Real len = sqrt(lx * lx + ly * ly);
+		if (len <= eps)
+			return true;
+		Real nx = -ly / len, ny = lx / len, c = -(nx * B[0] + ny * B[1]);
+		Real dMin = 0, dMax = 0;
+		for (int i = 0; i < numB; i++) {
+			Real d = nx * B[i * 2] + ny * B[i * 2 + 1] + c;
+			dMin = std::min(dMin, d);
+			dMax = std::max(dMax, d);
+		}
+		dMin -= tolerance;
+		dMax += tolerance;
+
+		int n = numA - 1;
+		Real dist[Bezier::maxDegree + 1];
+		for (int i = 0; i <= n; i++)
+			dist[i] = nx * A[i * 2] + ny * A[i * 2 + 1] + c;
+		if (n == 0)
+			return dist[0] >= dMin && dist[0] <= dMax;
+
+		// Extremes of convex hull inside the band are hull points in it, or crossings of hull edges with its borders
+		s0 = std::numeric_limits<Real>::max();
+		s1 = std::numeric_limits<Real>::lowest();
+		for (int i = 0; i <= n; i++) {
+			Real xi = (Real)i / n;
+			if (dist[i] >= dMin && dist[i] <= dMax) {
+				s0 = std::min(s0, xi);
+				s1 = std::max(s1, xi);
+			}
+			for (int k = i + 1; k <= n; k++) {
+				Real xk = (Real)k / n;
+				for (Real level : { dMin, dMax }) {
+					if ((dist[i] - level) * (dist[k] - level) < 0.0) {
+						Real x = xi + (xk - xi) * (dist[i] - level) / (dist[i] - dist[k]);
+						s0 = std::min(s0, x);
+						s1 = std::max(s1, x);
+					}
+				}
+			}
+		}
+		if (s0 > s1)
+			return false;
+		s0 = clamp01(s0);
+		s1 = clamp01(s1);
+		return true;
+	}
+
+	/*
+	 * Intersections of one pair of Bezier curves, in their local parameters.
+	 * Scratch buffers are kept between calls, so that one solver is reused over many pairs.
+	 */
+	template<int D>
+	class CurvePairSolver {
+	private:
+		using Kernel = BezierKernel<D>;
+		class Entry {
+		public:
+			Real a0, a1, b0, b1;	// Parameter range of subcurves
+			int depth;
+		};
+		std::vector<Entry> entries;		// Pairs waiting to be processed
+		std::vector<Real> nets;			// Control points of [ entries ], stacked in the same order
+		std::vector<Real> curA, curB;	// Control points of pair being processed
+
+		const Real* cptsA = nullptr;
+		const Real* cptsB = nullptr;
+		int numA = 0, numB = 0;
+		Real tolerance = 0;
+		std::vector<CurveIntersection>* result = nullptr;
+
+		// Distance between A(s) and B(t) of original curves
+		Real distance(Real s, Real t) const {
+			Real a[D], b[D], distSq = 0;
+			Kernel::evaluate(cptsA, numA, s, a);
+			Kernel::evaluate(cptsB, numB, t, b);
+			for (int d = 0; d < D; d++)
+				distSq += (a[d] - b[d]) * (a[d] - b[d]);
+			return sqrt(distSq);
+		}
+		// Gauss-Newton iteration minimizing |A(s) - B(t)|^2, which equals to Newton for transversal intersection in 2D
+		void refine(Real s, Real t) {
+			Real dist = distance(s, t);
+			for (int it = 0; it < maxNewton && dist > 0.0; it++) {
+				Real a[D], b[D], da[D], db[D];
+				Kernel::evaluate(cptsA, numA, s, a);
+				Kernel::evaluate(cptsB, numB, t, b);
+				Kernel::differentiate(cptsA, numA, s, da);
+				Kernel::differentiate(cptsB, numB, t, db);
+				Real m00 = 0, m01 = 0, m11 = 0, g0 = 0, g1 = 0;
+				for (int d = 0; d < D; d++) {
+					Real r = a[d] - b[d];
+					m00 += da[d] * da[d];
+					m01 -= da[d] * db[d];
+					m11 += db[d] * db[d];
+					g0 += da[d] * r;
+					g1 -= db[d] * r;
+				}
+				Real det = m00 * m11 - m01 * m01;
+				if (det <= eps * (m00 * m11 + eps))
+					break;
+				Real
+					ns = clamp01(s - (m11 * g0 - m01 * g1) / det),
+					nt = clamp01(t - (m00 * g1 - m01 * g0) / det);
+				Real nDist = distance(ns, nt);
+				if (nDist >= dist)
+					break;
+				s = ns;
+				t = nt;
+				dist = nDist;
+			}
+			if (dist <= tolerance) {
+				CurveIntersection x;
+				x.a = s;
+				x.b = t;
+				result->push_back(x);
+			}
+		}
+		// Both subcurves are within tolerance of their chords, so solve them as segments
+		void solveSegments(const Entry& e, const Real* A, const Real* B) {
+			const Real* P0 = A;
+			const Real* P1 = A + (numA - 1) * D;
+			const Real* Q0 = B;
+			const Real* Q1 = B + (numB - 1) * D;
+			Real u[D], v[D], w[D], uu = 0, uv = 0, vv = 0, uw = 0, vw = 0;
+			for (int d = 0; d < D; d++) {
+				u[d] = P1[d] - P0[d];
+				v[d] = Q1[d] - Q0[d];
+				w[d] = P0[d] - Q0[d];
+				uu += u[d] * u[d];
+				uv += u[d] * v[d];
+				vv += v[d] * v[d];
+				uw += u[d] * w[d];
+				vw += v[d] * w[d];
+			}
+			Real aw = e.a1 - e.a0, bw = e.b1 - e.b0;
+
+			// Nearly parallel segments that stay within tolerance of each other overlap
+			Real crossSq = std::max(uu * vv - uv * uv, 0.0);
+			if (uu > tolerance * tolerance && vv > tolerance * tolerance && crossSq <= tolerance * tolerance * std::min(uu, vv)) {
+				// Parameters of B's endpoints on A's chord, and distance of B's line from A's line
+				Real
+					s0 = -uw / uu,
+					s1 = (uv - uw) / uu;
+				Real offSq = 0;
+				for (int d = 0; d < D; d++) {
+					Real r = -w[d] - s0 * u[d];
+					offSq += r * r;
+				}
+				if (offSq > 4.0 * tolerance * tolerance)
+					return;
+				Real lo = clamp01(std::min(s0, s1)), hi = clamp01(std::max(s0, s1));
+				if ((hi - lo) * sqrt(uu) > tolerance) {
+					// Map overlap range of A back to B through B's chord
+					Real
+						tLo = (uv * lo + vw) / vv,
+						tHi = (uv * hi + vw) / vv;
+					CurveIntersection x;
+					x.overlap = true;
+					x.a = e.a0 + lo * aw;
+					x.aEnd = e.a0 + hi * aw;
+					x.b = e.b0 + clamp01(tLo) * bw;
+					x.bEnd = e.b0 + clamp01(tHi) * bw;
+					result->push_back(x);
+					return;
+				}
+			}
+
+			// Closest points of two segments
+			Real s, t;
+			if (uu <= eps && vv <= eps) {
+				s = t = 0.0;
+			}
+			else if (uu <= eps) {
+				s = 0.0;
+				t = clamp01(vw / vv);
+			}
+			else if (vv <= eps) {
+				t = 0.0;
+				s = clamp01(-uw / uu);
+			}
+			else {
+				Real denom = uu * vv - uv * uv;
+				s = (denom > 0.0) ? clamp01((uv * vw - vv * uw) / denom) : 0.0;
+				t = (uv * s + vw) / vv;
+				if (t < 0.0) {
+					t = 0.0;
+					s = clamp01(-uw / uu);
+				}
+				else if (t > 1.0) {
+					t = 1.0;
+					s = clamp01((uv - uw) / uu);
+				}
+			}
+			Real distSq = 0;
+			for (int d = 0; d < D; d++) {
+				Real r = w[d] + s * u[d] - t * v[d];
+				distSq += r * r;
+			}
+			if (distSq <= 9.0 * tolerance * tolerance)
+				refine(e.a0 + s * aw, e.b0 + t * bw);
+		}
+		// Report pair as overlap when every sample of A lies within tolerance of B
+		bool solveOverlap(const Entry& e, const Real* A, const Real* B) {
+			Real loA[D], hiA[D], loB[D], hiB[D], extA = 0, extB = 0;
+			Kernel::bound(A, numA, loA, hiA);
+			Kernel::bound(B, numB, loB, hiB);
+			for (int d = 0; d < D; d++) {
+				extA += (hiA[d] - loA[d]) * (hiA[d] - loA[d]);
+				extB += (hiB[d] - loB[d]) * (hiB[d] - loB[d]);
+			}
+			if (extA <= tolerance * tolerance || extB <= tolerance * tolerance)
+				return false;
+
+			Real tBeg = 0, tEnd = 0, t = 0.0;
+			for (int k = 0; k <= overlapSamples; k++) {
+				Real point[D];
+				Kernel::evaluate(A, numA, (Real)k / overlapSamples, point);
+				if (k == 0) {
+					// Start from nearer end of B
+					Real d0 = 0, d1 = 0;
+					for (int d = 0; d < D; d++) {
+						d0 += (B[d] - point[d]) * (B[d] - point[d]);
+						d1 += (B[(numB - 1) * D + d] - point[d]) * (B[(numB - 1) * D + d] - point[d]);
+					}
+					t = (d0 <= d1) ? 0.0 : 1.0;
+				}
+				if (Kernel::project(B, numB, point, t) > tolerance * tolerance)
+					return false;
+				if (k == 0)
+					tBeg = t;
+				tEnd = t;
+			}
+			Real bw = e.b1 - e.b0;
+			CurveIntersection x;
+			x.overlap = true;
+			x.a = e.a0;
+			x.aEnd = e.a1;
+			x.b = e.b0 + tBeg * bw;
+			x.bEnd = e.b0 + tEnd * bw;
+			result->push_back(x);
+			return true;
+		}
+	public:
+		void solve(const Real* cptsA, int numA, const Real* cptsB, int numB, Real tolerance, std::vector<CurveIntersection>& result) {
+			if (numA > Bezier::maxDegree + 1 || numB > Bezier::maxDegree + 1)
+				throw(std::runtime_error("Degree of Bezier curve is too high for intersection"));
+			this->cptsA = cptsA;
+			this->cptsB = cptsB;
+			this->numA = numA;
+			this->numB = numB;
+			this->tolerance = tolerance;
+			this->result = &result;
+
+			size_t sizeA = (size_t)numA * D, sizeB = (size_t)numB * D, netSize = sizeA + sizeB;
+			entries.clear();
+			entries.push_back({ 0.0, 1.0, 0.0, 1.0, 0 });
+			if (nets.size() < netSize)
+				nets.resize(netSize);
+			std::copy(cptsA, cptsA + sizeA, nets.begin());
+			std::copy(cptsB, cptsB + sizeB, nets.begin() + sizeA);
+			curA.resize(sizeA);
+			curB.resize(sizeB);
+
+			while (!entries.empty()) {
+				Entry e = entries.back();
+				entries.pop_back();
+				auto source = nets.begin() + entries.size() * netSize;
+				std::copy(source, source + sizeA, curA.begin());
+				std::copy(source + sizeA, source + netSize, curB.begin());
+				Real* A = curA.data();
+				Real* B = curB.data();
+
+				for (;;) {
+					Real loA[D], hiA[D], loB[D], hiB[D];
+					Kernel::bound(A, numA, loA, hiA);
+					Kernel::bound(B, numB, loB, hiB);
+					bool separate = false;
+					for (int d = 0; d < D; d++)
+						if (loA[d] > hiB[d] + tolerance || loB[d] > hiA[d] + tolerance)
+							separate = true;
+					if (separate)
+						break;
+					if (Kernel::flatness(A, numA) <= tolerance && Kernel::flatness(B, numB) <= tolerance) {
+						solveSegments(e, A, B);
+						break;
+					}
+					if (e.depth >= maxDepth) {
+						refine((e.a0 + e.a1) * 0.5, (e.b0 + e.b1) * 0.5);
+						break;
+					}
+
+					// Clipping against fat line only applies to planar curves
+					Real aw = e.a1 - e.a0, bw = e.b1 - e.b0, ratio = 1.0;
+					if (D == 2) {
+						Real s0, s1;
+						if (!clipFatLine(A, numA, B, numB, tolerance, s0, s1))
+							break;
+						Kernel::extract(A, numA, s0, s1);
+						e.a1 = e.a0 + s1 * aw;
+						e.a0 = e.a0 + s0 * aw;
+						if (!clipFatLine(B, numB, A, numA, tolerance, s0, s1))
+							break;
+						Kernel::extract(B, numB, s0, s1);
+						e.b1 = e.b0 + s1 * bw;
+						e.b0 = e.b0 + s0 * bw;
+						ratio = (e.a1 - e.a0) * (e.b1 - e.b0) / std::max(aw * bw, eps);
+					}
+					if (ratio <= stallRatio)
+						continue;
+
+					// Clipping stalled : coincident pair is overlap, otherwise split longer subcurve
+					if (solveOverlap(e, A, B))
+						break;
+					Real extA = 0, extB = 0;
+					for (int d = 0; d < D; d++) {
+						extA = std::max(extA, hiA[d] - loA[d]);
+						extB = std::max(extB, hiB[d] - loB[d]);
+					}
+					size_t offset = entries.size() * netSize;
+					if (nets.size() < offset + netSize)
+						nets.resize(offset + netSize);
+					Real* upperA = &nets[offset];
+					Real* upperB = &nets[offset + sizeA];
+					std::copy(A, A + sizeA, upperA);
+					std::copy(B, B + sizeB, upperB);
+					Entry upper = e;
+					if (extA >= extB) {
+						Kernel::extract(upperA, numA, 0.5, 1.0);
+						Kernel::extract(A, numA, 0.0, 0.5);
+						upper.a0 = e.a1 = (e.a0 + e.a1) * 0.5;
+					}
+					else {
+						Kernel::extract(upperB, numB, 0.5, 1.0);
+						Kernel::extract(B, numB, 0.0, 0.5);
+						upper.b0 = e.b1 = (e.b0 + e.b1) * 0.5;
+					}
+					e.depth++;
+					upper.depth = e.depth;
+					entries.push_back(upper);
+				}
+			}
+		}
+	};
+
+	// Merge overlaps that touch each other, and drop duplicated points found from neighboring pairs
+	// @aTol, bTol : Parameter distance regarded as same on each curve
+	static void mergeIntersections(std::vector<CurveIntersection>& result, Real aTol, Real bTol) {
+		std::vector<CurveIntersection> overlaps, points;
+		for (auto x : result) {
+			if (x.overlap) {
+				if (x.aEnd < x.a) {
+					std::swap(x.a, x.aEnd);
+					std::swap(x.b, x.bEnd);
+				}
+				overlaps.push_back(x);
+			}
+			else
+				points.push_back(x);
+		}
+		auto byA = [](const CurveIntersection& x, const CurveIntersection& y) { return x.a < y.a; };
+		std::sort(overlaps.begin(), overlaps.end(), byA);
+		std::sort(points.begin(), points.end(), byA);
+
+		result.clear();
+		for (const auto& x : overlaps) {
+			if (!result.empty() && x.a <= result.back().aEnd + aTol) {
+				auto& last = result.back();
+				if (x.aEnd > last.aEnd) {
+					last.aEnd = x.aEnd;
+					last.bEnd = x.bEnd;
+				}
+			}
+			else
+				result.push_back(x);
+		}
+		size_t overlapNum = result.size();
+		for (const auto& x : points) {
+			bool duplicate = false;
+			for (size_t i = 0; i < overlapNum && !duplicate; i++)
+				duplicate = (x.a >= result[i].a - aTol && x.a <= result[i].aEnd + aTol);
+			for (size_t i = result.size(); i > overlapNum && !duplicate; i--) {
+				const auto& y = result[i - 1];
+				if (x.a - y.a > aTol)
+					break;
+				duplicate = (fabs(x.b - y.b) <= bTol);
+			}
+			if (!duplicate)
+				result.push_back(x);
+		}
+		std::sort(result.begin(), result.end(), byA);
+	}
+
+	// Control points of every patch of Bspline curve flattened into one array, with patch BVH inflated by tolerance
+	template<int D, typename BVHType, typename Box>
+	class PreparedCurve {
+	public:
+		BVHType bvh;
+		Box bound;
+		std::vector<Real> cpts;
+		std::vector<size_t> offset;		// Offset of each patch in [ cpts ]
+		std::vector<int> num;			// Number of control points of each patch
+		std::vector<Domain> subdomain;
+		Domain domain;
+
+		template<typename Curve>
+		static PreparedCurve create(const Curve& curve, Real tolerance) {
+			PreparedCurve prepared;
+			const auto& patches = curve.getPatchVectorC();
+			std::vector<Box> bounds;
+			BVHType::calPatchBounds(curve, bounds);
+			prepared.bound = Box::create();
+			for (auto& bound : bounds) {
+				bound.inflate(tolerance);
+				prepared.bound.expand(bound);
+			}
+			prepared.bvh = BVHType::create(bounds);
+			for (const auto& patch : patches) {
+				const auto& patchCpts = patch.curve->getCptsC();
+				prepared.offset.push_back(prepared.cpts.size());
+				prepared.num.push_back((int)patchCpts.size());
+				prepared.subdomain.push_back(patch.subdomain);
+				for (const auto& cpt : patchCpts)
+					for (int d = 0; d < D; d++)
+						prepared.cpts.push_back(cpt[d]);
+			}
+			prepared.domain = curve.getDomainC();
+			return prepared;
+		}
+	};
+	template<int D, typename Prepared>
+	static void intersectPrepared(const Prepared& curveA, const Prepared& curveB, Real tolerance, CurvePairSolver<D>& solver, std::vector<CurveIntersection>& result) {
+		result.clear();
+		std::vector<CurveIntersection> local;
+		decltype(curveA.bvh)::traversePair(curveA.bvh, curveB.bvh, [&](int pa, int pb) {
+			local.clear();
+			solver.solve(&curveA.cpts[curveA.offset[pa]], curveA.num[pa], &curveB.cpts[curveB.offset[pb]], curveB.num[pb], tolerance, local);
+			const Domain& da = curveA.subdomain[pa];
+			const Domain& db = curveB.subdomain[pb];
+			for (auto x : local) {
+				x.a = da.beg() + x.a * da.width();
+				x.b = db.beg() + x.b * db.width();
+				x.aEnd = da.beg() + x.aEnd * da.width();
+				x.bEnd = db.beg() + x.bEnd * db.width();
+				result.push_back(x);
+			}
+			return true;
+		});
+		Real mergeTol = mergeRatio * tolerance;
+		mergeIntersections(result, mergeTol * curveA.domain.width(), mergeTol * curveB.domain.width());
+	}
+	template<int D, typename Prepared, typename Curve>
+	static void intersectAllPrepared(const std::vector<std::shared_ptr<Curve>>& curves, std::vector<CurveIntersection>& result, Real tolerance) {
+		int num = (int)curves.size();
+		std::vector<Prepared> prepared(num);
+		Parallel::forEach(0, num, [&](int i) {
+			prepared[i] = Prepared::template create<Curve>(*curves[i], tolerance);
+		});
+
+		// Broad phase : sweep along x axis over curve bounds
+		std::vector<int> order(num);
+		for (int i = 0; i < num; i++)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&](int a, int b) {
+			return prepared[a].bound.minCorner[0] < prepared[b].bound.minCorner[0];
+		});
+		std::vector<std::pair<int, int>> pairs;
+		std::vector<int> active;
+		for (int i : order) {
+			const auto& bound = prepared[i].bound;
+			size_t kept = 0;
+			for (int j : active) {
+				if (prepared[j].bound.maxCorner[0] < bound.minCorner[0])
+					continue;
+				active[kept++] = j;
+				if (prepared[j].bound.overlap(bound))
+					pairs.push_back({ std::min(i, j), std::max(i, j) });
+			}
+			active.resize(kept);
+			active.push_back(i);
+		}
+		std::sort(pairs.begin(), pairs.end());
+
+		// Narrow phase in parallel, each chunk reusing one solver
+		std::vector<std::vector<CurveIntersection>> pairResults(pairs.size());
+		int chunkNum = ((int)pairs.size() + pairChunk - 1) / pairChunk;
+		Parallel::forEach(0, chunkNum, [&](int chunk) {
+			CurvePairSolver<D> solver;
+			int end = std::min((chunk + 1) * pairChunk, (int)pairs.size());
+			for (int i = chunk * pairChunk; i < end; i++) {
+				intersectPrepared<D>(prepared[pairs[i].first], prepared[pairs[i].second], tolerance, solver, pairResults[i]);
+				for (auto& x : pairResults[i]) {
+					x.curveA = pairs[i].first;
+					x.curveB = pairs[i].second;
+				}
+			}
+		});
+		result.clear();
+		for (const auto& pairResult : pairResults)
+			result.insert(result.end(), pairResult.begin(), pairResult.end());
+	}
+	template<int D, typename BezierCurve>
+	static void intersectBezier(const BezierCurve& curveA, const BezierCurve& curveB, std::vector<CurveIntersection>& result, Real tolerance) {
+		std::vector<Real> cptsA, cptsB;
+		for (const auto& cpt : curveA.getCptsC())
+			for (int d = 0; d < D; d++)
+				cptsA.push_back(cpt[d]);
+		for (const auto& cpt : curveB.getCptsC())
+			for (int d = 0; d < D; d++)
+				cptsB.push_back(cpt[d]);
+		result.clear();
+		CurvePairSolver<D> solver;
+		solver.solve(cptsA.data(), (int)curveA.getCptsC().size(), cptsB.data(), (int)curveB.getCptsC().size(), tolerance, result);
+		Real mergeTol = mergeRatio * tolerance;
+		mergeIntersections(result, mergeTol, mergeTol);
+	}
+
+	using PreparedCurve2d = PreparedCurve<2, PatchBVH2d, AABB2d>;
+	using PreparedCurve3d = PreparedCurve<3, PatchBVH3d, AABB3d>;
+
+	// CurveIntersector2d
+	void CurveIntersector2d::intersect(const BezierCurve2d& curveA, const BezierCurve2d& curveB, std::vector<CurveIntersection>& result, Real tolerance) {
+		intersectBezier<2>(curveA, curveB, result, tolerance);
+	}
+	void CurveIntersector2d::intersect(const BsplineCurve2d& curveA, const BsplineCurve2d& curveB, std::vector<CurveIntersection>& result, Real tolerance) {
+		CurvePairSolver<2> solver;
+		intersectPrepared<2>(PreparedCurve2d::create(curveA, tolerance), PreparedCurve2d::create(curveB, tolerance), tolerance, solver, result);
+	}
+	void CurveIntersector2d::intersectAll(const std::vector<BsplineCurve2d::Ptr>& curves, std::vector<CurveIntersection>& result, Real tolerance) {
+		intersectAllPrepared<2, PreparedCurve2d>(curves, result, tolerance);
+	}
+
+	// CurveIntersector3d
+	void CurveIntersector3d::intersect(const BezierCurve3d& curveA, const BezierCurve3d& curveB, std::vector<CurveIntersection>& result, Real tolerance) {
+		intersectBezier<3>(curveA, curveB, result, tolerance);
+	}
+	void CurveIntersector3d::intersect(const BsplineCurve3d& curveA, const BsplineCurve3d& curveB, std::vector<CurveIntersection>& result, Real tolerance) {
+		CurvePairSolver<3> solver;
+		intersectPrepared<3>(PreparedCurve3d::create(curveA, tolerance), PreparedCurve3d::create(curveB, tolerance), tolerance, solver, result);
+	}
+	void CurveIntersector3d::intersectAll(const std::vector<BsplineCurve3d::Ptr>& curves, std::vector<CurveIntersection>& result, Real tolerance) {
+		intersectAllPrepared<3, PreparedCurve3d>(curves, result, tolerance);
+	}
+}
@@ -0,0 +1,60 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_CURVE_INTERSECTOR_H__
+#define __MN_CURVE_INTERSECTOR_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "../Curve/BsplineCurve2d.h"
+#include "../Curve/BsplineCurve3d.h"
+#include <vector>
+
+namespace MN {
+	// Intersection between two curves, given by parameters on each of them
+	class CurveIntersection {
+	public:
+		int curveA = -1;		// Index of curves, only set by [ intersectAll ]
+		int curveB = -1;
+		Real a = 0;				// Parameter on curve A
+		Real b = 0;				// Parameter on curve B
+		// Curves coincide over [a, aEnd] of A and [b, bEnd] of B, where bEnd can be less than b if orientations differ
+		bool overlap = false;
+		Real aEnd = 0;
+		Real bEnd = 0;
+	};
+
+	/*
+	 * Intersection of Bezier / Bspline curves by recursive subdivision of patch pairs.
+	 * Pair of subcurves is discarded when control polygon bounds do not overlap, and narrowed by Bezier clipping against fat line of the other in 2D.
+	 * When clipping stalls, coincident pair is reported as overlap, and otherwise longer one is split in half.
+	 * Pair that became flat within tolerance is solved as segments, which also settles tangential intersections, and refined by Newton iteration.
+	 * Subcurves live in reused scratch buffer, so that the inner loop does not allocate.
+	 * @tolerance : Distance between curves regarded as intersection
+	 */
+	class CurveIntersector2d {
+	public:
+		static void intersect(const BezierCurve2d& curveA, const BezierCurve2d& curveB, std::vector<CurveIntersection>& result, Real tolerance = 1e-9);
+		static void intersect(const BsplineCurve2d& curveA, const BsplineCurve2d& curveB, std::vector<CurveIntersection>& result, Real tolerance = 1e-9);
+		// Intersections of every pair of curves, whose candidates are found by sweep along x axis and processed in parallel
+		static void intersectAll(const std::vector<BsplineCurve2d::Ptr>& curves, std::vector<CurveIntersection>& result, Real tolerance = 1e-9);
+	};
+
+	// Same as above in 3D, where curves intersect when they pass within tolerance
+	class CurveIntersector3d {
+	public:
+		static void intersect(const BezierCurve3d& curveA, const BezierCurve3d& curveB, std::vector<CurveIntersection>& result, Real tolerance = 1e-9);
+		static void intersect(const BsplineCurve3d& curveA, const BsplineCurve3d& curveB, std::vector<CurveIntersection>& result, Real tolerance = 1e-9);
+		static void intersectAll(const std::vector<BsplineCurve3d::Ptr>& curves, std::vector<CurveIntersection>& result, Real tolerance = 1e-9);
+	};
+}
+
+#endif
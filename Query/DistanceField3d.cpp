@@ -0,0 +1,249 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "DistanceField3d.h"
+#include "../Parallel.h"
+#include <limits>
+
+namespace MN {
+	const static float farDistance = std::numeric_limits<float>::max();
+	const static int sweepTile = 16;		// Rows of a sweep tile in J and K, which is handled by one thread
+	const static int maxSampleNum = 256;	// Intervals of points sampled on one patch in each direction, to find narrow band
+
+	// Frozen flags are bits padded per row of grid, so that slabs never share a byte
+	static inline size_t rowBytes(const DistanceField3d::Grid& grid) noexcept {
+		return (size_t)(grid.size[0] + 7) / 8;
+	}
+	static inline bool isFrozen(const std::vector<unsigned char>& frozen, size_t bytes, int i, size_t row) noexcept {
+		return (frozen[row * bytes + (i >> 3)] >> (i & 7)) & 1;
+	}
+
+	DistanceField3d DistanceField3d::create(const BsplineSurface3d::Ptr& surface, int leafSize) {
+		DistanceField3d field;
+		field.surface = surface;
+		field.projector = SurfaceProjector3d::createPtr(surface, leafSize);
+		return field;
+	}
+	DistanceField3d::Ptr DistanceField3d::createPtr(const BsplineSurface3d::Ptr& surface, int leafSize) {
+		return std::make_shared<DistanceField3d>(create(surface, leafSize));
+	}
+	void DistanceField3d::refit() {
+		projector->refit();
+	}
+	void DistanceField3d::setBandWidth(int bandWidth) {
+		if (bandWidth < 1)
+			throw(std::runtime_error("Band width of distance field must be positive"));
+		this->bandWidth = bandWidth;
+	}
+	void DistanceField3d::setSlabSize(int slabSize) {
+		if (slabSize < 1)
+			throw(std::runtime_error("Slab size of distance field must be positive"));
+		this->slabSize = slabSize;
+	}
+	void DistanceField3d::setSweepNum(int sweepNum) {
+		if (sweepNum < 0)
+			throw(std::runtime_error("Number of sweeps of distance field must not be negative"));
+		this->sweepNum = sweepNum;
+	}
+
+	void DistanceField3d::sampleBand(const Grid& grid, float* distances, std::vector<unsigned char>& frozen) const {
+		const int nx = grid.size[0], ny = grid.size[1], nz = grid.size[2];
+		const Real h = grid.spacing;
+		const Real band = bandWidth * h;
+		const size_t bytes = rowBytes(grid);
+		const size_t plane = (size_t)nx * ny;
+		const auto& bvh = projector->getBVH();
+		const auto& patches = surface->patches;
+		const int patchNum = (int)patches.size();
+
+		// Points on each patch about one cell apart, so that by Lipschitz bound every point of patch is within [ slack ] of one
+		std::vector<std::vector<Vec3>> samples(patchNum);
+		std::vector<Real> slack(patchNum);
+		Parallel::forEach(0, patchNum, [&](int p) {
+			const auto& patch = *patches[p].patch;
+			int num[2];
+			for (int d = 0; d < 2; d++)
+				num[d] = (int)std::min((Real)maxSampleNum, std::max((Real)1, std::ceil(patch.getLipschitz(d) / h)));
+			slack[p] = patch.getLipschitz(0) / (2 * num[0]) + patch.getLipschitz(1) / (2 * num[1]);
+			std::vector<Real> u, v;
+			for (int a = 0; a <= num[0]; a++) {
+				for (int b = 0; b <= num[1]; b++) {
+					u.push_back((Real)a / num[0]);
+					v.push_back((Real)b / num[1]);
+				}
+			}
+			patch.evaluate(u, v, samples[p]);
+		});
+		Real maxSlack = 0;
+		for (Real value : slack)
+			maxSlack = std::max(maxSlack, value);
+
+		Parallel::forEach(0, (nz + slabSize - 1) / slabSize, [&](int slab) {
+			int k0 = slab * slabSize, k1 = std::min(k0 + slabSize, nz);
+			std::fill(distances + k0 * plane, distances + k1 * plane, farDistance);
+
+			AABB3d slabBound = AABB3d::create(
+				grid.origin + Vec3{ 0, 0, k0 * h },
+				grid.origin + Vec3{ (nx - 1) * h, (ny - 1) * h, (k1 - 1) * h });
+			slabBound.inflate(band + maxSlack);
+			std::vector<int> candidates;
+			bvh.query(slabBound, candidates);
+			if (candidates.empty())
+				return;
+
+			// Cells within band of surface are within [ band + slack ] of sample points, which bounds distance from below
+			std::vector<unsigned char> marked((size_t)(k1 - k0) * plane, 0);
+			int clampLo[3] = { 0, 0, k0 };
+			int clampHi[3] = { nx - 1, ny - 1, k1 - 1 };
+			for (int p : candidates) {
+				Real radius = band + slack[p];
+				for (const auto& sample : samples[p]) {
+					int lo[3], hi[3];
+					for (int d = 0; d < 3; d++) {
+						lo[d] = (int)std::max((Real)clampLo[d], std::ceil((sample[d] - radius - grid.origin[d]) / h));
+						hi[d] = (int)std::min((Real)clampHi[d], std::floor((sample[d] + radius - grid.origin[d]) / h));
+					}
+					for (int k = lo[2]; k <= hi[2]; k++) {
+						for (int j = lo[1]; j <= hi[1]; j++) {
+							for (int i = lo[0]; i <= hi[0]; i++) {
+								Vec3 diff = grid.origin + Vec3{ i * h, j * h, k * h } - sample;
+								if (diff.lenSq() <= radius * radius)
+									marked[(k - k0) * plane + (size_t)j * nx + i] = 1;
+							}
+						}
+					}
+				}
+			}
+			std::vector<Vec3> points;
+			std::vector<size_t> cells;
+			for (size_t c = 0; c < marked.size(); c++) {
+				if (!marked[c])
+					continue;
+				int i = (int)(c % nx), j = (int)((c / nx) % ny), k = k0 + (int)(c / plane);
+				points.push_back(grid.origin + Vec3{ i * h, j * h, k * h });
+				cells.push_back(k0 * plane + c);
+			}
+			// Projection runs serially here, sharing warm start along Morton order
+			std::vector<SurfaceProjector3d::Result> results;
+			projector->project(points, results);
+			for (size_t q = 0; q < results.size(); q++) {
+				const auto& result = results[q];
+				// Cells out of band are left to sweeping
+				if (result.distance > band)
+					continue;
+				const auto& patch = patches[result.patch];
+				Real u = (result.u - patch.uSubdomain.beg()) / patch.uSubdomain.width();
+				Real v = (result.v - patch.vSubdomain.beg()) / patch.vSubdomain.width();
+				auto jet = patch.patch->jet(u, v);
+				Real side = (points[q] - result.point).dot(jet.Su.cross(jet.Sv));
+				size_t cell = cells[q];
+				distances[cell] = (float)(side < 0.0 ? -result.distance : result.distance);
+				size_t row = cell / nx;
+				int i = (int)(cell % nx);
+				frozen[row * bytes + (i >> 3)] |= (unsigned char)(1 << (i & 7));
+			}
+		});
+	}
+
+	// Godunov upwind solution of |grad d| = 1 from the smallest neighbor in each axis, sorted as a <= b <= c
+	static inline float solveEikonal(float a, float b, float c, Real h) {
+		Real x = a + h;
+		if (x <= b)
+			return (float)x;
+		x = (a + b + sqrt(std::max(2.0 * h * h - ((Real)a - b) * ((Real)a - b), 0.0))) * 0.5;
+		if (x <= c)
+			return (float)x;
+		Real sum = (Real)a + b + c;
+		Real sumSq = (Real)a * a + (Real)b * b + (Real)c * c;
+		return (float)((sum + sqrt(std::max(sum * sum - 3.0 * (sumSq - h * h), 0.0))) / 3.0);
+	}
+	void DistanceField3d::sweep(const Grid& grid, float* distances, const std::vector<unsigned char>& frozen) const {
+		const int n[3] = { grid.size[0], grid.size[1], grid.size[2] };
+		const Real h = grid.spacing;
+		const size_t bytes = rowBytes(grid);
+		const size_t stride[3] = { 1, (size_t)n[0], (size_t)n[0] * n[1] };
+
+		auto update = [&](int i, int j, int k) {
+			size_t row = (size_t)k * n[1] + j;
+			if (isFrozen(frozen, bytes, i, row))
+				return;
+			size_t cell = row * n[0] + i;
+			int idx[3] = { i, j, k };
+			float m[3];
+			float nearest = farDistance, nearestSigned = farDistance;
+			for (int d = 0; d < 3; d++) {
+				m[d] = farDistance;
+				for (int s = -1; s <= 1; s += 2) {
+					int x = idx[d] + s;
+					if (x < 0 || x >= n[d])
+						continue;
+					float value = distances[cell + s * (long long)stride[d]];
+					float mag = std::fabs(value);
+					if (mag < m[d])
+						m[d] = mag;
+					if (mag < nearest) {
+						nearest = mag;
+						nearestSigned = value;
+					}
+				}
+			}
+			if (nearest == farDistance)
+				return;
+			std::sort(m, m + 3);
+			float x = solveEikonal(m[0], m[1], m[2], h);
+			if (x < std::fabs(distances[cell]))
+				distances[cell] = nearestSigned < 0.0f ? -x : x;
+		};
+
+		for (int pass = 0; pass < sweepNum; pass++) {
+			for (int dir = 0; dir < 8; dir++) {
+				// Index in sweep order maps to grid index by flipping axes
+				bool flip[3] = { (dir & 1) != 0, (dir & 2) != 0, (dir & 4) != 0 };
+				auto at = [&](int d, int t) {
+					return flip[d] ? n[d] - 1 - t : t;
+				};
+				if (Parallel::threadCount() <= 1) {
+					for (int tk = 0; tk < n[2]; tk++)
+						for (int tj = 0; tj < n[1]; tj++)
+							for (int ti = 0; ti < n[0]; ti++)
+								update(at(0, ti), at(1, tj), at(2, tk));
+					continue;
+				}
+				// Rows are grouped into tiles in J and K, which are swept in the same order as above within a tile.
+				// Tiles on one anti-diagonal never read cells of each other, so each diagonal is one parallel pass
+				int tileNum[2] = { (n[1] + sweepTile - 1) / sweepTile, (n[2] + sweepTile - 1) / sweepTile };
+				for (int level = 0; level <= tileNum[0] + tileNum[1] - 2; level++) {
+					int bkBeg = std::max(0, level - (tileNum[0] - 1)), bkEnd = std::min(tileNum[1] - 1, level);
+					Parallel::forEach(bkBeg, bkEnd + 1, [&](int bk) {
+						int bj = level - bk;
+						int tkEnd = std::min(n[2], (bk + 1) * sweepTile), tjEnd = std::min(n[1], (bj + 1) * sweepTile);
+						for (int tk = bk * sweepTile; tk < tkEnd; tk++)
+							for (int tj = bj * sweepTile; tj < tjEnd; tj++)
+								for (int ti = 0; ti < n[0]; ti++)
+									update(at(0, ti), at(1, tj), at(2, tk));
+					});
+				}
+			}
+		}
+	}
+
+	void DistanceField3d::sample(const Grid& grid, float* distances) const {
+		for (int d = 0; d < 3; d++)
+			if (grid.size[d] < 1)
+				throw(std::runtime_error("Size of distance field grid must be positive"));
+		if (grid.spacing <= 0.0)
+			throw(std::runtime_error("Spacing of distance field grid must be positive"));
+		std::vector<unsigned char> frozen(rowBytes(grid) * grid.size[1] * grid.size[2], 0);
+		sampleBand(grid, distances, frozen);
+		sweep(grid, distances, frozen);
+	}
+	void DistanceField3d::sample(const Grid& grid, std::vector<float>& distances) const {
+		distances.resize(grid.count());
+		sample(grid, distances.data());
+	}
+}
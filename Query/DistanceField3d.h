@@ -0,0 +1,90 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_DISTANCE_FIELD_3D_H__
+#define __MN_DISTANCE_FIELD_3D_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "../Surface/BsplineSurface3d.h"
+#include "ClosestPoint.h"
+#include <memory>
+#include <vector>
+
+namespace MN {
+	/*
+	 * Signed distance field of Bspline surface sampled on regular grid.
+	 * Narrow band : Grid is processed in slabs along Z in parallel. Cells that may be within band width of surface,
+	 * judged by distance to points sampled on patches, are projected onto surface exactly, and only those within
+	 * band width are kept, signed by side of surface normal at closest point.
+	 * Elsewhere : Distance is propagated from narrow band by fast sweeping of Eikonal equation in 8 directions,
+	 * where each sweep visits tiles of rows in wavefront order and tiles of one wavefront in parallel.
+	 * Sign is carried from the nearest neighbor during sweeping, so it is meaningful for closed surfaces,
+	 * and for open surface it tells side of the surface only near it.
+	 * Distances are written as float into buffer owned by caller. Work memory is one frozen bit per cell of grid,
+	 * plus sample points of every patch, which grow with surface area / h^2, and per slab in flight,
+	 * one byte per cell of slab and query points of cells in band.
+	 */
+	class DistanceField3d {
+	public:
+		// Cell (i, j, k) is at [ origin + (i, j, k) * spacing ], and stored at [ (k * size[1] + j) * size[0] + i ]
+		class Grid {
+		public:
+			Vec3 origin;
+			Real spacing = 1;
+			int size[3] = { 0, 0, 0 };
+
+			inline size_t count() const noexcept {
+				return (size_t)size[0] * size[1] * size[2];
+			}
+		};
+		using Ptr = std::shared_ptr<DistanceField3d>;
+	private:
+		DistanceField3d() = default;
+
+		BsplineSurface3d::Ptr surface = nullptr;
+		SurfaceProjector3d::Ptr projector = nullptr;
+		int bandWidth = 3;			// Width of narrow band in cells
+		int slabSize = 4;			// Number of Z planes in one slab of narrow band
+		int sweepNum = 1;			// Number of passes of 8 sweeps
+
+		void sampleBand(const Grid& grid, float* distances, std::vector<unsigned char>& frozen) const;
+		void sweep(const Grid& grid, float* distances, const std::vector<unsigned char>& frozen) const;
+	public:
+		static DistanceField3d create(const BsplineSurface3d::Ptr& surface, int leafSize = 4);
+		static Ptr createPtr(const BsplineSurface3d::Ptr& surface, int leafSize = 4);
+
+		// Call after control points of surface patches are edited
+		void refit();
+
+		void setBandWidth(int bandWidth);
+		inline int getBandWidth() const noexcept {
+			return bandWidth;
+		}
+		void setSlabSize(int slabSize);
+		inline int getSlabSize() const noexcept {
+			return slabSize;
+		}
+		void setSweepNum(int sweepNum);
+		inline int getSweepNum() const noexcept {
+			return sweepNum;
+		}
+		inline const SurfaceProjector3d& getProjector() const noexcept {
+			return *projector;
+		}
+
+		// @distances : Buffer of [ grid.count() ] floats
+		void sample(const Grid& grid, float* distances) const;
+		void sample(const Grid& grid, std::vector<float>& distances) const;
+	};
+}
+
+#endif
@@ -0,0 +1,289 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "InverseMapper3d.h"
+#include "Morton.h"
+#include "../Parallel.h"
+#include <limits>
+
+namespace MN {
+	const static Real eps = 1e-30;			// Guard against division by zero
+	const static Real stepTol = 1e-14;		// Newton iteration stops when parameter step is smaller than this
+	const static Real singularTol = 1e-10;	// Jacobian is regarded as singular when its volume is smaller than this, relative to lengths of columns
+	const static Real damping = 1e-10;		// Damping of least squares step, relative to trace of normal matrix
+	const static Real gradientTol = 1e-6;	// Cosine between residual and tangent that is regarded as orthogonal
+	const static int maxHalving = 8;		// Maximum number of step halving in line search
+	const static int queryChunk = 64;		// Number of consecutive queries handled by one thread, sharing warm start
+
+	static inline Real clamp01(Real t) noexcept {
+		return std::min(std::max(t, 0.0), 1.0);
+	}
+	// Whether descent along gradient component [g] is blocked by boundary of [0, 1]
+	static inline bool isBlocked(Real g, Real t) noexcept {
+		return (t <= 0.0 && g >= 0.0) || (t >= 1.0 && g <= 0.0);
+	}
+	// Damped least squares step minimizing |J * step + r|^2 over columns of J that are not fixed
+	static void solveLeastSquares(const Vec3* J, const bool* fixed, const Vec3& r, Real* step) {
+		int index[3], num = 0;
+		for (int i = 0; i < 3; i++) {
+			step[i] = 0.0;
+			if (!fixed[i])
+				index[num++] = i;
+		}
+		Real A[3][3], b[3], trace = 0.0;
+		for (int i = 0; i < num; i++) {
+			for (int k = 0; k < num; k++)
+				A[i][k] = J[index[i]].dot(J[index[k]]);
+			b[i] = -J[index[i]].dot(r);
+			trace += A[i][i];
+		}
+		if (trace <= eps)
+			return;
+		for (int i = 0; i < num; i++)
+			A[i][i] += damping * trace;
+
+		// Gaussian elimination, which is stable without pivoting for symmetric positive definite matrix
+		for (int i = 0; i < num; i++) {
+			for (int k = i + 1; k < num; k++) {
+				Real ratio = A[k][i] / A[i][i];
+				for (int l = i; l < num; l++)
+					A[k][l] -= ratio * A[i][l];
+				b[k] -= ratio * b[i];
+			}
+		}
+		for (int i = num - 1; i >= 0; i--) {
+			Real sum = b[i];
+			for (int k = i + 1; k < num; k++)
+				sum -= A[i][k] * step[index[k]];
+			step[index[i]] = sum / A[i][i];
+		}
+	}
+
+	InverseMapper3d InverseMapper3d::create(const BsplineVolume3d::Ptr& volume, int leafSize) {
+		InverseMapper3d mapper;
+		mapper.volume = volume;
+		mapper.bvh = PatchBVH3d::create(*volume, leafSize);
+		return mapper;
+	}
+	InverseMapper3d::Ptr InverseMapper3d::createPtr(const BsplineVolume3d::Ptr& volume, int leafSize) {
+		return std::make_shared<InverseMapper3d>(create(volume, leafSize));
+	}
+	void InverseMapper3d::refit() {
+		bvh.refit(*volume);
+	}
+	Real InverseMapper3d::getInsideTolerance() const noexcept {
+		Real size = bvh.size() > 0 ? bvh.getRootBound().extent().len() : 0.0;
+		return (size > 0.0) ? tolerance * size : tolerance;
+	}
+	Real InverseMapper3d::solvePatch(const BezierVolume3d& patch, const Vec3& point, Real& u, Real& v, Real& w, bool& converged) const {
+		converged = false;
+		Freeform3dv::Jet j = patch.jet(u, v, w);
+		Vec3 r = j.V - point;
+		Real f = r.dot(r);
+		for (int it = 0; it < maxIteration; it++) {
+			if (f <= eps) {
+				converged = true;
+				break;
+			}
+			Real param[3] = { u, v, w };
+			Vec3 J[3] = { j.Vu, j.Vv, j.Vw };
+			Real g[3];
+			bool fixed[3];
+			for (int i = 0; i < 3; i++) {
+				g[i] = J[i].dot(r);
+				fixed[i] = isBlocked(g[i], param[i]);
+			}
+			if (fixed[0] && fixed[1] && fixed[2]) {
+				converged = true;
+				break;
+			}
+
+			// Newton step solving J * step = -r, or least squares step when some coordinates are fixed or J is near singular
+			Real step[3];
+			Real det = Vec3::Tcross(J[0], J[1], J[2]);
+			if (!fixed[0] && !fixed[1] && !fixed[2] && fabs(det) > singularTol * J[0].len() * J[1].len() * J[2].len()) {
+				step[0] = -r.dot(J[1].cross(J[2])) / det;
+				step[1] = -r.dot(J[2].cross(J[0])) / det;
+				step[2] = -r.dot(J[0].cross(J[1])) / det;
+			}
+			else
+				solveLeastSquares(J, fixed, r, step);
+
+			// Coordinate on boundary can still be pushed outward, then fix it and solve again
+			for (int pass = 0; pass < 2; pass++) {
+				bool refix = false;
+				for (int i = 0; i < 3; i++) {
+					if (!fixed[i] && ((param[i] <= 0.0 && step[i] < 0.0) || (param[i] >= 1.0 && step[i] > 0.0))) {
+						fixed[i] = true;
+						refix = true;
+					}
+				}
+				if (!refix)
+					break;
+				solveLeastSquares(J, fixed, r, step);
+			}
+
+			// Truncate step at patch boundary, which keeps its direction
+			Real scale = 1.0;
+			for (int i = 0; i < 3; i++) {
+				if (param[i] + step[i] < 0.0)
+					scale = std::min(scale, -param[i] / step[i]);
+				else if (param[i] + step[i] > 1.0)
+					scale = std::min(scale, (1.0 - param[i]) / step[i]);
+			}
+			Real
+				nu = clamp01(u + step[0] * scale),
+				nv = clamp01(v + step[1] * scale),
+				nw = clamp01(w + step[2] * scale);
+
+			// Halve step until squared residual does not increase
+			Freeform3dv::Jet nj;
+			Real nf = f;
+			bool accepted = false;
+			for (int k = 0; k < maxHalving && !accepted; k++) {
+				nj = patch.jet(nu, nv, nw);
+				Vec3 nr = nj.V - point;
+				nf = nr.dot(nr);
+				if (nf <= f)
+					accepted = true;
+				else {
+					nu = (u + nu) * 0.5;
+					nv = (v + nv) * 0.5;
+					nw = (w + nw) * 0.5;
+				}
+			}
+			if (!accepted) {
+				// No descent : converged if residual is orthogonal to every free direction
+				Real residual = sqrt(f);
+				converged = true;
+				for (int i = 0; i < 3; i++)
+					if (!isBlocked(g[i], param[i]) && fabs(g[i]) > gradientTol * J[i].len() * residual)
+						converged = false;
+				break;
+			}
+			Real change = fabs(nu - u) + fabs(nv - v) + fabs(nw - w);
+			u = nu;
+			v = nv;
+			w = nw;
+			j = nj;
+			r = j.V - point;
+			f = nf;
+			if (change < stepTol) {
+				converged = true;
+				break;
+			}
+		}
+		return f;
+	}
+	InverseMapper3d::Result InverseMapper3d::map(const Vec3& point, const Result* hint) const {
+		const auto& patches = volume->patches;
+		const auto& bounds = bvh.getBounds();
+		Real insideTol = getInsideTolerance();
+		Real insideSq = insideTol * insideTol;
+
+		Result best;
+		Real bestSq = std::numeric_limits<Real>::max();
+		Real bestU = 0, bestV = 0, bestW = 0;
+		auto solve = [&](int index, Real u, Real v, Real w) {
+			bool converged;
+			Real distSq = solvePatch(*patches[index].patch, point, u, v, w, converged);
+			if (distSq < bestSq) {
+				bestSq = distSq;
+				bestU = u;
+				bestV = v;
+				bestW = w;
+				best.patch = index;
+				best.converged = converged;
+			}
+			return bestSq <= insideSq;
+		};
+		// Start from nearest sample of coarse grid on patch
+		auto solveFromSample = [&](int index) {
+			const auto& patch = *patches[index].patch;
+			Real seed[3] = { 0.5, 0.5, 0.5 }, seedSq = std::numeric_limits<Real>::max();
+			for (int i = 0; i <= seedResolution; i++) {
+				for (int k = 0; k <= seedResolution; k++) {
+					for (int l = 0; l <= seedResolution; l++) {
+						Real
+							u = (Real)i / seedResolution,
+							v = (Real)k / seedResolution,
+							w = (Real)l / seedResolution;
+						Vec3 d = patch.evaluate(u, v, w) - point;
+						if (d.dot(d) < seedSq) {
+							seedSq = d.dot(d);
+							seed[0] = u;
+							seed[1] = v;
+							seed[2] = w;
+						}
+					}
+				}
+			}
+			return solve(index, seed[0], seed[1], seed[2]);
+		};
+
+		// Warm start from previous result, which is usually in the same patch
+		bool found = false;
+		if (hint != nullptr && hint->patch >= 0 && bounds[hint->patch].has(point)) {
+			const auto& patch = patches[hint->patch];
+			found = solve(hint->patch,
+				clamp01((hint->u - patch.uSubdomain.beg()) / patch.uSubdomain.width()),
+				clamp01((hint->v - patch.vSubdomain.beg()) / patch.vSubdomain.width()),
+				clamp01((hint->w - patch.wSubdomain.beg()) / patch.wSubdomain.width()));
+		}
+
+		// Only patches whose control net bound contains the point can contain it
+		if (!found) {
+			bvh.traverse(
+				[&](const AABB3d& bound) { return bound.has(point); },
+				[&](int index) {
+					found = solve(index, 0.5, 0.5, 0.5) || solveFromSample(index);
+					return !found;
+				});
+		}
+
+		// Outside of volume : find nearest point among the other patches
+		if (!found) {
+			bvh.traverseNearest(
+				[&](const AABB3d& bound) { return bound.distanceSq(point); },
+				[&](int index) {
+					if (!bounds[index].has(point) && bounds[index].distanceSq(point) < bestSq)
+						solveFromSample(index);
+					return bestSq;
+				});
+		}
+		if (best.patch < 0)
+			throw(std::runtime_error("Cannot map point into Bspline volume without patches"));
+
+		const auto& patch = patches[best.patch];
+		best.u = patch.uSubdomain.beg() + bestU * patch.uSubdomain.width();
+		best.v = patch.vSubdomain.beg() + bestV * patch.vSubdomain.width();
+		best.w = patch.wSubdomain.beg() + bestW * patch.wSubdomain.width();
+		best.point = patch.patch->evaluate(bestU, bestV, bestW);
+		best.distance = sqrt(bestSq);
+		best.inside = (bestSq <= insideSq);
+		return best;
+	}
+	InverseMapper3d::Result InverseMapper3d::map(const Vec3& point) const {
+		return map(point, nullptr);
+	}
+	void InverseMapper3d::map(const std::vector<Vec3>& points, std::vector<Result>& results) const {
+		int num = (int)points.size();
+		std::vector<int> order;
+		Morton::sort(points, order);
+		results.resize(num);
+		Parallel::forEach(0, (num + queryChunk - 1) / queryChunk, [&](int chunk) {
+			const Result* prev = nullptr;
+			int end = std::min((chunk + 1) * queryChunk, num);
+			for (int i = chunk * queryChunk; i < end; i++) {
+				int query = order[i];
+				results[query] = map(points[query], prev);
+				prev = &results[query];
+			}
+		});
+	}
+}
@@ -0,0 +1,92 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_INVERSE_MAPPER_3D_H__
+#define __MN_INVERSE_MAPPER_3D_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "../Volume/BsplineVolume3d.h"
+#include "PatchBVH.h"
+#include <memory>
+
+namespace MN {
+	/*
+	 * Inverse mapping from physical point to parameter (u, v, w) of Bspline volume.
+	 * Candidate patches are those whose control net bound contains the point, found through patch BVH.
+	 * On each candidate, Newton iteration solves V(u, v, w) = point with 3x3 Jacobian from volume jet.
+	 * When Jacobian is near singular, damped least squares step is taken instead, and steps are truncated at patch boundary.
+	 * Point that no patch contains is reported as outside, with parameter of its nearest point in the volume.
+	 */
+	class InverseMapper3d {
+	public:
+		class Result {
+		public:
+			Real u = 0;					// Parameter of mapped point
+			Real v = 0;
+			Real w = 0;
+			Vec3 point;					// Image of parameter, which equals to query point when inside
+			Real distance = 0;			// Distance between query point and [point]
+			int patch = -1;				// Index of patch that holds parameter
+			bool inside = false;		// Whether query point is inside volume
+			bool converged = false;		// Whether Newton iteration converged
+		};
+		using Ptr = std::shared_ptr<InverseMapper3d>;
+	private:
+		InverseMapper3d() = default;
+
+		BsplineVolume3d::Ptr volume = nullptr;
+		PatchBVH3d bvh;
+		Real tolerance = 1e-10;		// Point is regarded as inside when residual is smaller than this, relative to size of volume
+		int maxIteration = 32;
+		int seedResolution = 2;		// Number of intervals per direction sampled on each patch when Newton from patch center fails
+
+		Real getInsideTolerance() const noexcept;
+		// Newton iteration on local parameter (u, v, w) of one patch, returns squared residual
+		Real solvePatch(const BezierVolume3d& patch, const Vec3& point, Real& u, Real& v, Real& w, bool& converged) const;
+		Result map(const Vec3& point, const Result* hint) const;
+	public:
+		static InverseMapper3d create(const BsplineVolume3d::Ptr& volume, int leafSize = 4);
+		static Ptr createPtr(const BsplineVolume3d::Ptr& volume, int leafSize = 4);
+
+		// Call after control points of volume patches are edited
+		void refit();
+
+		inline void setTolerance(Real tolerance) noexcept {
+			this->tolerance = tolerance;
+		}
+		inline Real getTolerance() const noexcept {
+			return tolerance;
+		}
+		inline void setMaxIteration(int maxIteration) noexcept {
+			this->maxIteration = maxIteration;
+		}
+		inline int getMaxIteration() const noexcept {
+			return maxIteration;
+		}
+		inline void setSeedResolution(int seedResolution) {
+			if (seedResolution < 1)
+				throw(std::runtime_error("Seed resolution must be positive"));
+			this->seedResolution = seedResolution;
+		}
+		inline int getSeedResolution() const noexcept {
+			return seedResolution;
+		}
+		inline const PatchBVH3d& getBVH() const noexcept {
+			return bvh;
+		}
+
+		Result map(const Vec3& point) const;
+		void map(const std::vector<Vec3>& points, std::vector<Result>& results) const;
+	};
+}
+
+#endif
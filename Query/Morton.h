@@ -0,0 +1,64 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_MORTON_H__
+#define __MN_MORTON_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "AABB.h"
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+
+namespace MN {
+	// Morton (Z-order) curve, which keeps points that are close in space close in order
+	class Morton {
+	private:
+		// Insert two zero bits between each of lower 21 bits
+		inline static uint64_t spread(uint64_t x) noexcept {
+			x &= 0x1fffff;
+			x = (x | x << 32) & 0x1f00000000ffffULL;
+			x = (x | x << 16) & 0x1f0000ff0000ffULL;
+			x = (x | x << 8) & 0x100f00f00f00f00fULL;
+			x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+			x = (x | x << 2) & 0x1249249249249249ULL;
+			return x;
+		}
+	public:
+		// 63-bit code of [point] quantized in [bound], 21 bits per axis
+		inline static uint64_t encode(const Vec3& point, const AABB3d& bound) noexcept {
+			uint64_t code = 0;
+			for (int i = 0; i < 3; i++) {
+				Real
+					width = bound.maxCorner[i] - bound.minCorner[i],
+					x = (width > 0) ? (point[i] - bound.minCorner[i]) / width : 0.0;
+				x = std::min(std::max(x, 0.0), 1.0);
+				code |= spread((uint64_t)(x * 2097151.0)) << i;
+			}
+			return code;
+		}
+		// Indices of [points] sorted along Morton curve in their bound
+		inline static void sort(const std::vector<Vec3>& points, std::vector<int>& order) {
+			AABB3d bound = AABB3d::create(points);
+			std::vector<uint64_t> codes(points.size());
+			for (size_t i = 0; i < points.size(); i++)
+				codes[i] = encode(points[i], bound);
+			order.resize(points.size());
+			std::iota(order.begin(), order.end(), 0);
+			std::sort(order.begin(), order.end(), [&](int a, int b) {
+				return codes[a] < codes[b];
+			});
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_OBB_H__
+#define __MN_OBB_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "AABB.h"
+
+namespace MN {
+	// Oriented bounding box, whose axes are orthonormal
+	class OBB3d {
+	public:
+		Vec3 center;
+		Vec3 axes[3];
+		Vec3 halfExtent;
+
+		// Box along principal axes of given points, i.e. eigenvectors of their covariance. It also contains their convex hull
+		inline static OBB3d create(const std::vector<Vec3>& points) {
+			OBB3d box;
+			int num = (int)points.size();
+			if (num == 0)
+				throw(std::runtime_error("Cannot build oriented bound of no points"));
+			Vec3 mean{ 0, 0, 0 };
+			for (const auto& point : points)
+				mean += point;
+			mean /= (Real)num;
+			Real cov[3][3] = {};
+			for (const auto& point : points) {
+				Vec3 d = point - mean;
+				for (int i = 0; i < 3; i++)
+					for (int k = 0; k < 3; k++)
+						cov[i][k] += d[i] * d[k];
+			}
+			calEigenvectors(cov, box.axes);
+
+			Vec3 lo, hi;
+			for (int i = 0; i < 3; i++) {
+				lo[i] = std::numeric_limits<Real>::max();
+				hi[i] = -std::numeric_limits<Real>::max();
+			}
+			for (const auto& point : points) {
+				for (int i = 0; i < 3; i++) {
+					Real proj = box.axes[i].dot(point - mean);
+					lo[i] = std::min(lo[i], proj);
+					hi[i] = std::max(hi[i], proj);
+				}
+			}
+			box.center = mean;
+			for (int i = 0; i < 3; i++) {
+				box.center += box.axes[i] * ((lo[i] + hi[i]) * 0.5);
+				box.halfExtent[i] = (hi[i] - lo[i]) * 0.5;
+			}
+			return box;
+		}
+
+		inline bool has(const Vec3& point) const noexcept {
+			Vec3 d = point - center;
+			for (int i = 0; i < 3; i++)
+				if (fabs(axes[i].dot(d)) > halfExtent[i])
+					return false;
+			return true;
+		}
+		inline Real distanceSq(const Vec3& point) const noexcept {
+			Vec3 d = point - center;
+			Real dist = 0;
+			for (int i = 0; i < 3; i++) {
+				Real excess = fabs(axes[i].dot(d)) - halfExtent[i];
+				if (excess > 0.0)
+					dist += excess * excess;
+			}
+			return dist;
+		}
+		// Separating axis test over face normals of both boxes and their cross products
+		inline bool overlap(const OBB3d& box) const noexcept {
+			Vec3 d = box.center - center;
+			auto separates = [&](const Vec3& axis) {
+				Real lenSq = axis.dot(axis);
+				if (lenSq <= 1e-24)
+					return false;
+				Real ra = 0, rb = 0;
+				for (int i = 0; i < 3; i++) {
+					ra += halfExtent[i] * fabs(axes[i].dot(axis));
+					rb += box.halfExtent[i] * fabs(box.axes[i].dot(axis));
+				}
+				return fabs(d.dot(axis)) > ra + rb;
+			};
+			for (int i = 0; i < 3; i++)
+				if (separates(axes[i]) || separates(box.axes[i]))
+					return false;
+			for (int i = 0; i < 3; i++)
+				for (int k = 0; k < 3; k++)
+					if (separates(axes[i].cross(box.axes[k])))
+						return false;
+			return true;
+		}
+		inline AABB3d toAABB() const noexcept {
+			Vec3 extent;
+			for (int i = 0; i < 3; i++)
+				extent[i] = fabs(axes[0][i]) * halfExtent[0] + fabs(axes[1][i]) * halfExtent[1] + fabs(axes[2][i]) * halfExtent[2];
+			return AABB3d::create(center - extent, center + extent);
+		}
+		inline Real volume() const noexcept {
+			return 8.0 * halfExtent[0] * halfExtent[1] * halfExtent[2];
+		}
+	private:
+		// Eigenvectors of symmetric matrix by cyclic Jacobi rotations
+		inline static void calEigenvectors(Real (&A)[3][3], Vec3 (&vectors)[3]) {
+			Real V[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+			for (int sweep = 0; sweep < 32; sweep++) {
+				Real off = fabs(A[0][1]) + fabs(A[0][2]) + fabs(A[1][2]);
+				if (off <= 1e-15 * (fabs(A[0][0]) + fabs(A[1][1]) + fabs(A[2][2])) || off == 0.0)
+					break;
+				for (int p = 0; p < 2; p++) {
+					for (int q = p + 1; q < 3; q++) {
+						if (A[p][q] == 0.0)
+							continue;
+						Real theta = (A[q][q] - A[p][p]) / (2.0 * A[p][q]);
+						Real t = ((theta >= 0.0) ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+						Real c = 1.0 / sqrt(t * t + 1.0), s = t * c;
+						for (int k = 0; k < 3; k++) {
+							Real akp = A[k][p], akq = A[k][q];
+							A[k][p] = c * akp - s * akq;
+							A[k][q] = s * akp + c * akq;
+						}
+						for (int k = 0; k < 3; k++) {
+							Real apk = A[p][k], aqk = A[q][k];
+							A[p][k] = c * apk - s * aqk;
+							A[q][k] = s * apk + c * aqk;
+						}
+						for (int k = 0; k < 3; k++) {
+							Real vkp = V[k][p], vkq = V[k][q];
+							V[k][p] = c * vkp - s * vkq;
+							V[k][q] = s * vkp + c * vkq;
+						}
+					}
+				}
+			}
+			for (int i = 0; i < 3; i++)
+				vectors[i] = Vec3{ V[0][i], V[1][i], V[2][i] };
+		}
+	};
+
+	// Bounds of Bezier patch taken from its control points, cached in the patch
+	class PatchBound3d {
+	public:
+		AABB3d bound = AABB3d::create();
+		// Bounds of hodograph control points in each parameter direction, which contain first derivatives
+		AABB3d derivBound[3] = { AABB3d::create(), AABB3d::create(), AABB3d::create() };
+		// Largest norm of hodograph control points, which bounds speed in each direction for Lipschitz pruning
+		Real lipschitz[3] = { 0, 0, 0 };
+
+		// Squared norms are gathered here, so that [ finish ] takes one square root per direction
+		inline void expandDeriv(int dir, const Vec3& deriv) noexcept {
+			derivBound[dir].expand(deriv);
+			lipschitz[dir] = std::max(lipschitz[dir], deriv.lenSq());
+		}
+		inline void finish() noexcept {
+			for (int d = 0; d < 3; d++)
+				lipschitz[d] = std::sqrt(lipschitz[d]);
+		}
+	};
+}
+
+#endif
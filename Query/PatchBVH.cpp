@@ -0,0 +1,144 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "PatchBVH.h"
+
+namespace MN {
+	// Patches are cheap to bound, so each thread takes at least this many of them
+	const static int boundGrain = 256;
+
+	// PatchBVH3d
+	AABB3d PatchBVH3d::calPatchBound(const BezierCurve3d& curve) {
+		return curve.getBound();
+	}
+	AABB3d PatchBVH3d::calPatchBound(const BezierSurface3d& surface) {
+		return surface.getBound();
+	}
+	AABB3d PatchBVH3d::calPatchBound(const BezierVolume3d& volume) {
+		return volume.getBound();
+	}
+	void PatchBVH3d::calPatchBounds(const BsplineCurve3d& curve, std::vector<AABB3d>& bounds) {
+		const auto& patches = curve.getPatchVectorC();
+		bounds.resize(patches.size());
+		Parallel::forEach(0, (int)patches.size(), [&](int i) {
+			bounds[i] = calPatchBound(*patches[i].curve);
+		}, boundGrain);
+	}
+	void PatchBVH3d::calPatchBounds(const BsplineSurface3d& surface, std::vector<AABB3d>& bounds) {
+		const auto& patches = surface.patches;
+		bounds.resize(patches.size());
+		Parallel::forEach(0, (int)patches.size(), [&](int i) {
+			bounds[i] = calPatchBound(*patches[i].patch);
+		}, boundGrain);
+	}
+	void PatchBVH3d::calPatchBounds(const BsplineVolume3d& volume, std::vector<AABB3d>& bounds) {
+		const auto& patches = volume.patches;
+		bounds.resize(patches.size());
+		Parallel::forEach(0, (int)patches.size(), [&](int i) {
+			bounds[i] = calPatchBound(*patches[i].patch);
+		}, boundGrain);
+	}
+
+	PatchBVH3d PatchBVH3d::create(const std::vector<AABB3d>& bounds, int leafSize) {
+		MN_INSTRUMENT_TIMER(BVHBuild);
+		PatchBVH3d bvh;
+		bvh.build(bounds, leafSize);
+		return bvh;
+	}
+	PatchBVH3d PatchBVH3d::create(const BsplineCurve3d& curve, int leafSize) {
+		std::vector<AABB3d> bounds;
+		calPatchBounds(curve, bounds);
+		return create(bounds, leafSize);
+	}
+	PatchBVH3d PatchBVH3d::create(const BsplineSurface3d& surface, int leafSize) {
+		std::vector<AABB3d> bounds;
+		calPatchBounds(surface, bounds);
+		return create(bounds, leafSize);
+	}
+	PatchBVH3d PatchBVH3d::create(const BsplineVolume3d& volume, int leafSize) {
+		std::vector<AABB3d> bounds;
+		calPatchBounds(volume, bounds);
+		return create(bounds, leafSize);
+	}
+
+	void PatchBVH3d::refit(const BsplineCurve3d& curve) {
+		std::vector<AABB3d> bounds;
+		calPatchBounds(curve, bounds);
+		refit(bounds);
+	}
+	void PatchBVH3d::refit(const BsplineSurface3d& surface) {
+		std::vector<AABB3d> bounds;
+		calPatchBounds(surface, bounds);
+		refit(bounds);
+	}
+	void PatchBVH3d::refit(const BsplineVolume3d& volume) {
+		std::vector<AABB3d> bounds;
+		calPatchBounds(volume, bounds);
+		refit(bounds);
+	}
+	void PatchBVH3d::refit(const BsplineSurface3d& surface, const std::vector<int>& editedPatches) {
+		if (surface.patches.size() != bounds.size())
+			throw(std::runtime_error("Number of patches must not change in BVH refit"));
+		for (int patch : editedPatches)
+			refit(patch, calPatchBound(*surface.patches[patch].patch));
+	}
+
+	// PatchBVH2d
+	AABB2d PatchBVH2d::calPatchBound(const BezierCurve2d& curve) {
+		return AABB2d::create(curve.getCptsC());
+	}
+	AABB2d PatchBVH2d::calPatchBound(const BezierSurface2d& surface) {
+		AABB2d bound = AABB2d::create();
+		for (const auto& row : surface.getCptsC())
+			for (const auto& cpt : row)
+				bound.expand(cpt);
+		return bound;
+	}
+	void PatchBVH2d::calPatchBounds(const BsplineCurve2d& curve, std::vector<AABB2d>& bounds) {
+		const auto& patches = curve.getPatchVectorC();
+		bounds.resize(patches.size());
+		Parallel::forEach(0, (int)patches.size(), [&](int i) {
+			bounds[i] = calPatchBound(*patches[i].curve);
+		}, boundGrain);
+	}
+	void PatchBVH2d::calPatchBounds(const BsplineSurface2d& surface, std::vector<AABB2d>& bounds) {
+		const auto& patches = surface.patches;
+		bounds.resize(patches.size());
+		Parallel::forEach(0, (int)patches.size(), [&](int i) {
+			bounds[i] = calPatchBound(*patches[i].patch);
+		}, boundGrain);
+	}
+
+	PatchBVH2d PatchBVH2d::create(const std::vector<AABB2d>& bounds, int leafSize) {
+		MN_INSTRUMENT_TIMER(BVHBuild);
+		PatchBVH2d bvh;
+		bvh.build(bounds, leafSize);
+		return bvh;
+	}
+	PatchBVH2d PatchBVH2d::create(const BsplineCurve2d& curve, int leafSize) {
+		std::vector<AABB2d> bounds;
+		calPatchBounds(curve, bounds);
+		return create(bounds, leafSize);
+	}
+	PatchBVH2d PatchBVH2d::create(const BsplineSurface2d& surface, int leafSize) {
+		std::vector<AABB2d> bounds;
+		calPatchBounds(surface, bounds);
+		return create(bounds, leafSize);
+	}
+
+	void PatchBVH2d::refit(const BsplineCurve2d& curve) {
+		std::vector<AABB2d> bounds;
+		calPatchBounds(curve, bounds);
+		refit(bounds);
+	}
+	void PatchBVH2d::refit(const BsplineSurface2d& surface) {
+		std::vector<AABB2d> bounds;
+		calPatchBounds(surface, bounds);
+		refit(bounds);
+	}
+}
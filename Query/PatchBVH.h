@@ -0,0 +1,374 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_PATCH_BVH_H__
+#define __MN_PATCH_BVH_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "../Parallel.h"
+#include "../Curve/BsplineCurve2d.h"
+#include "../Curve/BsplineCurve3d.h"
+#include "../Surface/BsplineSurface2d.h"
+#include "../Surface/BsplineSurface3d.h"
+#include "../Volume/BsplineVolume3d.h"
+#include "AABB.h"
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace MN {
+	/*
+	 * Bounding volume hierarchy over primitives given by their bounds.
+	 * Tree is built top-down by median split along longest axis of primitive centers.
+	 * @Box : Type of bound, e.g) AABB2d, AABB3d
+	 */
+	template<typename Box>
+	class BVH {
+	public:
+		class Node {
+		public:
+			Box bound;
+			int left = -1;		// Index of left child, -1 for leaf
+			int right = -1;		// Index of right child, -1 for leaf
+			int parent = -1;	// Index of parent, -1 for root
+			int beg = 0;		// Range of [ order ] that this node covers
+			int end = 0;
+
+			inline bool isLeaf() const noexcept {
+				return left < 0;
+			}
+		};
+		// Maximum depth of traversal stack, which is enough for balanced tree of median split
+		const static int maxStack = 128;
+		const static int parallelBuildSize = 4096;	// Primitives below which tree is built serially
+		const static int deferDepth = 4;			// Depth of subtrees built in parallel, i.e) 16 subtrees
+	protected:
+		std::vector<Node> nodes;	// Root is nodes[0], and every child comes after its parent
+		std::vector<int> order;		// Primitive indices permuted so that every node covers contiguous range
+		std::vector<int> leafOf;	// Index of leaf node that holds each primitive
+		std::vector<Box> bounds;	// Bound of each primitive
+		int leafSize = 4;
+
+		// Number of nodes of subtree over [num] primitives, which depends only on [num]
+		inline int countNodes(int num) const noexcept {
+			if (num <= leafSize)
+				return 1;
+			return 1 + countNodes(num / 2) + countNodes(num - num / 2);
+		}
+		// Subtree left to be built later, at [ index ] with its parent already linked
+		class Subtree {
+		public:
+			int index, parent, beg, end;
+		};
+		// Top levels are split here, and subtrees below [ deferDepth ] are appended to [deferred] when it is given
+		inline void buildNode(int index, int parent, int beg, int end, int depth, const std::vector<Real>& centers, int dim, std::vector<Subtree>* deferred) {
+			if (deferred && depth == deferDepth) {
+				deferred->push_back({ index, parent, beg, end });
+				return;
+			}
+			Node& node = nodes[index];
+			node.parent = parent;
+			node.beg = beg;
+			node.end = end;
+			node.bound = Box::create();
+			Box centerBound = Box::create();
+			for (int i = beg; i < end; i++) {
+				node.bound.expand(bounds[order[i]]);
+				centerBound.expand(bounds[order[i]].center());
+			}
+			if (end - beg <= leafSize) {
+				for (int i = beg; i < end; i++)
+					leafOf[order[i]] = index;
+				return;
+			}
+
+			int axis = centerBound.longestAxis();
+			int mid = beg + (end - beg) / 2;
+			std::nth_element(order.begin() + beg, order.begin() + mid, order.begin() + end, [&](int a, int b) {
+				return centers[(size_t)a * dim + axis] < centers[(size_t)b * dim + axis];
+			});
+			node.left = index + 1;
+			node.right = index + 1 + countNodes(mid - beg);
+
+			int left = node.left, right = node.right;
+			buildNode(left, index, beg, mid, depth + 1, centers, dim, deferred);
+			buildNode(right, index, mid, end, depth + 1, centers, dim, deferred);
+		}
+		inline void build(const std::vector<Box>& bounds, int leafSize) {
+			if (leafSize < 1)
+				throw(std::runtime_error("Invalid leaf size for BVH"));
+			this->leafSize = leafSize;
+			this->bounds = bounds;
+
+			int num = (int)bounds.size();
+			nodes.clear();
+			order.resize(num);
+			leafOf.assign(num, -1);
+			if (num == 0)
+				return;
+
+			const int dim = Box::dim;
+			std::vector<Real> centers((size_t)num * dim);
+			for (int i = 0; i < num; i++) {
+				order[i] = i;
+				auto center = bounds[i].center();
+				for (int d = 0; d < dim; d++)
+					centers[(size_t)i * dim + d] = center[d];
+			}
+			nodes.resize(countNodes(num));
+			if (num <= parallelBuildSize) {
+				buildNode(0, -1, 0, num, 0, centers, dim, nullptr);
+				return;
+			}
+			// Subtrees write disjoint ranges of [ nodes ], [ order ] and [ leafOf ], so that they are built in one parallel loop
+			std::vector<Subtree> subtrees;
+			buildNode(0, -1, 0, num, 0, centers, dim, &subtrees);
+			Parallel::forEach(0, (int)subtrees.size(), [&](int i) {
+				const Subtree& sub = subtrees[i];
+				buildNode(sub.index, sub.parent, sub.beg, sub.end, deferDepth, centers, dim, nullptr);
+			});
+		}
+	public:
+		inline static BVH create(const std::vector<Box>& bounds, int leafSize = 4) {
+			BVH bvh;
+			bvh.build(bounds, leafSize);
+			return bvh;
+		}
+
+		inline const std::vector<Node>& getNodes() const noexcept {
+			return nodes;
+		}
+		inline const std::vector<int>& getOrder() const noexcept {
+			return order;
+		}
+		inline const std::vector<Box>& getBounds() const noexcept {
+			return bounds;
+		}
+		inline int size() const noexcept {
+			return (int)bounds.size();
+		}
+		inline const Box& getRootBound() const {
+			if (nodes.empty())
+				throw(std::runtime_error("Empty BVH has no root"));
+			return nodes[0].bound;
+		}
+
+		// Update bounds of every node for new primitive bounds, keeping tree topology
+		inline void refit(const std::vector<Box>& bounds) {
+			if (bounds.size() != this->bounds.size())
+				throw(std::runtime_error("Number of bounds must not change in BVH refit"));
+			this->bounds = bounds;
+			// Children come after parents, so reverse sweep updates children first
+			for (int i = (int)nodes.size() - 1; i >= 0; i--) {
+				Node& node = nodes[i];
+				node.bound = Box::create();
+				if (node.isLeaf()) {
+					for (int j = node.beg; j < node.end; j++)
+						node.bound.expand(this->bounds[order[j]]);
+				}
+				else {
+					node.bound.expand(nodes[node.left].bound);
+					node.bound.expand(nodes[node.right].bound);
+				}
+			}
+		}
+		// Update bound of one primitive and its ancestors only
+		inline void refit(int primitive, const Box& bound) {
+			if (primitive < 0 || primitive >= (int)bounds.size())
+				throw(std::runtime_error("Invalid primitive index for BVH refit"));
+			bounds[primitive] = bound;
+			int index = leafOf[primitive];
+			Node& leaf = nodes[index];
+			leaf.bound = Box::create();
+			for (int j = leaf.beg; j < leaf.end; j++)
+				leaf.bound.expand(bounds[order[j]]);
+			for (index = leaf.parent; index >= 0; index = nodes[index].parent) {
+				Node& node = nodes[index];
+				node.bound = nodes[node.left].bound;
+				node.bound.expand(nodes[node.right].bound);
+			}
+		}
+
+		// Visit every primitive whose node bounds pass [ test(const Box&) ]
+		// Traversal stops when [ visit(int primitive) ] returns false
+		template<typename Test, typename Visit>
+		inline void traverse(const Test& test, const Visit& visit) const {
+			if (nodes.empty())
+				return;
+			int stack[maxStack];
+			int top = 0;
+			stack[top++] = 0;
+			while (top > 0) {
+				const Node& node = nodes[stack[--top]];
+				if (!test(node.bound))
+					continue;
+				if (node.isLeaf()) {
+					for (int i = node.beg; i < node.end; i++) {
+						int primitive = order[i];
+						if (test(bounds[primitive]) && !visit(primitive))
+							return;
+					}
+				}
+				else {
+					stack[top++] = node.right;
+					stack[top++] = node.left;
+				}
+			}
+		}
+		// Indices of primitives whose bounds overlap [box]
+		inline void query(const Box& box, std::vector<int>& result) const {
+			result.clear();
+			traverse(
+				[&](const Box& bound) { return bound.overlap(box); },
+				[&](int primitive) { result.push_back(primitive); return true; });
+		}
+
+		// Best-first traversal for nearest-type queries, e.g) closest point, first ray hit
+		// [ key(const Box&) ] returns lower bound of query value in the box, and [ visit(int primitive) ] returns current best value
+		// Nodes whose key is not less than current best value are pruned, and nearer child is visited first
+		template<typename Key, typename Visit>
+		inline void traverseNearest(const Key& key, const Visit& visit) const {
+			if (nodes.empty())
+				return;
+			Real best = std::numeric_limits<Real>::max();
+			std::pair<int, Real> stack[maxStack];
+			int top = 0;
+			stack[top++] = { 0, key(nodes[0].bound) };
+			while (top > 0) {
+				auto item = stack[--top];
+				if (item.second >= best)
+					continue;
+				const Node& node = nodes[item.first];
+				if (node.isLeaf()) {
+					for (int i = node.beg; i < node.end; i++) {
+						int primitive = order[i];
+						if (key(bounds[primitive]) < best)
+							best = std::min(best, visit(primitive));
+					}
+				}
+				else {
+					Real
+						leftKey = key(nodes[node.left].bound),
+						rightKey = key(nodes[node.right].bound);
+					if (leftKey < rightKey) {
+						if (rightKey < best)
+							stack[top++] = { node.right, rightKey };
+						if (leftKey < best)
+							stack[top++] = { node.left, leftKey };
+					}
+					else {
+						if (leftKey < best)
+							stack[top++] = { node.left, leftKey };
+						if (rightKey < best)
+							stack[top++] = { node.right, rightKey };
+					}
+				}
+			}
+		}
+
+		// Visit every pair of primitives from [a] and [b] whose bounds overlap, by simultaneous descent
+		// Bounds of [a] are inflated by [margin] before overlap test
+		// Traversal stops when [ visit(int primitiveA, int primitiveB) ] returns false
+		template<typename Visit>
+		inline static void traversePair(const BVH& a, const BVH& b, const Visit& visit, Real margin = 0) {
+			traversePair(a, b, 0, 0, visit, margin);
+		}
+		// Same as above, but starts from given pair of nodes
+		template<typename Visit>
+		inline static void traversePair(const BVH& a, const BVH& b, int nodeA, int nodeB, const Visit& visit, Real margin = 0) {
+			if (a.nodes.empty() || b.nodes.empty())
+				return;
+			auto overlap = [margin](Box boxA, const Box& boxB) {
+				boxA.inflate(margin);
+				return boxA.overlap(boxB);
+			};
+			std::vector<std::pair<int, int>> stack;
+			stack.push_back({ nodeA, nodeB });
+			while (!stack.empty()) {
+				auto item = stack.back();
+				stack.pop_back();
+				const Node& na = a.nodes[item.first];
+				const Node& nb = b.nodes[item.second];
+				if (!overlap(na.bound, nb.bound))
+					continue;
+				if (na.isLeaf() && nb.isLeaf()) {
+					for (int i = na.beg; i < na.end; i++) {
+						int pa = a.order[i];
+						for (int j = nb.beg; j < nb.end; j++) {
+							int pb = b.order[j];
+							if (overlap(a.bounds[pa], b.bounds[pb]) && !visit(pa, pb))
+								return;
+						}
+					}
+				}
+				else if (nb.isLeaf() || (!na.isLeaf() && na.end - na.beg >= nb.end - nb.beg)) {
+					// Descend larger node
+					stack.push_back({ na.right, item.second });
+					stack.push_back({ na.left, item.second });
+				}
+				else {
+					stack.push_back({ item.first, nb.right });
+					stack.push_back({ item.first, nb.left });
+				}
+			}
+		}
+	};
+
+	/*
+	 * BVH over Bezier patches of Bspline entities in 3D space.
+	 * Bound of each patch is box of its control net, which contains the patch by convex hull property.
+	 * Primitive index equals to patch index in [ patchVector ] or [ patches ] of the entity.
+	 */
+	class PatchBVH3d : public BVH<AABB3d> {
+	public:
+		static PatchBVH3d create(const std::vector<AABB3d>& bounds, int leafSize = 4);
+		static PatchBVH3d create(const BsplineCurve3d& curve, int leafSize = 4);
+		static PatchBVH3d create(const BsplineSurface3d& surface, int leafSize = 4);
+		static PatchBVH3d create(const BsplineVolume3d& volume, int leafSize = 4);
+
+		// Refit after control points of patches are edited. Number of patches must not change
+		void refit(const BsplineCurve3d& curve);
+		void refit(const BsplineSurface3d& surface);
+		void refit(const BsplineVolume3d& volume);
+		void refit(const BsplineSurface3d& surface, const std::vector<int>& editedPatches);
+		using BVH<AABB3d>::refit;
+
+		// Control net bounds of every patch, computed in parallel
+		static void calPatchBounds(const BsplineCurve3d& curve, std::vector<AABB3d>& bounds);
+		static void calPatchBounds(const BsplineSurface3d& surface, std::vector<AABB3d>& bounds);
+		static void calPatchBounds(const BsplineVolume3d& volume, std::vector<AABB3d>& bounds);
+		static AABB3d calPatchBound(const BezierCurve3d& curve);
+		static AABB3d calPatchBound(const BezierSurface3d& surface);
+		static AABB3d calPatchBound(const BezierVolume3d& volume);
+	};
+
+	/*
+	 * BVH over Bezier patches of Bspline entities in 2D space.
+	 */
+	class PatchBVH2d : public BVH<AABB2d> {
+	public:
+		static PatchBVH2d create(const std::vector<AABB2d>& bounds, int leafSize = 4);
+		static PatchBVH2d create(const BsplineCurve2d& curve, int leafSize = 4);
+		static PatchBVH2d create(const BsplineSurface2d& surface, int leafSize = 4);
+
+		void refit(const BsplineCurve2d& curve);
+		void refit(const BsplineSurface2d& surface);
+		using BVH<AABB2d>::refit;
+
+		static void calPatchBounds(const BsplineCurve2d& curve, std::vector<AABB2d>& bounds);
+		static void calPatchBounds(const BsplineSurface2d& surface, std::vector<AABB2d>& bounds);
+		static AABB2d calPatchBound(const BezierCurve2d& curve);
+		static AABB2d calPatchBound(const BezierSurface2d& surface);
+	};
+}
+
+#endif
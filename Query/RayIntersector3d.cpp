@@ -0,0 +1,397 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "RayIntersector3d.h"
+#include "../Parallel.h"
+
+namespace MN {
+	const static Real eps = 1e-30;			// Guard against division by zero
+	const static Real clipTol = 1e-7;		// Clipping stops when subpatch is narrower than this in both directions
+	const static Real stallRatio = 0.64;	// Subpatch is split when one clipping step keeps more than this ratio of its area
+	const static int maxRefinement = 8;		// Maximum number of Newton iterations after clipping
+
+	static inline Real clamp01(Real t) noexcept {
+		return std::min(std::max(t, 0.0), 1.0);
+	}
+
+	class RayIntersector3d::Ray {
+	public:
+		Vec3 origin;
+		Vec3 dir;
+		Vec3 invDir;
+		Vec3 n1, n2;		// Unit normals of two planes whose intersection is the ray
+		Real invDirSq;		// Converts projection onto [dir] into ray parameter
+		Real tMin;
+
+		static Ray create(const Vec3& origin, const Vec3& dir, Real tMin) {
+			Real lenSq = dir.dot(dir);
+			if (lenSq <= 0.0)
+				throw(std::runtime_error("Ray direction must not be zero"));
+			Ray ray;
+			ray.origin = origin;
+			ray.dir = dir;
+			ray.invDir = Vec3{ 1.0 / dir[0], 1.0 / dir[1], 1.0 / dir[2] };
+			ray.invDirSq = 1.0 / lenSq;
+			ray.tMin = tMin;
+
+			Vec3 unit = dir * (1.0 / sqrt(lenSq));
+			Vec3 axis = (fabs(unit[0]) < 0.9) ? Vec3{ 1, 0, 0 } : Vec3{ 0, 1, 0 };
+			ray.n1 = unit.cross(axis);
+			ray.n1.normalize();
+			ray.n2 = unit.cross(ray.n1);
+			return ray;
+		}
+		// Signed distances to two planes, and ray parameter of projection onto the ray
+		inline void project(const Vec3& point, Real* coords) const noexcept {
+			Vec3 diff = point - origin;
+			coords[0] = n1.dot(diff);
+			coords[1] = n2.dot(diff);
+			coords[2] = dir.dot(diff) * invDirSq;
+		}
+	};
+
+	// Scratch buffers reused over patches of one ray or one packet
+	class RayIntersector3d::ClipWork {
+	public:
+		class Entry {
+		public:
+			Real u0, u1, v0, v1;	// Parameter range of subpatch in patch
+		};
+		std::vector<Entry> entries;	// Subpatches waiting to be clipped
+		std::vector<Real> nets;		// Projected control nets of [ entries ], stacked in the same order
+		std::vector<Real> net;		// Projected control net of subpatch being clipped
+	};
+
+	// Range of parameter in [dir] where convex hull of projected net can meet the ray, false if it cannot at all
+	// Distance is measured from line through the ray that is parallel to the other parameter direction of net
+	static bool calClipRange(const Real* net, int rowNum, int colNum, int dir, Real& a, Real& b) {
+		auto at = [&](int i, int k) { return net + ((size_t)i * colNum + k) * 3; };
+		int n = rowNum - 1, m = colNum - 1;
+		Real lx, ly, ox, oy;	// Other direction, clipping direction
+		if (dir == 0) {
+			lx = (at(0, m)[0] - at(0, 0)[0]) + (at(n, m)[0] - at(n, 0)[0]);
+			ly = (at(0, m)[1] - at(0, 0)[1]) + (at(n, m)[1] - at(n, 0)[1]);
+			ox = (at(n, 0)[0] - at(0, 0)[0]) + (at(n, m)[0] - at(0, m)[0]);
+			oy = (at(n, 0)[1] - at(0, 0)[1]) + (at(n, m)[1] - at(0, m)[1]);
+		}
+		else {
+			lx = (at(n, 0)[0] - at(0, 0)[0]) + (at(n, m)[0] - at(0, m)[0]);
+			ly = (at(n, 0)[1] - at(0, 0)[1]) + (at(n, m)[1] - at(0, m)[1]);
+			ox = (at(0, m)[0] - at(0, 0)[0]) + (at(n, m)[0] - at(n, 0)[0]);
+			oy = (at(0, m)[1] - at(0, 0)[1]) + (at(n, m)[1] - at(n, 0)[1]);
+		}
+		Real nx = -ly, ny = lx;
+		if (nx * nx + ny * ny <= eps) {
+			// Degenerate other direction, measure along clipping direction instead
+			nx = ox;
+			ny = oy;
+			if (nx * nx + ny * ny <= eps) {
+				nx = 1.0;
+				ny = 0.0;
+			}
+		}
+
+		// Distance range of each control point line perpendicular to clipping direction
+		int num = (dir == 0) ? rowNum : colNum, other = (dir == 0) ? colNum : rowNum;
+		Real lo[Bezier::maxDegree + 1], hi[Bezier::maxDegree + 1];
+		for (int i = 0; i < num; i++) {
+			lo[i] = std::numeric_limits<Real>::max();
+			hi[i] = std::numeric_limits<Real>::lowest();
+			for (int k = 0; k < other; k++) {
+				const Real* p = (dir == 0) ? at(i, k) : at(k, i);
+				Real d = nx * p[0] + ny * p[1];
+				lo[i] = std::min(lo[i], d);
+				hi[i] = std::max(hi[i], d);
+			}
+		}
+		int degree = num - 1;
+		if (degree == 0) {
+			a = 0.0;
+			b = 1.0;
+			return lo[0] <= 0.0 && hi[0] >= 0.0;
+		}
+
+		// Intersection of convex hull with zero line is spanned by crossings of every pair of hull points
+		a = std::numeric_limits<Real>::max();
+		b = std::numeric_limits<Real>::lowest();
+		for (int i = 0; i < num; i++) {
+			Real xi = (Real)i / degree;
+			if (lo[i] <= 0.0 && hi[i] >= 0.0) {
+				a = std::min(a, xi);
+				b = std::max(b, xi);
+			}
+			for (int k = i + 1; k < num; k++) {
+				Real xk = (Real)k / degree;
+				Real yi[2] = { lo[i], hi[i] }, yk[2] = { lo[k], hi[k] };
+				for (int s = 0; s < 2; s++) {
+					for (int r = 0; r < 2; r++) {
+						if ((yi[s] < 0.0 && yk[r] > 0.0) || (yi[s] > 0.0 && yk[r] < 0.0)) {
+							Real x = xi + (xk - xi) * yi[s] / (yi[s] - yk[r]);
+							a = std::min(a, x);
+							b = std::max(b, x);
+						}
+					}
+				}
+			}
+		}
+		if (a > b)
+			return false;
+		a = clamp01(a);
+		b = clamp01(b);
+		return true;
+	}
+	// Restrict projected net to [a, b] of parameter in [dir], by de Casteljau's algorithm in place
+	static void clipNet(Real* net, int rowNum, int colNum, int dir, Real a, Real b) {
+		int num = (dir == 0) ? rowNum : colNum, lines = (dir == 0) ? colNum : rowNum;
+		int n = num - 1;
+		size_t stride = (dir == 0) ? (size_t)colNum * 3 : 3;
+		Real s = (b > 0.0) ? a / b : 0.0;
+		for (int line = 0; line < lines; line++) {
+			Real* p = (dir == 0) ? net + (size_t)line * 3 : net + (size_t)line * colNum * 3;
+			// Lower part [0, b]
+			for (int r = 1; r <= n; r++)
+				for (int i = n; i >= r; i--)
+					for (int c = 0; c < 3; c++)
+						p[i * stride + c] = (1.0 - b) * p[(i - 1) * stride + c] + b * p[i * stride + c];
+			// Upper part [a / b, 1] of it
+			if (s > 0.0) {
+				for (int r = 1; r <= n; r++)
+					for (int i = 0; i <= n - r; i++)
+						for (int c = 0; c < 3; c++)
+							p[i * stride + c] = (1.0 - s) * p[i * stride + c] + s * p[(i + 1) * stride + c];
+			}
+		}
+	}
+
+	RayIntersector3d RayIntersector3d::create(const BsplineSurface3d::Ptr& surface, int leafSize) {
+		RayIntersector3d intersector;
+		intersector.surface = surface;
+		intersector.bvh = PatchBVH3d::create(*surface, leafSize);
+		return intersector;
+	}
+	RayIntersector3d::Ptr RayIntersector3d::createPtr(const BsplineSurface3d::Ptr& surface, int leafSize) {
+		return std::make_shared<RayIntersector3d>(create(surface, leafSize));
+	}
+	void RayIntersector3d::refit() {
+		bvh.refit(*surface);
+	}
+	void RayIntersector3d::intersectPatch(int index, const Ray& ray, Hit& hit, ClipWork& work) const {
+		const auto& patch = surface->patches[index];
+		const BezierSurface3d& bezier = *patch.patch;
+		const auto& cpts = bezier.getCptsC();
+		int rowNum = bezier.getDegree(0) + 1, colNum = bezier.getDegree(1) + 1;
+		size_t netSize = (size_t)rowNum * colNum * 3;
+		Real hitTol = tolerance * bvh.getBounds()[index].extent().len();
+
+		work.entries.clear();
+		work.entries.push_back({ 0.0, 1.0, 0.0, 1.0 });
+		if (work.nets.size() < netSize)
+			work.nets.resize(netSize);
+		for (int i = 0; i < rowNum; i++)
+			for (int k = 0; k < colNum; k++)
+				ray.project(cpts[i][k], &work.nets[((size_t)i * colNum + k) * 3]);
+
+		// Newton iteration on distances to two planes, starting from converged subpatch
+		auto refine = [&](Real u, Real v) {
+			auto residual = [&](const Freeform3ds::Jet& j) {
+				Vec3 diff = j.S - ray.origin;
+				return Vec3{ ray.n1.dot(diff), ray.n2.dot(diff), 0.0 };
+			};
+			Freeform3ds::Jet j = bezier.jet(u, v);
+			Vec3 F = residual(j);
+			for (int it = 0; it < maxRefinement; it++) {
+				Real
+					a = ray.n1.dot(j.Su), b = ray.n1.dot(j.Sv),
+					c = ray.n2.dot(j.Su), d = ray.n2.dot(j.Sv),
+					det = a * d - b * c;
+				if (fabs(det) <= eps)
+					break;
+				Real
+					nu = clamp01(u - (d * F[0] - b * F[1]) / det),
+					nv = clamp01(v - (a * F[1] - c * F[0]) / det);
+				Freeform3ds::Jet nj = bezier.jet(nu, nv);
+				Vec3 nF = residual(nj);
+				if (nF.dot(nF) >= F.dot(F))
+					break;
+				u = nu;
+				v = nv;
+				j = nj;
+				F = nF;
+			}
+			if (F.dot(F) > hitTol * hitTol)
+				return;
+			Real t = ray.dir.dot(j.S - ray.origin) * ray.invDirSq;
+			if (t < ray.tMin || t >= hit.t)
+				return;
+			hit.t = t;
+			hit.u = patch.uSubdomain.beg() + u * patch.uSubdomain.width();
+			hit.v = patch.vSubdomain.beg() + v * patch.vSubdomain.width();
+			hit.point = j.S;
+			hit.normal = j.Su.cross(j.Sv);
+			hit.normal.normalize();
+			hit.patch = index;
+			hit.hit = true;
+		};
+
+		while (!work.entries.empty()) {
+			ClipWork::Entry entry = work.entries.back();
+			work.entries.pop_back();
+			auto source = work.nets.begin() + work.entries.size() * netSize;
+			work.net.assign(source, source + netSize);
+			Real* net = work.net.data();
+
+			for (int it = 0; it < maxIteration; it++) {
+				// Subpatch farther than current hit, or behind the ray, is culled by range of ray parameter
+				Real tLo = std::numeric_limits<Real>::max(), tHi = std::numeric_limits<Real>::lowest();
+				for (size_t i = 2; i < netSize; i += 3) {
+					tLo = std::min(tLo, net[i]);
+					tHi = std::max(tHi, net[i]);
+				}
+				if (tHi < ray.tMin || tLo >= hit.t)
+					break;
+
+				Real
+					uWidth = entry.u1 - entry.u0,
+					vWidth = entry.v1 - entry.v0;
+				if (uWidth <= clipTol && vWidth <= clipTol) {
+					refine((entry.u0 + entry.u1) * 0.5, (entry.v0 + entry.v1) * 0.5);
+					break;
+				}
+				Real a, b;
+				if (uWidth > clipTol) {
+					if (!calClipRange(net, rowNum, colNum, 0, a, b))
+						break;
+					clipNet(net, rowNum, colNum, 0, a, b);
+					entry.u1 = entry.u0 + b * uWidth;
+					entry.u0 = entry.u0 + a * uWidth;
+				}
+				if (vWidth > clipTol) {
+					if (!calClipRange(net, rowNum, colNum, 1, a, b))
+						break;
+					clipNet(net, rowNum, colNum, 1, a, b);
+					entry.v1 = entry.v0 + b * vWidth;
+					entry.v0 = entry.v0 + a * vWidth;
+				}
+
+				// Clipping stalls when several hits remain in subpatch, then split it in longer direction
+				Real
+					newUWidth = entry.u1 - entry.u0,
+					newVWidth = entry.v1 - entry.v0;
+				if (newUWidth * newVWidth > stallRatio * uWidth * vWidth) {
+					int dir = (newUWidth >= newVWidth) ? 0 : 1;
+					size_t offset = work.entries.size() * netSize;
+					if (work.nets.size() < offset + netSize)
+						work.nets.resize(offset + netSize);
+					std::copy(net, net + netSize, work.nets.begin() + offset);
+					clipNet(&work.nets[offset], rowNum, colNum, dir, 0.5, 1.0);
+					clipNet(net, rowNum, colNum, dir, 0.0, 0.5);
+
+					ClipWork::Entry upper = entry;
+					if (dir == 0) {
+						upper.u0 = entry.u1 = (entry.u0 + entry.u1) * 0.5;
+					}
+					else {
+						upper.v0 = entry.v1 = (entry.v0 + entry.v1) * 0.5;
+					}
+					work.entries.push_back(upper);
+				}
+			}
+		}
+	}
+	RayIntersector3d::Hit RayIntersector3d::intersectRay(const Vec3& origin, const Vec3& dir, Real tMin, Real tMax) const {
+		MN_INSTRUMENT_TIMER(RayIntersect);
+		Ray ray = Ray::create(origin, dir, tMin);
+		Hit hit;
+		hit.t = tMax;
+		ClipWork work;
+		bvh.traverseNearest(
+			[&](const AABB3d& bound) {
+				Real tEnter;
+				if (bound.intersectRay(ray.origin, ray.invDir, tMin, hit.t, tEnter))
+					return tEnter;
+				return std::numeric_limits<Real>::max();
+			},
+			[&](int index) {
+				intersectPatch(index, ray, hit, work);
+				return hit.t;
+			});
+		if (!hit.hit)
+			hit.t = std::numeric_limits<Real>::max();
+		return hit;
+	}
+	void RayIntersector3d::intersectPacket(const Vec3* origins, const Vec3* dirs, int count, Real tMin, Real tMax, Hit* hits, ClipWork& work) const {
+		MN_INSTRUMENT_TIMER(RayIntersect);
+		const auto& nodes = bvh.getNodes();
+		const auto& order = bvh.getOrder();
+		const auto& bounds = bvh.getBounds();
+		if (nodes.empty())
+			return;
+		Ray rays[packetSize];
+		for (int r = 0; r < count; r++) {
+			rays[r] = Ray::create(origins[r], dirs[r], tMin);
+			hits[r] = Hit();
+			hits[r].t = tMax;
+		}
+
+		// Every ray shares one traversal, and node is entered when any ray of the packet may hit inside it
+		int stack[PatchBVH3d::maxStack];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const auto& node = nodes[stack[--top]];
+			bool active = false;
+			for (int r = 0; r < count && !active; r++) {
+				Real tEnter;
+				active = node.bound.intersectRay(rays[r].origin, rays[r].invDir, tMin, hits[r].t, tEnter);
+			}
+			if (!active)
+				continue;
+			if (node.isLeaf()) {
+				for (int i = node.beg; i < node.end; i++) {
+					int primitive = order[i];
+					for (int r = 0; r < count; r++) {
+						Real tEnter;
+						if (bounds[primitive].intersectRay(rays[r].origin, rays[r].invDir, tMin, hits[r].t, tEnter))
+							intersectPatch(primitive, rays[r], hits[r], work);
+					}
+				}
+			}
+			else {
+				// Nearer child along first ray is visited first
+				const auto& left = nodes[node.left].bound;
+				const auto& right = nodes[node.right].bound;
+				Real
+					leftDist = rays[0].dir.dot(left.center() - rays[0].origin),
+					rightDist = rays[0].dir.dot(right.center() - rays[0].origin);
+				if (leftDist < rightDist) {
+					stack[top++] = node.right;
+					stack[top++] = node.left;
+				}
+				else {
+					stack[top++] = node.left;
+					stack[top++] = node.right;
+				}
+			}
+		}
+		for (int r = 0; r < count; r++)
+			if (!hits[r].hit)
+				hits[r].t = std::numeric_limits<Real>::max();
+	}
+	void RayIntersector3d::intersectRays(const std::vector<Vec3>& origins, const std::vector<Vec3>& dirs, std::vector<Hit>& hits, Real tMin, Real tMax) const {
+		if (origins.size() != dirs.size())
+			throw(std::runtime_error("Number of ray origins and directions must be same"));
+		int num = (int)origins.size();
+		hits.resize(num);
+		Parallel::forEach(0, (num + packetSize - 1) / packetSize, [&](int packet) {
+			ClipWork work;
+			int beg = packet * packetSize;
+			int count = std::min(packetSize, num - beg);
+			intersectPacket(&origins[beg], &dirs[beg], count, tMin, tMax, &hits[beg], work);
+		});
+	}
+}
@@ -0,0 +1,93 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_RAY_INTERSECTOR_3D_H__
+#define __MN_RAY_INTERSECTOR_3D_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "../Surface/BsplineSurface3d.h"
+#include "PatchBVH.h"
+#include <limits>
+#include <memory>
+
+namespace MN {
+	/*
+	 * First hit of ray [ origin + t * dir ] on Bspline surface, without tessellation.
+	 * Patches are visited front-to-back through patch BVH, and each hit patch is solved by Bezier clipping.
+	 * Ray is regarded as intersection of two planes, and control net is projected onto their distances.
+	 * Parameter ranges where convex hull of projected net cannot reach zero are clipped away alternately in u and v,
+	 * and patch is split in half when clipping stalls, which happens around multiple intersections.
+	 * Converged parameter is polished with Newton iteration on original patch.
+	 */
+	class RayIntersector3d {
+	public:
+		class Hit {
+		public:
+			Real t = std::numeric_limits<Real>::max();	// Ray parameter of hit point
+			Real u = 0;					// Surface parameter of hit point
+			Real v = 0;
+			Vec3 point;
+			Vec3 normal;				// Unit normal of surface at hit point
+			int patch = -1;				// Index of hit patch
+			bool hit = false;
+		};
+		using Ptr = std::shared_ptr<RayIntersector3d>;
+
+		// Rays handled together in one packet traversal
+		const static int packetSize = 64;
+	private:
+		class Ray;
+		class ClipWork;
+
+		RayIntersector3d() = default;
+
+		BsplineSurface3d::Ptr surface = nullptr;
+		PatchBVH3d bvh;
+		Real tolerance = 1e-9;		// Hit is accepted when its distance to ray is smaller than this, relative to size of patch
+		int maxIteration = 64;		// Maximum number of clipping steps for one subpatch
+
+		// Update [hit] when ray hits patch nearer than [ hit.t ]
+		void intersectPatch(int index, const Ray& ray, Hit& hit, ClipWork& work) const;
+		void intersectPacket(const Vec3* origins, const Vec3* dirs, int count, Real tMin, Real tMax, Hit* hits, ClipWork& work) const;
+	public:
+		static RayIntersector3d create(const BsplineSurface3d::Ptr& surface, int leafSize = 4);
+		static Ptr createPtr(const BsplineSurface3d::Ptr& surface, int leafSize = 4);
+
+		// Call after control points of surface patches are edited
+		void refit();
+
+		inline void setTolerance(Real tolerance) noexcept {
+			this->tolerance = tolerance;
+		}
+		inline Real getTolerance() const noexcept {
+			return tolerance;
+		}
+		inline void setMaxIteration(int maxIteration) noexcept {
+			this->maxIteration = maxIteration;
+		}
+		inline int getMaxIteration() const noexcept {
+			return maxIteration;
+		}
+		inline const PatchBVH3d& getBVH() const noexcept {
+			return bvh;
+		}
+
+		// Only hits with t in [tMin, tMax] are reported
+		Hit intersectRay(const Vec3& origin, const Vec3& dir, Real tMin = 0, Real tMax = std::numeric_limits<Real>::max()) const;
+		// Consecutive rays are grouped into packets that share BVH traversal, so coherent rays should be adjacent
+		// Packets run in parallel
+		void intersectRays(const std::vector<Vec3>& origins, const std::vector<Vec3>& dirs, std::vector<Hit>& hits,
+			Real tMin = 0, Real tMax = std::numeric_limits<Real>::max()) const;
+	};
+}
+
+#endif
@@ -0,0 +1,529 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "SurfaceIntersector3d.h"
+#include "../Parallel.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace MN {
+	const static Real eps = 1e-30;			// Guard against division by zero
+	const static Real singularTol = 1e-12;	// Linear system is regarded as singular when its pivot is smaller than this, relative to largest entry
+	const static Real minStepRatio = 1e-4;	// Marching stops when step is halved below this ratio of maximum step
+	const static Real growth = 1.5;			// Step grows by this factor after smooth step
+	const static int maxSeedDepth = 10;		// Maximum number of splits of one patch pair while finding seeds
+	const static int pairChunk = 16;		// Number of candidate patch pairs handled by one thread, sharing scratch buffer
+
+	// Parameters on both surfaces, in order of uA, vA, uB, vB
+	class SurfaceIntersector3d::Point {
+	public:
+		Real param[4];
+		Vec3 position;
+		Vec3 tangent;		// Unit tangent of intersection curve
+	};
+	class SurfaceIntersector3d::Seed {
+	public:
+		Real param[4];
+	};
+
+	// Solve n x n system [A | b] by Gaussian elimination with partial pivoting, false if singular
+	template<int n>
+	static bool solveLinear(Real (&A)[n][n + 1], Real* x) {
+		Real scale = 0;
+		for (int i = 0; i < n; i++)
+			for (int k = 0; k < n; k++)
+				scale = std::max(scale, fabs(A[i][k]));
+		if (scale <= eps)
+			return false;
+		for (int i = 0; i < n; i++) {
+			int pivot = i;
+			for (int k = i + 1; k < n; k++)
+				if (fabs(A[k][i]) > fabs(A[pivot][i]))
+					pivot = k;
+			if (fabs(A[pivot][i]) <= singularTol * scale)
+				return false;
+			for (int l = 0; l <= n; l++)
+				std::swap(A[i][l], A[pivot][l]);
+			for (int k = i + 1; k < n; k++) {
+				Real ratio = A[k][i] / A[i][i];
+				for (int l = i; l <= n; l++)
+					A[k][l] -= ratio * A[i][l];
+			}
+		}
+		for (int i = n - 1; i >= 0; i--) {
+			Real sum = A[i][n];
+			for (int k = i + 1; k < n; k++)
+				sum -= A[i][k] * x[k];
+			x[i] = sum / A[i][i];
+		}
+		return true;
+	}
+
+	// Restrict control net of [rowNum] x [colNum] points to [a, b] in direction [dir] by de Casteljau's algorithm in place
+	static void extractNet(Real* net, int rowNum, int colNum, int dir, Real a, Real b) {
+		int lineNum = (dir == 0) ? colNum : rowNum;
+		int n = ((dir == 0) ? rowNum : colNum) - 1;
+		size_t stride = (dir == 0) ? (size_t)colNum * 3 : 3;
+		size_t lineStride = (dir == 0) ? 3 : (size_t)colNum * 3;
+		Real s = (b > 0.0) ? a / b : 0.0;
+		for (int line = 0; line < lineNum; line++) {
+			Real* p = net + line * lineStride;
+			for (int r = 1; r <= n; r++)
+				for (int i = n; i >= r; i--)
+					for (int d = 0; d < 3; d++)
+						p[i * stride + d] = (1.0 - b) * p[(i - 1) * stride + d] + b * p[i * stride + d];
+			if (s > 0.0) {
+				for (int r = 1; r <= n; r++)
+					for (int i = 0; i <= n - r; i++)
+						for (int d = 0; d < 3; d++)
+							p[i * stride + d] = (1.0 - s) * p[i * stride + d] + s * p[(i + 1) * stride + d];
+			}
+		}
+	}
+	static AABB3d calNetBound(const Real* net, int num) {
+		AABB3d bound = AABB3d::create();
+		for (int i = 0; i < num; i++)
+			bound.expand(Vec3{ net[i * 3], net[i * 3 + 1], net[i * 3 + 2] });
+		return bound;
+	}
+	static void flattenNet(const BezierSurface3d& patch, std::vector<Real>& net, int& rowNum, int& colNum) {
+		const auto& cpts = patch.getCptsC();
+		rowNum = (int)cpts.size();
+		colNum = (int)cpts[0].size();
+		net.clear();
+		for (const auto& row : cpts)
+			for (const auto& cpt : row)
+				for (int d = 0; d < 3; d++)
+					net.push_back(cpt[d]);
+	}
+
+	// PatchGrid
+	SurfaceIntersector3d::PatchGrid SurfaceIntersector3d::PatchGrid::create(const BsplineSurface3d& surface) {
+		PatchGrid grid;
+		Real uEnd = std::numeric_limits<Real>::lowest(), vEnd = std::numeric_limits<Real>::lowest();
+		for (const auto& patch : surface.patches) {
+			grid.uBreaks.push_back(patch.uSubdomain.beg());
+			grid.vBreaks.push_back(patch.vSubdomain.beg());
+			uEnd = std::max(uEnd, patch.uSubdomain.end());
+			vEnd = std::max(vEnd, patch.vSubdomain.end());
+		}
+		if (surface.patches.empty())
+			throw(std::runtime_error("Cannot intersect Bspline surface without patches"));
+		for (auto* breaks : { &grid.uBreaks, &grid.vBreaks }) {
+			std::sort(breaks->begin(), breaks->end());
+			breaks->erase(std::unique(breaks->begin(), breaks->end()), breaks->end());
+		}
+		grid.uBreaks.push_back(uEnd);
+		grid.vBreaks.push_back(vEnd);
+
+		int uNum = (int)grid.uBreaks.size() - 1, vNum = (int)grid.vBreaks.size() - 1;
+		grid.index.assign((size_t)uNum * vNum, -1);
+		for (int i = 0; i < (int)surface.patches.size(); i++) {
+			const auto& patch = surface.patches[i];
+			int
+				iu = (int)(std::lower_bound(grid.uBreaks.begin(), grid.uBreaks.end(), patch.uSubdomain.beg()) - grid.uBreaks.begin()),
+				iv = (int)(std::lower_bound(grid.vBreaks.begin(), grid.vBreaks.end(), patch.vSubdomain.beg()) - grid.vBreaks.begin());
+			grid.index[(size_t)iu * vNum + iv] = i;
+		}
+		for (int index : grid.index)
+			if (index < 0)
+				throw(std::runtime_error("Patches of Bspline surface do not form a grid"));
+		return grid;
+	}
+	int SurfaceIntersector3d::PatchGrid::find(Real u, Real v) const {
+		int uNum = (int)uBreaks.size() - 1, vNum = (int)vBreaks.size() - 1;
+		int
+			iu = (int)(std::upper_bound(uBreaks.begin(), uBreaks.end(), u) - uBreaks.begin()) - 1,
+			iv = (int)(std::upper_bound(vBreaks.begin(), vBreaks.end(), v) - vBreaks.begin()) - 1;
+		iu = std::min(std::max(iu, 0), uNum - 1);
+		iv = std::min(std::max(iv, 0), vNum - 1);
+		return index[(size_t)iu * vNum + iv];
+	}
+
+	// SurfaceIntersector3d
+	SurfaceIntersector3d SurfaceIntersector3d::create(const BsplineSurface3d::Ptr& surfaceA, const BsplineSurface3d::Ptr& surfaceB, int leafSize) {
+		SurfaceIntersector3d intersector;
+		intersector.surfaceA = surfaceA;
+		intersector.surfaceB = surfaceB;
+		// One after another, as each build is parallel by itself
+		intersector.bvhA = PatchBVH3d::create(*surfaceA, leafSize);
+		intersector.bvhB = PatchBVH3d::create(*surfaceB, leafSize);
+		intersector.gridA = PatchGrid::create(*surfaceA);
+		intersector.gridB = PatchGrid::create(*surfaceB);
+		return intersector;
+	}
+	SurfaceIntersector3d::Ptr SurfaceIntersector3d::createPtr(const BsplineSurface3d::Ptr& surfaceA, const BsplineSurface3d::Ptr& surfaceB, int leafSize) {
+		return std::make_shared<SurfaceIntersector3d>(create(surfaceA, surfaceB, leafSize));
+	}
+	void SurfaceIntersector3d::refit() {
+		bvhA.refit(*surfaceA);
+		bvhB.refit(*surfaceB);
+	}
+	void SurfaceIntersector3d::setMaxStep(Real maxStep) {
+		if (maxStep <= 0.0)
+			throw(std::runtime_error("Maximum step of surface intersection must be positive"));
+		this->maxStep = maxStep;
+	}
+	Real SurfaceIntersector3d::getSize() const noexcept {
+		return std::min(bvhA.getRootBound().extent().len(), bvhB.getRootBound().extent().len());
+	}
+	Freeform3ds::Jet SurfaceIntersector3d::jet(const BsplineSurface3d& surface, const PatchGrid& grid, Real u, Real v) const {
+		const auto& patch = surface.patches[grid.find(u, v)];
+		Real uWidth = patch.uSubdomain.width(), vWidth = patch.vSubdomain.width();
+		Freeform3ds::Jet j = patch.patch->jet((u - patch.uSubdomain.beg()) / uWidth, (v - patch.vSubdomain.beg()) / vWidth);
+		j.Su /= uWidth;
+		j.Sv /= vWidth;
+		j.Suu /= SQ(uWidth);
+		j.Suv /= (uWidth * vWidth);
+		j.Svv /= SQ(vWidth);
+		return j;
+	}
+	void SurfaceIntersector3d::findSeeds(std::vector<Seed>& seeds) const {
+		Real size = getSize();
+		Real distTol = tolerance * size, seedSize = maxStep * size;
+
+		// Broad phase : candidate patch pairs by simultaneous descent of both trees
+		std::vector<std::pair<int, int>> pairs;
+		PatchBVH3d::traversePair(bvhA, bvhB, [&](int a, int b) {
+			pairs.push_back({ a, b });
+			return true;
+		}, distTol);
+		int pairNum = (int)pairs.size();
+		int chunkNum = (pairNum + pairChunk - 1) / pairChunk;
+		std::vector<std::vector<Seed>> chunkSeeds(chunkNum);
+
+		Parallel::forEach(0, chunkNum, [&](int chunk) {
+			class Entry {
+			public:
+				Real range[8];		// Parameter range of subpatches in patch, as [u0, u1, v0, v1] of A and B
+				int depth;
+			};
+			std::vector<Entry> entries;
+			std::vector<Real> nets, netA, netB, cur;
+			int rowA, colA, rowB, colB;
+			const Domain domains[4] = { surfaceA->getDomainC(0), surfaceA->getDomainC(1), surfaceB->getDomainC(0), surfaceB->getDomainC(1) };
+
+			// Solve intersection point nearest to [ param ] by minimum norm Gauss-Newton step of 3 equations in 4 unknowns
+			auto solveSeed = [&](Real* param) {
+				for (int it = 0; it < maxIteration; it++) {
+					Freeform3ds::Jet ja = jet(*surfaceA, gridA, param[0], param[1]);
+					Freeform3ds::Jet jb = jet(*surfaceB, gridB, param[2], param[3]);
+					Vec3 r = ja.S - jb.S;
+					if (r.len() <= distTol)
+						return true;
+					Vec3 J[4] = { ja.Su, ja.Sv, jb.Su * -1.0, jb.Sv * -1.0 };
+					Real M[3][4], y[3];
+					for (int i = 0; i < 3; i++) {
+						for (int k = 0; k < 3; k++) {
+							M[i][k] = 0;
+							for (int l = 0; l < 4; l++)
+								M[i][k] += J[l][i] * J[l][k];
+						}
+						M[i][3] = -r[i];
+					}
+					if (!solveLinear<3>(M, y))
+						return false;
+					Vec3 yv{ y[0], y[1], y[2] };
+					for (int l = 0; l < 4; l++)
+						param[l] += J[l].dot(yv);
+					for (int l = 0; l < 4; l++)
+						param[l] = std::min(std::max(param[l], domains[l].beg()), domains[l].end());
+				}
+				Freeform3ds::Jet ja = jet(*surfaceA, gridA, param[0], param[1]);
+				Freeform3ds::Jet jb = jet(*surfaceB, gridB, param[2], param[3]);
+				return (ja.S - jb.S).len() <= distTol;
+			};
+
+			// Narrow phase : subdivide each pair until subpatches are small enough to seed
+			int end = std::min((chunk + 1) * pairChunk, pairNum);
+			for (int index = chunk * pairChunk; index < end; index++) {
+				const auto& patchA = surfaceA->patches[pairs[index].first];
+				const auto& patchB = surfaceB->patches[pairs[index].second];
+				flattenNet(*patchA.patch, netA, rowA, colA);
+				flattenNet(*patchB.patch, netB, rowB, colB);
+				size_t sizeA = netA.size(), netSize = sizeA + netB.size();
+				entries.clear();
+				entries.push_back({ { 0, 1, 0, 1, 0, 1, 0, 1 }, 0 });
+				nets.resize(std::max(nets.size(), netSize));
+				std::copy(netA.begin(), netA.end(), nets.begin());
+				std::copy(netB.begin(), netB.end(), nets.begin() + sizeA);
+				cur.resize(netSize);
+
+				while (!entries.empty()) {
+					Entry e = entries.back();
+					entries.pop_back();
+					auto source = nets.begin() + entries.size() * netSize;
+					std::copy(source, source + netSize, cur.begin());
+					AABB3d subA = calNetBound(cur.data(), rowA * colA);
+					AABB3d subB = calNetBound(cur.data() + sizeA, rowB * colB);
+					subA.inflate(distTol);
+					if (!subA.overlap(subB))
+						continue;
+					Real extA = subA.extent().len(), extB = subB.extent().len();
+					if ((extA <= seedSize && extB <= seedSize) || e.depth >= maxSeedDepth) {
+						Seed seed;
+						seed.param[0] = patchA.uSubdomain.beg() + (e.range[0] + e.range[1]) * 0.5 * patchA.uSubdomain.width();
+						seed.param[1] = patchA.vSubdomain.beg() + (e.range[2] + e.range[3]) * 0.5 * patchA.vSubdomain.width();
+						seed.param[2] = patchB.uSubdomain.beg() + (e.range[4] + e.range[5]) * 0.5 * patchB.uSubdomain.width();
+						seed.param[3] = patchB.vSubdomain.beg() + (e.range[6] + e.range[7]) * 0.5 * patchB.vSubdomain.width();
+						if (solveSeed(seed.param))
+							chunkSeeds[chunk].push_back(seed);
+						continue;
+					}
+
+					// Split larger subpatch into four
+					bool splitA = extA >= extB;
+					int rowNum = splitA ? rowA : rowB, colNum = splitA ? colA : colB;
+					size_t offset = splitA ? 0 : sizeA;
+					int base = splitA ? 0 : 4;
+					for (int quad = 0; quad < 4; quad++) {
+						size_t target = entries.size() * netSize;
+						if (nets.size() < target + netSize)
+							nets.resize(target + netSize);
+						std::copy(cur.begin(), cur.end(), nets.begin() + target);
+						Real* net = &nets[target + offset];
+						Real
+							ua = (quad & 1) ? 0.5 : 0.0,
+							va = (quad & 2) ? 0.5 : 0.0;
+						extractNet(net, rowNum, colNum, 0, ua, ua + 0.5);
+						extractNet(net, rowNum, colNum, 1, va, va + 0.5);
+						Entry child = e;
+						Real
+							uMid = (e.range[base] + e.range[base + 1]) * 0.5,
+							vMid = (e.range[base + 2] + e.range[base + 3]) * 0.5;
+						if (quad & 1)
+							child.range[base] = uMid;
+						else
+							child.range[base + 1] = uMid;
+						if (quad & 2)
+							child.range[base + 2] = vMid;
+						else
+							child.range[base + 3] = vMid;
+						child.depth = e.depth + 1;
+						entries.push_back(child);
+					}
+				}
+			}
+		});
+		seeds.clear();
+		for (const auto& chunk : chunkSeeds)
+			seeds.insert(seeds.end(), chunk.begin(), chunk.end());
+	}
+	bool SurfaceIntersector3d::correct(Point& point, const Vec3& origin, const Vec3& tangent, Real step, int fixed, Real fixedValue) const {
+		Real distTol = tolerance * getSize();
+		Real* param = point.param;
+		for (int it = 0; it <= maxIteration; it++) {
+			Freeform3ds::Jet ja = jet(*surfaceA, gridA, param[0], param[1]);
+			Freeform3ds::Jet jb = jet(*surfaceB, gridB, param[2], param[3]);
+			Vec3 r = ja.S - jb.S;
+			Real constraint = (fixed < 0) ? (ja.S - origin).dot(tangent) - step : param[fixed] - fixedValue;
+			if (r.len() <= distTol && fabs(constraint) <= distTol) {
+				Vec3 nA = ja.Su.cross(ja.Sv), nB = jb.Su.cross(jb.Sv);
+				Vec3 t = nA.cross(nB);
+				Real tLen = t.len();
+				if (tLen <= 1e-8 * nA.len() * nB.len())
+					return false;
+				point.position = (ja.S + jb.S) * 0.5;
+				point.tangent = t / tLen;
+				return true;
+			}
+			if (it == maxIteration)
+				break;
+
+			// Newton step of 4 equations : S_A - S_B = 0, and constraint = 0
+			Vec3 J[4] = { ja.Su, ja.Sv, jb.Su * -1.0, jb.Sv * -1.0 };
+			Real M[4][5], dx[4];
+			for (int i = 0; i < 3; i++) {
+				for (int l = 0; l < 4; l++)
+					M[i][l] = J[l][i];
+				M[i][4] = -r[i];
+			}
+			for (int l = 0; l < 4; l++)
+				M[3][l] = (fixed < 0) ? ((l < 2) ? J[l].dot(tangent) : 0.0) : ((l == fixed) ? 1.0 : 0.0);
+			M[3][4] = -constraint;
+			if (!solveLinear<4>(M, dx))
+				return false;
+			for (int l = 0; l < 4; l++)
+				param[l] += dx[l];
+		}
+		return false;
+	}
+	bool SurfaceIntersector3d::trace(const Point& seed, Real direction, std::vector<Point>& points, bool& closed) const {
+		Real size = getSize();
+		Real hMax = maxStep * size, hMin = hMax * minStepRatio;
+		const Domain domains[4] = { surfaceA->getDomainC(0), surfaceA->getDomainC(1), surfaceB->getDomainC(0), surfaceB->getDomainC(1) };
+		Real cosAngle = cos(maxAngle);
+
+		points.clear();
+		points.push_back(seed);
+		closed = false;
+		Point cur = seed;
+		Vec3 T = seed.tangent * direction;
+		Real h = hMax;
+		while ((int)points.size() < maxPoints) {
+			// Predictor : first order parameter step moving [h] along tangent on each surface
+			Point next = cur;
+			Freeform3ds::Jet ja = jet(*surfaceA, gridA, cur.param[0], cur.param[1]);
+			Freeform3ds::Jet jb = jet(*surfaceB, gridB, cur.param[2], cur.param[3]);
+			const Freeform3ds::Jet* jets[2] = { &ja, &jb };
+			for (int s = 0; s < 2; s++) {
+				const Vec3& Su = jets[s]->Su;
+				const Vec3& Sv = jets[s]->Sv;
+				Real
+					a = Su.dot(Su), b = Su.dot(Sv), c = Sv.dot(Sv),
+					bu = Su.dot(T) * h, bv = Sv.dot(T) * h;
+				Real det = a * c - b * b;
+				if (det > eps) {
+					next.param[s * 2] += (c * bu - b * bv) / det;
+					next.param[s * 2 + 1] += (a * bv - b * bu) / det;
+				}
+			}
+			if (!correct(next, cur.position, T, h, -1, 0.0)) {
+				h *= 0.5;
+				if (h < hMin)
+					return false;
+				continue;
+			}
+			Vec3 nextT = next.tangent;
+			if (nextT.dot(T) < 0.0)
+				nextT *= -1.0;
+			Real turn = nextT.dot(T);
+			if (turn < cosAngle && h > hMin * 2.0) {
+				h *= 0.5;
+				continue;
+			}
+			next.tangent = nextT;
+
+			// Leaving domain : end on the boundary of the most exceeded parameter
+			int exceeded = -1;
+			Real exceedRatio = 0, boundary = 0;
+			for (int l = 0; l < 4; l++) {
+				Real over = std::max(domains[l].beg() - next.param[l], next.param[l] - domains[l].end());
+				if (over > 0.0 && over / domains[l].width() > exceedRatio) {
+					exceeded = l;
+					exceedRatio = over / domains[l].width();
+					boundary = (next.param[l] < domains[l].beg()) ? domains[l].beg() : domains[l].end();
+				}
+			}
+			if (exceeded >= 0) {
+				Real ratio = (boundary - cur.param[exceeded]) / (next.param[exceeded] - cur.param[exceeded]);
+				Point last = cur;
+				for (int l = 0; l < 4; l++)
+					last.param[l] = cur.param[l] + ratio * (next.param[l] - cur.param[l]);
+				if (correct(last, cur.position, T, 0.0, exceeded, boundary)) {
+					bool inside = true;
+					for (int l = 0; l < 4; l++) {
+						Real slack = 1e-9 * domains[l].width();
+						if (last.param[l] < domains[l].beg() - slack || last.param[l] > domains[l].end() + slack)
+							inside = false;
+						last.param[l] = std::min(std::max(last.param[l], domains[l].beg()), domains[l].end());
+					}
+					if (last.tangent.dot(T) < 0.0)
+						last.tangent *= -1.0;
+					if (inside && (last.position - cur.position).len() > hMin)
+						points.push_back(last);
+				}
+				return true;
+			}
+
+			// Returned to start : seed lies on this step
+			if (points.size() >= 3) {
+				Vec3 chord = next.position - cur.position, diff = seed.position - cur.position;
+				Real lenSq = chord.dot(chord);
+				Real s = (lenSq > eps) ? diff.dot(chord) / lenSq : 0.0;
+				if (s >= 0.0 && s <= 1.0 && (diff - chord * s).len() <= 0.5 * hMax) {
+					closed = true;
+					return true;
+				}
+			}
+			points.push_back(next);
+			cur = next;
+			T = nextT;
+			if (turn > cos(maxAngle * 0.5))
+				h = std::min(hMax, h * growth);
+		}
+		return true;
+	}
+	void SurfaceIntersector3d::intersect(std::vector<Branch>& branches) const {
+		branches.clear();
+		std::vector<Seed> seeds;
+		findSeeds(seeds);
+
+		// Traced points hashed into grid of maximum step, to skip seeds on traced branches
+		Real hMax = maxStep * getSize();
+		std::unordered_map<long long, std::vector<Vec3>> traced;
+		auto cellOf = [&](const Vec3& p, int* cell) {
+			for (int d = 0; d < 3; d++)
+				cell[d] = (int)floor(p[d] / hMax);
+		};
+		auto keyOf = [](int x, int y, int z) {
+			return ((long long)(x & 0x1FFFFF) << 42) | ((long long)(y & 0x1FFFFF) << 21) | (long long)(z & 0x1FFFFF);
+		};
+		auto isTraced = [&](const Vec3& p) {
+			int cell[3];
+			cellOf(p, cell);
+			for (int x = -1; x <= 1; x++)
+				for (int y = -1; y <= 1; y++)
+					for (int z = -1; z <= 1; z++) {
+						auto it = traced.find(keyOf(cell[0] + x, cell[1] + y, cell[2] + z));
+						if (it == traced.end())
+							continue;
+						for (const auto& q : it->second)
+							if ((q - p).len() <= hMax)
+								return true;
+					}
+			return false;
+		};
+
+		// Seeds are corrected independently in parallel, while tracing stays serial
+		// since each branch decides which of later seeds are already traced
+		int seedNum = (int)seeds.size();
+		std::vector<Point> starts(seedNum);
+		std::vector<char> valid(seedNum);
+		Parallel::forEach(0, seedNum, [&](int i) {
+			Point& start = starts[i];
+			std::copy(seeds[i].param, seeds[i].param + 4, start.param);
+			Freeform3ds::Jet ja = jet(*surfaceA, gridA, start.param[0], start.param[1]);
+			valid[i] = correct(start, ja.S, Vec3{ 0, 0, 0 }, 0.0, 0, start.param[0]);
+		}, pairChunk);
+
+		std::vector<Point> forward, backward;
+		for (int index = 0; index < seedNum; index++) {
+			const Point& start = starts[index];
+			if (!valid[index] || isTraced(start.position))
+				continue;
+
+			bool closed, backClosed;
+			trace(start, 1.0, forward, closed);
+			if (!closed)
+				trace(start, -1.0, backward, backClosed);
+			else
+				backward.clear();
+
+			Branch branch;
+			branch.closed = closed;
+			for (int i = (int)backward.size() - 1; i > 0; i--) {
+				branch.points.push_back(backward[i].position);
+				branch.uvA.push_back(Vec2{ backward[i].param[0], backward[i].param[1] });
+				branch.uvB.push_back(Vec2{ backward[i].param[2], backward[i].param[3] });
+			}
+			for (const auto& point : forward) {
+				branch.points.push_back(point.position);
+				branch.uvA.push_back(Vec2{ point.param[0], point.param[1] });
+				branch.uvB.push_back(Vec2{ point.param[2], point.param[3] });
+			}
+			for (const auto& p : branch.points) {
+				int cell[3];
+				cellOf(p, cell);
+				traced[keyOf(cell[0], cell[1], cell[2])].push_back(p);
+			}
+			if (branch.points.size() >= 2)
+				branches.push_back(std::move(branch));
+		}
+	}
+}
@@ -0,0 +1,116 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_SURFACE_INTERSECTOR_3D_H__
+#define __MN_SURFACE_INTERSECTOR_3D_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "../Surface/BsplineSurface3d.h"
+#include "PatchBVH.h"
+#include <memory>
+
+namespace MN {
+	/*
+	 * Intersection curves of two Bspline surfaces.
+	 * Patch pairs whose bounds overlap are found by querying BVH of one surface with patches of the other, in parallel.
+	 * Each pair is subdivided until subpatches are about as small as marching step, and seed points are solved on the remaining ones.
+	 * Branches are traced from seeds in both directions by predictor-corrector marching along cross product of normals,
+	 * with step adapted to turning of the curve, and seeds that lie on traced branches are skipped.
+	 * Branch ends at domain boundary of either surface, or when it returns to its start.
+	 * Tangential contact, where normals are parallel, is not traced.
+	 */
+	class SurfaceIntersector3d {
+	public:
+		// One connected intersection curve, as polyline in space and in parameter domain of each surface
+		class Branch {
+		public:
+			std::vector<Vec3> points;
+			std::vector<Vec2> uvA;
+			std::vector<Vec2> uvB;
+			bool closed = false;		// Last point connects to first point
+		};
+		using Ptr = std::shared_ptr<SurfaceIntersector3d>;
+	private:
+		// Finds patch of parameter in O(log n) instead of linear search over patches
+		class PatchGrid {
+		public:
+			std::vector<Real> uBreaks;	// Sorted begin of patch subdomains, and end of the last one
+			std::vector<Real> vBreaks;
+			std::vector<int> index;		// Patch index of each cell of grid, row-major in u
+
+			static PatchGrid create(const BsplineSurface3d& surface);
+			int find(Real u, Real v) const;
+		};
+		class Point;
+		class Seed;
+
+		SurfaceIntersector3d() = default;
+
+		BsplineSurface3d::Ptr surfaceA = nullptr;
+		BsplineSurface3d::Ptr surfaceB = nullptr;
+		PatchBVH3d bvhA;
+		PatchBVH3d bvhB;
+		PatchGrid gridA;
+		PatchGrid gridB;
+		Real tolerance = 1e-9;		// Distance between surfaces regarded as intersection, relative to size of smaller surface
+		Real maxStep = 5e-3;		// Maximum distance between consecutive points, relative to size of smaller surface
+		Real maxAngle = 0.1;		// Maximum turning angle of tangent in one step, in radians
+		int maxIteration = 16;		// Maximum number of corrector iterations
+		int maxPoints = 100000;		// Maximum number of points in one branch
+
+		Real getSize() const noexcept;
+		Freeform3ds::Jet jet(const BsplineSurface3d& surface, const PatchGrid& grid, Real u, Real v) const;
+		void findSeeds(std::vector<Seed>& seeds) const;
+		// Newton iteration onto intersection, where the last equation fixes either distance along [ tangent ] or one parameter
+		bool correct(Point& point, const Vec3& origin, const Vec3& tangent, Real step, int fixed, Real fixedValue) const;
+		bool trace(const Point& seed, Real direction, std::vector<Point>& points, bool& closed) const;
+	public:
+		static SurfaceIntersector3d create(const BsplineSurface3d::Ptr& surfaceA, const BsplineSurface3d::Ptr& surfaceB, int leafSize = 4);
+		static Ptr createPtr(const BsplineSurface3d::Ptr& surfaceA, const BsplineSurface3d::Ptr& surfaceB, int leafSize = 4);
+
+		// Call after control points of surface patches are edited
+		void refit();
+
+		inline void setTolerance(Real tolerance) noexcept {
+			this->tolerance = tolerance;
+		}
+		inline Real getTolerance() const noexcept {
+			return tolerance;
+		}
+		void setMaxStep(Real maxStep);
+		inline Real getMaxStep() const noexcept {
+			return maxStep;
+		}
+		inline void setMaxAngle(Real maxAngle) noexcept {
+			this->maxAngle = maxAngle;
+		}
+		inline Real getMaxAngle() const noexcept {
+			return maxAngle;
+		}
+		inline void setMaxIteration(int maxIteration) noexcept {
+			this->maxIteration = maxIteration;
+		}
+		inline int getMaxIteration() const noexcept {
+			return maxIteration;
+		}
+		inline void setMaxPoints(int maxPoints) noexcept {
+			this->maxPoints = maxPoints;
+		}
+		inline int getMaxPoints() const noexcept {
+			return maxPoints;
+		}
+
+		void intersect(std::vector<Branch>& branches) const;
+	};
+}
+
+#endif
@@ -11,89 +11,67 @@
 namespace MN {
 	// BezierSurface2d
 	static const BezierSurface2d empty2d = BezierSurface2d::create(0, 0, {}, false);
+	// Column [col] of control net, i.e) control points along U direction
+	template<typename Net, typename Point>
+	class BezierSurface2dColumnView {
+	public:
+		Net* net;
+		int col;
+
+		inline Point& operator[](int i) const noexcept {
+			return (*net)[i][col];
+		}
+	};
+	using BezierSurface2dConstColumn = BezierSurface2dColumnView<const BezierSurface2d::ControlPoints, const Vec2>;
+	using BezierSurface2dColumn = BezierSurface2dColumnView<BezierSurface2d::ControlPoints, Vec2>;
+
 	void BezierSurface2d::subdivideCpts(const std::vector<Vec2>& cpts, Real t, std::vector<Vec2>& lower, std::vector<Vec2>& upper) {
-		// De Casteljou's algorithm
 		int size = (int)cpts.size();
 		lower.resize(size);
 		upper.resize(size);
-
-		Real t1 = 1 - t;
-
-		std::vector<Vec2> copy = cpts;
-		lower[0] = copy.front();
-		upper[size - 1] = copy.back();
-
-		int cnt = 1;
-		for (int i = size - 1; i > 0; i--) {
-			std::vector<Vec2> tmp;
-			tmp.resize(i);
-			for (int j = 0; j < i; j++)
-				tmp[j] = copy[j] * t1 + copy[j + 1] * t;
-			copy = tmp;
-
-			lower[cnt] = copy.front();
-			upper[size - cnt - 1] = copy.back();
-			cnt++;
-		}
+		Bezier::subdivide(cpts, size, t, Bezier::StridedView<Vec2>{ lower.data(), 1 }, Bezier::StridedView<Vec2>{ upper.data(), 1 });
 	}
+	void BezierSurface2d::prepareSubdivision(BezierSurface2d& piece) const {
+		piece.setDomain(0, Domain::create(0, 1));
+		piece.setDomain(1, Domain::create(0, 1));
+		piece.setDegree(0, uDegree);
+		piece.setDegree(1, vDegree);
+		piece.cpts.resize(cpts.size());
+		for (size_t i = 0; i < cpts.size(); i++)
+			piece.cpts[i].resize(cpts[i].size());
+		for (auto* mat : { &piece.derivMatU, &piece.derivMatV, &piece.derivMatUU, &piece.derivMatUV, &piece.derivMatVV,
+			&piece.derivMatUUU, &piece.derivMatUUV, &piece.derivMatUVV, &piece.derivMatVVV })
+			mat->clear();
+	}
+	// Subdivision writes into control points of [lower] and [upper] in place, either of which may be this surface
 	void BezierSurface2d::uSubdivide(Real u, BezierSurface2d& lower, BezierSurface2d& upper) const {
-		ControlPoints lowerCpts = cpts;
-		ControlPoints upperCpts = cpts;
 		int rowNum = (int)cpts.size();
 		int colNum = (int)cpts[0].size();
-		std::vector<Vec2> lowerCol;
-		std::vector<Vec2> upperCol;
-		for (int i = 0; i < colNum; i++) {
-			std::vector<Vec2> col;
-			col.resize(rowNum);
-			for (int j = 0; j < rowNum; j++)
-				col[j] = cpts[j][i];
-			subdivideCpts(col, u, lowerCol, upperCol);
-
-			for (int j = 0; j < rowNum; j++) {
-				lowerCpts[j][i] = lowerCol[j];
-				upperCpts[j][i] = upperCol[j];
-			}
-		}
-		lower = BezierSurface2d::create(uDegree, vDegree, lowerCpts, false);
-		upper = BezierSurface2d::create(uDegree, vDegree, upperCpts, false);
+		prepareSubdivision(lower);
+		prepareSubdivision(upper);
+		for (int i = 0; i < colNum; i++)
+			Bezier::subdivide(BezierSurface2dConstColumn{ &cpts, i }, rowNum, u, BezierSurface2dColumn{ &lower.cpts, i }, BezierSurface2dColumn{ &upper.cpts, i });
 	}
 	void BezierSurface2d::vSubdivide(Real v, BezierSurface2d& lower, BezierSurface2d& upper) const {
-		ControlPoints lowerCpts = cpts;
-		ControlPoints upperCpts = cpts;
 		int rowNum = (int)cpts.size();
 		int colNum = (int)cpts[0].size();
-		std::vector<Vec2> lowerRow;
-		std::vector<Vec2> upperRow;
-		for (int i = 0; i < rowNum; i++) {
-			std::vector<Vec2> row;
-			row.resize(colNum);
-			for (int j = 0; j < colNum; j++)
-				row[j] = cpts[i][j];
-			subdivideCpts(row, v, lowerRow, upperRow);
-
-			for (int j = 0; j < colNum; j++) {
-				lowerCpts[i][j] = lowerRow[j];
-				upperCpts[i][j] = upperRow[j];
-			}
-		}
-		lower = BezierSurface2d::create(uDegree, vDegree, lowerCpts, false);
-		upper = BezierSurface2d::create(uDegree, vDegree, upperCpts, false);
+		prepareSubdivision(lower);
+		prepareSubdivision(upper);
+		for (int i = 0; i < rowNum; i++)
+			Bezier::subdivide(cpts[i], colNum, v, Bezier::StridedView<Vec2>{ lower.cpts[i].data(), 1 }, Bezier::StridedView<Vec2>{ upper.cpts[i].data(), 1 });
 	}
 	BezierSurface2d::Ptr BezierSurface2d::subdivide(const Domain& uSubdomain, const Domain& vSubdomain) const {
-		// Divide in u direction
-		BezierSurface2d lower, upper;
-		uSubdivide(uSubdomain.beg(), lower, upper);	// upper
-		Real t = (uSubdomain.end() - uSubdomain.beg()) / (1.0 - uSubdomain.beg());
-		upper.uSubdivide(t, lower, upper);			// lower
-
-		// Divide in v direction
-		lower.vSubdivide(vSubdomain.beg(), lower, upper);	// upper
-		t = (vSubdomain.end() - vSubdomain.beg()) / (1.0 - vSubdomain.beg());
-		upper.vSubdivide(t, lower, upper);			// lower
-
-		lower.updateDerivMat();
-		return std::make_shared<BezierSurface2d>(lower);
+		// Blossoming gives control points over subdomain at once, column by column into the only allocated surface, then row by row in place
+		int rowNum = (int)cpts.size();
+		int colNum = (int)cpts[0].size();
+		BezierSurface2d piece;
+		prepareSubdivision(piece);
+		for (int i = 0; i < colNum; i++)
+			Bezier::extract(BezierSurface2dConstColumn{ &cpts, i }, rowNum, uSubdomain.beg(), uSubdomain.end(), BezierSurface2dColumn{ &piece.cpts, i });
+		for (int i = 0; i < rowNum; i++)
+			Bezier::extract(piece.cpts[i], colNum, vSubdomain.beg(), vSubdomain.end(), Bezier::StridedView<Vec2>{ piece.cpts[i].data(), 1 });
+		piece.updateDerivMat();
+		return std::make_shared<BezierSurface2d>(std::move(piece));
 	}
 	BezierSurface2d BezierSurface2d::create() {
 		return empty2d;
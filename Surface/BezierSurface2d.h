@@ -35,6 +35,8 @@ namespace MN {
 		ControlPoints derivMatVVV;
 
 		static void subdivideCpts(const std::vector<Vec2>& cpts, Real t, std::vector<Vec2>& lower, std::vector<Vec2>& upper);
+		// Gives [piece] degrees, domains and shape of control points of this surface to be overwritten by subdivision
+		void prepareSubdivision(BezierSurface2d& piece) const;
 	public:
 		using Ptr = std::shared_ptr<BezierSurface2d>;
 		const static Binomial binomial;
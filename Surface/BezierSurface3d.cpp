@@ -7,91 +7,143 @@
  */
 
 #include "BezierSurface3d.h"
+#include "../Batch/BezierSimd.h"
+#include "../Parallel.h"
 
 namespace MN {
+	const static int rowChunk = 4;		// Number of grid rows handled by one thread, sharing scratch buffer
+	const static int maxUniformLevels = 10;	// Limit of levels of uniform subdivision, giving 4^10 sub-patches
+
+	// Column [col] of control net, i.e) control points along U direction
+	template<typename Net, typename Point>
+	class BezierSurface3dColumnView {
+	public:
+		Net* net;
+		int col;
+
+		inline Point& operator[](int i) const noexcept {
+			return (*net)[i][col];
+		}
+	};
+	using BezierSurface3dConstColumn = BezierSurface3dColumnView<const BezierSurface3d::ControlPoints, const Vec3>;
+	using BezierSurface3dColumn = BezierSurface3dColumnView<BezierSurface3d::ControlPoints, Vec3>;
+
 	void BezierSurface3d::subdivideCpts(const std::vector<Vec3>& cpts, Real t, std::vector<Vec3>& lower, std::vector<Vec3>& upper) {
-		// De Casteljou's algorithm
 		int size = (int)cpts.size();
 		lower.resize(size);
 		upper.resize(size);
-
-		Real t1 = 1 - t;
-
-		std::vector<Vec3> copy = cpts;
-		lower[0] = copy.front();
-		upper[size - 1] = copy.back();
-
-		int cnt = 1;
-		for (int i = size - 1; i > 0; i--) {
-			std::vector<Vec3> tmp;
-			tmp.resize(i);
-			for (int j = 0; j < i; j++)
-				tmp[j] = copy[j] * t1 + copy[j + 1] * t;
-			copy = tmp;
-
-			lower[cnt] = copy.front();
-			upper[size - cnt - 1] = copy.back();
-			cnt++;
-		}
+		Bezier::subdivide(cpts, size, t, Bezier::StridedView<Vec3>{ lower.data(), 1 }, Bezier::StridedView<Vec3>{ upper.data(), 1 });
+	}
+	void BezierSurface3d::prepareSubdivision(BezierSurface3d& piece) const {
+		piece.setDomain(0, Domain::create(0, 1));
+		piece.setDomain(1, Domain::create(0, 1));
+		piece.setDegree(0, uDegree);
+		piece.setDegree(1, vDegree);
+		piece.cpts.resize(cpts.size());
+		for (size_t i = 0; i < cpts.size(); i++)
+			piece.cpts[i].resize(cpts[i].size());
+		for (auto* mat : { &piece.derivMatU, &piece.derivMatV, &piece.derivMatUU, &piece.derivMatUV, &piece.derivMatVV,
+			&piece.derivMatUUU, &piece.derivMatUUV, &piece.derivMatUVV, &piece.derivMatVVV })
+			mat->clear();
+		piece.boundValid = false;
 	}
-	void BezierSurface3d::uSubdivide(Real u, BezierSurface3d& lower, BezierSurface3d& upper) const {
-		ControlPoints lowerCpts = cpts;
-		ControlPoints upperCpts = cpts;
+	// Subdivision writes into control points of [lower] and [upper] in place, either of which may be this surface
+	void BezierSurface3d::uSubdivide(Real u, BezierSurface3d& lower, BezierSurface3d& upper, bool buildMat) const {
 		int rowNum = (int)cpts.size();
 		int colNum = (int)cpts[0].size();
-		std::vector<Vec3> lowerCol;
-		std::vector<Vec3> upperCol;
-		for (int i = 0; i < colNum; i++) {
-			std::vector<Vec3> col;
-			col.resize(rowNum);
-			for (int j = 0; j < rowNum; j++)
-				col[j] = cpts[j][i];
-			subdivideCpts(col, u, lowerCol, upperCol);
-
-			for (int j = 0; j < rowNum; j++) {
-				lowerCpts[j][i] = lowerCol[j];
-				upperCpts[j][i] = upperCol[j];
-			}
+		prepareSubdivision(lower);
+		prepareSubdivision(upper);
+		for (int i = 0; i < colNum; i++)
+			Bezier::subdivide(BezierSurface3dConstColumn{ &cpts, i }, rowNum, u, BezierSurface3dColumn{ &lower.cpts, i }, BezierSurface3dColumn{ &upper.cpts, i });
+		if (buildMat) {
+			lower.updateDerivMat();
+			upper.updateDerivMat();
+		}
+		else {
+			lower.updateBound();
+			upper.updateBound();
 		}
-		lower = BezierSurface3d::create(uDegree, vDegree, lowerCpts, false);
-		upper = BezierSurface3d::create(uDegree, vDegree, upperCpts, false);
 	}
-	void BezierSurface3d::vSubdivide(Real v, BezierSurface3d& lower, BezierSurface3d& upper) const {
-		ControlPoints lowerCpts = cpts;
-		ControlPoints upperCpts = cpts;
+	void BezierSurface3d::vSubdivide(Real v, BezierSurface3d& lower, BezierSurface3d& upper, bool buildMat) const {
 		int rowNum = (int)cpts.size();
 		int colNum = (int)cpts[0].size();
-		std::vector<Vec3> lowerRow;
-		std::vector<Vec3> upperRow;
-		for (int i = 0; i < rowNum; i++) {
-			std::vector<Vec3> row;
-			row.resize(colNum);
-			for (int j = 0; j < colNum; j++)
-				row[j] = cpts[i][j];
-			subdivideCpts(row, v, lowerRow, upperRow);
-
-			for (int j = 0; j < colNum; j++) {
-				lowerCpts[i][j] = lowerRow[j];
-				upperCpts[i][j] = upperRow[j];
-			}
+		prepareSubdivision(lower);
+		prepareSubdivision(upper);
+		for (int i = 0; i < rowNum; i++)
+			Bezier::subdivide(cpts[i], colNum, v, Bezier::StridedView<Vec3>{ lower.cpts[i].data(), 1 }, Bezier::StridedView<Vec3>{ upper.cpts[i].data(), 1 });
+		if (buildMat) {
+			lower.updateDerivMat();
+			upper.updateDerivMat();
+		}
+		else {
+			lower.updateBound();
+			upper.updateBound();
 		}
-		lower = BezierSurface3d::create(uDegree, vDegree, lowerCpts, false);
-		upper = BezierSurface3d::create(uDegree, vDegree, upperCpts, false);
 	}
 	BezierSurface3d::Ptr BezierSurface3d::subdivide(const Domain& uSubdomain, const Domain& vSubdomain) const {
-		// Divide in u direction
-		BezierSurface3d lower, upper;
-		uSubdivide(uSubdomain.beg(), lower, upper);	// upper
-		Real t = (uSubdomain.end() - uSubdomain.beg()) / (1.0 - uSubdomain.beg());
-		upper.uSubdivide(t, lower, upper);			// lower
+		// Blossoming gives control points over subdomain at once, column by column into the only allocated surface, then row by row in place
+		int rowNum = (int)cpts.size();
+		int colNum = (int)cpts[0].size();
+		BezierSurface3d piece;
+		prepareSubdivision(piece);
+		for (int i = 0; i < colNum; i++)
+			Bezier::extract(BezierSurface3dConstColumn{ &cpts, i }, rowNum, uSubdomain.beg(), uSubdomain.end(), BezierSurface3dColumn{ &piece.cpts, i });
+		for (int i = 0; i < rowNum; i++)
+			Bezier::extract(piece.cpts[i], colNum, vSubdomain.beg(), vSubdomain.end(), Bezier::StridedView<Vec3>{ piece.cpts[i].data(), 1 });
+		piece.updateDerivMat();
+		return std::make_shared<BezierSurface3d>(std::move(piece));
+	}
+	void BezierSurface3d::subdivideUniform(int levels, UniformPatches& patches) const {
+		if (levels < 0 || levels > maxUniformLevels)
+			throw(std::runtime_error("Invalid number of levels for uniform subdivision of bezier surface 3d"));
+		const int num = 1 << levels;
+		const int uSize = (int)cpts.size();
+		const int vSize = (int)cpts[0].size();
+		patches.levels = levels;
+		patches.num = num;
+		patches.uSize = uSize;
+		patches.vSize = vSize;
+		patches.cpts.resize((size_t)num * num * uSize * vSize);
 
-		// Divide in v direction
-		lower.vSubdivide(vSubdomain.beg(), lower, upper);	// upper
-		t = (vSubdomain.end() - vSubdomain.beg()) / (1.0 - vSubdomain.beg());
-		upper.vSubdivide(t, lower, upper);			// lower
+		// Along U : column j of net splits into pieces a, at [ columns[(j * num + a) * uSize + i] ]
+		std::vector<Vec3> columns((size_t)vSize * num * uSize);
+		Parallel::forEach(0, vSize, [&](int j) {
+			Vec3* column = columns.data() + (size_t)j * num * uSize;
+			for (int i = 0; i < uSize; i++)
+				column[i] = cpts[i][j];
+			Bezier::subdivideUniform(column, uSize, levels);
+		});
+		// Along V : row i of piece a splits into row i of sub-patches (a, b)
+		Parallel::forEach(0, num, [&](int a) {
+			std::vector<Vec3> row((size_t)num * vSize);
+			for (int i = 0; i < uSize; i++) {
+				for (int j = 0; j < vSize; j++)
+					row[j] = columns[((size_t)j * num + a) * uSize + i];
+				Bezier::subdivideUniform(row.data(), vSize, levels);
+				for (int b = 0; b < num; b++)
+					std::copy(row.begin() + b * vSize, row.begin() + (b + 1) * vSize,
+						patches.cpts.begin() + (((size_t)a * num + b) * uSize + i) * vSize);
+			}
+		});
+	}
+	std::vector<BezierSurface3d::Ptr> BezierSurface3d::subdivideUniform(int levels, bool buildMat) const {
+		UniformPatches patches;
+		subdivideUniform(levels, patches);
 
-		lower.updateDerivMat();
-		return std::make_shared<BezierSurface3d>(lower);
+		std::vector<Ptr> pieces((size_t)patches.num * patches.num);
+		Parallel::forEach(0, (int)pieces.size(), [&](int p) {
+			BezierSurface3d piece;
+			prepareSubdivision(piece);
+			const Vec3* net = patches.cpts.data() + (size_t)p * patches.uSize * patches.vSize;
+			for (int i = 0; i < patches.uSize; i++)
+				std::copy(net + i * patches.vSize, net + (i + 1) * patches.vSize, piece.cpts[i].begin());
+			if (buildMat)
+				piece.updateDerivMat();
+			else
+				piece.updateBound();
+			pieces[p] = std::make_shared<BezierSurface3d>(std::move(piece));
+		});
+		return pieces;
 	}
 	BezierSurface3d BezierSurface3d::create(int uDegree, int vDegree, const ControlPoints& cpts, bool buildMat) {
 		BezierSurface3d surface;
@@ -99,9 +151,11 @@ namespace MN {
 		surface.setDomain(1, Domain::create(0, 1));
 		surface.setDegree(0, uDegree);
 		surface.setDegree(1, vDegree);
-		surface.setCpts(cpts);
+		surface.cpts = cpts;
 		if (buildMat)
 			surface.updateDerivMat();
+		else
+			surface.updateBound();
 		return surface;
 	}
 	BezierSurface3d::Ptr BezierSurface3d::createPtr(int uDegree, int vDegree, const ControlPoints& cpts, bool buildMat) {
@@ -201,6 +255,56 @@ namespace MN {
 				}
 			}
 		}
+		updateBound();
+	}
+	void BezierSurface3d::updateBound() {
+		if (cpts.empty()) {
+			boundValid = false;
+			return;
+		}
+		int rowNum = (int)cpts.size();
+		int colNum = (int)cpts[0].size();
+		patchBound = PatchBound3d();
+		for (int i = 0; i < rowNum; i++) {
+			for (int j = 0; j < colNum; j++) {
+				patchBound.bound.expand(cpts[i][j]);
+				// Hodograph control points
+				if (i < rowNum - 1)
+					patchBound.expandDeriv(0, (cpts[i + 1][j] - cpts[i][j]) * uDegree);
+				if (j < colNum - 1)
+					patchBound.expandDeriv(1, (cpts[i][j + 1] - cpts[i][j]) * vDegree);
+			}
+		}
+		if (rowNum == 1)
+			patchBound.expandDeriv(0, Vec3{ 0, 0, 0 });
+		if (colNum == 1)
+			patchBound.expandDeriv(1, Vec3{ 0, 0, 0 });
+		patchBound.finish();
+		boundValid = true;
+	}
+	const AABB3d& BezierSurface3d::getBound() const {
+		if (!boundValid)
+			throw(std::runtime_error("Bezier surface has no control points to bound"));
+		return patchBound.bound;
+	}
+	const AABB3d& BezierSurface3d::getDerivBound(int dir) const {
+		if (!boundValid)
+			throw(std::runtime_error("Bezier surface has no control points to bound"));
+		return patchBound.derivBound[dir];
+	}
+	Real BezierSurface3d::getLipschitz(int dir) const {
+		if (!boundValid)
+			throw(std::runtime_error("Bezier surface has no control points to bound"));
+		return patchBound.lipschitz[dir];
+	}
+	OBB3d BezierSurface3d::getOrientedBound() const {
+		if (cpts.empty())
+			throw(std::runtime_error("Cannot build oriented bound of empty bezier surface"));
+		std::vector<Vec3> points;
+		points.reserve(cpts.size() * cpts[0].size());
+		for (const auto& row : cpts)
+			points.insert(points.end(), row.begin(), row.end());
+		return OBB3d::create(points);
 	}
 	Vec3 BezierSurface3d::evaluate(Real u, Real v) const {
 		BasisVector uBasis, vBasis;
@@ -208,6 +312,95 @@ namespace MN {
 		Bezier::calBasisVector(v, vDegree, vBasis);
 		return tensorProduct(uBasis, cpts, vBasis);
 	}
+	void BezierSurface3d::evaluate(const std::vector<Real>& u, const std::vector<Real>& v, std::vector<Vec3>& points) const {
+		if (u.size() != v.size())
+			throw(std::runtime_error("Number of u and v parameters must be same for Bezier surface evaluation"));
+		int count = (int)u.size();
+		int rowNum = uDegree + 1;
+		int colNum = vDegree + 1;
+		std::vector<Real> flatCpts, flatPoints;
+		flatCpts.resize((size_t)rowNum * colNum * 3);
+		for (int i = 0; i < rowNum; i++)
+			for (int j = 0; j < colNum; j++)
+				for (int c = 0; c < 3; c++)
+					flatCpts[(i * colNum + j) * 3 + c] = cpts[i][j][c];
+		flatPoints.resize((size_t)count * 3);
+		BezierSimd::evaluateSurface(uDegree, vDegree, flatCpts.data(), count, u.data(), v.data(), flatPoints.data());
+
+		points.resize(count);
+		for (int i = 0; i < count; i++)
+			points[i] = { flatPoints[i * 3], flatPoints[i * 3 + 1], flatPoints[i * 3 + 2] };
+	}
+	BezierSurface3d::Jet BezierSurface3d::jet(Real u, Real v) const {
+		// Basis of all orders share one recurrence per direction, and are contracted with control points directly
+		Real uBasis[3][Bezier::maxDegree + 1], vBasis[3][Bezier::maxDegree + 1];
+		Bezier::calBasisJet(u, uDegree, uBasis[0], uBasis[1], uBasis[2]);
+		Bezier::calBasisJet(v, vDegree, vBasis[0], vBasis[1], vBasis[2]);
+
+		Jet j;
+		j.S = j.Su = j.Sv = j.Suu = j.Suv = j.Svv = Vec3::zero();
+		for (int i = 0; i <= uDegree; i++) {
+			// Contract each row in V direction first
+			Vec3 row0 = Vec3::zero(), row1 = Vec3::zero(), row2 = Vec3::zero();
+			for (int k = 0; k <= vDegree; k++) {
+				const Vec3& cpt = cpts[i][k];
+				row0 += cpt * vBasis[0][k];
+				row1 += cpt * vBasis[1][k];
+				row2 += cpt * vBasis[2][k];
+			}
+			j.S += row0 * uBasis[0][i];
+			j.Su += row0 * uBasis[1][i];
+			j.Sv += row1 * uBasis[0][i];
+			j.Suu += row0 * uBasis[2][i];
+			j.Suv += row1 * uBasis[1][i];
+			j.Svv += row2 * uBasis[0][i];
+		}
+		return j;
+	}
+	void BezierSurface3d::curvatureGrid(const std::vector<Real>& uParams, const std::vector<Real>& vParams, CurvatureGrid& grid) const {
+		int uNum = (int)uParams.size(), vNum = (int)vParams.size();
+		int rowNum = uDegree + 1, colNum = vDegree + 1;
+		grid.resize(uNum, vNum);
+
+		// Basis of all orders of each V parameter, shared by every row
+		std::vector<Real> vBasis((size_t)vNum * 3 * colNum);
+		for (int j = 0; j < vNum; j++) {
+			Real* basis = &vBasis[(size_t)j * 3 * colNum];
+			Bezier::calBasisJet(vParams[j], vDegree, basis, basis + colNum, basis + 2 * colNum);
+		}
+		Parallel::forEach(0, (uNum + rowChunk - 1) / rowChunk, [&](int chunk) {
+			std::vector<Jet> jets(vNum);
+			Real uBasis[3][Bezier::maxDegree + 1];
+			Vec3 column[3][Bezier::maxDegree + 1];		// Control points contracted in U direction, for each order
+			int end = std::min((chunk + 1) * rowChunk, uNum);
+			for (int i = chunk * rowChunk; i < end; i++) {
+				Bezier::calBasisJet(uParams[i], uDegree, uBasis[0], uBasis[1], uBasis[2]);
+				for (int k = 0; k < colNum; k++) {
+					column[0][k] = column[1][k] = column[2][k] = Vec3::zero();
+					for (int r = 0; r < rowNum; r++) {
+						const Vec3& cpt = cpts[r][k];
+						column[0][k] += cpt * uBasis[0][r];
+						column[1][k] += cpt * uBasis[1][r];
+						column[2][k] += cpt * uBasis[2][r];
+					}
+				}
+				// Point itself is not needed for curvature
+				for (int j = 0; j < vNum; j++) {
+					const Real* basis = &vBasis[(size_t)j * 3 * colNum];
+					Jet& jet = jets[j];
+					jet.Su = jet.Sv = jet.Suu = jet.Suv = jet.Svv = Vec3::zero();
+					for (int k = 0; k < colNum; k++) {
+						jet.Su += column[1][k] * basis[k];
+						jet.Sv += column[0][k] * basis[colNum + k];
+						jet.Suu += column[2][k] * basis[k];
+						jet.Suv += column[1][k] * basis[colNum + k];
+						jet.Svv += column[0][k] * basis[2 * colNum + k];
+					}
+				}
+				calCurvatureRow(jets.data(), vNum, grid, (size_t)i * vNum);
+			}
+		});
+	}
 	Vec3 BezierSurface3d::differentiate(Real u, Real v, int uOrder, int vOrder) const {
 		BasisVector uBasis, vBasis;
 		if (uOrder == 0 && vOrder == 0)
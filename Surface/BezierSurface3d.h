@@ -21,6 +21,7 @@ namespace MN {
 	class BezierSurface3d : public Freeform3ds {
 	private:
 		BezierSurface3d() = default;
+		friend class FreeformStore;
 
 		// Control points for calculating derivatives up to 2nd order
 		// @WARNING : Degree multiplication is already done in those matrices e.g) When 3rd degree Bezier is differentiated, 6 must be multiplied. 
@@ -33,23 +34,70 @@ namespace MN {
 		ControlPoints derivMatUUV;
 		ControlPoints derivMatUVV;
 		ControlPoints derivMatVVV;
+
+		// Bounds of control points, rebuilt whenever control points are set, subdivided or deriv matrices are updated
+		PatchBound3d patchBound;
+		bool boundValid = false;
+		inline void cptsChanged() override {
+			updateBound();
+		}
 		
 		static void subdivideCpts(const std::vector<Vec3>& cpts, Real t, std::vector<Vec3>& lower, std::vector<Vec3>& upper);
-		void uSubdivide(Real u, BezierSurface3d& lower, BezierSurface3d& upper) const;
-		void vSubdivide(Real v, BezierSurface3d& lower, BezierSurface3d& upper) const;
+		// Gives [piece] degrees, domains and shape of control points of this surface to be overwritten by subdivision
+		void prepareSubdivision(BezierSurface3d& piece) const;
 	public:
 		using Ptr = std::shared_ptr<BezierSurface3d>;
 		const static Binomial binomial;
 
+		// Control nets of (2^levels x 2^levels) sub-patches over uniform grid of domain, in one buffer
+		// Net of sub-patch (a, b) over [a, a + 1] x [b, b + 1] / 2^levels starts at [ (a * num + b) * uSize * vSize ], in row major order
+		class UniformPatches {
+		public:
+			int levels = 0;
+			int num = 1;			// 2^levels
+			int uSize = 0;			// Number of control points of each sub-patch in U, V direction
+			int vSize = 0;
+			std::vector<Vec3> cpts;
+
+			inline const Vec3* net(int a, int b) const noexcept {
+				return cpts.data() + ((size_t)a * num + b) * uSize * vSize;
+			}
+			inline const Vec3& at(int a, int b, int i, int j) const noexcept {
+				return net(a, b)[i * vSize + j];
+			}
+		};
+
 		// @buildMat : Option for building derivMats in creation time
 		static BezierSurface3d create(int uDegree, int vDegree, const ControlPoints& cpts, bool buildMat = true);
 		static Ptr createPtr(int uDegree, int vDegree, const ControlPoints& cpts, bool buildMat = true);
 
-		void updateDerivMat();	// Update deriv matrices with current control points
+		void updateDerivMat();	// Update deriv matrices and bounds with current control points
+		// Rebuild bounds alone, e.g) after editing control points in place through [ getCpts ]
+		void updateBound();
+
+		// Bound of control points, which contains the surface
+		const AABB3d& getBound() const;
+		// Bound of first derivative in [dir], 0 for U and 1 for V, and largest norm of it
+		const AABB3d& getDerivBound(int dir) const;
+		Real getLipschitz(int dir) const;
+		// Bound along principal axes of control points, computed on each request as it is rarely needed
+		OBB3d getOrientedBound() const;
 		virtual Vec3 evaluate(Real u, Real v) const;
 		virtual Vec3 differentiate(Real u, Real v, int uOrder, int vOrder) const;
+		virtual Jet jet(Real u, Real v) const;
+		// Evaluate at multiple parameter pairs at once with SIMD : points[i] = S(u[i], v[i])
+		void evaluate(const std::vector<Real>& u, const std::vector<Real>& v, std::vector<Vec3>& points) const;
+		// Basis of each V parameter is computed once, and control points are contracted with basis of each U parameter once per row
+		virtual void curvatureGrid(const std::vector<Real>& uParams, const std::vector<Real>& vParams, CurvatureGrid& grid) const;
 
+		// Split at [u] or [v] in place, where either piece may be this surface, and pieces of the same degrees are not reallocated
+		void uSubdivide(Real u, BezierSurface3d& lower, BezierSurface3d& upper, bool buildMat = true) const;
+		void vSubdivide(Real v, BezierSurface3d& lower, BezierSurface3d& upper, bool buildMat = true) const;
 		Ptr subdivide(const Domain& uSubdomain, const Domain& vSubdomain) const;
+		// Split into (2^levels x 2^levels) sub-patches by one midpoint subdivision sweep per direction, in parallel across sub-patches
+		void subdivideUniform(int levels, UniformPatches& patches) const;
+		// Sub-patches as surfaces, in the order of [ UniformPatches ], with deriv matrices only when [buildMat]
+		std::vector<Ptr> subdivideUniform(int levels, bool buildMat = false) const;
 
 		inline const ControlPoints& getDerivMatU() const noexcept {
 			return derivMatU;
@@ -152,6 +152,7 @@ namespace MN {
 		return std::make_shared<BsplineSurface2d>(create(uDegree, vDegree, uKnot, vKnot, cpts));
 	}
 	void BsplineSurface2d::updatePatches() {
+		MN_INSTRUMENT_TIMER(UpdatePatches);
 		// Insert knots in both directions
 		insertKnotFull(0);
 		insertKnotFull(1);
@@ -220,6 +221,7 @@ namespace MN {
 	Vec2 BsplineSurface2d::evaluate(Real u, Real v) const {
 		for (const auto& patch : patches) {
 			if (patch.domainHas(u, v)) {
+				MN_INSTRUMENT_ADD(PatchScans, &patch - patches.data() + 1);
 				double nu = (u - patch.subdomain.a.beg()) / patch.subdomain.a.width();
 				double nv = (v - patch.subdomain.b.beg()) / patch.subdomain.b.width();
 				return patch.patch->evaluate(nu, nv);
@@ -230,6 +232,7 @@ namespace MN {
 	Vec2 BsplineSurface2d::differentiate(Real u, Real v, int uOrder, int vOrder) const {
 		for (const auto& patch : patches) {
 			if (patch.domainHas(u, v)) {
+				MN_INSTRUMENT_ADD(PatchScans, &patch - patches.data() + 1);
 				double uWidth, vWidth;
 				uWidth = patch.subdomain.a.width();
 				vWidth = patch.subdomain.b.width();
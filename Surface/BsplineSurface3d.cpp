@@ -7,9 +7,32 @@
  */
 
 #include "BsplineSurface3d.h"
+#include "../Parallel.h"
 #include <map>
 
 namespace MN {
+	const static int rowChunk = 4;		// Number of grid rows handled by one thread, sharing scratch buffer
+
+	// Sorted begins of patch subdomains in one direction, and end of the last one
+	static void collectBreaks(const std::vector<BsplineSurface3d::Patch>& patches, int dir, std::vector<Real>& breaks) {
+		breaks.clear();
+		Real last = -std::numeric_limits<Real>::max();
+		for (const auto& patch : patches) {
+			const Domain& domain = (dir == 0) ? patch.uSubdomain : patch.vSubdomain;
+			breaks.push_back(domain.beg());
+			last = std::max(last, domain.end());
+		}
+		breaks.push_back(last);
+		std::sort(breaks.begin(), breaks.end());
+		breaks.erase(std::unique(breaks.begin(), breaks.end()), breaks.end());
+	}
+	// Index of span between breaks that has [t], where the last end belongs to the last span
+	static int findSpan(const std::vector<Real>& breaks, Real t) {
+		if (t < breaks.front() || t > breaks.back())
+			throw(std::runtime_error("Invalid parameter for Bspline surface curvature"));
+		int span = (int)(std::upper_bound(breaks.begin(), breaks.end(), t) - breaks.begin()) - 1;
+		return std::min(span, (int)breaks.size() - 2);
+	}
 	// BsplineSurface Patch
 	bool BsplineSurface3d::Patch::domainHas(double u, double v) const noexcept {
 		return uSubdomain.has(u) && vSubdomain.has(v);
@@ -183,6 +206,7 @@ namespace MN {
 		return std::make_shared<BsplineSurface3d>(surface);
 	}
 	void BsplineSurface3d::updatePatches() {
+		MN_INSTRUMENT_TIMER(UpdatePatches);
 		// Insert knots in both directions
 		insertKnotFull(0);
 		insertKnotFull(1);
@@ -249,6 +273,7 @@ namespace MN {
 	Vec3 BsplineSurface3d::evaluate(double u, double v) const {
 		for (const auto& patch : patches) {
 			if (patch.domainHas(u, v)) {
+				MN_INSTRUMENT_ADD(PatchScans, &patch - patches.data() + 1);
 				double nu = (u - patch.uSubdomain.beg()) / patch.uSubdomain.width();
 				double nv = (v - patch.vSubdomain.beg()) / patch.vSubdomain.width();
 				return patch.patch->evaluate(nu, nv);
@@ -259,6 +284,7 @@ namespace MN {
 	Vec3 BsplineSurface3d::differentiate(double u, double v, int uOrder, int vOrder) const {
 		for (const auto& patch : patches) {
 			if (patch.domainHas(u, v)) {
+				MN_INSTRUMENT_ADD(PatchScans, &patch - patches.data() + 1);
 				double uWidth, vWidth;
 				uWidth = patch.uSubdomain.width();
 				vWidth = patch.vSubdomain.width();
@@ -281,4 +307,101 @@ namespace MN {
 		}
 		throw(std::runtime_error("Invalid parameter for Bspline surface differentiation"));
 	}
+	BsplineSurface3d::Jet BsplineSurface3d::jet(double u, double v) const {
+		for (const auto& patch : patches) {
+			if (patch.domainHas(u, v)) {
+				MN_INSTRUMENT_ADD(PatchScans, &patch - patches.data() + 1);
+				double uWidth, vWidth;
+				uWidth = patch.uSubdomain.width();
+				vWidth = patch.vSubdomain.width();
+				double nu = (u - patch.uSubdomain.beg()) / uWidth;
+				double nv = (v - patch.vSubdomain.beg()) / vWidth;
+				Jet j = patch.patch->jet(nu, nv);
+
+				j.Su /= uWidth;
+				j.Sv /= vWidth;
+				j.Suu /= SQ(uWidth);
+				j.Suv /= (uWidth * vWidth);
+				j.Svv /= SQ(vWidth);
+				return j;
+			}
+		}
+		throw(std::runtime_error("Invalid parameter for Bspline surface jet"));
+	}
+	void BsplineSurface3d::curvatureGrid(const std::vector<Real>& uParams, const std::vector<Real>& vParams, CurvatureGrid& grid) const {
+		MN_INSTRUMENT_TIMER(CurvatureGrid);
+		int uNum = (int)uParams.size(), vNum = (int)vParams.size();
+		int rowNum = uDegree + 1, colNum = vDegree + 1;
+		grid.resize(uNum, vNum);
+		if (uNum == 0 || vNum == 0)
+			return;
+
+		// Patch of each cell between breaks
+		std::vector<Real> uBreaks, vBreaks;
+		collectBreaks(patches, 0, uBreaks);
+		collectBreaks(patches, 1, vBreaks);
+		int vSpanNum = (int)vBreaks.size() - 1;
+		std::vector<int> cellPatch((size_t)(uBreaks.size() - 1) * vSpanNum, -1);
+		for (int p = 0; p < (int)patches.size(); p++)
+			cellPatch[(size_t)findSpan(uBreaks, patches[p].uSubdomain.beg()) * vSpanNum + findSpan(vBreaks, patches[p].vSubdomain.beg())] = p;
+
+		// Basis of all orders of each V parameter in its span, shared by every row
+		std::vector<int> vSpan(vNum);
+		std::vector<Real> vScale(vNum);
+		std::vector<Real> vBasis((size_t)vNum * 3 * colNum);
+		for (int j = 0; j < vNum; j++) {
+			vSpan[j] = findSpan(vBreaks, vParams[j]);
+			Real width = vBreaks[vSpan[j] + 1] - vBreaks[vSpan[j]];
+			vScale[j] = 1.0 / width;
+			Real* basis = &vBasis[(size_t)j * 3 * colNum];
+			Bezier::calBasisJet((vParams[j] - vBreaks[vSpan[j]]) * vScale[j], vDegree, basis, basis + colNum, basis + 2 * colNum);
+		}
+		Parallel::forEach(0, (uNum + rowChunk - 1) / rowChunk, [&](int chunk) {
+			std::vector<Jet> jets(vNum);
+			Real uBasis[3][Bezier::maxDegree + 1];
+			Vec3 column[3][Bezier::maxDegree + 1];		// Control points of current patch contracted in U direction, for each order
+			int end = std::min((chunk + 1) * rowChunk, uNum);
+			for (int i = chunk * rowChunk; i < end; i++) {
+				int uSpan = findSpan(uBreaks, uParams[i]);
+				Real uScale = 1.0 / (uBreaks[uSpan + 1] - uBreaks[uSpan]);
+				Bezier::calBasisJet((uParams[i] - uBreaks[uSpan]) * uScale, uDegree, uBasis[0], uBasis[1], uBasis[2]);
+				int current = -1;
+				for (int j = 0; j < vNum; j++) {
+					int p = cellPatch[(size_t)uSpan * vSpanNum + vSpan[j]];
+					if (p < 0)
+						throw(std::runtime_error("Invalid parameter for Bspline surface curvature"));
+					if (p != current) {
+						const auto& pcpts = patches[p].patch->getCptsC();
+						for (int k = 0; k < colNum; k++) {
+							column[0][k] = column[1][k] = column[2][k] = Vec3::zero();
+							for (int r = 0; r < rowNum; r++) {
+								const Vec3& cpt = pcpts[r][k];
+								column[0][k] += cpt * uBasis[0][r];
+								column[1][k] += cpt * uBasis[1][r];
+								column[2][k] += cpt * uBasis[2][r];
+							}
+						}
+						current = p;
+					}
+					const Real* basis = &vBasis[(size_t)j * 3 * colNum];
+					Jet& jet = jets[j];
+					jet.Su = jet.Sv = jet.Suu = jet.Suv = jet.Svv = Vec3::zero();
+					for (int k = 0; k < colNum; k++) {
+						jet.Su += column[1][k] * basis[k];
+						jet.Sv += column[0][k] * basis[colNum + k];
+						jet.Suu += column[2][k] * basis[k];
+						jet.Suv += column[1][k] * basis[colNum + k];
+						jet.Svv += column[0][k] * basis[2 * colNum + k];
+					}
+					Real vs = vScale[j];
+					jet.Su *= uScale;
+					jet.Sv *= vs;
+					jet.Suu *= uScale * uScale;
+					jet.Suv *= uScale * vs;
+					jet.Svv *= vs * vs;
+				}
+				calCurvatureRow(jets.data(), vNum, grid, (size_t)i * vNum);
+			}
+		});
+	}
 }
\ No newline at end of file
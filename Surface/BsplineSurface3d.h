@@ -51,6 +51,9 @@ namespace MN {
 		void updatePatches();
 		virtual Vec3 evaluate(double u, double v) const;
 		virtual Vec3 differentiate(double u, double v, int uOrder, int vOrder) const;
+		virtual Jet jet(double u, double v) const;
+		// Patch of each parameter is found by binary search over patch breaks, and basis is shared over rows and columns of the same patch
+		virtual void curvatureGrid(const std::vector<Real>& uParams, const std::vector<Real>& vParams, CurvatureGrid& grid) const;
 	};
 }
 
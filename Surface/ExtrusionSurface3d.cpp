@@ -1,4 +1,5 @@
 #include "ExtrusionSurface3d.h"
+#include "../Parallel.h"
 
 namespace MN {
 	ExtrusionSurface3d ExtrusionSurface3d::create(const Freeform2dc::Ptr profile) {
@@ -60,4 +61,29 @@ namespace MN {
 		else
 			throw(std::runtime_error("Extrusion surface differentiation is only allowed up to 2nd derivatives"));
 	}
+	void ExtrusionSurface3d::curvatureGrid(const std::vector<Real>& uParams, const std::vector<Real>& vParams, CurvatureGrid& grid) const {
+		int uNum = (int)uParams.size(), vNum = (int)vParams.size();
+		grid.resize(uNum, vNum);
+		if (vNum == 0)
+			return;
+		Parallel::forEach(0, uNum, [&](int i) {
+			Jet jet;
+			Vec2 d1 = profile->differentiate(uParams[i], 1);
+			Vec2 d2 = profile->differentiate(uParams[i], 2);
+			jet.Su = { d1[0], d1[1], 0 };
+			jet.Sv = { 0, 0, 1 };
+			jet.Suu = { d2[0], d2[1], 0 };
+			jet.Suv = jet.Svv = Vec3::zero();
+			size_t row = (size_t)i * vNum;
+			calCurvatureRow(&jet, 1, grid, row);
+			for (int j = 1; j < vNum; j++) {
+				grid.K[row + j] = grid.K[row];
+				grid.H[row + j] = grid.H[row];
+				grid.k1[row + j] = grid.k1[row];
+				grid.k2[row + j] = grid.k2[row];
+				grid.w1[row + j] = grid.w1[row];
+				grid.w2[row + j] = grid.w2[row];
+			}
+		}, 16);
+	}
 }
\ No newline at end of file
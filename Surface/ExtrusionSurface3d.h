@@ -37,6 +37,8 @@ namespace MN {
 		// v : Parameter for extrusion along Z axis
 		virtual Vec3 evaluate(Real u, Real v) const;
 		virtual Vec3 differentiate(Real u, Real v, int uOrder, int vOrder) const;
+		// Curvature does not change along extrusion, so it is computed once for each U parameter
+		virtual void curvatureGrid(const std::vector<Real>& uParams, const std::vector<Real>& vParams, CurvatureGrid& grid) const;
 	};
 }
 
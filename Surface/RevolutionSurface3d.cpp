@@ -1,4 +1,5 @@
 #include "RevolutionSurface3d.h"
+#include "../Parallel.h"
 
 namespace MN {
 	RevolutionSurface3d RevolutionSurface3d::create(const Freeform2dc::Ptr profile) {
@@ -68,4 +69,29 @@ namespace MN {
 		else
 			throw(std::runtime_error("Revolution surface differentiation is only allowed up to 2nd derivatives"));
 	}
+	void RevolutionSurface3d::curvatureGrid(const std::vector<Real>& uParams, const std::vector<Real>& vParams, CurvatureGrid& grid) const {
+		int uNum = (int)uParams.size(), vNum = (int)vParams.size();
+		grid.resize(uNum, vNum);
+		std::vector<Real> cosV(vNum), sinV(vNum);
+		for (int j = 0; j < vNum; j++) {
+			cosV[j] = cos(vParams[j]);
+			sinV[j] = sin(vParams[j]);
+		}
+		Parallel::forEach(0, uNum, [&](int i) {
+			Vec2 p = profile->evaluate(uParams[i]);
+			Vec2 d1 = profile->differentiate(uParams[i], 1);
+			Vec2 d2 = profile->differentiate(uParams[i], 2);
+			std::vector<Jet> jets(vNum);
+			for (int j = 0; j < vNum; j++) {
+				Real c = cosV[j], s = sinV[j];
+				Jet& jet = jets[j];
+				jet.Su = { d1[0] * c, d1[1], d1[0] * s };
+				jet.Sv = { p[0] * -s, 0, p[0] * c };
+				jet.Suu = { d2[0] * c, d2[1], d2[0] * s };
+				jet.Suv = { d1[0] * -s, 0, d1[0] * c };
+				jet.Svv = { p[0] * -c, 0, p[0] * -s };
+			}
+			calCurvatureRow(jets.data(), vNum, grid, (size_t)i * vNum);
+		});
+	}
 }
\ No newline at end of file
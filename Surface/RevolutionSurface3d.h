@@ -38,6 +38,8 @@ namespace MN {
 		// v : Parameter for rotation around Y axis
 		virtual Vec3 evaluate(Real u, Real v) const;
 		virtual Vec3 differentiate(Real u, Real v, int uOrder, int vOrder) const;
+		// Profile is evaluated once for each U parameter, and rotation once for each V parameter
+		virtual void curvatureGrid(const std::vector<Real>& uParams, const std::vector<Real>& vParams, CurvatureGrid& grid) const;
 	};
 }
 
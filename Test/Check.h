@@ -0,0 +1,49 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_TEST_CHECK_H__
+#define __MN_TEST_CHECK_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+
+// Checks shared by test executables, each of which is registered to CTest and fails by nonzero exit code
+namespace MN {
+	namespace Test {
+		static int failures = 0;
+
+		inline void check(bool condition, const char* what, const char* file, int line) {
+			if (condition)
+				return;
+			std::printf("%s:%d: check failed : %s\n", file, line, what);
+			failures++;
+		}
+		// Run [ body ], which fails on uncaught exception, and return exit code of test
+		template<typename Body>
+		inline int run(const char* name, const Body& body) {
+			try {
+				body();
+			}
+			catch (const std::exception& e) {
+				std::printf("%s : unexpected exception : %s\n", name, e.what());
+				failures++;
+			}
+			std::printf("%s : %d failure(s)\n", name, failures);
+			return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+}
+
+#define MN_CHECK(condition) MN::Test::check((condition), #condition, __FILE__, __LINE__)
+
+#endif
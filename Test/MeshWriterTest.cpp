@@ -0,0 +1,229 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+// Mesh of grid and of Bspline surface written in OBJ, binary STL and binary PLY, and read back
+// Counts in headers must match writer, and vertices of every triangle must be points of grid in single precision
+
+#include "../IO/MeshWriter.h"
+#include "Check.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+using namespace MN;
+
+class Mesh {
+public:
+	std::vector<Vec3> vertices;
+	std::vector<int> indices;		// Empty for STL, whose triangles hold their own vertices
+};
+
+static std::string readFile(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+// Value of little endian bytes, as written by binary formats
+template<typename T>
+static T readLittle(const std::string& data, size_t& pos) {
+	unsigned char bytes[sizeof(T)];
+	for (size_t b = 0; b < sizeof(T); b++)
+		bytes[b] = (unsigned char)data[pos + b];
+	uint64_t bits = 0;
+	for (size_t b = sizeof(T); b > 0; b--)
+		bits = (bits << 8) | bytes[b - 1];
+	T value;
+	if (sizeof(T) == 4) {
+		uint32_t word = (uint32_t)bits;
+		std::memcpy(&value, &word, sizeof(T));
+	}
+	else {
+		uint16_t half = (uint16_t)bits;
+		std::memcpy(&value, &half, sizeof(T));
+	}
+	pos += sizeof(T);
+	return value;
+}
+static Mesh readObj(const std::string& path) {
+	Mesh mesh;
+	std::istringstream stream(readFile(path));
+	std::string tag;
+	while (stream >> tag) {
+		if (tag == "v") {
+			Vec3 v;
+			stream >> v[0] >> v[1] >> v[2];
+			mesh.vertices.push_back(v);
+		}
+		else if (tag == "f") {
+			for (int c = 0; c < 3; c++) {
+				int index;
+				stream >> index;
+				mesh.indices.push_back(index - 1);
+			}
+		}
+	}
+	return mesh;
+}
+static Mesh readStl(const std::string& path, uint32_t& count) {
+	Mesh mesh;
+	std::string data = readFile(path);
+	size_t pos = 80;
+	count = readLittle<uint32_t>(data, pos);
+	MN_CHECK(data.size() == 84 + (size_t)count * 50);
+	for (uint32_t t = 0; t < count && pos + 50 <= data.size(); t++) {
+		pos += 12;		// Normal
+		for (int c = 0; c < 3; c++) {
+			Vec3 v;
+			for (int d = 0; d < 3; d++)
+				v[d] = readLittle<float>(data, pos);
+			mesh.vertices.push_back(v);
+		}
+		MN_CHECK(readLittle<uint16_t>(data, pos) == 0);
+	}
+	return mesh;
+}
+static Mesh readPly(const std::string& path) {
+	Mesh mesh;
+	std::string data = readFile(path);
+	size_t end = data.find("end_header\n");
+	MN_CHECK(end != std::string::npos);
+	if (end == std::string::npos)
+		return mesh;
+	MN_CHECK(data.find("format binary_little_endian 1.0") != std::string::npos);
+	std::istringstream header(data.substr(0, end));
+	std::string line;
+	size_t vertexNum = 0, faceNum = 0;
+	while (std::getline(header, line)) {
+		if (line.rfind("element vertex ", 0) == 0)
+			vertexNum = std::stoull(line.substr(15));
+		else if (line.rfind("element face ", 0) == 0)
+			faceNum = std::stoull(line.substr(13));
+	}
+	size_t pos = end + 11;
+	MN_CHECK(data.size() == pos + vertexNum * 12 + faceNum * 13);
+	if (data.size() != pos + vertexNum * 12 + faceNum * 13)
+		return mesh;
+	for (size_t i = 0; i < vertexNum; i++) {
+		Vec3 v;
+		for (int d = 0; d < 3; d++)
+			v[d] = readLittle<float>(data, pos);
+		mesh.vertices.push_back(v);
+	}
+	for (size_t f = 0; f < faceNum; f++) {
+		MN_CHECK(data[pos] == 3);
+		pos++;
+		for (int c = 0; c < 3; c++)
+			mesh.indices.push_back((int)readLittle<uint32_t>(data, pos));
+	}
+	return mesh;
+}
+// Triangles of mesh as vertex triples
+static std::vector<Vec3> triangleVertices(const Mesh& mesh) {
+	if (mesh.indices.empty())
+		return mesh.vertices;
+	std::vector<Vec3> result;
+	for (int index : mesh.indices) {
+		MN_CHECK(index >= 0 && index < (int)mesh.vertices.size());
+		if (index >= 0 && index < (int)mesh.vertices.size())
+			result.push_back(mesh.vertices[index]);
+	}
+	return result;
+}
+static Vec3 toFloat(const Vec3& v) {
+	return Vec3{ (float)v[0], (float)v[1], (float)v[2] };
+}
+
+static void testGrid() {
+	const int uNum = 5, vNum = 4;
+	std::vector<Vec3> points;
+	for (int i = 0; i < uNum; i++)
+		for (int j = 0; j < vNum; j++)
+			points.push_back(Vec3{ i * 0.25, j * 0.3 + 0.1, sin(i * 0.7 + j) });
+	// Triangles that writer makes for each cell, facing (d / di) x (d / dj)
+	std::vector<Vec3> expected;
+	for (int i = 0; i < uNum - 1; i++)
+		for (int j = 0; j < vNum - 1; j++) {
+			int a = i * vNum + j, b = a + vNum, c = b + 1, d = a + 1;
+			for (int index : { a, b, c, a, c, d })
+				expected.push_back(toFloat(points[index]));
+		}
+
+	const MeshWriter::Format formats[] = { MeshWriter::Format::Obj, MeshWriter::Format::Stl, MeshWriter::Format::Ply };
+	const char* paths[] = { "MeshWriterTest.obj", "MeshWriterTest.stl", "MeshWriterTest.ply" };
+	for (int f = 0; f < 3; f++) {
+		auto writer = MeshWriter::createPtr(paths[f], formats[f]);
+		writer->writeGrid(points.data(), uNum, vNum);
+		MN_CHECK(writer->getTriangleNum() == (uint64_t)(uNum - 1) * (vNum - 1) * 2);
+		writer->close();
+
+		Mesh mesh;
+		uint32_t count = 0;
+		if (formats[f] == MeshWriter::Format::Obj)
+			mesh = readObj(paths[f]);
+		else if (formats[f] == MeshWriter::Format::Stl) {
+			mesh = readStl(paths[f], count);
+			MN_CHECK(count == writer->getTriangleNum());
+		}
+		else
+			mesh = readPly(paths[f]);
+		if (!mesh.indices.empty())
+			MN_CHECK(mesh.vertices.size() == points.size());
+
+		std::vector<Vec3> vertices = triangleVertices(mesh);
+		MN_CHECK(vertices.size() == expected.size());
+		Real error = 0;
+		for (size_t i = 0; i < vertices.size() && i < expected.size(); i++)
+			error = std::max(error, (vertices[i] - expected[i]).len());
+		// OBJ text is shortest representation of float, which reads back to same float
+		MN_CHECK(error <= 1e-6);
+	}
+}
+static void testSurface() {
+	int n = 6;
+	BsplineSurface3d::ControlPoints cpts(n, std::vector<Vec3>(n));
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			cpts[i][j] = Vec3{ (Real)i, (Real)j, 0.5 * sin(i + j * 0.5) };
+	auto knots = Bspline::createOpenUniformKnotVector(3, n);
+	auto surface = BsplineSurface3d::create(3, 3, knots, knots, cpts);
+	const int resolution = 4;
+
+	auto writer = MeshWriter::createPtr("MeshWriterTestSurface.ply", MeshWriter::Format::Ply);
+	writer->writeSurface(surface, resolution);
+	writer->close();
+	size_t patchNum = surface.patches.size();
+	MN_CHECK(writer->getVertexNum() == patchNum * (resolution + 1) * (resolution + 1));
+	MN_CHECK(writer->getTriangleNum() == patchNum * resolution * resolution * 2);
+
+	Mesh mesh = readPly("MeshWriterTestSurface.ply");
+	MN_CHECK(mesh.vertices.size() == writer->getVertexNum());
+	MN_CHECK(mesh.indices.size() == writer->getTriangleNum() * 3);
+	// Every vertex lies on surface, so it is within float precision of its projection along grid
+	Real error = 0;
+	for (size_t p = 0; p < patchNum && mesh.vertices.size() == writer->getVertexNum(); p++) {
+		const auto& patch = *surface.patches[p].patch;
+		for (int i = 0; i <= resolution; i++)
+			for (int j = 0; j <= resolution; j++) {
+				Real
+					u = patch.getDomainC(0).beg() + patch.getDomainC(0).width() * i / resolution,
+					v = patch.getDomainC(1).beg() + patch.getDomainC(1).width() * j / resolution;
+				const Vec3& vertex = mesh.vertices[(p * (resolution + 1) + i) * (resolution + 1) + j];
+				error = std::max(error, (vertex - patch.evaluate(u, v)).len());
+			}
+	}
+	MN_CHECK(error <= 1e-5);
+}
+
+int main() {
+	return Test::run("MeshWriterTest", [] {
+		testGrid();
+		testSurface();
+	});
+}
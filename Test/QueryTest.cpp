@@ -0,0 +1,224 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+// Closest point projection and ray intersection against brute force over dense samples
+// Surface is height field whose x and y equal to (u, v), by control points at Greville abscissae,
+// so that vertical rays have exact answer, and other rays are compared with dense tessellation
+
+#include "../Query/ClosestPoint.h"
+#include "../Query/RayIntersector3d.h"
+#include "Check.h"
+#include <cmath>
+#include <random>
+
+using namespace MN;
+
+const static int surfaceCpts = 9;
+const static int bruteGrid = 300;		// Intervals of brute force samples of surface in each direction
+const static int bruteCurve = 20000;	// Intervals of brute force samples of curve
+
+static Real height(Real x, Real y) {
+	return 0.25 * sin(5.0 * x + 1.0) * cos(4.0 * y);
+}
+// Average of [degree] knots after [i], where linear function of parameter takes its control value
+static Real greville(const KnotVector& knots, int degree, int i) {
+	Real sum = 0;
+	for (int k = 1; k <= degree; k++)
+		sum += knots[i + k];
+	return sum / degree;
+}
+static BsplineSurface3d::Ptr createHeightField() {
+	const int degree = 3;
+	auto knots = Bspline::createOpenUniformKnotVector(degree, surfaceCpts);
+	BsplineSurface3d::ControlPoints cpts(surfaceCpts, std::vector<Vec3>(surfaceCpts));
+	for (int i = 0; i < surfaceCpts; i++)
+		for (int j = 0; j < surfaceCpts; j++) {
+			Real x = greville(knots, degree, i), y = greville(knots, degree, j);
+			cpts[i][j] = Vec3{ x, y, height(x, y) };
+		}
+	return BsplineSurface3d::createPtr(degree, degree, knots, knots, cpts);
+}
+// Hit of ray with triangle (a, b, c) at [t], by Moller-Trumbore
+static bool intersectTriangle(const Vec3& origin, const Vec3& dir, const Vec3& a, const Vec3& b, const Vec3& c, Real& t) {
+	Vec3 e1 = b - a, e2 = c - a, p = dir.cross(e2);
+	Real det = e1.dot(p);
+	if (fabs(det) < 1e-15)
+		return false;
+	Real inv = 1.0 / det;
+	Vec3 s = origin - a;
+	Real u = s.dot(p) * inv;
+	if (u < 0 || u > 1)
+		return false;
+	Vec3 q = s.cross(e1);
+	Real v = dir.dot(q) * inv;
+	if (v < 0 || u + v > 1)
+		return false;
+	t = e2.dot(q) * inv;
+	return t > 0;
+}
+
+static void testSurfaceProjection(const BsplineSurface3d::Ptr& surface, std::mt19937& rng) {
+	std::uniform_real_distribution<Real> uniform(0, 1);
+	std::vector<Vec3> samples;
+	for (int i = 0; i <= bruteGrid; i++)
+		for (int j = 0; j <= bruteGrid; j++)
+			samples.push_back(surface->evaluate((Real)i / bruteGrid, (Real)j / bruteGrid));
+	// Distance between neighboring samples bounds how much nearest sample exceeds true distance
+	Real spacing = 0;
+	for (int i = 0; i < bruteGrid; i++)
+		spacing = std::max(spacing, (samples[(size_t)(i + 1) * (bruteGrid + 1) + i] - samples[(size_t)i * (bruteGrid + 1) + i]).len());
+
+	auto projector = SurfaceProjector3d::create(surface);
+	std::vector<Vec3> points(300);
+	for (auto& point : points)
+		point = Vec3{ uniform(rng) * 1.4 - 0.2, uniform(rng) * 1.4 - 0.2, uniform(rng) - 0.5 };
+	std::vector<SurfaceProjector3d::Result> results;
+	projector.project(points, results);
+	MN_CHECK(results.size() == points.size());
+
+	Real excess = 0, shortfall = 0, error = 0;
+	for (size_t q = 0; q < points.size() && q < results.size(); q++) {
+		Real brute = std::numeric_limits<Real>::max();
+		for (const auto& sample : samples)
+			brute = std::min(brute, (sample - points[q]).len());
+		const auto& result = results[q];
+		excess = std::max(excess, result.distance - brute);
+		shortfall = std::max(shortfall, brute - result.distance);
+		error = std::max(error, (surface->evaluate(result.u, result.v) - result.point).len());
+		error = std::max(error, fabs((points[q] - result.point).len() - result.distance));
+
+		// Single query gives the same closest point
+		auto single = projector.project(points[q]);
+		MN_CHECK(fabs(single.distance - result.distance) <= 1e-9);
+	}
+	MN_CHECK(excess <= 1e-9);
+	MN_CHECK(shortfall <= spacing);
+	MN_CHECK(error <= 1e-9);
+}
+static void testCurveProjection(std::mt19937& rng) {
+	std::uniform_real_distribution<Real> uniform(0, 1);
+	const int n = 10;
+	BsplineCurve3d::ControlPoints cpts(n);
+	for (auto& cpt : cpts)
+		cpt = Vec3{ uniform(rng), uniform(rng), uniform(rng) };
+	auto curve = BsplineCurve3d::createPtr(3, Bspline::createOpenUniformKnotVector(3, n), cpts);
+	std::vector<Vec3> samples;
+	for (int i = 0; i <= bruteCurve; i++)
+		samples.push_back(curve->evaluate((Real)i / bruteCurve));
+
+	auto projector = CurveProjector3d::create(curve);
+	std::vector<Vec3> points(300);
+	for (auto& point : points)
+		point = Vec3{ uniform(rng) * 1.4 - 0.2, uniform(rng) * 1.4 - 0.2, uniform(rng) * 1.4 - 0.2 };
+	std::vector<CurveProjector3d::Result> results;
+	projector.project(points, results);
+
+	Real excess = 0, error = 0;
+	for (size_t q = 0; q < points.size() && q < results.size(); q++) {
+		Real brute = std::numeric_limits<Real>::max();
+		for (const auto& sample : samples)
+			brute = std::min(brute, (sample - points[q]).len());
+		excess = std::max(excess, results[q].distance - brute);
+		error = std::max(error, (curve->evaluate(results[q].t) - results[q].point).len());
+	}
+	MN_CHECK(excess <= 1e-9);
+	MN_CHECK(error <= 1e-9);
+}
+static void testRays(const BsplineSurface3d::Ptr& surface, std::mt19937& rng) {
+	std::uniform_real_distribution<Real> uniform(0, 1);
+	auto intersector = RayIntersector3d::create(surface);
+
+	// Vertical rays hit at (u, v) = (x, y) exactly, and miss outside of unit square
+	std::vector<Vec3> origins, dirs;
+	for (int i = 0; i < 200; i++) {
+		origins.push_back(Vec3{ uniform(rng) * 1.2 - 0.1, uniform(rng) * 1.2 - 0.1, 2.0 });
+		dirs.push_back(Vec3{ 0, 0, -1 });
+	}
+	std::vector<RayIntersector3d::Hit> hits;
+	intersector.intersectRays(origins, dirs, hits);
+	MN_CHECK(hits.size() == origins.size());
+	int wrongHit = 0;
+	Real error = 0;
+	for (size_t r = 0; r < origins.size() && r < hits.size(); r++) {
+		Real x = origins[r][0], y = origins[r][1];
+		bool inside = x >= 0 && x <= 1 && y >= 0 && y <= 1;
+		if (hits[r].hit != inside) {
+			// Rays on boundary of square may go either way
+			if (std::min(std::min(fabs(x), fabs(1 - x)), std::min(fabs(y), fabs(1 - y))) > 1e-9)
+				wrongHit++;
+			continue;
+		}
+		if (!inside)
+			continue;
+		Real z = surface->evaluate(x, y)[2];
+		error = std::max(error, fabs(hits[r].t - (2.0 - z)));
+		error = std::max(error, fabs(hits[r].u - x) + fabs(hits[r].v - y));
+	}
+	MN_CHECK(wrongHit == 0);
+	MN_CHECK(error <= 1e-8);
+
+	// Slanted rays toward points of surface, from above and below, against tessellation of surface
+	std::vector<Vec3> grid;
+	for (int i = 0; i <= bruteGrid; i++)
+		for (int j = 0; j <= bruteGrid; j++)
+			grid.push_back(surface->evaluate((Real)i / bruteGrid, (Real)j / bruteGrid));
+	origins.clear();
+	dirs.clear();
+	for (int i = 0; i < 100; i++) {
+		Vec3 target = surface->evaluate(uniform(rng), uniform(rng));
+		Vec3 origin{ uniform(rng) * 2 - 0.5, uniform(rng) * 2 - 0.5, (i % 2) ? 1.0 + uniform(rng) : -1.0 - uniform(rng) };
+		origins.push_back(origin);
+		dirs.push_back(target - origin);
+	}
+	intersector.intersectRays(origins, dirs, hits);
+	int missed = 0;
+	Real onSurface = 0, tDiff = 0;
+	for (size_t r = 0; r < origins.size() && r < hits.size(); r++) {
+		const auto& hit = hits[r];
+		if (!hit.hit) {
+			missed++;
+			continue;
+		}
+		Vec3 onRay = origins[r] + dirs[r] * hit.t;
+		onSurface = std::max(onSurface, (surface->evaluate(hit.u, hit.v) - onRay).len());
+		Real brute = std::numeric_limits<Real>::max();
+		for (int i = 0; i < bruteGrid; i++)
+			for (int j = 0; j < bruteGrid; j++) {
+				const Vec3
+					& a = grid[(size_t)i * (bruteGrid + 1) + j],
+					& b = grid[(size_t)(i + 1) * (bruteGrid + 1) + j],
+					& c = grid[(size_t)i * (bruteGrid + 1) + j + 1],
+					& d = grid[(size_t)(i + 1) * (bruteGrid + 1) + j + 1];
+				Real t;
+				if (intersectTriangle(origins[r], dirs[r], a, b, c, t))
+					brute = std::min(brute, t);
+				if (intersectTriangle(origins[r], dirs[r], b, d, c, t))
+					brute = std::min(brute, t);
+			}
+		tDiff = std::max(tDiff, fabs(brute - hit.t));
+
+		// Single ray gives the same hit as packet
+		auto single = intersector.intersectRay(origins[r], dirs[r]);
+		MN_CHECK(single.hit && fabs(single.t - hit.t) <= 1e-12);
+	}
+	// Every ray aims at point of surface
+	MN_CHECK(missed == 0);
+	MN_CHECK(onSurface <= 1e-8);
+	// Tessellation is off surface by its chord error
+	MN_CHECK(tDiff <= 1e-3);
+}
+
+int main() {
+	return Test::run("QueryTest", [] {
+		std::mt19937 rng(7);
+		auto surface = createHeightField();
+		testSurfaceProjection(surface, rng);
+		testCurveProjection(rng);
+		testRays(surface, rng);
+	});
+}
@@ -0,0 +1,127 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+// Save and load of curve, surface and volume through FreeformStore, with every combination of optional sections
+// Loaded entity must evaluate and differentiate the same as saved one, and wrong entity or file must be rejected
+
+#include "../IO/FreeformStore.h"
+#include "Check.h"
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+using namespace MN;
+
+const static Real storeTol = 1e-12;
+const static int sectionSets[] = { 0, FreeformStore::Patches, FreeformStore::Patches | FreeformStore::DerivMats };
+
+// Parameters spread over domain by irrational steps
+static Real sampleParam(int i, Real step) {
+	return std::fmod(i * step, 1.0);
+}
+static void testCurve() {
+	int n = 9;
+	BsplineCurve3d::ControlPoints cpts(n);
+	for (int i = 0; i < n; i++)
+		cpts[i] = Vec3{ (Real)i, sin(i * 0.5), cos(i * 0.3) };
+	auto curve = BsplineCurve3d::create(3, Bspline::createOpenUniformKnotVector(3, n), cpts);
+	for (int sections : sectionSets) {
+		FreeformStore::save("StoreTestCurve.mnf", curve, sections);
+		auto view = FreeformStore::open("StoreTestCurve.mnf");
+		MN_CHECK(view.getEntity() == FreeformStore::Entity::BsplineCurve3d);
+		MN_CHECK(view.hasPatches() == ((sections & FreeformStore::Patches) != 0));
+		auto loaded = FreeformStore::loadCurve(view);
+		MN_CHECK(loaded->getPatchVectorC().size() == curve.getPatchVectorC().size());
+		Real error = 0;
+		for (int i = 0; i <= 500; i++) {
+			Real t = i / 500.0;
+			error = std::max(error, (loaded->evaluate(t) - curve.evaluate(t)).len());
+			error = std::max(error, (loaded->differentiate(t, 2) - curve.differentiate(t, 2)).len());
+		}
+		MN_CHECK(error <= storeTol);
+	}
+}
+static void testSurface() {
+	int n = 8;
+	BsplineSurface3d::ControlPoints cpts(n, std::vector<Vec3>(n + 1));
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j <= n; j++)
+			cpts[i][j] = Vec3{ (Real)i, (Real)j, sin(i * 0.3) * cos(j * 0.2) };
+	auto surface = BsplineSurface3d::create(3, 2, Bspline::createOpenUniformKnotVector(3, n), Bspline::createOpenUniformKnotVector(2, n + 1), cpts);
+	for (int sections : sectionSets) {
+		FreeformStore::save("StoreTestSurface.mnf", surface, sections);
+		auto view = FreeformStore::open("StoreTestSurface.mnf");
+		MN_CHECK(view.getEntity() == FreeformStore::Entity::BsplineSurface3d);
+		MN_CHECK(view.hasDerivMats() == ((sections & FreeformStore::DerivMats) != 0));
+		auto loaded = FreeformStore::loadSurface(view);
+		MN_CHECK(loaded->patches.size() == surface.patches.size());
+		Real error = 0;
+		for (int i = 0; i < 1000; i++) {
+			Real u = sampleParam(i, 0.6180339887), v = sampleParam(i, 0.4142135623);
+			error = std::max(error, (loaded->evaluate(u, v) - surface.evaluate(u, v)).len());
+			error = std::max(error, (loaded->differentiate(u, v, 1, 1) - surface.differentiate(u, v, 1, 1)).len());
+		}
+		MN_CHECK(error <= storeTol);
+	}
+}
+static void testVolume() {
+	int n = 6;
+	BsplineVolume3d::ControlPoints cpts(n, std::vector<std::vector<Vec3>>(n, std::vector<Vec3>(n)));
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			for (int k = 0; k < n; k++)
+				cpts[i][j][k] = Vec3{ i + 0.1 * sin(j * 1.0), j + 0.1 * cos(k * 1.0), k + 0.05 * i * i };
+	auto knots = Bspline::createOpenUniformKnotVector(2, n);
+	auto volume = BsplineVolume3d::create(2, 2, 2, knots, knots, knots, cpts);
+	for (int sections : sectionSets) {
+		FreeformStore::save("StoreTestVolume.mnf", volume, sections);
+		auto loaded = FreeformStore::loadVolume(FreeformStore::open("StoreTestVolume.mnf"));
+		MN_CHECK(loaded->patches.size() == volume.patches.size());
+		Real error = 0;
+		for (int i = 0; i < 1000; i++) {
+			Real u = sampleParam(i, 0.6180339887), v = sampleParam(i, 0.4142135623), w = sampleParam(i, 0.7320508075);
+			error = std::max(error, (loaded->evaluate(u, v, w) - volume.evaluate(u, v, w)).len());
+			error = std::max(error, (loaded->differentiate(u, v, w, 1, 0, 1) - volume.differentiate(u, v, w, 1, 0, 1)).len());
+		}
+		MN_CHECK(error <= storeTol);
+	}
+}
+static void testRejection() {
+	bool thrown = false;
+	try {
+		FreeformStore::loadCurve(FreeformStore::open("StoreTestSurface.mnf"));
+	}
+	catch (const std::runtime_error&) {
+		thrown = true;
+	}
+	MN_CHECK(thrown);
+
+	std::FILE* file = std::fopen("StoreTestInvalid.mnf", "wb");
+	MN_CHECK(file != nullptr);
+	if (file) {
+		std::fputs("not a freeform store", file);
+		std::fclose(file);
+	}
+	thrown = false;
+	try {
+		FreeformStore::open("StoreTestInvalid.mnf");
+	}
+	catch (const std::runtime_error&) {
+		thrown = true;
+	}
+	MN_CHECK(thrown);
+}
+
+int main() {
+	return Test::run("StoreTest", [] {
+		testCurve();
+		testSurface();
+		testVolume();
+		testRejection();
+	});
+}
@@ -0,0 +1,186 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+// Pieces from every subdivision path of Bezier curve, surface and volume must evaluate the same as parent
+// over their subdomains, with derivatives scaled by width of subdomain, and must be contained in their bounds
+
+#include "../Curve/BezierCurve3d.h"
+#include "../Surface/BezierSurface3d.h"
+#include "../Volume/BezierVolume3d.h"
+#include "Check.h"
+#include <cmath>
+
+using namespace MN;
+
+const static Real pieceTol = 1e-12;
+const static Real boundTol = 1e-12;
+const static int samples = 6;		// Intervals of parameters sampled on each piece in each direction
+
+static Vec3 samplePoint(int i) {
+	return Vec3{ sin(i * 1.3), cos(i * 0.7), sin(i * 0.3 + 1.0) };
+}
+static Real lerp(Real beg, Real end, Real t) {
+	return beg + (end - beg) * t;
+}
+static bool contains(AABB3d bound, const Vec3& point) {
+	bound.inflate(boundTol);
+	return bound.has(point);
+}
+
+// Piece over [beg, end] of parent, checked at samples with first derivative
+static void checkPiece(const BezierCurve3d& parent, const BezierCurve3d& piece, Real beg, Real end, bool derivs = true) {
+	Real error = 0;
+	bool inside = true;
+	for (int i = 0; i <= samples; i++) {
+		Real t = (Real)i / samples, s = lerp(beg, end, t);
+		Vec3 point = piece.evaluate(t);
+		error = std::max(error, (point - parent.evaluate(s)).len());
+		if (derivs)
+			error = std::max(error, (piece.differentiate(t, 1) - parent.differentiate(s, 1) * (end - beg)).len());
+		inside = inside && contains(piece.getBound(), point);
+	}
+	MN_CHECK(error <= pieceTol);
+	MN_CHECK(inside);
+}
+static void checkPiece(const BezierSurface3d& parent, const BezierSurface3d& piece, const Real* range, bool derivs = true) {
+	Real error = 0;
+	bool inside = true;
+	for (int i = 0; i <= samples; i++)
+		for (int j = 0; j <= samples; j++) {
+			Real u = (Real)i / samples, v = (Real)j / samples;
+			Real pu = lerp(range[0], range[1], u), pv = lerp(range[2], range[3], v);
+			Vec3 point = piece.evaluate(u, v);
+			error = std::max(error, (point - parent.evaluate(pu, pv)).len());
+			if (derivs) {
+				Vec3 diff = piece.differentiate(u, v, 1, 1) - parent.differentiate(pu, pv, 1, 1) * ((range[1] - range[0]) * (range[3] - range[2]));
+				error = std::max(error, diff.len());
+			}
+			inside = inside && contains(piece.getBound(), point);
+		}
+	MN_CHECK(error <= pieceTol);
+	MN_CHECK(inside);
+}
+static void checkPiece(const BezierVolume3d& parent, const BezierVolume3d& piece, const Real* range, bool derivs = true) {
+	Real error = 0;
+	bool inside = true;
+	for (int i = 0; i <= samples; i++)
+		for (int j = 0; j <= samples; j++)
+			for (int k = 0; k <= samples; k++) {
+				Real u = (Real)i / samples, v = (Real)j / samples, w = (Real)k / samples;
+				Real pu = lerp(range[0], range[1], u), pv = lerp(range[2], range[3], v), pw = lerp(range[4], range[5], w);
+				Vec3 point = piece.evaluate(u, v, w);
+				error = std::max(error, (point - parent.evaluate(pu, pv, pw)).len());
+				if (derivs) {
+					Vec3 diff = piece.differentiate(u, v, w, 0, 1, 0) - parent.differentiate(pu, pv, pw, 0, 1, 0) * (range[3] - range[2]);
+					error = std::max(error, diff.len());
+				}
+				inside = inside && contains(piece.getBound(), point);
+			}
+	MN_CHECK(error <= pieceTol);
+	MN_CHECK(inside);
+}
+
+static void testCurve() {
+	for (int degree = 1; degree <= 7; degree++) {
+		BezierCurve3d::ControlPoints cpts(degree + 1);
+		for (int i = 0; i <= degree; i++)
+			cpts[i] = samplePoint(i + degree);
+		auto curve = BezierCurve3d::create(degree, cpts);
+		// Split pieces have no deriv matrices until they are updated
+		auto lower = BezierCurve3d::create(), upper = BezierCurve3d::create();
+		curve.subdivide(0.35, lower, upper);
+		checkPiece(curve, lower, 0.0, 0.35, false);
+		checkPiece(curve, upper, 0.35, 1.0, false);
+		lower.updateDerivMat();
+		checkPiece(curve, lower, 0.0, 0.35);
+		checkPiece(curve, *curve.subdivide(Domain::create(0.2, 0.65)), 0.2, 0.65);
+	}
+}
+static void testSurface() {
+	for (int degree = 1; degree <= 5; degree++) {
+		int vDegree = degree + 1;
+		BezierSurface3d::ControlPoints cpts(degree + 1, std::vector<Vec3>(vDegree + 1));
+		for (int i = 0; i <= degree; i++)
+			for (int j = 0; j <= vDegree; j++)
+				cpts[i][j] = samplePoint(i * 7 + j);
+		auto surface = BezierSurface3d::create(degree, vDegree, cpts);
+
+		// Pieces with and without deriv matrices, and one piece overwriting parent copy in place
+		for (bool buildMat : { true, false }) {
+			auto lower = surface, upper = surface;
+			surface.uSubdivide(0.4, lower, upper, buildMat);
+			Real lowerRange[4] = { 0.0, 0.4, 0.0, 1.0 }, upperRange[4] = { 0.4, 1.0, 0.0, 1.0 };
+			checkPiece(surface, lower, lowerRange, buildMat);
+			checkPiece(surface, upper, upperRange, buildMat);
+
+			auto inPlace = surface;
+			inPlace.vSubdivide(0.7, inPlace, upper, buildMat);
+			Real inPlaceRange[4] = { 0.0, 1.0, 0.0, 0.7 }, restRange[4] = { 0.0, 1.0, 0.7, 1.0 };
+			checkPiece(surface, inPlace, inPlaceRange, buildMat);
+			checkPiece(surface, upper, restRange, buildMat);
+		}
+		Real range[4] = { 0.1, 0.6, 0.25, 0.9 };
+		checkPiece(surface, *surface.subdivide(Domain::create(range[0], range[1]), Domain::create(range[2], range[3])), range);
+
+		const int levels = 2, num = 1 << levels;
+		auto pieces = surface.subdivideUniform(levels);
+		MN_CHECK((int)pieces.size() == num * num);
+		for (int a = 0; a < num && (int)pieces.size() == num * num; a++)
+			for (int b = 0; b < num; b++) {
+				Real cell[4] = { (Real)a / num, (Real)(a + 1) / num, (Real)b / num, (Real)(b + 1) / num };
+				checkPiece(surface, *pieces[a * num + b], cell, false);
+			}
+	}
+}
+static void testVolume() {
+	for (int degree = 1; degree <= 3; degree++) {
+		int vDegree = degree + 1, wDegree = 2;
+		BezierVolume3d::ControlPoints cpts(degree + 1, std::vector<std::vector<Vec3>>(vDegree + 1, std::vector<Vec3>(wDegree + 1)));
+		for (int i = 0; i <= degree; i++)
+			for (int j = 0; j <= vDegree; j++)
+				for (int k = 0; k <= wDegree; k++)
+					cpts[i][j][k] = samplePoint((i * 5 + j) * 3 + k);
+		auto volume = BezierVolume3d::create(degree, vDegree, wDegree, cpts);
+
+		for (bool buildMat : { true, false }) {
+			auto lower = BezierVolume3d::create(), upper = BezierVolume3d::create();
+			volume.uSubdivide(0.3, lower, upper, buildMat);
+			Real uLower[6] = { 0.0, 0.3, 0.0, 1.0, 0.0, 1.0 }, uUpper[6] = { 0.3, 1.0, 0.0, 1.0, 0.0, 1.0 };
+			checkPiece(volume, lower, uLower, buildMat);
+			checkPiece(volume, upper, uUpper, buildMat);
+			volume.vSubdivide(0.5, lower, upper, buildMat);
+			Real vLower[6] = { 0.0, 1.0, 0.0, 0.5, 0.0, 1.0 }, vUpper[6] = { 0.0, 1.0, 0.5, 1.0, 0.0, 1.0 };
+			checkPiece(volume, lower, vLower, buildMat);
+			checkPiece(volume, upper, vUpper, buildMat);
+			volume.wSubdivide(0.8, lower, upper, buildMat);
+			Real wLower[6] = { 0.0, 1.0, 0.0, 1.0, 0.0, 0.8 }, wUpper[6] = { 0.0, 1.0, 0.0, 1.0, 0.8, 1.0 };
+			checkPiece(volume, lower, wLower, buildMat);
+			checkPiece(volume, upper, wUpper, buildMat);
+		}
+		Real range[6] = { 0.2, 0.7, 0.1, 0.5, 0.3, 0.95 };
+		checkPiece(volume, *volume.subdivide(Domain::create(range[0], range[1]), Domain::create(range[2], range[3]), Domain::create(range[4], range[5])), range);
+
+		const int levels = 1, num = 1 << levels;
+		auto pieces = volume.subdivideUniform(levels);
+		MN_CHECK((int)pieces.size() == num * num * num);
+		for (int a = 0; a < num && (int)pieces.size() == num * num * num; a++)
+			for (int b = 0; b < num; b++)
+				for (int c = 0; c < num; c++) {
+					Real cell[6] = { (Real)a / num, (Real)(a + 1) / num, (Real)b / num, (Real)(b + 1) / num, (Real)c / num, (Real)(c + 1) / num };
+					checkPiece(volume, *pieces[(a * num + b) * num + c], cell, false);
+				}
+	}
+}
+
+int main() {
+	return Test::run("SubdivisionTest", [] {
+		testCurve();
+		testSurface();
+		testVolume();
+	});
+}
@@ -7,136 +7,210 @@
  */
 
 #include "BezierVolume3d.h"
+#include "../Parallel.h"
 
 namespace MN {
 	// BezierVolume3d
 	static const BezierVolume3d empty = BezierVolume3d::create(0, 0, 0, {}, false);
+	const static int maxUniformLevels = 7;		// Limit of levels of uniform subdivision, giving 8^7 sub-volumes
+
+	// Control points along U direction at (j, k), and along V direction at (i, k) of control net
+	template<typename Net, typename Point>
+	class BezierVolume3dUView {
+	public:
+		Net* net;
+		int j, k;
+
+		inline Point& operator[](int i) const noexcept {
+			return (*net)[i][j][k];
+		}
+	};
+	template<typename Net, typename Point>
+	class BezierVolume3dVView {
+	public:
+		Net* net;
+		int i, k;
+
+		inline Point& operator[](int j) const noexcept {
+			return (*net)[i][j][k];
+		}
+	};
 
 	void BezierVolume3d::subdivideCpts(const std::vector<Vec3>& cpts, Real t, std::vector<Vec3>& lower, std::vector<Vec3>& upper) {
-		// De Casteljou's algorithm
 		int size = (int)cpts.size();
 		lower.resize(size);
 		upper.resize(size);
-
-		Real t1 = 1 - t;
-
-		std::vector<Vec3> copy = cpts;
-		lower[0] = copy.front();
-		upper[size - 1] = copy.back();
-
-		int cnt = 1;
-		for (int i = size - 1; i > 0; i--) {
-			std::vector<Vec3> tmp;
-			tmp.resize(i);
-			for (int j = 0; j < i; j++)
-				tmp[j] = copy[j] * t1 + copy[j + 1] * t;
-			copy = tmp;
-
-			lower[cnt] = copy.front();
-			upper[size - cnt - 1] = copy.back();
-			cnt++;
-		}
+		Bezier::subdivide(cpts, size, t, Bezier::StridedView<Vec3>{ lower.data(), 1 }, Bezier::StridedView<Vec3>{ upper.data(), 1 });
+	}
+	void BezierVolume3d::prepareSubdivision(BezierVolume3d& piece) const {
+		piece.setDomain(0, Domain::create(0, 1));
+		piece.setDomain(1, Domain::create(0, 1));
+		piece.setDomain(2, Domain::create(0, 1));
+		piece.setDegree(0, uDegree);
+		piece.setDegree(1, vDegree);
+		piece.setDegree(2, wDegree);
+		piece.cpts.resize(cpts.size());
+		for (size_t i = 0; i < cpts.size(); i++) {
+			piece.cpts[i].resize(cpts[i].size());
+			for (size_t j = 0; j < cpts[i].size(); j++)
+				piece.cpts[i][j].resize(cpts[i][j].size());
+		}
+		for (auto* mat : { &piece.derivMatU, &piece.derivMatV, &piece.derivMatW,
+			&piece.derivMatUU, &piece.derivMatUV, &piece.derivMatUW, &piece.derivMatVV, &piece.derivMatVW, &piece.derivMatWW,
+			&piece.derivMatUUU, &piece.derivMatUUV, &piece.derivMatUUW, &piece.derivMatUVV, &piece.derivMatUVW,
+			&piece.derivMatUWW, &piece.derivMatVVV, &piece.derivMatVVW, &piece.derivMatVWW, &piece.derivMatWWW })
+			mat->clear();
+		piece.boundValid = false;
 	}
+	// Subdivision writes into control points of [lower] and [upper] in place, either of which may be this volume
 	void BezierVolume3d::uSubdivide(Real u, BezierVolume3d& lower, BezierVolume3d& upper, bool buildMat) const {
-		ControlPoints lowerCpts = cpts;
-		ControlPoints upperCpts = cpts;
+		using ConstView = BezierVolume3dUView<const ControlPoints, const Vec3>;
+		using View = BezierVolume3dUView<ControlPoints, Vec3>;
 		int uSize = (int)cpts.size();
 		int vSize = (int)cpts[0].size();
 		int wSize = (int)cpts[0][0].size();
-
-		std::vector<Vec3> lowerCol;
-		std::vector<Vec3> upperCol;
-		for (int i = 0; i < vSize; i++) {
-			for (int j = 0; j < wSize; j++) {
-				std::vector<Vec3> col;
-				col.resize(uSize);
-				for (int k = 0; k < uSize; k++)
-					col[k] = cpts[k][i][j];
-				subdivideCpts(col, u, lowerCol, upperCol);
-
-				for (int k = 0; k < uSize; k++) {
-					lowerCpts[k][i][j] = lowerCol[k];
-					upperCpts[k][i][j] = upperCol[k];
-				}
-			}
+		prepareSubdivision(lower);
+		prepareSubdivision(upper);
+		for (int i = 0; i < vSize; i++)
+			for (int j = 0; j < wSize; j++)
+				Bezier::subdivide(ConstView{ &cpts, i, j }, uSize, u, View{ &lower.cpts, i, j }, View{ &upper.cpts, i, j });
+		if (buildMat) {
+			lower.updateDerivMat();
+			upper.updateDerivMat();
+		}
+		else {
+			lower.updateBound();
+			upper.updateBound();
 		}
-
-		lower = BezierVolume3d::create(uDegree, vDegree, wDegree, lowerCpts, buildMat);
-		upper = BezierVolume3d::create(uDegree, vDegree, wDegree, upperCpts, buildMat);
 	}
 	void BezierVolume3d::vSubdivide(Real v, BezierVolume3d& lower, BezierVolume3d& upper, bool buildMat) const {
-		ControlPoints lowerCpts = cpts;
-		ControlPoints upperCpts = cpts;
+		using ConstView = BezierVolume3dVView<const ControlPoints, const Vec3>;
+		using View = BezierVolume3dVView<ControlPoints, Vec3>;
 		int uSize = (int)cpts.size();
 		int vSize = (int)cpts[0].size();
 		int wSize = (int)cpts[0][0].size();
-
-		std::vector<Vec3> lowerCol;
-		std::vector<Vec3> upperCol;
-		for (int i = 0; i < uSize; i++) {
-			for (int j = 0; j < wSize; j++) {
-				std::vector<Vec3> col;
-				col.resize(vSize);
-				for (int k = 0; k < vSize; k++)
-					col[k] = cpts[i][k][j];
-				subdivideCpts(col, v, lowerCol, upperCol);
-
-				for (int k = 0; k < vSize; k++) {
-					lowerCpts[i][k][j] = lowerCol[k];
-					upperCpts[i][k][j] = upperCol[k];
-				}
-			}
+		prepareSubdivision(lower);
+		prepareSubdivision(upper);
+		for (int i = 0; i < uSize; i++)
+			for (int j = 0; j < wSize; j++)
+				Bezier::subdivide(ConstView{ &cpts, i, j }, vSize, v, View{ &lower.cpts, i, j }, View{ &upper.cpts, i, j });
+		if (buildMat) {
+			lower.updateDerivMat();
+			upper.updateDerivMat();
+		}
+		else {
+			lower.updateBound();
+			upper.updateBound();
 		}
-
-		lower = BezierVolume3d::create(uDegree, vDegree, wDegree, lowerCpts, buildMat);
-		upper = BezierVolume3d::create(uDegree, vDegree, wDegree, upperCpts, buildMat);
 	}
 	void BezierVolume3d::wSubdivide(Real w, BezierVolume3d& lower, BezierVolume3d& upper, bool buildMat) const {
-		ControlPoints lowerCpts = cpts;
-		ControlPoints upperCpts = cpts;
 		int uSize = (int)cpts.size();
 		int vSize = (int)cpts[0].size();
 		int wSize = (int)cpts[0][0].size();
+		prepareSubdivision(lower);
+		prepareSubdivision(upper);
+		for (int i = 0; i < uSize; i++)
+			for (int j = 0; j < vSize; j++)
+				Bezier::subdivide(cpts[i][j], wSize, w, Bezier::StridedView<Vec3>{ lower.cpts[i][j].data(), 1 }, Bezier::StridedView<Vec3>{ upper.cpts[i][j].data(), 1 });
+		if (buildMat) {
+			lower.updateDerivMat();
+			upper.updateDerivMat();
+		}
+		else {
+			lower.updateBound();
+			upper.updateBound();
+		}
+	}
+	BezierVolume3d::Ptr BezierVolume3d::subdivide(const Domain& uSubdomain, const Domain& vSubdomain, const Domain& wSubdomain) const {
+		// Blossoming gives control points over subdomain at once, along U into the only allocated volume, then along V and W in place
+		int uSize = (int)cpts.size();
+		int vSize = (int)cpts[0].size();
+		int wSize = (int)cpts[0][0].size();
+		BezierVolume3d piece;
+		prepareSubdivision(piece);
+		for (int i = 0; i < vSize; i++)
+			for (int j = 0; j < wSize; j++)
+				Bezier::extract(BezierVolume3dUView<const ControlPoints, const Vec3>{ &cpts, i, j }, uSize, uSubdomain.beg(), uSubdomain.end(), BezierVolume3dUView<ControlPoints, Vec3>{ &piece.cpts, i, j });
+		for (int i = 0; i < uSize; i++)
+			for (int j = 0; j < wSize; j++)
+				Bezier::extract(BezierVolume3dVView<ControlPoints, Vec3>{ &piece.cpts, i, j }, vSize, vSubdomain.beg(), vSubdomain.end(), BezierVolume3dVView<ControlPoints, Vec3>{ &piece.cpts, i, j });
+		for (int i = 0; i < uSize; i++)
+			for (int j = 0; j < vSize; j++)
+				Bezier::extract(piece.cpts[i][j], wSize, wSubdomain.beg(), wSubdomain.end(), Bezier::StridedView<Vec3>{ piece.cpts[i][j].data(), 1 });
+		piece.updateDerivMat();
+		return std::make_shared<BezierVolume3d>(std::move(piece));
+	}
+	void BezierVolume3d::subdivideUniform(int levels, UniformVolumes& volumes) const {
+		if (levels < 0 || levels > maxUniformLevels)
+			throw(std::runtime_error("Invalid number of levels for uniform subdivision of bezier volume 3d"));
+		const int num = 1 << levels;
+		const int uSize = (int)cpts.size();
+		const int vSize = (int)cpts[0].size();
+		const int wSize = (int)cpts[0][0].size();
+		volumes.levels = levels;
+		volumes.num = num;
+		volumes.uSize = uSize;
+		volumes.vSize = vSize;
+		volumes.wSize = wSize;
+		volumes.cpts.resize((size_t)num * num * num * uSize * vSize * wSize);
 
-		std::vector<Vec3> lowerCol;
-		std::vector<Vec3> upperCol;
-		for (int i = 0; i < uSize; i++) {
-			for (int j = 0; j < vSize; j++) {
-				std::vector<Vec3> col;
-				col.resize(wSize);
-				for (int k = 0; k < wSize; k++)
-					col[k] = cpts[i][j][k];
-				subdivideCpts(col, w, lowerCol, upperCol);
-
+		// Along U : line (j, k) of net splits into pieces a, at [ uLines[((j * wSize + k) * num + a) * uSize + i] ]
+		std::vector<Vec3> uLines((size_t)vSize * wSize * num * uSize);
+		Parallel::forEach(0, vSize * wSize, [&](int jk) {
+			int j = jk / wSize, k = jk % wSize;
+			Vec3* line = uLines.data() + (size_t)jk * num * uSize;
+			for (int i = 0; i < uSize; i++)
+				line[i] = cpts[i][j][k];
+			Bezier::subdivideUniform(line, uSize, levels);
+		});
+		// Along V : line (i, k) of piece a splits into pieces (a, b), at [ vNets[(((a * num + b) * uSize + i) * vSize + j) * wSize + k] ]
+		std::vector<Vec3> vNets((size_t)num * num * uSize * vSize * wSize);
+		Parallel::forEach(0, num, [&](int a) {
+			std::vector<Vec3> line((size_t)num * vSize);
+			for (int i = 0; i < uSize; i++)
 				for (int k = 0; k < wSize; k++) {
-					lowerCpts[i][j][k] = lowerCol[k];
-					upperCpts[i][j][k] = upperCol[k];
+					for (int j = 0; j < vSize; j++)
+						line[j] = uLines[((size_t)(j * wSize + k) * num + a) * uSize + i];
+					Bezier::subdivideUniform(line.data(), vSize, levels);
+					for (int b = 0; b < num; b++)
+						for (int j = 0; j < vSize; j++)
+							vNets[((((size_t)a * num + b) * uSize + i) * vSize + j) * wSize + k] = line[b * vSize + j];
 				}
+		});
+		// Along W : row (i, j) of piece (a, b) splits into row (i, j) of sub-volumes (a, b, c)
+		const size_t netSize = (size_t)uSize * vSize * wSize;
+		Parallel::forEach(0, num * num, [&](int ab) {
+			std::vector<Vec3> row((size_t)num * wSize);
+			for (int ij = 0; ij < uSize * vSize; ij++) {
+				const Vec3* src = vNets.data() + (size_t)ab * netSize + (size_t)ij * wSize;
+				std::copy(src, src + wSize, row.begin());
+				Bezier::subdivideUniform(row.data(), wSize, levels);
+				for (int c = 0; c < num; c++)
+					std::copy(row.begin() + c * wSize, row.begin() + (c + 1) * wSize,
+						volumes.cpts.begin() + ((size_t)ab * num + c) * netSize + (size_t)ij * wSize);
 			}
-		}
-
-		lower = BezierVolume3d::create(uDegree, vDegree, wDegree, lowerCpts, buildMat);
-		upper = BezierVolume3d::create(uDegree, vDegree, wDegree, upperCpts, buildMat);
+		});
 	}
-	BezierVolume3d::Ptr BezierVolume3d::subdivide(const Domain& uSubdomain, const Domain& vSubdomain, const Domain& wSubdomain) const {
-		// Divide in u direction
-		BezierVolume3d lower, upper;
-		uSubdivide(uSubdomain.beg(), lower, upper, false);		// upper
-		Real t = (uSubdomain.end() - uSubdomain.beg()) / (1.0 - uSubdomain.beg());
-		upper.uSubdivide(t, lower, upper, false);					// lower
-
-		// Divide in v direction
-		lower.vSubdivide(vSubdomain.beg(), lower, upper, false);	// upper
-		t = (vSubdomain.end() - vSubdomain.beg()) / (1.0 - vSubdomain.beg());
-		upper.vSubdivide(t, lower, upper, false);					// lower
-
-		// Divide in w direction
-		lower.wSubdivide(wSubdomain.beg(), lower, upper, false);	// upper
-		t = (wSubdomain.end() - wSubdomain.beg()) / (1.0 - wSubdomain.beg());
-		upper.wSubdivide(t, lower, upper, false);					// lower
+	std::vector<BezierVolume3d::Ptr> BezierVolume3d::subdivideUniform(int levels, bool buildMat) const {
+		UniformVolumes volumes;
+		subdivideUniform(levels, volumes);
 
-		lower.updateDerivMat();
-		return std::make_shared<BezierVolume3d>(lower);
+		std::vector<Ptr> pieces((size_t)volumes.num * volumes.num * volumes.num);
+		const size_t netSize = (size_t)volumes.uSize * volumes.vSize * volumes.wSize;
+		Parallel::forEach(0, (int)pieces.size(), [&](int p) {
+			BezierVolume3d piece;
+			prepareSubdivision(piece);
+			const Vec3* net = volumes.cpts.data() + (size_t)p * netSize;
+			for (int i = 0; i < volumes.uSize; i++)
+				for (int j = 0; j < volumes.vSize; j++, net += volumes.wSize)
+					std::copy(net, net + volumes.wSize, piece.cpts[i][j].begin());
+			if (buildMat)
+				piece.updateDerivMat();
+			else
+				piece.updateBound();
+			pieces[p] = std::make_shared<BezierVolume3d>(std::move(piece));
+		});
+		return pieces;
 	}
 	BezierVolume3d BezierVolume3d::create() {
 		return empty;
@@ -152,6 +226,8 @@ namespace MN {
 		volume.cpts = cpts;
 		if (buildMat)
 			volume.updateDerivMat();
+		else
+			volume.updateBound();
 		return volume;
 	}
 	BezierVolume3d::Ptr BezierVolume3d::createPtr(int uDegree, int vDegree, int wDegree, const ControlPoints& cpts, bool buildMat) {
@@ -414,6 +490,64 @@ namespace MN {
 				}
 			}
 		}
+		updateBound();
+	}
+	void BezierVolume3d::updateBound() {
+		if (cpts.empty()) {
+			boundValid = false;
+			return;
+		}
+		int uNum = (int)cpts.size();
+		int vNum = (int)cpts[0].size();
+		int wNum = (int)cpts[0][0].size();
+		patchBound = PatchBound3d();
+		for (int i = 0; i < uNum; i++) {
+			for (int j = 0; j < vNum; j++) {
+				for (int k = 0; k < wNum; k++) {
+					patchBound.bound.expand(cpts[i][j][k]);
+					// Hodograph control points
+					if (i < uNum - 1)
+						patchBound.expandDeriv(0, (cpts[i + 1][j][k] - cpts[i][j][k]) * uDegree);
+					if (j < vNum - 1)
+						patchBound.expandDeriv(1, (cpts[i][j + 1][k] - cpts[i][j][k]) * vDegree);
+					if (k < wNum - 1)
+						patchBound.expandDeriv(2, (cpts[i][j][k + 1] - cpts[i][j][k]) * wDegree);
+				}
+			}
+		}
+		if (uNum == 1)
+			patchBound.expandDeriv(0, Vec3{ 0, 0, 0 });
+		if (vNum == 1)
+			patchBound.expandDeriv(1, Vec3{ 0, 0, 0 });
+		if (wNum == 1)
+			patchBound.expandDeriv(2, Vec3{ 0, 0, 0 });
+		patchBound.finish();
+		boundValid = true;
+	}
+	const AABB3d& BezierVolume3d::getBound() const {
+		if (!boundValid)
+			throw(std::runtime_error("Bezier volume has no control points to bound"));
+		return patchBound.bound;
+	}
+	const AABB3d& BezierVolume3d::getDerivBound(int dir) const {
+		if (!boundValid)
+			throw(std::runtime_error("Bezier volume has no control points to bound"));
+		return patchBound.derivBound[dir];
+	}
+	Real BezierVolume3d::getLipschitz(int dir) const {
+		if (!boundValid)
+			throw(std::runtime_error("Bezier volume has no control points to bound"));
+		return patchBound.lipschitz[dir];
+	}
+	OBB3d BezierVolume3d::getOrientedBound() const {
+		if (cpts.empty())
+			throw(std::runtime_error("Cannot build oriented bound of empty bezier volume"));
+		std::vector<Vec3> points;
+		points.reserve(cpts.size() * cpts[0].size() * cpts[0][0].size());
+		for (const auto& plane : cpts)
+			for (const auto& row : plane)
+				points.insert(points.end(), row.begin(), row.end());
+		return OBB3d::create(points);
 	}
 	Vec3 BezierVolume3d::evaluate(Real u, Real v, Real w) const {
 		BasisVector uBasis, vBasis, wBasis;
@@ -422,6 +556,36 @@ namespace MN {
 		Bezier::calBasisVector(w, wDegree, wBasis);
 		return tensorProduct(uBasis, vBasis, wBasis, cpts);
 	}
+	BezierVolume3d::Jet BezierVolume3d::jet(Real u, Real v, Real w) const {
+		// Basis and its derivative share one recurrence per direction, and are contracted with control points directly
+		Real uBasis[3][Bezier::maxDegree + 1], vBasis[3][Bezier::maxDegree + 1], wBasis[3][Bezier::maxDegree + 1];
+		Bezier::calBasisJet(u, uDegree, uBasis[0], uBasis[1], uBasis[2]);
+		Bezier::calBasisJet(v, vDegree, vBasis[0], vBasis[1], vBasis[2]);
+		Bezier::calBasisJet(w, wDegree, wBasis[0], wBasis[1], wBasis[2]);
+
+		Jet j;
+		j.V = j.Vu = j.Vv = j.Vw = Vec3::zero();
+		for (int i = 0; i <= uDegree; i++) {
+			// Contract each plane in W, then V direction
+			Vec3 plane0 = Vec3::zero(), planeV = Vec3::zero(), planeW = Vec3::zero();
+			for (int k = 0; k <= vDegree; k++) {
+				Vec3 row0 = Vec3::zero(), row1 = Vec3::zero();
+				for (int l = 0; l <= wDegree; l++) {
+					const Vec3& cpt = cpts[i][k][l];
+					row0 += cpt * wBasis[0][l];
+					row1 += cpt * wBasis[1][l];
+				}
+				plane0 += row0 * vBasis[0][k];
+				planeV += row0 * vBasis[1][k];
+				planeW += row1 * vBasis[0][k];
+			}
+			j.V += plane0 * uBasis[0][i];
+			j.Vu += plane0 * uBasis[1][i];
+			j.Vv += planeV * uBasis[0][i];
+			j.Vw += planeW * uBasis[0][i];
+		}
+		return j;
+	}
 	Vec3 BezierVolume3d::differentiate(Real u, Real v, Real w, int uOrder, int vOrder, int wOrder) const {
 		BasisVector uBasis, vBasis, wBasis;
 		if (uOrder == 0 && vOrder == 0 && wOrder == 0)
@@ -14,12 +14,14 @@
 #endif
 
 #include "../Freeform.h"
+#include "../Query/OBB.h"
 #include <memory>
 
 namespace MN {
 	class BezierVolume3d : public Freeform3dv {
 	private:
 		BezierVolume3d() = default;
+		friend class FreeformStore;
 
 		// Control points for calculating derivatives up to 3rd order
 		// @WARNING : Degree multiplication is already done in those matrices e.g) When 3rd degree Bezier is differentiated, 6 must be multiplied. 
@@ -45,25 +47,69 @@ namespace MN {
 		ControlPoints derivMatVWW;
 		ControlPoints derivMatWWW;
 
+		// Bounds of control points, rebuilt whenever control points are set, subdivided or deriv matrices are updated
+		PatchBound3d patchBound;
+		bool boundValid = false;
+		inline void cptsChanged() override {
+			updateBound();
+		}
+
 		static void subdivideCpts(const std::vector<Vec3>& cpts, Real t, std::vector<Vec3>& lower, std::vector<Vec3>& upper);
+		// Gives [piece] degrees, domains and shape of control points of this volume to be overwritten by subdivision
+		void prepareSubdivision(BezierVolume3d& piece) const;
 
 	public:
 		using Ptr = std::shared_ptr<BezierVolume3d>;
 		const static Binomial binomial;
 
+		// Control nets of (2^levels)^3 sub-volumes over uniform grid of domain, in one buffer
+		// Net of sub-volume (a, b, c) over [a, a + 1] x [b, b + 1] x [c, c + 1] / 2^levels starts at [ ((a * num + b) * num + c) * uSize * vSize * wSize ],
+		// in row major order
+		class UniformVolumes {
+		public:
+			int levels = 0;
+			int num = 1;			// 2^levels
+			int uSize = 0;			// Number of control points of each sub-volume in U, V, W direction
+			int vSize = 0;
+			int wSize = 0;
+			std::vector<Vec3> cpts;
+
+			inline const Vec3* net(int a, int b, int c) const noexcept {
+				return cpts.data() + (((size_t)a * num + b) * num + c) * uSize * vSize * wSize;
+			}
+			inline const Vec3& at(int a, int b, int c, int i, int j, int k) const noexcept {
+				return net(a, b, c)[(i * vSize + j) * wSize + k];
+			}
+		};
+
 		// @buildMat : Option for building derivMats in creation time
 		static BezierVolume3d create();
 		static BezierVolume3d create(int uDegree, int vDegree, int wDegree, const ControlPoints& cpts, bool buildMat = true);
 		static Ptr createPtr(int uDegree, int vDegree, int wDegree, const ControlPoints& cpts, bool buildMat = true);
 
-		void updateDerivMat();		// Update deriv matrices with current control points
+		void updateDerivMat();		// Update deriv matrices and bounds with current control points
+		// Rebuild bounds alone, e.g) after editing control points in place through [ getCpts ]
+		void updateBound();
+
+		// Bound of control points, which contains the volume
+		const AABB3d& getBound() const;
+		// Bound of first derivative in [dir], 0 for U, 1 for V and 2 for W, and largest norm of it
+		const AABB3d& getDerivBound(int dir) const;
+		Real getLipschitz(int dir) const;
+		// Bound along principal axes of control points, computed on each request as it is rarely needed
+		OBB3d getOrientedBound() const;
 		virtual Vec3 evaluate(Real u, Real v, Real w) const;
 		virtual Vec3 differentiate(Real u, Real v, Real w, int uOrder, int vOrder, int wOrder) const;
+		virtual Jet jet(Real u, Real v, Real w) const;
 
 		void uSubdivide(Real u, BezierVolume3d& lower, BezierVolume3d& upper, bool buildMat = true) const;
 		void vSubdivide(Real v, BezierVolume3d& lower, BezierVolume3d& upper, bool buildMat = true) const;
 		void wSubdivide(Real w, BezierVolume3d& lower, BezierVolume3d& upper, bool buildMat = true) const;
 		Ptr subdivide(const Domain& uSubdomain, const Domain& vSubdomain, const Domain& wSubdomain) const;
+		// Split into (2^levels)^3 sub-volumes by one midpoint subdivision sweep per direction, in parallel across sub-volumes
+		void subdivideUniform(int levels, UniformVolumes& volumes) const;
+		// Sub-volumes as volumes, in the order of [ UniformVolumes ], with deriv matrices only when [buildMat]
+		std::vector<Ptr> subdivideUniform(int levels, bool buildMat = false) const;
 
 		inline const ControlPoints& getDerivMatU() const noexcept {
 			return derivMatU;
@@ -182,6 +182,7 @@ namespace MN {
 		return std::make_shared<BsplineVolume3d>(create(uDegree, vDegree, wDegree, uKnot, vKnot, wKnot, cpts));
 	}
 	void BsplineVolume3d::updatePatches() {
+		MN_INSTRUMENT_TIMER(UpdatePatches);
 		// Insert knots in all directions
 		insertKnotFull(0);
 		insertKnotFull(1);
@@ -277,6 +278,7 @@ namespace MN {
 	Vec3 BsplineVolume3d::evaluate(Real u, Real v, Real w) const {
 		for (const auto& patch : patches) {
 			if (patch.domainHas(u, v, w)) {
+				MN_INSTRUMENT_ADD(PatchScans, &patch - patches.data() + 1);
 				Real nu = (u - patch.uSubdomain.beg()) / patch.uSubdomain.width();
 				Real nv = (v - patch.vSubdomain.beg()) / patch.vSubdomain.width();
 				Real nw = (w - patch.wSubdomain.beg()) / patch.wSubdomain.width();
@@ -288,6 +290,7 @@ namespace MN {
 	Vec3 BsplineVolume3d::differentiate(Real u, Real v, Real w, int uOrder, int vOrder, int wOrder) const {
 		for (const auto& patch : patches) {
 			if (patch.domainHas(u, v, w)) {
+				MN_INSTRUMENT_ADD(PatchScans, &patch - patches.data() + 1);
 				Real uWidth, vWidth, wWidth;
 				uWidth = patch.uSubdomain.width();
 				vWidth = patch.vSubdomain.width();
@@ -343,4 +346,25 @@ namespace MN {
 		}
 		throw(std::runtime_error("Invalid parameter for Bspline surface differentiation"));
 	}
+	BsplineVolume3d::Jet BsplineVolume3d::jet(Real u, Real v, Real w) const {
+		for (const auto& patch : patches) {
+			if (patch.domainHas(u, v, w)) {
+				MN_INSTRUMENT_ADD(PatchScans, &patch - patches.data() + 1);
+				Real uWidth, vWidth, wWidth;
+				uWidth = patch.uSubdomain.width();
+				vWidth = patch.vSubdomain.width();
+				wWidth = patch.wSubdomain.width();
+				Real nu = (u - patch.uSubdomain.beg()) / uWidth;
+				Real nv = (v - patch.vSubdomain.beg()) / vWidth;
+				Real nw = (w - patch.wSubdomain.beg()) / wWidth;
+				Jet j = patch.patch->jet(nu, nv, nw);
+
+				j.Vu /= uWidth;
+				j.Vv /= vWidth;
+				j.Vw /= wWidth;
+				return j;
+			}
+		}
+		throw(std::runtime_error("Invalid parameter for Bspline volume jet"));
+	}
 }
\ No newline at end of file
@@ -44,6 +44,7 @@ namespace MN {
 		void insertKnot(int direction, Real knot);
 		void insertKnotFull(int direction);
 		BsplineVolume3d() = default;
+		friend class FreeformStore;
 	public:
 		using Ptr = std::shared_ptr<BsplineVolume3d>;
 		using KnotVector = std::vector<Real>;
@@ -60,6 +61,7 @@ namespace MN {
 		void updatePatches();
 		virtual Vec3 evaluate(Real u, Real v, Real w) const;
 		virtual Vec3 differentiate(Real u, Real v, Real w, int uOrder, int vOrder, int wOrder) const;
+		virtual Jet jet(Real u, Real v, Real w) const;
 	};
 }
 
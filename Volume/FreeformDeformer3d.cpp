@@ -0,0 +1,156 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "FreeformDeformer3d.h"
+#include "../Query/InverseMapper3d.h"
+#include "../Parallel.h"
+
+namespace MN {
+	const static int vertexGrain = 1024;		// Minimum number of vertices handled by one thread
+
+	FreeformDeformer3d FreeformDeformer3d::create(const BsplineVolume3d::Ptr& volume, const std::vector<Vec3>& vertices) {
+		FreeformDeformer3d deformer;
+		deformer.bind(volume, vertices);
+		return deformer;
+	}
+	FreeformDeformer3d FreeformDeformer3d::create(const BezierVolume3d& volume, const std::vector<Vec3>& vertices) {
+		// Bezier volume is Bspline volume with a single knot interval in each direction
+		int uDegree = volume.getDegree(0), vDegree = volume.getDegree(1), wDegree = volume.getDegree(2);
+		auto bspline = BsplineVolume3d::createPtr(uDegree, vDegree, wDegree,
+			Bspline::createOpenUniformKnotVector(uDegree, uDegree + 1),
+			Bspline::createOpenUniformKnotVector(vDegree, vDegree + 1),
+			Bspline::createOpenUniformKnotVector(wDegree, wDegree + 1),
+			volume.getCptsC());
+		return create(bspline, vertices);
+	}
+	FreeformDeformer3d::Ptr FreeformDeformer3d::createPtr(const BsplineVolume3d::Ptr& volume, const std::vector<Vec3>& vertices) {
+		return std::make_shared<FreeformDeformer3d>(create(volume, vertices));
+	}
+	FreeformDeformer3d::Ptr FreeformDeformer3d::createPtr(const BezierVolume3d& volume, const std::vector<Vec3>& vertices) {
+		return std::make_shared<FreeformDeformer3d>(create(volume, vertices));
+	}
+
+	void FreeformDeformer3d::bind(const BsplineVolume3d::Ptr& volume, const std::vector<Vec3>& vertices) {
+		const auto& cpts = volume->getCptsC();
+		uDegree = volume->getDegree(0);
+		vDegree = volume->getDegree(1);
+		wDegree = volume->getDegree(2);
+		if (std::max({ uDegree, vDegree, wDegree }) > Bezier::maxDegree)
+			throw(std::runtime_error("Degree of volume is too high for free-form deformation"));
+		uNum = (int)cpts.size();
+		vNum = (int)cpts[0].size();
+		wNum = (int)cpts[0][0].size();
+
+		std::vector<InverseMapper3d::Result> results;
+		InverseMapper3d::create(volume).map(vertices, results);
+
+		int num = (int)vertices.size();
+		int stride = uDegree + vDegree + wDegree + 3;
+		base.resize(num);
+		weights.resize((size_t)num * stride);
+		offsets.resize(num);
+		outsideNum = 0;
+		for (const auto& result : results)
+			if (!result.inside)
+				outsideNum++;
+		Parallel::forEach(0, num, [&](int i) {
+			const auto& result = results[i];
+			int uSpan = Bspline::findSpan(result.u, uDegree, volume->uKnot);
+			int vSpan = Bspline::findSpan(result.v, vDegree, volume->vKnot);
+			int wSpan = Bspline::findSpan(result.w, wDegree, volume->wKnot);
+			Real* weight = &weights[(size_t)i * stride];
+			Bspline::calBasis(result.u, uSpan, uDegree, volume->uKnot, weight);
+			Bspline::calBasis(result.v, vSpan, vDegree, volume->vKnot, weight + uDegree + 1);
+			Bspline::calBasis(result.w, wSpan, wDegree, volume->wKnot, weight + uDegree + vDegree + 2);
+			base[i] = ((uSpan - uDegree) * vNum + (vSpan - vDegree)) * wNum + (wSpan - wDegree);
+			offsets[i] = vertices[i] - result.point;
+		}, vertexGrain);
+	}
+
+	// Sparse product of one vertex, where fixed [ W ] lets the innermost loop be unrolled and vectorized, or 0 for runtime order
+	template<int W>
+	static inline Vec3 deformVertex(const Real* uWeight, const Real* vWeight, const Real* wWeight, const Real* lattice, int uOrder, int vOrder, int wOrder, size_t uStep, size_t vStep) {
+		if (W > 0)
+			wOrder = W;
+		Real x = 0, y = 0, z = 0;
+		for (int a = 0; a < uOrder; a++, lattice += uStep) {
+			const Real* row = lattice;
+			for (int b = 0; b < vOrder; b++, row += vStep) {
+				// Control points along W are contiguous, so the innermost loop streams one short run
+				Real px = 0, py = 0, pz = 0;
+				for (int c = 0; c < wOrder; c++) {
+					px += wWeight[c] * row[c * 3];
+					py += wWeight[c] * row[c * 3 + 1];
+					pz += wWeight[c] * row[c * 3 + 2];
+				}
+				Real weight = uWeight[a] * vWeight[b];
+				x += weight * px;
+				y += weight * py;
+				z += weight * pz;
+			}
+		}
+		return { x, y, z };
+	}
+	template<int W>
+	static void deformVertices(const std::vector<int>& base, const std::vector<Real>& weights, const std::vector<Vec3>& offsets, const Real* lattice,
+		int uOrder, int vOrder, int wOrder, size_t uStep, size_t vStep, std::vector<Vec3>& vertices) {
+		int stride = uOrder + vOrder + wOrder;
+		Parallel::forEach(0, (int)base.size(), [&](int i) {
+			const Real* uWeight = &weights[(size_t)i * stride];
+			const Real* vWeight = uWeight + uOrder;
+			const Real* wWeight = vWeight + vOrder;
+			vertices[i] = deformVertex<W>(uWeight, vWeight, wWeight, lattice + (size_t)base[i] * 3, uOrder, vOrder, wOrder, uStep, vStep) + offsets[i];
+		}, vertexGrain);
+	}
+	void FreeformDeformer3d::deform(const Real* lattice, std::vector<Vec3>& vertices) const {
+		int uOrder = uDegree + 1, vOrder = vDegree + 1, wOrder = wDegree + 1;
+		size_t uStep = (size_t)vNum * wNum * 3, vStep = (size_t)wNum * 3;
+		vertices.resize(base.size());
+		switch (wOrder) {
+		case 2:
+			deformVertices<2>(base, weights, offsets, lattice, uOrder, vOrder, wOrder, uStep, vStep, vertices);
+			break;
+		case 3:
+			deformVertices<3>(base, weights, offsets, lattice, uOrder, vOrder, wOrder, uStep, vStep, vertices);
+			break;
+		case 4:
+			deformVertices<4>(base, weights, offsets, lattice, uOrder, vOrder, wOrder, uStep, vStep, vertices);
+			break;
+		default:
+			deformVertices<0>(base, weights, offsets, lattice, uOrder, vOrder, wOrder, uStep, vStep, vertices);
+			break;
+		}
+	}
+	void FreeformDeformer3d::deform(const BsplineVolume3d::ControlPoints& cpts, std::vector<Vec3>& vertices) const {
+		if ((int)cpts.size() != uNum || (int)cpts[0].size() != vNum || (int)cpts[0][0].size() != wNum)
+			throw(std::runtime_error("Control lattice size does not match bound volume for free-form deformation"));
+		// Flatten lattice once, so that every vertex reads plain arrays
+		std::vector<Real> lattice((size_t)uNum * vNum * wNum * 3);
+		Real* dst = lattice.data();
+		for (const auto& plane : cpts) {
+			if ((int)plane.size() != vNum)
+				throw(std::runtime_error("Control lattice size does not match bound volume for free-form deformation"));
+			for (const auto& row : plane) {
+				if ((int)row.size() != wNum)
+					throw(std::runtime_error("Control lattice size does not match bound volume for free-form deformation"));
+				for (const auto& cpt : row) {
+					*dst++ = cpt[0];
+					*dst++ = cpt[1];
+					*dst++ = cpt[2];
+				}
+			}
+		}
+		deform(lattice.data(), vertices);
+	}
+	void FreeformDeformer3d::deform(const BsplineVolume3d& volume, std::vector<Vec3>& vertices) const {
+		deform(volume.getCptsC(), vertices);
+	}
+	void FreeformDeformer3d::deform(const BezierVolume3d& volume, std::vector<Vec3>& vertices) const {
+		deform(volume.getCptsC(), vertices);
+	}
+}
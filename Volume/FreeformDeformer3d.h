@@ -0,0 +1,69 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_FREEFORM_DEFORMER_3D_H__
+#define __MN_FREEFORM_DEFORMER_3D_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "BezierVolume3d.h"
+#include "BsplineVolume3d.h"
+#include <memory>
+#include <vector>
+
+namespace MN {
+	/*
+	 * Free-form deformation of vertices embedded in control lattice of Bspline / Bezier volume.
+	 * Bind : Each vertex is inverse mapped to parameter (u, v, w) once, and its nonzero basis weights against control points are cached.
+	 * Deform : Vertex positions are recomputed from moved control points as sparse product of cached weights and control points,
+	 * without evaluating volume or updating its patches.
+	 * Weights are kept in tensor product form, i.e. (uDegree + 1) + (vDegree + 1) + (wDegree + 1) per vertex instead of their product,
+	 * so that memory traffic of deform stays small for millions of vertices.
+	 * Vertex outside of volume keeps its offset from the nearest point in volume.
+	 */
+	class FreeformDeformer3d {
+	public:
+		using Ptr = std::shared_ptr<FreeformDeformer3d>;
+	private:
+		FreeformDeformer3d() = default;
+
+		int uDegree = 0, vDegree = 0, wDegree = 0;
+		int uNum = 0, vNum = 0, wNum = 0;		// Size of control lattice
+		std::vector<int> base;					// Flat index of first control point that affects each vertex, [ (i * vNum + j) * wNum + k ]
+		std::vector<Real> weights;				// Basis in U, V and W directions of each vertex, in sequence
+		std::vector<Vec3> offsets;				// Vertex minus its image in volume at bind time
+		int outsideNum = 0;
+
+		void bind(const BsplineVolume3d::Ptr& volume, const std::vector<Vec3>& vertices);
+		void deform(const Real* lattice, std::vector<Vec3>& vertices) const;
+	public:
+		static FreeformDeformer3d create(const BsplineVolume3d::Ptr& volume, const std::vector<Vec3>& vertices);
+		static FreeformDeformer3d create(const BezierVolume3d& volume, const std::vector<Vec3>& vertices);
+		static Ptr createPtr(const BsplineVolume3d::Ptr& volume, const std::vector<Vec3>& vertices);
+		static Ptr createPtr(const BezierVolume3d& volume, const std::vector<Vec3>& vertices);
+
+		inline int getVertexNum() const noexcept {
+			return (int)base.size();
+		}
+		// Number of vertices that were outside of volume at bind time
+		inline int getOutsideNum() const noexcept {
+			return outsideNum;
+		}
+
+		// Positions of bound vertices for given control points, which must have the same lattice size as bound volume
+		// For Bspline volume, these are control points of the volume after its creation, i.e. [ getCptsC() ]
+		void deform(const BsplineVolume3d::ControlPoints& cpts, std::vector<Vec3>& vertices) const;
+		void deform(const BsplineVolume3d& volume, std::vector<Vec3>& vertices) const;
+		void deform(const BezierVolume3d& volume, std::vector<Vec3>& vertices) const;
+	};
+}
+
+#endif
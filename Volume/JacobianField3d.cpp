@@ -0,0 +1,445 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "JacobianField3d.h"
+#include "../Parallel.h"
+#include <limits>
+
+namespace MN {
+	const static int rowChunk = 4;		// Number of U parameters handled by one thread, sharing scratch buffer
+
+	// Binomial coefficients up to degree of det(J), as Real
+	static const Real* binomialRow(int n) {
+		const static int maxN = 3 * Bezier::maxDegree;
+		const static std::vector<std::vector<Real>> table = []() {
+			std::vector<std::vector<Real>> rows(maxN + 1);
+			for (int i = 0; i <= maxN; i++) {
+				rows[i].assign(i + 1, 1.0);
+				for (int k = 1; k < i; k++)
+					rows[i][k] = rows[i - 1][k - 1] + rows[i - 1][k];
+			}
+			return rows;
+		}();
+		return table[n].data();
+	}
+
+	// Basis and its derivative of each parameter, (degree + 1) values per parameter
+	static void calBasisTable(int degree, const std::vector<Real>& params, std::vector<Real>& basis, std::vector<Real>& basisT) {
+		int order = degree + 1;
+		Real basisTT[Bezier::maxDegree + 1];
+		basis.resize(params.size() * order);
+		basisT.resize(params.size() * order);
+		for (size_t i = 0; i < params.size(); i++)
+			Bezier::calBasisJet(params[i], degree, &basis[i * order], &basisT[i * order], basisTT);
+	}
+
+	// Contraction of control points of one Bezier volume with basis, one direction at a time
+	class Contraction {
+	public:
+		int uOrder = 0, vOrder = 0, wOrder = 0;
+		std::vector<Vec3> C0, C1;		// Contracted in U with basis and its derivative, [ j * wOrder + k ]
+		Vec3 D00[Bezier::maxDegree + 1];	// Contracted further in V, with (U, V) basis / derivative
+		Vec3 D10[Bezier::maxDegree + 1];
+		Vec3 D01[Bezier::maxDegree + 1];
+
+		inline void setDegree(int uDegree, int vDegree, int wDegree) {
+			uOrder = uDegree + 1;
+			vOrder = vDegree + 1;
+			wOrder = wDegree + 1;
+			C0.resize(vOrder * wOrder);
+			C1.resize(vOrder * wOrder);
+		}
+		inline void contractU(const BezierVolume3d::ControlPoints& cpts, const Real* basis, const Real* basisT) {
+			for (int j = 0; j < vOrder; j++) {
+				for (int k = 0; k < wOrder; k++) {
+					Vec3 c0 = Vec3::zero(), c1 = Vec3::zero();
+					for (int i = 0; i < uOrder; i++) {
+						const Vec3& cpt = cpts[i][j][k];
+						c0 += cpt * basis[i];
+						c1 += cpt * basisT[i];
+					}
+					C0[j * wOrder + k] = c0;
+					C1[j * wOrder + k] = c1;
+				}
+			}
+		}
+		inline void contractV(const Real* basis, const Real* basisT) {
+			for (int k = 0; k < wOrder; k++)
+				D00[k] = D10[k] = D01[k] = Vec3::zero();
+			for (int j = 0; j < vOrder; j++) {
+				const Vec3* c0 = &C0[j * wOrder];
+				const Vec3* c1 = &C1[j * wOrder];
+				for (int k = 0; k < wOrder; k++) {
+					D00[k] += c0[k] * basis[j];
+					D10[k] += c1[k] * basis[j];
+					D01[k] += c0[k] * basisT[j];
+				}
+			}
+		}
+		inline Real det(const Real* basis, const Real* basisT) const {
+			Vec3 Vu = Vec3::zero(), Vv = Vec3::zero(), Vw = Vec3::zero();
+			for (int k = 0; k < wOrder; k++) {
+				Vu += D10[k] * basis[k];
+				Vv += D01[k] * basis[k];
+				Vw += D00[k] * basisT[k];
+			}
+			return Vec3::Tcross(Vv, Vw, Vu);
+		}
+	};
+
+	// Knots without repetition, which bound patch subdomains
+	static void uniqueKnots(const KnotVector& knot, std::vector<Real>& breaks) {
+		breaks = knot;
+		breaks.erase(std::unique(breaks.begin(), breaks.end()), breaks.end());
+	}
+	static int findSpan(const std::vector<Real>& breaks, Real t) {
+		if (t < breaks.front() || t > breaks.back())
+			throw(std::runtime_error("Invalid parameter for Jacobian evaluation"));
+		int span = (int)(std::upper_bound(breaks.begin(), breaks.end(), t) - breaks.begin()) - 1;
+		return std::min(span, (int)breaks.size() - 2);
+	}
+	// Span and local parameter of each parameter, with parameters grouped by span
+	static void localize(const std::vector<Real>& breaks, const std::vector<Real>& params, std::vector<Real>& local, std::vector<Real>& scale, std::vector<std::vector<int>>& groups) {
+		int num = (int)params.size();
+		local.resize(num);
+		scale.resize(num);
+		groups.assign(breaks.size() - 1, std::vector<int>());
+		for (int i = 0; i < num; i++) {
+			int span = findSpan(breaks, params[i]);
+			Real width = breaks[span + 1] - breaks[span];
+			local[i] = (params[i] - breaks[span]) / width;
+			scale[i] = 1.0 / width;
+			groups[span].push_back(i);
+		}
+	}
+
+	void JacobianField3d::evaluate(const BsplineVolume3d& volume, const std::vector<Real>& uParams, const std::vector<Real>& vParams, const std::vector<Real>& wParams, std::vector<Real>& dets) {
+		int uNum = (int)uParams.size(), vNum = (int)vParams.size(), wNum = (int)wParams.size();
+		int uDegree = volume.getDegree(0), vDegree = volume.getDegree(1), wDegree = volume.getDegree(2);
+		int uOrder = uDegree + 1, vOrder = vDegree + 1, wOrder = wDegree + 1;
+		dets.resize((size_t)uNum * vNum * wNum);
+		if (dets.empty())
+			return;
+
+		std::vector<Real> uBreaks, vBreaks, wBreaks;
+		uniqueKnots(volume.uKnot, uBreaks);
+		uniqueKnots(volume.vKnot, vBreaks);
+		uniqueKnots(volume.wKnot, wBreaks);
+		int vSpanNum = (int)vBreaks.size() - 1, wSpanNum = (int)wBreaks.size() - 1;
+		std::vector<int> cellPatch((size_t)(uBreaks.size() - 1) * vSpanNum * wSpanNum, -1);
+		for (int p = 0; p < (int)volume.patches.size(); p++) {
+			const auto& patch = volume.patches[p];
+			int cell = (findSpan(uBreaks, patch.uSubdomain.beg()) * vSpanNum + findSpan(vBreaks, patch.vSubdomain.beg())) * wSpanNum + findSpan(wBreaks, patch.wSubdomain.beg());
+			cellPatch[cell] = p;
+		}
+
+		// Basis of each parameter in its span is computed once
+		std::vector<Real> uLocal, vLocal, wLocal, uScale, vScale, wScale;
+		std::vector<std::vector<int>> uGroups, vGroups, wGroups;
+		localize(uBreaks, uParams, uLocal, uScale, uGroups);
+		localize(vBreaks, vParams, vLocal, vScale, vGroups);
+		localize(wBreaks, wParams, wLocal, wScale, wGroups);
+		std::vector<Real> uBasis, uBasisT, vBasis, vBasisT, wBasis, wBasisT;
+		calBasisTable(uDegree, uLocal, uBasis, uBasisT);
+		calBasisTable(vDegree, vLocal, vBasis, vBasisT);
+		calBasisTable(wDegree, wLocal, wBasis, wBasisT);
+
+		Parallel::forEach(0, (uNum + rowChunk - 1) / rowChunk, [&](int chunk) {
+			Contraction contraction;
+			contraction.setDegree(uDegree, vDegree, wDegree);
+			int end = std::min((chunk + 1) * rowChunk, uNum);
+			for (int i = chunk * rowChunk; i < end; i++) {
+				int uSpan = findSpan(uBreaks, uParams[i]);
+				// Each patch in this U span is contracted in U once
+				for (int vSpan = 0; vSpan < vSpanNum; vSpan++) {
+					if (vGroups[vSpan].empty())
+						continue;
+					for (int wSpan = 0; wSpan < wSpanNum; wSpan++) {
+						if (wGroups[wSpan].empty())
+							continue;
+						int p = cellPatch[((size_t)uSpan * vSpanNum + vSpan) * wSpanNum + wSpan];
+						if (p < 0)
+							throw(std::runtime_error("Invalid parameter for Jacobian evaluation"));
+						contraction.contractU(volume.patches[p].patch->getCptsC(), &uBasis[(size_t)i * uOrder], &uBasisT[(size_t)i * uOrder]);
+						for (int j : vGroups[vSpan]) {
+							contraction.contractV(&vBasis[(size_t)j * vOrder], &vBasisT[(size_t)j * vOrder]);
+							Real scale = uScale[i] * vScale[j];
+							Real* row = &dets[((size_t)i * vNum + j) * wNum];
+							for (int k : wGroups[wSpan])
+								row[k] = contraction.det(&wBasis[(size_t)k * wOrder], &wBasisT[(size_t)k * wOrder]) * scale * wScale[k];
+						}
+					}
+				}
+			}
+		});
+	}
+	void JacobianField3d::evaluate(const BezierVolume3d& volume, const std::vector<Real>& uParams, const std::vector<Real>& vParams, const std::vector<Real>& wParams, std::vector<Real>& dets) {
+		int uNum = (int)uParams.size(), vNum = (int)vParams.size(), wNum = (int)wParams.size();
+		int uDegree = volume.getDegree(0), vDegree = volume.getDegree(1), wDegree = volume.getDegree(2);
+		int uOrder = uDegree + 1, vOrder = vDegree + 1, wOrder = wDegree + 1;
+		dets.resize((size_t)uNum * vNum * wNum);
+
+		std::vector<Real> uBasis, uBasisT, vBasis, vBasisT, wBasis, wBasisT;
+		calBasisTable(uDegree, uParams, uBasis, uBasisT);
+		calBasisTable(vDegree, vParams, vBasis, vBasisT);
+		calBasisTable(wDegree, wParams, wBasis, wBasisT);
+		Parallel::forEach(0, (uNum + rowChunk - 1) / rowChunk, [&](int chunk) {
+			Contraction contraction;
+			contraction.setDegree(uDegree, vDegree, wDegree);
+			int end = std::min((chunk + 1) * rowChunk, uNum);
+			for (int i = chunk * rowChunk; i < end; i++) {
+				contraction.contractU(volume.getCptsC(), &uBasis[(size_t)i * uOrder], &uBasisT[(size_t)i * uOrder]);
+				for (int j = 0; j < vNum; j++) {
+					contraction.contractV(&vBasis[(size_t)j * vOrder], &vBasisT[(size_t)j * vOrder]);
+					Real* row = &dets[((size_t)i * vNum + j) * wNum];
+					for (int k = 0; k < wNum; k++)
+						row[k] = contraction.det(&wBasis[(size_t)k * wOrder], &wBasisT[(size_t)k * wOrder]);
+				}
+			}
+		});
+	}
+
+	// Accumulate [sign] * a * b into [out], where all are Bernstein coefficients scaled by binomials so that product is convolution
+	static void convolve(const Real* a, const int (&na)[3], const Real* b, const int (&nb)[3], Real sign, Real* out) {
+		int n1 = na[1] + nb[1] + 1, n2 = na[2] + nb[2] + 1;
+		for (int i = 0; i <= na[0]; i++)
+			for (int j = 0; j <= na[1]; j++)
+				for (int k = 0; k <= na[2]; k++) {
+					Real aVal = sign * a[(i * (na[1] + 1) + j) * (na[2] + 1) + k];
+					if (aVal == 0.0)
+						continue;
+					for (int p = 0; p <= nb[0]; p++)
+						for (int q = 0; q <= nb[1]; q++) {
+							const Real* bRow = &b[(p * (nb[1] + 1) + q) * (nb[2] + 1)];
+							Real* oRow = &out[((i + p) * n1 + j + q) * n2 + k];
+							for (int r = 0; r <= nb[2]; r++)
+								oRow[r] += aVal * bRow[r];
+						}
+				}
+	}
+	// Scaled coefficients of one component of hodograph in direction [dir]
+	static void calScaledHodograph(const BezierVolume3d::ControlPoints& cpts, const int (&degree)[3], int dir, int c, std::vector<Real>& out, int (&n)[3]) {
+		for (int d = 0; d < 3; d++)
+			n[d] = degree[d] - (d == dir ? 1 : 0);
+		const Real* bu = binomialRow(n[0]);
+		const Real* bv = binomialRow(n[1]);
+		const Real* bw = binomialRow(n[2]);
+		out.resize((size_t)(n[0] + 1) * (n[1] + 1) * (n[2] + 1));
+		for (int i = 0; i <= n[0]; i++)
+			for (int j = 0; j <= n[1]; j++)
+				for (int k = 0; k <= n[2]; k++) {
+					const Vec3& a = cpts[i][j][k];
+					const Vec3& b = (dir == 0) ? cpts[i + 1][j][k] : (dir == 1 ? cpts[i][j + 1][k] : cpts[i][j][k + 1]);
+					out[(i * (n[1] + 1) + j) * (n[2] + 1) + k] = (b[c] - a[c]) * degree[dir] * bu[i] * bv[j] * bw[k];
+				}
+	}
+	void JacobianField3d::calDetCoefficients(const BezierVolume3d& volume, std::vector<Real>& coefs, int (&degree)[3]) {
+		int vdeg[3] = { volume.getDegree(0), volume.getDegree(1), volume.getDegree(2) };
+		for (int d = 0; d < 3; d++) {
+			if (vdeg[d] < 1)
+				throw(std::runtime_error("Jacobian of volume with zero degree is singular"));
+			if (vdeg[d] > Bezier::maxDegree)
+				throw(std::runtime_error("Degree of volume is too high for Jacobian coefficients"));
+		}
+		const auto& cpts = volume.getCptsC();
+		// Hodographs, per direction and component
+		std::vector<Real> H[3][3];
+		int nH[3][3];
+		for (int dir = 0; dir < 3; dir++)
+			for (int c = 0; c < 3; c++)
+				calScaledHodograph(cpts, vdeg, dir, c, H[dir][c], nH[dir]);
+
+		// Vv x Vw
+		int nCross[3];
+		for (int d = 0; d < 3; d++)
+			nCross[d] = nH[1][d] + nH[2][d];
+		size_t crossSize = (size_t)(nCross[0] + 1) * (nCross[1] + 1) * (nCross[2] + 1);
+		std::vector<Real> cross[3];
+		for (int c = 0; c < 3; c++) {
+			int c1 = (c + 1) % 3, c2 = (c + 2) % 3;
+			cross[c].assign(crossSize, 0.0);
+			convolve(H[1][c1].data(), nH[1], H[2][c2].data(), nH[2], 1.0, cross[c].data());
+			convolve(H[1][c2].data(), nH[1], H[2][c1].data(), nH[2], -1.0, cross[c].data());
+		}
+		// Vu . (Vv x Vw)
+		for (int d = 0; d < 3; d++)
+			degree[d] = nH[0][d] + nCross[d];
+		coefs.assign((size_t)(degree[0] + 1) * (degree[1] + 1) * (degree[2] + 1), 0.0);
+		for (int c = 0; c < 3; c++)
+			convolve(H[0][c].data(), nH[0], cross[c].data(), nCross, 1.0, coefs.data());
+		const Real* bu = binomialRow(degree[0]);
+		const Real* bv = binomialRow(degree[1]);
+		const Real* bw = binomialRow(degree[2]);
+		for (int i = 0; i <= degree[0]; i++)
+			for (int j = 0; j <= degree[1]; j++)
+				for (int k = 0; k <= degree[2]; k++)
+					coefs[(i * (degree[1] + 1) + j) * (degree[2] + 1) + k] /= bu[i] * bv[j] * bw[k];
+	}
+
+	// Bernstein coefficients of det(J) on sub-box of patch, refined by splitting in half
+	class Certifier {
+	public:
+		int n[3];				// Degree in each direction
+		int maxDepth;
+		bool folded = false;
+		Real foldedParam[3] = { 0, 0, 0 };
+		bool unknown = false;
+
+		// Lower bound of det(J) over box [lo, hi] in local parameter
+		Real certify(const std::vector<Real>& coefs, const Real (&lo)[3], const Real (&hi)[3], int depth) {
+			Real minCoef = *std::min_element(coefs.begin(), coefs.end());
+			if (minCoef > 0.0)
+				return minCoef;
+			// Corner coefficients equal to det(J) at corners
+			for (int corner = 0; corner < 8; corner++) {
+				int idx[3];
+				for (int d = 0; d < 3; d++)
+					idx[d] = ((corner >> d) & 1) ? n[d] : 0;
+				if (coefs[(idx[0] * (n[1] + 1) + idx[1]) * (n[2] + 1) + idx[2]] <= 0.0) {
+					folded = true;
+					for (int d = 0; d < 3; d++)
+						foldedParam[d] = idx[d] ? hi[d] : lo[d];
+					return minCoef;
+				}
+			}
+			if (depth >= maxDepth) {
+				unknown = true;
+				return minCoef;
+			}
+			int dir = depth % 3;
+			std::vector<Real> lower, upper;
+			split(coefs, dir, lower, upper);
+			Real mid = (lo[dir] + hi[dir]) * 0.5;
+			Real loB[3] = { lo[0], lo[1], lo[2] }, hiA[3] = { hi[0], hi[1], hi[2] };
+			hiA[dir] = mid;
+			loB[dir] = mid;
+			Real bound = certify(lower, lo, hiA, depth + 1);
+			if (folded)
+				return std::min(bound, *std::min_element(upper.begin(), upper.end()));
+			return std::min(bound, certify(upper, loB, hi, depth + 1));
+		}
+		// de Casteljau at 0.5 along [dir] for every line of coefficients
+		void split(const std::vector<Real>& coefs, int dir, std::vector<Real>& lower, std::vector<Real>& upper) const {
+			int stride[3] = { (n[1] + 1) * (n[2] + 1), n[2] + 1, 1 };
+			int m = n[dir];
+			lower.resize(coefs.size());
+			upper.resize(coefs.size());
+			Real line[3 * Bezier::maxDegree + 1];
+			int a = (dir == 0) ? 1 : 0, b = (dir == 2) ? 1 : 2;
+			for (int x = 0; x <= n[a]; x++) {
+				for (int y = 0; y <= n[b]; y++) {
+					int start = x * stride[a] + y * stride[b];
+					for (int i = 0; i <= m; i++)
+						line[i] = coefs[start + i * stride[dir]];
+					for (int r = 1; r <= m; r++) {
+						lower[start + (r - 1) * stride[dir]] = line[0];
+						upper[start + (m - r + 1) * stride[dir]] = line[m - r + 1];
+						for (int i = 0; i <= m - r; i++)
+							line[i] = (line[i] + line[i + 1]) * 0.5;
+					}
+					lower[start + m * stride[dir]] = line[0];
+					upper[start] = line[0];
+				}
+			}
+		}
+	};
+
+	static JacobianField3d::PatchQuality calPatchQuality(const BezierVolume3d& patch, const std::vector<Real>& samples, const std::vector<Real>* basis, const std::vector<Real>* basisT, bool certify, int maxDepth, Contraction& contraction) {
+		JacobianField3d::PatchQuality quality;
+		int num = (int)samples.size();
+		int order[3] = { patch.getDegree(0) + 1, patch.getDegree(1) + 1, patch.getDegree(2) + 1 };
+		quality.minDet = std::numeric_limits<Real>::max();
+		quality.maxDet = -std::numeric_limits<Real>::max();
+		int minId[3] = { 0, 0, 0 };
+		for (int i = 0; i < num; i++) {
+			contraction.contractU(patch.getCptsC(), &basis[0][i * order[0]], &basisT[0][i * order[0]]);
+			for (int j = 0; j < num; j++) {
+				contraction.contractV(&basis[1][j * order[1]], &basisT[1][j * order[1]]);
+				for (int k = 0; k < num; k++) {
+					Real det = contraction.det(&basis[2][k * order[2]], &basisT[2][k * order[2]]);
+					if (det < quality.minDet) {
+						quality.minDet = det;
+						minId[0] = i;
+						minId[1] = j;
+						minId[2] = k;
+					}
+					quality.maxDet = std::max(quality.maxDet, det);
+				}
+			}
+		}
+		if (quality.minDet <= 0.0) {
+			quality.validity = JacobianField3d::Validity::Folded;
+			for (int d = 0; d < 3; d++)
+				quality.foldedParam[d] = samples[minId[d]];
+		}
+		if (!certify)
+			return quality;
+
+		std::vector<Real> coefs;
+		Certifier certifier;
+		JacobianField3d::calDetCoefficients(patch, coefs, certifier.n);
+		certifier.maxDepth = maxDepth;
+		quality.upperBound = *std::max_element(coefs.begin(), coefs.end());
+		Real lo[3] = { 0, 0, 0 }, hi[3] = { 1, 1, 1 };
+		quality.lowerBound = certifier.certify(coefs, lo, hi, 0);
+		if (quality.validity != JacobianField3d::Validity::Folded) {
+			if (certifier.folded) {
+				quality.validity = JacobianField3d::Validity::Folded;
+				for (int d = 0; d < 3; d++)
+					quality.foldedParam[d] = certifier.foldedParam[d];
+			}
+			else if (!certifier.unknown)
+				quality.validity = JacobianField3d::Validity::Positive;
+		}
+		return quality;
+	}
+	static void calSampleBasis(const BezierVolume3d& patch, int resolution, std::vector<Real>& samples, std::vector<Real> (&basis)[3], std::vector<Real> (&basisT)[3]) {
+		if (resolution < 1)
+			throw(std::runtime_error("Resolution of Jacobian sampling must be positive"));
+		samples.resize(resolution + 1);
+		for (int i = 0; i <= resolution; i++)
+			samples[i] = (Real)i / resolution;
+		for (int d = 0; d < 3; d++)
+			calBasisTable(patch.getDegree(d), samples, basis[d], basisT[d]);
+	}
+	// Local values are scaled into parameter of Bspline volume, and folded parameter is mapped into it
+	static void toGlobal(const BsplineVolume3d::Patch& patch, JacobianField3d::PatchQuality& quality) {
+		Real scale = 1.0 / (patch.uSubdomain.width() * patch.vSubdomain.width() * patch.wSubdomain.width());
+		quality.minDet *= scale;
+		quality.maxDet *= scale;
+		quality.lowerBound *= scale;
+		quality.upperBound *= scale;
+		const Domain* domains[3] = { &patch.uSubdomain, &patch.vSubdomain, &patch.wSubdomain };
+		for (int d = 0; d < 3; d++)
+			quality.foldedParam[d] = domains[d]->beg() + quality.foldedParam[d] * domains[d]->width();
+	}
+
+	void JacobianField3d::patchQuality(const BsplineVolume3d& volume, std::vector<PatchQuality>& qualities, int resolution, bool certify, int maxDepth) {
+		int num = (int)volume.patches.size();
+		qualities.resize(num);
+		if (num == 0)
+			return;
+		// Every patch shares degree, so basis at samples is computed once
+		std::vector<Real> samples, basis[3], basisT[3];
+		calSampleBasis(*volume.patches[0].patch, resolution, samples, basis, basisT);
+		Parallel::forEach(0, num, [&](int p) {
+			const auto& patch = volume.patches[p];
+			Contraction contraction;
+			contraction.setDegree(volume.getDegree(0), volume.getDegree(1), volume.getDegree(2));
+			qualities[p] = calPatchQuality(*patch.patch, samples, basis, basisT, certify, maxDepth, contraction);
+			toGlobal(patch, qualities[p]);
+		});
+	}
+	JacobianField3d::PatchQuality JacobianField3d::patchQuality(const BezierVolume3d& volume, int resolution, bool certify, int maxDepth) {
+		std::vector<Real> samples, basis[3], basisT[3];
+		calSampleBasis(volume, resolution, samples, basis, basisT);
+		Contraction contraction;
+		contraction.setDegree(volume.getDegree(0), volume.getDegree(1), volume.getDegree(2));
+		return calPatchQuality(volume, samples, basis, basisT, certify, maxDepth, contraction);
+	}
+}
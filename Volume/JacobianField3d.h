@@ -0,0 +1,64 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_JACOBIAN_FIELD_3D_H__
+#define __MN_JACOBIAN_FIELD_3D_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "BezierVolume3d.h"
+#include "BsplineVolume3d.h"
+#include <vector>
+
+namespace MN {
+	/*
+	 * Determinant of Jacobian det(J) = Vu . (Vv x Vw) of volume, for checking validity of parameterization.
+	 * Batched evaluation shares basis over grid lines and contracts control points one direction at a time,
+	 * so that each sample costs a few short sums instead of three differentiations.
+	 * Bernstein coefficients of det(J) of Bezier patch, of degree (3p - 1) in each direction, bound it from below and above.
+	 * Patch is certified positive when every coefficient is positive, and folded when det(J) <= 0 at some corner of subdivided patch.
+	 * Otherwise coefficients are split by de Casteljau until either holds, which tightens the bound without dense sampling.
+	 * Values are in parameter of Bspline volume, i.e. scaled by size of patch subdomains.
+	 */
+	class JacobianField3d {
+	public:
+		enum class Validity {
+			Positive,		// det(J) > 0 over whole patch, certified
+			Folded,			// det(J) <= 0 at [ foldedParam ]
+			Unknown			// Neither could be decided within subdivision limit
+		};
+		class PatchQuality {
+		public:
+			Real minDet = 0;			// Minimum and maximum of sampled det(J)
+			Real maxDet = 0;
+			Real lowerBound = 0;		// Certified bounds of det(J) over patch, only set when certified
+			Real upperBound = 0;
+			Validity validity = Validity::Unknown;
+			Real foldedParam[3] = { 0, 0, 0 };	// Parameter where det(J) <= 0, only set when folded
+		};
+	public:
+		// det(J) of every triple (uParams[i], vParams[j], wParams[k]), stored at [ (i * vNum + j) * wNum + k ]
+		static void evaluate(const BsplineVolume3d& volume, const std::vector<Real>& uParams, const std::vector<Real>& vParams, const std::vector<Real>& wParams, std::vector<Real>& dets);
+		static void evaluate(const BezierVolume3d& volume, const std::vector<Real>& uParams, const std::vector<Real>& vParams, const std::vector<Real>& wParams, std::vector<Real>& dets);
+
+		// Quality of each patch of volume, computed in parallel
+		// @resolution : Number of intervals sampled in each direction of patch
+		// @certify : Whether to compute certified bounds and validity from Bernstein coefficients
+		// @maxDepth : Maximum number of splits of coefficients in certification
+		static void patchQuality(const BsplineVolume3d& volume, std::vector<PatchQuality>& qualities, int resolution = 4, bool certify = true, int maxDepth = 12);
+		static PatchQuality patchQuality(const BezierVolume3d& volume, int resolution = 4, bool certify = true, int maxDepth = 12);
+
+		// Bernstein coefficients of det(J) of Bezier volume in its local parameter, stored at [ (i * (degree[1] + 1) + j) * (degree[2] + 1) + k ]
+		static void calDetCoefficients(const BezierVolume3d& volume, std::vector<Real>& coefs, int (&degree)[3]);
+	};
+}
+
+#endif
@@ -0,0 +1,210 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "VolumeOctree3d.h"
+#include "JacobianField3d.h"
+#include "../Parallel.h"
+
+namespace MN {
+	const static int maxOctreeDepth = 10;		// Limit of depth, giving 8^10 leaves per patch at most
+
+	// Split [volume] at midpoints into 8 octants, indexed by (u, v, w) halves as bits (4, 2, 1)
+	static void splitOctants(const BezierVolume3d& volume, BezierVolume3d* octants) {
+		volume.uSubdivide(0.5, octants[0], octants[4], false);
+		for (int a = 0; a < 8; a += 4)
+			octants[a].vSubdivide(0.5, octants[a], octants[a + 2], false);
+		for (int a = 0; a < 8; a += 2)
+			octants[a].wSubdivide(0.5, octants[a], octants[a + 1], false);
+	}
+	static Domain halfDomain(const Domain& domain, int upper) {
+		Real mid = domain.beg() + domain.width() * 0.5;
+		return upper ? Domain::create(mid, domain.end()) : Domain::create(domain.beg(), mid);
+	}
+
+	VolumeOctree3d VolumeOctree3d::create(const BsplineVolume3d& volume, Criterion criterion, Real tolerance, int maxDepth, bool buildMat) {
+		if (maxDepth < 0 || maxDepth > maxOctreeDepth)
+			throw(std::runtime_error("Invalid maximum depth of volume octree"));
+		VolumeOctree3d octree;
+		octree.criterion = criterion;
+		octree.tolerance = tolerance;
+		octree.maxDepth = maxDepth;
+		octree.buildMat = buildMat;
+		octree.build(volume.patches);
+		return octree;
+	}
+	VolumeOctree3d VolumeOctree3d::create(const BezierVolume3d& volume, Criterion criterion, Real tolerance, int maxDepth, bool buildMat) {
+		if (maxDepth < 0 || maxDepth > maxOctreeDepth)
+			throw(std::runtime_error("Invalid maximum depth of volume octree"));
+		BsplineVolume3d::Patch patch;
+		patch.patch = std::make_shared<BezierVolume3d>(volume);
+		VolumeOctree3d octree;
+		octree.criterion = criterion;
+		octree.tolerance = tolerance;
+		octree.maxDepth = maxDepth;
+		octree.buildMat = buildMat;
+		octree.build({ patch });
+		return octree;
+	}
+	VolumeOctree3d::Ptr VolumeOctree3d::createPtr(const BsplineVolume3d& volume, Criterion criterion, Real tolerance, int maxDepth, bool buildMat) {
+		return std::make_shared<VolumeOctree3d>(create(volume, criterion, tolerance, maxDepth, buildMat));
+	}
+	VolumeOctree3d::Ptr VolumeOctree3d::createPtr(const BezierVolume3d& volume, Criterion criterion, Real tolerance, int maxDepth, bool buildMat) {
+		return std::make_shared<VolumeOctree3d>(create(volume, criterion, tolerance, maxDepth, buildMat));
+	}
+
+	Real VolumeOctree3d::flatness(const BezierVolume3d& volume) {
+		const auto& cpts = volume.getCptsC();
+		int deg[3] = { volume.getDegree(0), volume.getDegree(1), volume.getDegree(2) };
+		const Vec3
+			c000 = cpts[0][0][0], c001 = cpts[0][0][deg[2]], c010 = cpts[0][deg[1]][0], c011 = cpts[0][deg[1]][deg[2]],
+			c100 = cpts[deg[0]][0][0], c101 = cpts[deg[0]][0][deg[2]], c110 = cpts[deg[0]][deg[1]][0], c111 = cpts[deg[0]][deg[1]][deg[2]];
+
+		Real error = 0;
+		for (int i = 0; i <= deg[0]; i++) {
+			Real s = deg[0] > 0 ? (Real)i / deg[0] : 0.0;
+			for (int j = 0; j <= deg[1]; j++) {
+				Real t = deg[1] > 0 ? (Real)j / deg[1] : 0.0;
+				for (int k = 0; k <= deg[2]; k++) {
+					Real r = deg[2] > 0 ? (Real)k / deg[2] : 0.0;
+					Vec3 c00 = c000 * (1.0 - r) + c001 * r, c01 = c010 * (1.0 - r) + c011 * r;
+					Vec3 c10 = c100 * (1.0 - r) + c101 * r, c11 = c110 * (1.0 - r) + c111 * r;
+					Vec3 c0 = c00 * (1.0 - t) + c01 * t, c1 = c10 * (1.0 - t) + c11 * t;
+					error = std::max(error, (cpts[i][j][k] - (c0 * (1.0 - s) + c1 * s)).len());
+				}
+			}
+		}
+		return error;
+	}
+	Real VolumeOctree3d::jacobianVariation(const BezierVolume3d& volume) {
+		std::vector<Real> coefs;
+		int degree[3];
+		JacobianField3d::calDetCoefficients(volume, coefs, degree);
+		auto range = std::minmax_element(coefs.begin(), coefs.end());
+		Real scale = std::max(std::fabs(*range.first), std::fabs(*range.second));
+		return scale > 0.0 ? (*range.second - *range.first) / scale : 0.0;
+	}
+	Real VolumeOctree3d::calError(const BezierVolume3d& volume) const {
+		return criterion == Criterion::Flatness ? flatness(volume) : jacobianVariation(volume);
+	}
+
+	void VolumeOctree3d::build(const std::vector<BsplineVolume3d::Patch>& patches) {
+		// Grid of patches over breaks of their subdomains, for locating root of parameter
+		for (int d = 0; d < 3; d++) {
+			auto& dBreaks = breaks[d];
+			for (const auto& patch : patches) {
+				const Domain& sub = d == 0 ? patch.uSubdomain : (d == 1 ? patch.vSubdomain : patch.wSubdomain);
+				dBreaks.push_back(sub.beg());
+				dBreaks.push_back(sub.end());
+			}
+			std::sort(dBreaks.begin(), dBreaks.end());
+			dBreaks.erase(std::unique(dBreaks.begin(), dBreaks.end()), dBreaks.end());
+		}
+		int gridNum[3];
+		for (int d = 0; d < 3; d++)
+			gridNum[d] = (int)breaks[d].size() - 1;
+		patchRoots.assign((size_t)gridNum[0] * gridNum[1] * gridNum[2], -1);
+
+		std::vector<int> frontier;
+		std::vector<BezierVolume3d> volumes;
+		for (int p = 0; p < (int)patches.size(); p++) {
+			const auto& patch = patches[p];
+			Node root;
+			root.range[0] = patch.uSubdomain;
+			root.range[1] = patch.vSubdomain;
+			root.range[2] = patch.wSubdomain;
+			root.patch = p;
+			int cell[3];
+			for (int d = 0; d < 3; d++)
+				cell[d] = (int)(std::lower_bound(breaks[d].begin(), breaks[d].end(), root.range[d].beg()) - breaks[d].begin());
+			patchRoots[((size_t)cell[0] * gridNum[1] + cell[1]) * gridNum[2] + cell[2]] = (int)nodes.size();
+
+			frontier.push_back((int)nodes.size());
+			nodes.push_back(root);
+			const auto& source = *patch.patch;
+			volumes.push_back(BezierVolume3d::create(source.getDegree(0), source.getDegree(1), source.getDegree(2), source.getCptsC(), false));
+		}
+
+		// Level by level, nodes of frontier are tested in parallel, linked serially, then split in parallel into lattices of next level
+		std::vector<char> split;
+		std::vector<int> firstChild;
+		while (!frontier.empty()) {
+			int num = (int)frontier.size();
+			split.assign(num, 0);
+			Parallel::forEach(0, num, [&](int i) {
+				split[i] = nodes[frontier[i]].depth < maxDepth && calError(volumes[i]) > tolerance;
+			});
+
+			std::vector<int> nextFrontier;
+			firstChild.assign(num, -1);
+			for (int i = 0; i < num; i++) {
+				int id = frontier[i];
+				if (!split[i]) {
+					nodes[id].leaf = (int)leafNodes.size();
+					leafNodes.push_back(id);
+					leaves.add(std::move(volumes[i]));
+					continue;
+				}
+				firstChild[i] = (int)nextFrontier.size();
+				nodes[id].child = (int)nodes.size();
+				for (int c = 0; c < 8; c++) {
+					Node child;
+					for (int d = 0; d < 3; d++)
+						child.range[d] = halfDomain(nodes[id].range[d], (c >> (2 - d)) & 1);
+					child.patch = nodes[id].patch;
+					child.depth = nodes[id].depth + 1;
+					nextFrontier.push_back((int)nodes.size());
+					nodes.push_back(child);
+				}
+			}
+			std::vector<BezierVolume3d> nextVolumes(nextFrontier.size(), BezierVolume3d::create());
+			Parallel::forEach(0, num, [&](int i) {
+				if (split[i])
+					splitOctants(volumes[i], &nextVolumes[firstChild[i]]);
+			});
+			frontier.swap(nextFrontier);
+			volumes.swap(nextVolumes);
+		}
+
+		if (buildMat)
+			Parallel::forEach(0, (int)leaves.size(), [&](int i) {
+				leaves[i].updateDerivMat();
+			});
+	}
+
+	VolumeOctree3d::Location VolumeOctree3d::locate(Real u, Real v, Real w) const {
+		Real param[3] = { u, v, w };
+		int cell[3];
+		for (int d = 0; d < 3; d++) {
+			const auto& dBreaks = breaks[d];
+			if (dBreaks.size() < 2 || param[d] < dBreaks.front() || param[d] > dBreaks.back())
+				throw(std::runtime_error("Invalid parameter for volume octree location"));
+			// End of domain belongs to the last interval
+			cell[d] = (int)(std::upper_bound(dBreaks.begin(), dBreaks.end() - 1, param[d]) - dBreaks.begin()) - 1;
+		}
+		int id = patchRoots[((size_t)cell[0] * (breaks[1].size() - 1) + cell[1]) * (breaks[2].size() - 1) + cell[2]];
+		if (id < 0)
+			throw(std::runtime_error("Invalid parameter for volume octree location"));
+
+		while (nodes[id].child >= 0) {
+			int c = 0;
+			for (int d = 0; d < 3; d++) {
+				const Domain& range = nodes[id].range[d];
+				if (param[d] >= range.beg() + range.width() * 0.5)
+					c |= 1 << (2 - d);
+			}
+			id = nodes[id].child + c;
+		}
+		const Node& leaf = nodes[id];
+		Location location;
+		location.leaf = leaf.leaf;
+		location.u = (u - leaf.range[0].beg()) / leaf.range[0].width();
+		location.v = (v - leaf.range[1].beg()) / leaf.range[1].width();
+		location.w = (w - leaf.range[2].beg()) / leaf.range[2].width();
+		return location;
+	}
+}
@@ -0,0 +1,154 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __MN_VOLUME_OCTREE_3D_H__
+#define __MN_VOLUME_OCTREE_3D_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "../Freeform.h"
+#include "BezierVolume3d.h"
+#include "BsplineVolume3d.h"
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace MN {
+	/*
+	 * Objects allocated in blocks of [blockSize], so that they stay in place while pool grows and are not allocated one by one.
+	 * Objects are only added, and destroyed together with pool.
+	 */
+	template<typename T, int blockSize = 256>
+	class ObjectPool {
+	private:
+		using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+		std::vector<std::unique_ptr<Storage[]>> blocks;
+		size_t count = 0;
+	public:
+		ObjectPool() = default;
+		ObjectPool(const ObjectPool&) = delete;
+		ObjectPool& operator=(const ObjectPool&) = delete;
+		ObjectPool(ObjectPool&& other) noexcept : blocks(std::move(other.blocks)), count(other.count) {
+			other.count = 0;
+		}
+		ObjectPool& operator=(ObjectPool&& other) noexcept {
+			if (this != &other) {
+				clear();
+				blocks = std::move(other.blocks);
+				count = other.count;
+				other.count = 0;
+			}
+			return *this;
+		}
+		~ObjectPool() {
+			clear();
+		}
+
+		inline T& add(T&& object) {
+			if (count == blocks.size() * blockSize)
+				blocks.emplace_back(new Storage[blockSize]);
+			T* slot = reinterpret_cast<T*>(&blocks[count / blockSize][count % blockSize]);
+			new (slot) T(std::move(object));
+			count++;
+			return *slot;
+		}
+		inline T& operator[](size_t i) noexcept {
+			return *reinterpret_cast<T*>(&blocks[i / blockSize][i % blockSize]);
+		}
+		inline const T& operator[](size_t i) const noexcept {
+			return *reinterpret_cast<const T*>(&blocks[i / blockSize][i % blockSize]);
+		}
+		inline size_t size() const noexcept {
+			return count;
+		}
+		void clear() noexcept {
+			for (size_t i = 0; i < count; i++)
+				(*this)[i].~T();
+			blocks.clear();
+			count = 0;
+		}
+	};
+
+	/*
+	 * Octree over patches of Bspline / Bezier volume, refined until each leaf meets error criterion.
+	 * Flatness : Largest distance of control points from trilinear interpolation of corner control points.
+	 * Jacobian : Relative variation (max - min) / max(|max|, |min|) of Bernstein coefficients of det(J), which bound det(J) over leaf.
+	 * Each level is refined in parallel, splitting nodes at midpoints without deriv matrices, and lattices of interior nodes are dropped after split.
+	 * Only leaves keep Bezier volumes, stored in pool, and only they are given deriv matrices when asked.
+	 */
+	class VolumeOctree3d {
+	public:
+		using Ptr = std::shared_ptr<VolumeOctree3d>;
+		enum class Criterion {
+			Flatness,
+			Jacobian
+		};
+		class Node {
+		public:
+			Domain range[3] = { Domain::create(0, 1), Domain::create(0, 1), Domain::create(0, 1) };	// Domain of node in parameter of original volume
+			int patch = -1;			// Index of patch of original volume
+			int depth = 0;
+			int child = -1;			// First of 8 children, in order of (u, v, w) halves as bits (4, 2, 1), or -1 for leaf
+			int leaf = -1;			// Index of leaf volume, or -1 for interior node
+		};
+		// Leaf that has parameter, and local parameter of leaf volume in [0, 1]
+		class Location {
+		public:
+			int leaf = -1;
+			Real u = 0, v = 0, w = 0;
+		};
+	private:
+		VolumeOctree3d() = default;
+
+		Criterion criterion = Criterion::Flatness;
+		Real tolerance = 0;
+		int maxDepth = 0;
+		bool buildMat = false;
+		std::vector<Node> nodes;				// Roots of patches come first
+		std::vector<int> leafNodes;				// Node of each leaf
+		ObjectPool<BezierVolume3d> leaves;
+		std::vector<Real> breaks[3];			// Sorted ends of patch subdomains in each direction
+		std::vector<int> patchRoots;			// Root of patch at interval (i, j, k) of breaks, at [ (i * vNum + j) * wNum + k ]
+
+		void build(const std::vector<BsplineVolume3d::Patch>& patches);
+		Real calError(const BezierVolume3d& volume) const;
+	public:
+		// @tolerance : Leaf is not split further when its error is not larger than this
+		// @maxDepth : Maximum depth of leaf, where root of each patch is at depth 0
+		// @buildMat : Whether to build deriv matrices of leaves, needed for their differentiation
+		static VolumeOctree3d create(const BsplineVolume3d& volume, Criterion criterion, Real tolerance, int maxDepth = 6, bool buildMat = false);
+		static VolumeOctree3d create(const BezierVolume3d& volume, Criterion criterion, Real tolerance, int maxDepth = 6, bool buildMat = false);
+		static Ptr createPtr(const BsplineVolume3d& volume, Criterion criterion, Real tolerance, int maxDepth = 6, bool buildMat = false);
+		static Ptr createPtr(const BezierVolume3d& volume, Criterion criterion, Real tolerance, int maxDepth = 6, bool buildMat = false);
+
+		// Error of volume by criterion of this octree
+		static Real flatness(const BezierVolume3d& volume);
+		static Real jacobianVariation(const BezierVolume3d& volume);
+
+		inline const std::vector<Node>& getNodes() const noexcept {
+			return nodes;
+		}
+		inline int getLeafNum() const noexcept {
+			return (int)leafNodes.size();
+		}
+		inline const BezierVolume3d& getLeaf(int i) const noexcept {
+			return leaves[i];
+		}
+		inline const Node& getLeafNode(int i) const noexcept {
+			return nodes[leafNodes[i]];
+		}
+
+		// Leaf that has parameter (u, v, w) of original volume, which must be in its domain
+		Location locate(Real u, Real v, Real w) const;
+	};
+}
+
+#endif